@@ -22,12 +22,22 @@
 #include "_test_random.h"
 #include "_test_arena.h"
 #include "_test_array.h"
+#include "_test_array_simd.h"
 #include "_test_hash.h"
 #include "_test_log.h"
 #include "_test_math.h"
 #include "_test_stable_array.h"
+#include "_test_block_list.h"
+#include "_test_bitset.h"
+#include "_test_allocator_tlsf_threaded.h"
+#include "_test_allocator_pool.h"
+#include "_test_allocator_debug.h"
+#include "_test_allocator_stats.h"
+#include "_test_allocator_sampling.h"
+#include "_test_allocator_tracking_threaded.h"
 #include "_test_image.h"
 #include "_test_chase_lev_queue.h"
+#include "_test_channel_shared.h"
 #include "_test_string_map.h"
 
 typedef enum Test_Func_Type {
@@ -67,11 +77,22 @@ static void test_all(double total_time)
         // TIMED_TEST(test_string_map), //currently broken?
         TIMED_TEST(test_hash),
         TIMED_TEST(test_array),
+        TIMED_TEST(test_array_simd),
+        TIMED_TEST(test_block_list),
+        TIMED_TEST(test_bitset),
         TIMED_TEST(test_math),
         TIMED_TEST(test_string),
         TIMED_TEST(test_allocator_tlsf),
+        TIMED_TEST(test_allocator_tlsf_threaded),
+        TIMED_TEST(test_allocator_pool),
+        UNIT_TEST(test_allocator_debug),
+        UNIT_TEST(test_allocator_stats),
+        UNIT_TEST(test_allocator_sampling),
+        TIMED_TEST(test_allocator_sampling_stress),
+        TIMED_TEST(test_allocator_tracking_threaded),
         TIMED_TEST(slz4_test),
         TIMED_TEST(test_chase_lev_queue),
+        UNIT_TEST(test_channel_shared),
         UNIT_TEST(NULL)
     );
 }
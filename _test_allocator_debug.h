@@ -0,0 +1,125 @@
+#pragma once
+
+#include "allocator_debug.h"
+
+typedef struct _Test_Debug_Guard_Access {
+    volatile u8* ptr;
+    isize offset;
+    bool write;
+} _Test_Debug_Guard_Access;
+
+INTERNAL void _test_debug_guard_access(void* context)
+{
+    _Test_Debug_Guard_Access* access = (_Test_Debug_Guard_Access*) context;
+    if(access->write)
+        access->ptr[access->offset] = 0;
+    else
+        (void) access->ptr[access->offset];
+}
+
+INTERNAL Platform_Exception _test_debug_guard_try_access(void* ptr, isize offset, bool write)
+{
+    _Test_Debug_Guard_Access access = {(volatile u8*) ptr, offset, write};
+    return platform_exception_sandbox(_test_debug_guard_access, &access, NULL, NULL);
+}
+
+INTERNAL void _test_debug_guard_panic(Debug_Allocator* allocator, Debug_Allocator_Panic_Reason reason, Debug_Allocation allocation, isize penetration, void* context)
+{
+    (void) allocator; (void) allocation; (void) penetration;
+    *(Debug_Allocator_Panic_Reason*) context = reason;
+}
+
+INTERNAL void test_allocator_debug_guard_pages()
+{
+    Debug_Allocator_Panic_Reason panic_reason = DEBUG_ALLOC_PANIC_NONE;
+    Debug_Allocator_Options options = {0};
+    options.use_guard_pages = true;
+    options.guard_delay_free_count = 4;
+    options.captured_callstack_size = 8;
+    options.panic_handler = _test_debug_guard_panic;
+    options.panic_context = &panic_reason;
+
+    Debug_Allocator debug = {0};
+    debug_allocator_init_custom(&debug, allocator_get_malloc(), options);
+    {
+        isize page_size = platform_page_size();
+
+        //User data ends right before the guard page (up to alignment)
+        isize sizes[] = {1, 13, 16, 100, 4096, 5000, 3*4096 + 8};
+        isize aligns[] = {1, 8, 16, 64, 256};
+        for(isize i = 0; i < ARRAY_LEN(sizes); i++)
+            for(isize j = 0; j < ARRAY_LEN(aligns); j++)
+            {
+                isize size = sizes[i];
+                isize align = aligns[j];
+                u8* ptr = (u8*) allocator_allocate(debug.alloc, size, align);
+                TEST((uintptr_t) ptr % (uintptr_t) align == 0);
+                TEST((uintptr_t) (ptr + size) % (uintptr_t) page_size == 0 || page_size - (isize) ((uintptr_t) (ptr + size) % (uintptr_t) page_size) < MAX(align, DEF_ALIGN));
+                memset(ptr, 0x11, (size_t) size);
+                allocator_deallocate(debug.alloc, ptr, size, align);
+            }
+        TEST(panic_reason == DEBUG_ALLOC_PANIC_NONE);
+
+        //Overruns fault immediately
+        u8* ptr = (u8*) allocator_allocate(debug.alloc, 64, 8);
+        TEST(_test_debug_guard_try_access(ptr, 63, true) == PLATFORM_EXCEPTION_NONE);
+        TEST(_test_debug_guard_try_access(ptr, 64, true) == PLATFORM_EXCEPTION_ACCESS_VIOLATION);
+        TEST(_test_debug_guard_try_access(ptr, 64, false) == PLATFORM_EXCEPTION_ACCESS_VIOLATION);
+
+        //Reallocation keeps the data and moves the guard page
+        for(isize i = 0; i < 64; i++)
+            ptr[i] = (u8) i;
+        ptr = (u8*) allocator_reallocate(debug.alloc, 1000, ptr, 64, 8);
+        for(isize i = 0; i < 64; i++)
+            TEST(ptr[i] == (u8) i);
+        TEST(_test_debug_guard_try_access(ptr, 1000, true) == PLATFORM_EXCEPTION_ACCESS_VIOLATION);
+
+        //Use after free faults while the block is delayed
+        allocator_deallocate(debug.alloc, ptr, 1000, 8);
+        TEST(_test_debug_guard_try_access(ptr, 0, false) == PLATFORM_EXCEPTION_ACCESS_VIOLATION);
+        TEST(debug.guard_delayed_frees.count > 0 && debug.guard_delayed_frees.count <= 4);
+
+        //Overwrites of the alignment padding before the guard page are caught by the dead zone check
+        u8* unaligned = (u8*) allocator_allocate(debug.alloc, 13, 8);
+        unaligned[13] = 0;
+        allocator_deallocate(debug.alloc, unaligned, 13, 8);
+        TEST(panic_reason == DEBUG_ALLOC_PANIC_OVERWRITE_AFTER_BLOCK);
+        unaligned[13] = DEBUG_ALLOCATOR_MAGIC_NUM8;
+        allocator_deallocate(debug.alloc, unaligned, 13, 8);
+
+        //With align bigger than a page the padding before the guard page can span whole pages.
+        // Depending on where the block gets mapped one of the sizes results in at least a page of padding.
+        isize big_align = 2*page_size;
+        isize big_sizes[] = {1, page_size + 1};
+        for(isize i = 0; i < ARRAY_LEN(big_sizes); i++)
+        {
+            isize size = big_sizes[i];
+            u8* big = (u8*) allocator_allocate(debug.alloc, size, big_align);
+            TEST((uintptr_t) big % (uintptr_t) big_align == 0);
+
+            isize guard_offset = (u8*) align_forward(big + size, page_size) - big;
+            if(_test_debug_guard_try_access(big, guard_offset, false) == PLATFORM_EXCEPTION_NONE)
+                guard_offset += page_size;
+            TEST(_test_debug_guard_try_access(big, guard_offset, false) == PLATFORM_EXCEPTION_ACCESS_VIOLATION);
+
+            //Overwrite of the last byte before the guard page
+            panic_reason = DEBUG_ALLOC_PANIC_NONE;
+            big[guard_offset - 1] = 0;
+            allocator_deallocate(debug.alloc, big, size, big_align);
+            TEST(panic_reason == DEBUG_ALLOC_PANIC_OVERWRITE_AFTER_BLOCK);
+            big[guard_offset - 1] = DEBUG_ALLOCATOR_MAGIC_NUM8;
+            panic_reason = DEBUG_ALLOC_PANIC_NONE;
+            allocator_deallocate(debug.alloc, big, size, big_align);
+            TEST(panic_reason == DEBUG_ALLOC_PANIC_NONE);
+        }
+
+        Allocator_Stats stats = allocator_get_stats(debug.alloc);
+        TEST(stats.bytes_allocated == 0);
+    }
+    debug_allocator_deinit(&debug);
+}
+
+INTERNAL void test_allocator_debug()
+{
+    test_allocator_debug_guard_pages();
+}
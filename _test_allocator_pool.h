@@ -0,0 +1,282 @@
+#pragma once
+
+#include "allocator_pool.h"
+#include "allocator_debug.h"
+#include "stable_array.h"
+#include "list.h"
+#include "sync.h"
+#include "random.h"
+#include "time.h"
+
+typedef struct _Test_Pool_Node {
+    struct _Test_Pool_Node* next;
+    isize value;
+} _Test_Pool_Node;
+
+INTERNAL void test_allocator_pool_unit()
+{
+    Debug_Allocator debug_alloc = {0};
+    debug_allocator_init(&debug_alloc, allocator_get_default(), DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK);
+    {
+        Pool_Allocator pool = {0};
+        pool_allocator_init_custom(&pool, debug_alloc.alloc, 20, 8, 1024, 0, "test pool");
+        pool_allocator_test_invariants(&pool);
+        TEST(pool.chunk_size == 24);
+        TEST(pool_allocator_fits(&pool, 24, 8));
+        TEST(pool_allocator_fits(&pool, 25, 8) == false);
+        TEST(pool_allocator_fits(&pool, 8, 16) == false);
+
+        //Allocation is lazy
+        TEST(pool.slab_count == 0);
+        void* a = pool_allocator_allocate(&pool);
+        void* b = pool_allocator_allocate(&pool);
+        TEST(a && b && a != b);
+        TEST((uintptr_t) a % 8 == 0 && (uintptr_t) b % 8 == 0);
+        TEST(pool.slab_count == 1);
+
+        //Last freed is first reused
+        pool_allocator_deallocate(&pool, a);
+        TEST(pool_allocator_allocate(&pool) == a);
+        pool_allocator_deallocate(&pool, a);
+        pool_allocator_deallocate(&pool, b);
+        pool_allocator_deallocate(&pool, NULL);
+        pool_allocator_test_invariants(&pool);
+
+        //Allocator interface: fitting requests are pooled, reallocs within chunk are in place, others forwarded
+        Allocator* alloc = pool.alloc;
+        isize parent_bytes = debug_alloc.bytes_allocated;
+        u8* small = (u8*) allocator_allocate(alloc, 10, 4);
+        memset(small, 0x11, 10);
+        TEST(debug_alloc.bytes_allocated == parent_bytes);
+        TEST(allocator_reallocate(alloc, 20, small, 10, 4) == small);
+
+        u8* big = (u8*) allocator_reallocate(alloc, 100, small, 20, 4);
+        TEST(big != small);
+        TEST(big[0] == 0x11 && big[9] == 0x11);
+        TEST(debug_alloc.bytes_allocated == parent_bytes + 100);
+        big = (u8*) allocator_reallocate(alloc, 200, big, 100, 4);
+        TEST(big[0] == 0x11 && big[9] == 0x11);
+
+        u8* back = (u8*) allocator_reallocate(alloc, 16, big, 200, 4);
+        TEST(back[0] == 0x11 && back[9] == 0x11);
+        TEST(debug_alloc.bytes_allocated == parent_bytes);
+
+        void* overaligned = allocator_allocate(alloc, 16, 64);
+        TEST((uintptr_t) overaligned % 64 == 0);
+        TEST(debug_alloc.bytes_allocated > parent_bytes);
+        allocator_deallocate(alloc, overaligned, 16, 64);
+        allocator_deallocate(alloc, back, 16, 4);
+
+        Allocator_Stats stats = allocator_get_stats(alloc);
+        TEST(stats.bytes_allocated == 0);
+        TEST(stats.allocation_count == stats.deallocation_count);
+        TEST(stats.is_capable_of_free_all);
+
+        //Fill multiple slabs then free all
+        enum {NODES = 1000};
+        _Test_Pool_Node* first = NULL;
+        for(isize i = 0; i < NODES; i++)
+        {
+            _Test_Pool_Node* node = (_Test_Pool_Node*) allocator_allocate(alloc, sizeof(_Test_Pool_Node), 8);
+            node->value = i;
+            chain_push_nil(first, node, next, NULL);
+        }
+        TEST(pool.slab_count > 1);
+        pool_allocator_test_invariants(&pool);
+
+        isize expected = NODES;
+        for(_Test_Pool_Node* node = first; node; node = node->next)
+            TEST(node->value == --expected);
+
+        pool_allocator_free_all(&pool);
+        pool_allocator_test_invariants(&pool);
+        TEST(pool.bytes_allocated == 0);
+        TEST(pool.slab_count == 0);
+        TEST(debug_alloc.bytes_allocated == 0);
+
+        pool_allocator_deinit(&pool);
+    }
+    debug_allocator_deinit(&debug_alloc);
+}
+
+INTERNAL void test_allocator_pool_stress(f64 max_seconds)
+{
+    Debug_Allocator debug_alloc = {0};
+    debug_allocator_init(&debug_alloc, allocator_get_default(), DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK);
+    {
+        enum {LIVE = 1000, MIN_ITERS = 10000, CHECK_EVERY = 1000};
+        isize chunk_size = random_range(8, 200);
+        isize chunk_align = (isize) 1 << random_range(3, 7);
+
+        Pool_Allocator pool = {0};
+        pool_allocator_init_custom(&pool, debug_alloc.alloc, chunk_size, chunk_align, random_range(0, 4096), 0, "stress pool");
+
+        u8* ptrs[LIVE] = {0};
+        isize sizes[LIVE] = {0};
+        f64 start = clock_s();
+        for(isize iter = 0; clock_s() - start < max_seconds || iter < MIN_ITERS; iter++)
+        {
+            isize i = random_range(0, LIVE);
+            if(ptrs[i])
+            {
+                for(isize k = 0; k < sizes[i]; k++)
+                    TEST(ptrs[i][k] == (u8) i);
+                allocator_deallocate(pool.alloc, ptrs[i], sizes[i], chunk_align);
+                ptrs[i] = NULL;
+            }
+            else
+            {
+                //Mostly pooled sizes with a few forwarded ones
+                sizes[i] = random_range(1, random_range(0, 10) ? chunk_size + 1 : 4*chunk_size);
+                ptrs[i] = (u8*) allocator_allocate(pool.alloc, sizes[i], chunk_align);
+                TEST((uintptr_t) ptrs[i] % (uintptr_t) chunk_align == 0);
+                memset(ptrs[i], (u8) i, (size_t) sizes[i]);
+            }
+
+            if(iter % CHECK_EVERY == 0)
+                pool_allocator_test_invariants(&pool);
+        }
+
+        for(isize i = 0; i < LIVE; i++)
+            if(ptrs[i])
+                allocator_deallocate(pool.alloc, ptrs[i], sizes[i], chunk_align);
+
+        pool_allocator_test_invariants(&pool);
+        TEST(pool.bytes_allocated == 0);
+        pool_allocator_deinit(&pool);
+    }
+    debug_allocator_deinit(&debug_alloc);
+}
+
+INTERNAL void test_allocator_pool_stable_array()
+{
+    Debug_Allocator debug_alloc = {0};
+    debug_allocator_init(&debug_alloc, allocator_get_default(), DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK);
+    {
+        //Small reserves allocate exactly one block of items which is exactly one chunk. Bigger ones
+        // and the blocks array once it outgrows the chunk are forwarded to the parent.
+        enum {ITEM_SIZE = 16, BLOCK_BYTES = ITEM_SIZE*STABLE_ARRAY_BLOCK_SIZE, INSERTS = 10000};
+        Pool_Allocator pool = {0};
+        pool_allocator_init(&pool, debug_alloc.alloc, BLOCK_BYTES, DEF_ALIGN, "stable array pool");
+
+        Stable_Array stable = {0};
+        stable_array_init_custom(&stable, pool.alloc, ITEM_SIZE, DEF_ALIGN, BLOCK_BYTES);
+        for(isize i = 0; i < INSERTS; i++)
+        {
+            isize* item = NULL;
+            TEST(stable_array_insert(&stable, (void**) &item) == i);
+            *item = i;
+        }
+        stable_array_test_invariants(&stable, true);
+        TEST(stable.blocks_capacity*isizeof(Stable_Array_Block) > BLOCK_BYTES);
+        TEST(pool.chunks_allocated > 0);
+        TEST(pool.concurrent_allocations > pool.chunks_allocated);
+
+        for(isize i = 0; i < INSERTS; i += 2)
+            stable_array_remove(&stable, i);
+        for(isize i = 1; i < INSERTS; i += 2)
+            TEST(*(isize*) stable_array_at(&stable, i) == i);
+
+        stable_array_deinit(&stable);
+        TEST(pool.bytes_allocated == 0);
+        pool_allocator_test_invariants(&pool);
+        pool_allocator_deinit(&pool);
+    }
+    debug_allocator_deinit(&debug_alloc);
+}
+
+typedef struct _Test_Pool_Magazine_Context {
+    Pool_Allocator* pool;
+    CHAN_ATOMIC(void*)* exchange;
+    isize exchange_count;
+    CHAN_ATOMIC(uint32_t)* run;
+    Wait_Group* done;
+    uint64_t seed;
+    isize iters;
+} _Test_Pool_Magazine_Context;
+
+INTERNAL void _test_pool_magazine_runner(void* context)
+{
+    enum {LIVE = 256};
+    _Test_Pool_Magazine_Context* c = (_Test_Pool_Magazine_Context*) context;
+    Random_State rand = random_state_make(c->seed);
+    Pool_Magazine magazine = {0};
+    pool_magazine_init(&magazine, c->pool);
+
+    //Each chunk holds its own address so that writes by others would be caught
+    void* live[LIVE] = {0};
+    while(atomic_load_explicit(c->run, memory_order_relaxed))
+    {
+        isize i = random_range_from(&rand, 0, LIVE);
+        if(live[i])
+        {
+            TEST(*(void**) live[i] == live[i]);
+            if(random_range_from(&rand, 0, 4) == 0)
+            {
+                isize slot = random_range_from(&rand, 0, c->exchange_count);
+                live[i] = atomic_exchange(&c->exchange[slot], live[i]);
+                if(live[i])
+                    TEST(*(void**) live[i] == live[i]);
+                continue;
+            }
+            pool_magazine_deallocate(&magazine, live[i]);
+        }
+
+        live[i] = pool_magazine_allocate(&magazine);
+        TEST(live[i] != NULL);
+        *(void**) live[i] = live[i];
+        c->iters += 1;
+    }
+
+    for(isize i = 0; i < LIVE; i++)
+        pool_magazine_deallocate(&magazine, live[i]);
+
+    pool_magazine_deinit(&magazine);
+    wait_group_pop(c->done, 1, SYNC_WAIT_BLOCK);
+}
+
+INTERNAL void test_allocator_pool_magazines(f64 max_seconds, isize thread_count)
+{
+    enum {MAX_THREADS = 64, EXCHANGE = 64};
+    TEST(thread_count <= MAX_THREADS);
+
+    Pool_Allocator pool = {0};
+    pool_allocator_init_custom(&pool, NULL, 64, 0, 0, POOL_ALLOCATOR_THREAD_SAFE, "magazine pool");
+
+    CHAN_ATOMIC(void*) exchange[EXCHANGE] = {0};
+    CHAN_ATOMIC(uint32_t) run = 1;
+    Wait_Group done = {0};
+    wait_group_push(&done, thread_count);
+    _Test_Pool_Magazine_Context contexts[MAX_THREADS] = {0};
+    for(isize i = 0; i < thread_count; i++)
+    {
+        contexts[i].pool = &pool;
+        contexts[i].exchange = exchange;
+        contexts[i].exchange_count = EXCHANGE;
+        contexts[i].run = &run;
+        contexts[i].done = &done;
+        contexts[i].seed = random_u64();
+        TEST(chan_start_thread(_test_pool_magazine_runner, &contexts[i]));
+    }
+
+    platform_thread_sleep(max_seconds);
+    atomic_store(&run, 0);
+    wait_group_wait(&done, SYNC_WAIT_BLOCK);
+
+    for(isize i = 0; i < EXCHANGE; i++)
+        pool_allocator_deallocate(&pool, atomic_load(&exchange[i]));
+
+    pool_allocator_test_invariants(&pool);
+    TEST(pool.bytes_allocated == 0);
+    TEST(pool.concurrent_allocations == 0);
+    pool_allocator_deinit(&pool);
+}
+
+INTERNAL void test_allocator_pool(f64 max_seconds)
+{
+    test_allocator_pool_unit();
+    test_allocator_pool_stable_array();
+    test_allocator_pool_stress(max_seconds/2);
+    test_allocator_pool_magazines(max_seconds/4, 1);
+    test_allocator_pool_magazines(max_seconds/4, 8);
+}
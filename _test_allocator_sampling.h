@@ -0,0 +1,161 @@
+#pragma once
+
+#include "allocator_sampling.h"
+#include "allocator_debug.h"
+#include "sync.h"
+#include "random.h"
+
+INTERNAL void test_allocator_sampling_unit()
+{
+    //About ALLOCS*MAX_SIZE/2/PERIOD = 1000 samples. Kept low since the debug hash invariant checks make this quadratic in ALLOCS.
+    enum {PERIOD = 512, ALLOCS = 2000, MAX_SIZE = 512};
+    Debug_Allocator debug = {0};
+    debug_allocator_init(&debug, allocator_get_malloc(), DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK | DEBUG_ALLOCATOR_NO_DEAD_ZONE);
+    {
+        Sampling_Allocator sampling = {0};
+        sampling_allocator_init(&sampling, debug.alloc, PERIOD, "test sampling");
+
+        void** ptrs = (void**) malloc(ALLOCS*sizeof(void*));
+        isize* sizes = (isize*) malloc(ALLOCS*sizeof(isize));
+        isize total = 0;
+        for(isize i = 0; i < ALLOCS; i++)
+        {
+            sizes[i] = random_range(16, MAX_SIZE);
+            ptrs[i] = allocator_allocate(sampling.alloc, sizes[i], 8);
+            memset(ptrs[i], (u8) i, (size_t) sizes[i]);
+            total += sizes[i];
+        }
+
+        //About total/PERIOD samples each carrying on average PERIOD bytes.
+        // The estimate should be well within 20% (the standard deviation is around 3%).
+        TEST(sampling.live_sample_count > 0);
+        TEST(sampling.live_sample_count == sampling.samples_hash.count);
+        TEST(sampling.live_sampled_bytes < total);
+        TEST(sampling.live_estimated_bytes > total*8/10 && sampling.live_estimated_bytes < total*12/10);
+
+        //Big allocations are (practically) always sampled with weight close to their size
+        isize big_size = 30*PERIOD;
+        void* big = allocator_allocate(sampling.alloc, big_size, 64);
+        Sampling_Allocator_Sample_Array samples = {0};
+        array_init(&samples, allocator_get_default());
+        TEST(sampling_allocator_get_samples(&sampling, &samples) == sampling.live_sample_count);
+
+        Sampling_Allocator_Sample* big_sample = NULL;
+        for(isize i = 0; i < samples.count; i++)
+        {
+            TEST(samples.data[i].call_stack_size > 0);
+            TEST(samples.data[i].weight >= samples.data[i].size);
+            if(samples.data[i].ptr == big)
+                big_sample = &samples.data[i];
+        }
+        TEST(big_sample && big_sample->size == big_size && big_sample->align == 64);
+        TEST(big_sample->weight == big_size);
+
+        //Reallocating a sampled block moves its sample (or drops it if not resampled)
+        isize before = sampling.live_sample_count;
+        big = allocator_reallocate(sampling.alloc, 2*big_size, big, big_size, 64);
+        TEST(sampling.live_sample_count == before);
+
+        String_Builder folded = builder_make(allocator_get_default(), 0);
+        sampling_allocator_write_folded(&sampling, &folded);
+        TEST(folded.count > 0 && folded.data[folded.count - 1] == '\n');
+
+        String_Builder pprof = builder_make(allocator_get_default(), 0);
+        sampling_allocator_write_pprof(&sampling, &pprof);
+        TEST(string_is_prefixed_with(pprof.string, STRING("heap profile: ")));
+        TEST(string_find_first(pprof.string, STRING("@ heap_v2/512\n"), 0) != -1);
+
+        //Freeing removes the samples
+        allocator_deallocate(sampling.alloc, big, 2*big_size, 64);
+        for(isize i = 0; i < ALLOCS; i++)
+        {
+            TEST(*(u8*) ptrs[i] == (u8) i);
+            allocator_deallocate(sampling.alloc, ptrs[i], sizes[i], 8);
+        }
+        TEST(sampling.live_sample_count == 0);
+        TEST(sampling.live_sampled_bytes == 0);
+        TEST(sampling.live_estimated_bytes == 0);
+        TEST(sampling.samples_hash.count == 0);
+        for(isize i = 0; i < SAMPLING_ALLOCATOR_FILTER_SIZE; i++)
+            TEST(sampling.filter[i] == 0);
+
+        Allocator_Stats stats = allocator_get_stats(sampling.alloc);
+        TEST(stats.parent == debug.alloc);
+        TEST(stats.allocation_count == sampling.sample_count);
+
+        builder_deinit(&pprof);
+        builder_deinit(&folded);
+        array_deinit(&samples);
+        free(sizes);
+        free(ptrs);
+        sampling_allocator_deinit(&sampling);
+    }
+    debug_allocator_deinit(&debug);
+}
+
+typedef struct _Test_Sampling_Context {
+    Sampling_Allocator* sampling;
+    Wait_Group* done;
+    CHAN_ATOMIC(uint32_t)* run;
+    isize iters; //runs at least iters iterations and then until run is cleared
+} _Test_Sampling_Context;
+
+INTERNAL void _test_allocator_sampling_runner(void* context)
+{
+    enum {LIVE = 256};
+    _Test_Sampling_Context* c = (_Test_Sampling_Context*) context;
+    void* live[LIVE] = {0};
+    isize sizes[LIVE] = {0};
+    for(isize iter = 0; iter < c->iters || atomic_load_explicit(c->run, memory_order_relaxed); iter++)
+    {
+        isize i = random_range(0, LIVE);
+        isize new_size = random_range(0, 2) ? random_range(1, 1024) : 0;
+        live[i] = allocator_reallocate(c->sampling->alloc, new_size, live[i], sizes[i], 8);
+        sizes[i] = new_size;
+    }
+    for(isize i = 0; i < LIVE; i++)
+        allocator_deallocate(c->sampling->alloc, live[i], sizes[i], 8);
+    wait_group_pop(c->done, 1, SYNC_WAIT_BLOCK);
+}
+
+INTERNAL void test_allocator_sampling_threaded(isize thread_count, isize iters, double seconds)
+{
+    enum {MAX_THREADS = 16};
+    TEST(thread_count <= MAX_THREADS);
+
+    Sampling_Allocator sampling = {0};
+    sampling_allocator_init(&sampling, allocator_get_malloc(), 1024, "threaded sampling");
+
+    CHAN_ATOMIC(uint32_t) run = 1;
+    Wait_Group done = {0};
+    wait_group_push(&done, thread_count);
+    _Test_Sampling_Context contexts[MAX_THREADS] = {0};
+    for(isize i = 0; i < thread_count; i++)
+    {
+        contexts[i].sampling = &sampling;
+        contexts[i].done = &done;
+        contexts[i].run = &run;
+        contexts[i].iters = iters;
+        TEST(chan_start_thread(_test_allocator_sampling_runner, &contexts[i]));
+    }
+    platform_thread_sleep(seconds);
+    atomic_store(&run, 0);
+    wait_group_wait(&done, SYNC_WAIT_BLOCK);
+
+    TEST(sampling.sample_count > 0);
+    TEST(sampling.live_sample_count == 0);
+    TEST(sampling.live_estimated_bytes == 0);
+    sampling_allocator_deinit(&sampling);
+}
+
+INTERNAL void test_allocator_sampling()
+{
+    test_allocator_sampling_unit();
+    test_allocator_sampling_threaded(1, 20000, 0);
+}
+
+//Many threads sharing one sampling allocator for max_seconds
+INTERNAL void test_allocator_sampling_stress(double max_seconds)
+{
+    test_allocator_sampling_threaded(8, 5000, max_seconds);
+}
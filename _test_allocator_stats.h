@@ -0,0 +1,128 @@
+#pragma once
+
+#include "allocator_stats.h"
+#include "allocator_pool.h"
+#include "allocator_debug.h"
+#include "arena.h"
+
+INTERNAL isize _test_allocator_stats_find(const Allocator_Stats_Node* nodes, isize node_count, const char* name)
+{
+    for(isize i = 0; i < node_count; i++)
+        if(nodes[i].stats.name && strcmp(nodes[i].stats.name, name) == 0)
+            return i;
+    return -1;
+}
+
+INTERNAL void _test_allocator_stats_check_tree(const Allocator_Stats_Node* nodes, isize node_count)
+{
+    for(isize i = 0; i < node_count; i++)
+    {
+        const Allocator_Stats_Node* node = &nodes[i];
+        //Depth first order: parents come before their children and children follow right after
+        TEST(-1 <= node->parent && node->parent < i);
+        TEST(node->depth == (node->parent == -1 ? 0 : nodes[node->parent].depth + 1));
+        if(node->parent != -1)
+            TEST(nodes[i - 1].depth >= node->depth - 1);
+
+        isize children_bytes = 0;
+        for(i32 child = node->first_child; child != -1; child = nodes[child].next_sibling)
+        {
+            TEST(child > i && nodes[child].parent == i);
+            children_bytes += nodes[child].stats.bytes_allocated;
+        }
+        TEST(children_bytes == node->children_bytes_allocated);
+    }
+}
+
+INTERNAL void test_allocator_stats()
+{
+    bool was_enabled = allocator_registry_is_enabled();
+    allocator_registry_enable(true);
+    {
+        Debug_Allocator debug = {0};
+        debug_allocator_init(&debug, allocator_get_malloc(), DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK);
+        debug.name = "stats debug";
+
+        Pool_Allocator pool = {0};
+        pool_allocator_init_custom(&pool, debug.alloc, 64, 8, 0, 0, "stats pool");
+
+        Arena arena = {0};
+        TEST(arena_init(&arena, "stats arena", 16*MB, 0) == 0);
+
+        void* pooled = pool_allocator_allocate(&pool);
+        void* forwarded = allocator_allocate(pool.alloc, 1000, 8);
+        TEST(arena_push(&arena, 4096, 8) != NULL);
+
+        Allocator_Stats_Node_Array nodes = {0};
+        array_init(&nodes, allocator_get_default());
+        isize count = allocator_stats_snapshot(&nodes);
+        TEST(count == nodes.count);
+        _test_allocator_stats_check_tree(nodes.data, nodes.count);
+        allocator_stats_log("TEST", LOG_DEBUG, nodes.data, nodes.count);
+
+        isize debug_i = _test_allocator_stats_find(nodes.data, nodes.count, "stats debug");
+        isize pool_i = _test_allocator_stats_find(nodes.data, nodes.count, "stats pool");
+        isize arena_i = _test_allocator_stats_find(nodes.data, nodes.count, "stats arena");
+        TEST(debug_i != -1 && pool_i != -1 && arena_i != -1);
+        TEST(nodes.data[pool_i].parent == debug_i);
+        TEST(nodes.data[pool_i].is_registered);
+        TEST(nodes.data[debug_i].children_bytes_allocated == nodes.data[pool_i].stats.bytes_allocated);
+        TEST(nodes.data[arena_i].stats.bytes_allocated >= 4096);
+
+        //Malloc allocator is not registered but is reached as the parent of debug allocator
+        TEST(nodes.data[debug_i].parent != -1);
+        TEST(nodes.data[nodes.data[debug_i].parent].allocator == allocator_get_malloc());
+        TEST(nodes.data[nodes.data[debug_i].parent].is_registered == false);
+
+        //Round trip two appended snapshots
+        String_Builder stream = builder_make(allocator_get_default(), 0);
+        allocator_stats_serialize(&stream, nodes.data, nodes.count, 1);
+        allocator_stats_serialize(&stream, nodes.data, nodes.count, 2);
+
+        Allocator_Stats_Node_Array read = {0};
+        String_Builder names = builder_make(allocator_get_default(), 0);
+        array_init(&read, allocator_get_default());
+        String remaining = stream.string;
+        for(i64 expected_time = 1; expected_time <= 2; expected_time++)
+        {
+            i64 time = 0;
+            isize consumed = allocator_stats_deserialize(remaining, &read, &names, &time);
+            TEST(consumed > 0);
+            TEST(time == expected_time);
+            TEST(read.count == nodes.count);
+            _test_allocator_stats_check_tree(read.data, read.count);
+            for(isize i = 0; i < read.count; i++)
+            {
+                TEST(read.data[i].parent == nodes.data[i].parent);
+                TEST(read.data[i].stats.bytes_allocated == nodes.data[i].stats.bytes_allocated);
+                TEST(read.data[i].is_registered == nodes.data[i].is_registered);
+                TEST(strcmp(read.data[i].stats.name, nodes.data[i].stats.name ? nodes.data[i].stats.name : "") == 0);
+            }
+            remaining = string_tail(remaining, consumed);
+        }
+        TEST(remaining.count == 0);
+        TEST(allocator_stats_deserialize(string_head(stream.string, 20), &read, &names, NULL) == 0);
+
+        //Data written with the other endianness is rejected
+        SWAP(&stream.data[0], &stream.data[3]);
+        SWAP(&stream.data[1], &stream.data[2]);
+        TEST(allocator_stats_deserialize(stream.string, &read, &names, NULL) == 0);
+
+        //Deinited allocators disappear from the snapshot
+        allocator_deallocate(pool.alloc, forwarded, 1000, 8);
+        pool_allocator_deallocate(&pool, pooled);
+        pool_allocator_deinit(&pool);
+        arena_deinit(&arena);
+        allocator_stats_snapshot(&nodes);
+        TEST(_test_allocator_stats_find(nodes.data, nodes.count, "stats pool") == -1);
+        TEST(_test_allocator_stats_find(nodes.data, nodes.count, "stats arena") == -1);
+        TEST(_test_allocator_stats_find(nodes.data, nodes.count, "stats debug") != -1);
+
+        builder_deinit(&names);
+        builder_deinit(&stream);
+        array_deinit(&read);
+        array_deinit(&nodes);
+        debug_allocator_deinit(&debug);
+    }
+    allocator_registry_enable(was_enabled);
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include "allocator_tlsf_threaded.h"
+#include "random.h"
+#include "time.h"
+
+//Each live test block starts with its size and a seed byte and the rest is filled with the seed byte.
+// This lets whichever thread ends up freeing the block verify nobody else wrote into it.
+typedef struct _Test_Tlsf_Threaded_Block {
+    uint32_t size;
+    uint8_t seed;
+} _Test_Tlsf_Threaded_Block;
+
+INTERNAL void _test_tlsf_threaded_fill(void* ptr, isize size, uint8_t seed)
+{
+    TEST(size >= isizeof(_Test_Tlsf_Threaded_Block));
+    _Test_Tlsf_Threaded_Block* block = (_Test_Tlsf_Threaded_Block*) ptr;
+    memset(ptr, seed, (size_t) size);
+    block->size = (uint32_t) size;
+    block->seed = seed;
+}
+
+INTERNAL void _test_tlsf_threaded_check(void* ptr)
+{
+    _Test_Tlsf_Threaded_Block* block = (_Test_Tlsf_Threaded_Block*) ptr;
+    uint8_t* data = (uint8_t*) ptr;
+    for(isize i = isizeof(_Test_Tlsf_Threaded_Block); i < block->size; i++)
+        TEST(data[i] == block->seed);
+}
+
+INTERNAL void test_allocator_tlsf_threaded_unit()
+{
+    enum {MEMORY_SIZE = 4*1024*1024, NODES = 16*1024, CACHES = 4, ALLOCS = 1000};
+    void* memory = malloc(MEMORY_SIZE);
+    void* nodes = malloc(NODES*sizeof(Tlsf_Node));
+    Tlsf_Thread_Cache* caches = (Tlsf_Thread_Cache*) aligned_alloc(CHAN_CACHE_LINE, CACHES*sizeof(Tlsf_Thread_Cache));
+    void** ptrs = (void**) malloc(ALLOCS*sizeof(void*));
+
+    Tlsf_Threaded_Allocator allocator = {0};
+    TEST(tlsf_threaded_init(&allocator, memory, MEMORY_SIZE, nodes, NODES*sizeof(Tlsf_Node), caches, CACHES));
+    tlsf_threaded_test_invariants(&allocator);
+
+    Tlsf_Thread_Cache* a = tlsf_threaded_acquire_cache(&allocator);
+    Tlsf_Thread_Cache* b = tlsf_threaded_acquire_cache(&allocator);
+    TEST(a && b && a != b);
+
+    //Cached, uncached and overaligned allocations
+    for(isize i = 0; i < ALLOCS; i++)
+    {
+        isize size = random_range(isizeof(_Test_Tlsf_Threaded_Block), 2*TLSF_THREADED_MAX_CACHED_SIZE);
+        isize align = (isize) 1 << random_range(0, 8);
+        ptrs[i] = tlsf_thread_cache_malloc(&allocator, a, size, align);
+        TEST(ptrs[i] != NULL);
+        TEST((uintptr_t) ptrs[i] % (uintptr_t) MAX(align, TLSF_THREADED_ALIGN) == 0);
+        _test_tlsf_threaded_fill(ptrs[i], size, (uint8_t) i);
+    }
+    TEST(tlsf_thread_cache_malloc(&allocator, a, 0, 8) == NULL);
+    tlsf_thread_cache_free(&allocator, a, NULL);
+
+    //Free half locally and half as if from other thread
+    for(isize i = 0; i < ALLOCS; i++)
+    {
+        _test_tlsf_threaded_check(ptrs[i]);
+        tlsf_thread_cache_free(&allocator, i % 2 ? a : b, ptrs[i]);
+    }
+
+    Tlsf_Thread_Cache_Stats stats_a = tlsf_thread_cache_get_stats(a);
+    Tlsf_Thread_Cache_Stats stats_b = tlsf_thread_cache_get_stats(b);
+    TEST(stats_a.allocation_count == ALLOCS);
+    TEST(stats_a.deallocation_count == ALLOCS/2);
+    TEST(stats_b.deallocation_count == ALLOCS/2);
+    TEST(stats_b.remote_free_count > 0);
+    TEST(sync_queue_is_empty(&a->remote_frees) == false);
+    TEST(allocator.tlsf.bytes_allocated > 0);
+
+    //Releasing drains the remote frees queued for the cache
+    tlsf_threaded_release_cache(b);
+    tlsf_threaded_release_cache(a);
+    tlsf_threaded_collect(&allocator);
+    tlsf_threaded_test_invariants(&allocator);
+    TEST(allocator.tlsf.bytes_allocated == 0);
+    TEST(allocator.tlsf.node_count == 2);
+
+    //Blocks freed into a released cache wait until collect
+    TEST(tlsf_threaded_attach(&allocator));
+    TEST(tlsf_threaded_attach(&allocator));
+    Tlsf_Thread_Cache* attached = tlsf_threaded_get_cache(&allocator);
+    TEST(attached != NULL);
+
+    void* ptr = tlsf_threaded_malloc(&allocator, 100, 8);
+    TEST(ptr != NULL);
+    tlsf_threaded_detach(&allocator);
+    TEST(tlsf_threaded_get_cache(&allocator) == NULL);
+    tlsf_threaded_free(&allocator, ptr);
+    TEST(sync_queue_is_empty(&attached->remote_frees) == false);
+    tlsf_threaded_collect(&allocator);
+    TEST(allocator.tlsf.bytes_allocated == 0);
+
+    //Allocator interface without an attached cache goes through the shared allocator
+    void* realloced = allocator_allocate(&allocator.allocator, 10, 8);
+    _test_tlsf_threaded_fill(realloced, 10, 0x33);
+    realloced = allocator_reallocate(&allocator.allocator, 5000, realloced, 10, 64);
+    _test_tlsf_threaded_check(realloced);
+    TEST((uintptr_t) realloced % 64 == 0);
+    allocator_deallocate(&allocator.allocator, realloced, 5000, 64);
+    TEST(allocator.tlsf.bytes_allocated == 0);
+
+    tlsf_threaded_test_invariants(&allocator);
+    tlsf_threaded_deinit(&allocator);
+
+    free(ptrs);
+    free(caches);
+    free(nodes);
+    free(memory);
+}
+
+typedef struct _Test_Tlsf_Threaded_Context {
+    Tlsf_Threaded_Allocator* allocator;
+    CHAN_ATOMIC(void*)* exchange;
+    isize exchange_count;
+    CHAN_ATOMIC(uint32_t)* run;
+    Wait_Group* done;
+    uint64_t seed;
+    isize iters;
+} _Test_Tlsf_Threaded_Context;
+
+INTERNAL void _test_tlsf_threaded_runner(void* context)
+{
+    enum {LIVE = 256, MAX_SIZE_LOG2 = 12};
+
+    _Test_Tlsf_Threaded_Context* c = (_Test_Tlsf_Threaded_Context*) context;
+    Random_State rand = random_state_make(c->seed);
+    void* live[LIVE] = {0};
+    TEST(tlsf_threaded_attach(c->allocator));
+
+    while(atomic_load_explicit(c->run, memory_order_relaxed))
+    {
+        isize i = random_range_from(&rand, 0, LIVE);
+        if(live[i])
+        {
+            //Either free the block or give it to some other thread who will eventually free it
+            _test_tlsf_threaded_check(live[i]);
+            if(random_range_from(&rand, 0, 4) == 0)
+            {
+                isize slot = random_range_from(&rand, 0, c->exchange_count);
+                live[i] = atomic_exchange(&c->exchange[slot], live[i]);
+                if(live[i])
+                    _test_tlsf_threaded_check(live[i]);
+                continue;
+            }
+
+            tlsf_threaded_free(c->allocator, live[i]);
+        }
+
+        //Exponentially distributed sizes so that most hit the caches
+        isize size = random_range_from(&rand, 0, (isize) 1 << random_range_from(&rand, 3, MAX_SIZE_LOG2));
+        if(size < isizeof(_Test_Tlsf_Threaded_Block))
+            size = isizeof(_Test_Tlsf_Threaded_Block);
+        live[i] = tlsf_threaded_malloc(c->allocator, size, 8);
+        TEST(live[i] != NULL);
+        _test_tlsf_threaded_fill(live[i], size, (uint8_t) random_u64_from(&rand));
+        c->iters += 1;
+    }
+
+    for(isize i = 0; i < LIVE; i++)
+    {
+        if(live[i])
+            _test_tlsf_threaded_check(live[i]);
+        tlsf_threaded_free(c->allocator, live[i]);
+    }
+
+    tlsf_threaded_detach(c->allocator);
+    wait_group_pop(c->done, 1, SYNC_WAIT_BLOCK);
+}
+
+INTERNAL void test_allocator_tlsf_threaded_stress(f64 max_seconds, isize thread_count)
+{
+    enum {MAX_THREADS = 64, EXCHANGE = 64, MEMORY_SIZE = 128*1024*1024, NODES = 1024*1024};
+    TEST(thread_count <= MAX_THREADS);
+
+    void* memory = malloc(MEMORY_SIZE);
+    void* nodes = malloc(NODES*sizeof(Tlsf_Node));
+    Tlsf_Thread_Cache* caches = (Tlsf_Thread_Cache*) aligned_alloc(CHAN_CACHE_LINE, (size_t) thread_count*sizeof(Tlsf_Thread_Cache));
+
+    Tlsf_Threaded_Allocator allocator = {0};
+    TEST(tlsf_threaded_init(&allocator, memory, MEMORY_SIZE, nodes, NODES*sizeof(Tlsf_Node), caches, thread_count));
+
+    CHAN_ATOMIC(void*) exchange[EXCHANGE] = {0};
+    CHAN_ATOMIC(uint32_t) run = 1;
+    Wait_Group done = {0};
+    wait_group_push(&done, thread_count);
+    _Test_Tlsf_Threaded_Context contexts[MAX_THREADS] = {0};
+    for(isize i = 0; i < thread_count; i++)
+    {
+        contexts[i].allocator = &allocator;
+        contexts[i].exchange = exchange;
+        contexts[i].exchange_count = EXCHANGE;
+        contexts[i].run = &run;
+        contexts[i].done = &done;
+        contexts[i].seed = random_u64();
+        TEST(chan_start_thread(_test_tlsf_threaded_runner, &contexts[i]));
+    }
+
+    platform_thread_sleep(max_seconds);
+    atomic_store(&run, 0);
+    wait_group_wait(&done, SYNC_WAIT_BLOCK);
+
+    //Free whatever is left in the exchange. Since we dont have a cache these get sent to the owners.
+    for(isize i = 0; i < EXCHANGE; i++)
+    {
+        void* ptr = atomic_load(&exchange[i]);
+        if(ptr)
+            _test_tlsf_threaded_check(ptr);
+        tlsf_threaded_free(&allocator, ptr);
+    }
+
+    tlsf_threaded_collect(&allocator);
+    tlsf_threaded_test_invariants(&allocator);
+    TEST(allocator.tlsf.bytes_allocated == 0);
+    TEST(allocator.tlsf.node_count == 2);
+
+    isize iters = 0;
+    isize remote_frees = 0;
+    for(isize i = 0; i < thread_count; i++)
+    {
+        Tlsf_Thread_Cache_Stats stats = tlsf_thread_cache_get_stats(&caches[i]);
+        TEST(stats.allocation_count == contexts[i].iters);
+        iters += contexts[i].iters;
+        remote_frees += stats.remote_free_count;
+    }
+    LOG_INFO("TEST", "tlsf threaded %2lli threads: %lli allocs, %lli remote frees, %lli locks (%lli contended)",
+        (lli) thread_count, (lli) iters, (lli) remote_frees, (lli) allocator.lock_count, (lli) allocator.lock_contended_count);
+
+    tlsf_threaded_deinit(&allocator);
+    free(caches);
+    free(nodes);
+    free(memory);
+}
+
+INTERNAL void test_allocator_tlsf_threaded(f64 max_seconds)
+{
+    test_allocator_tlsf_threaded_unit();
+    test_allocator_tlsf_threaded_stress(max_seconds/3, 1);
+    test_allocator_tlsf_threaded_stress(max_seconds/3, 4);
+    test_allocator_tlsf_threaded_stress(max_seconds/3, 32);
+}
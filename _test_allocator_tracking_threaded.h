@@ -0,0 +1,169 @@
+#pragma once
+
+#include "allocator_tracking_threaded.h"
+#include "random.h"
+#include "time.h"
+
+INTERNAL void test_allocator_tracking_threaded_unit()
+{
+    Tracking_Threaded_Allocator tracking = {0};
+    tracking_threaded_init(&tracking, NULL, "test tracking");
+
+    u8* a = (u8*) allocator_allocate(tracking.alloc, 100, 8);
+    u8* b = (u8*) allocator_allocate(tracking.alloc, 50, 128);
+    TEST(a && b && (uintptr_t) b % 128 == 0);
+    memset(a, 0x11, 100);
+    a = (u8*) allocator_reallocate(tracking.alloc, 1000, a, 100, 8);
+    TEST(a[0] == 0x11 && a[99] == 0x11);
+
+    Allocator_Stats stats = allocator_get_stats(tracking.alloc);
+    TEST(stats.bytes_allocated == 1050);
+    TEST(stats.max_bytes_allocated == 1050);
+    TEST(stats.allocation_count == 2 && stats.reallocation_count == 1 && stats.deallocation_count == 0);
+
+    allocator_deallocate(tracking.alloc, a, 1000, 8);
+    stats = allocator_get_stats(tracking.alloc);
+    TEST(stats.bytes_allocated == 50);
+    TEST(stats.max_bytes_allocated == 1050);
+    TEST(stats.deallocation_count == 1);
+
+    //Free all releases the rest
+    for(isize i = 0; i < 100; i++)
+        allocator_allocate(tracking.alloc, i + 1, 8);
+    tracking_threaded_free_all(&tracking);
+    TEST(allocator_get_stats(tracking.alloc).bytes_allocated == 0);
+    for(isize i = 0; i < TRACKING_THREADED_SHARDS; i++)
+        TEST(tracking.shards[i].list.last_block == NULL);
+
+    tracking_threaded_deinit(&tracking);
+}
+
+typedef struct _Test_Tracking_Threaded_Context {
+    Tracking_Threaded_Allocator* tracking;
+    CHAN_ATOMIC(void*)* exchange;
+    isize exchange_count;
+    CHAN_ATOMIC(uint32_t)* run;
+    Wait_Group* done;
+    uint64_t seed;
+    isize iters;
+} _Test_Tracking_Threaded_Context;
+
+//Each live block holds its size in the first isize followed by bytes equal to the low byte of its size
+INTERNAL void* _test_tracking_threaded_check(void* ptr)
+{
+    if(ptr)
+    {
+        isize size = *(isize*) ptr;
+        for(isize k = isizeof(isize); k < size; k++)
+            TEST(((u8*) ptr)[k] == (u8) size);
+    }
+    return ptr;
+}
+
+INTERNAL void* _test_tracking_threaded_fill(void* ptr, isize size)
+{
+    memset(ptr, (u8) size, (size_t) size);
+    *(isize*) ptr = size;
+    return ptr;
+}
+
+INTERNAL void _test_tracking_threaded_runner(void* context)
+{
+    enum {LIVE = 64};
+    _Test_Tracking_Threaded_Context* c = (_Test_Tracking_Threaded_Context*) context;
+    Random_State rand = random_state_make(c->seed);
+    Allocator* alloc = c->tracking->alloc;
+    void* live[LIVE] = {0};
+
+    while(atomic_load_explicit(c->run, memory_order_relaxed))
+    {
+        isize i = random_range_from(&rand, 0, LIVE);
+        isize new_size = random_range_from(&rand, isizeof(isize), 512);
+        if(live[i] == NULL)
+            live[i] = _test_tracking_threaded_fill(allocator_allocate(alloc, new_size, 8), new_size);
+        else
+        {
+            //Free, realloc or exchange the block with other threads. Blocks coming from the exchange
+            // were usually allocated by other threads and thus exercise the cross shard paths.
+            isize old_size = *(isize*) _test_tracking_threaded_check(live[i]);
+            switch(random_range_from(&rand, 0, 3))
+            {
+                case 0:
+                    allocator_deallocate(alloc, live[i], old_size, 8);
+                    live[i] = NULL;
+                    break;
+                case 1:
+                    live[i] = allocator_reallocate(alloc, new_size, live[i], old_size, 8);
+                    TEST(new_size <= isizeof(isize) || old_size <= isizeof(isize) || ((u8*) live[i])[isizeof(isize)] == (u8) old_size);
+                    _test_tracking_threaded_fill(live[i], new_size);
+                    break;
+                case 2: {
+                    isize slot = random_range_from(&rand, 0, c->exchange_count);
+                    live[i] = _test_tracking_threaded_check(atomic_exchange(&c->exchange[slot], live[i]));
+                } break;
+            }
+        }
+        c->iters += 1;
+    }
+
+    //Leave some blocks alive for free_all
+    for(isize i = 0; i < LIVE; i += 2)
+        if(live[i])
+            allocator_deallocate(alloc, live[i], *(isize*) live[i], 8);
+
+    wait_group_pop(c->done, 1, SYNC_WAIT_BLOCK);
+}
+
+INTERNAL void test_allocator_tracking_threaded_stress(f64 max_seconds, isize thread_count)
+{
+    enum {MAX_THREADS = 64, EXCHANGE = 64};
+    TEST(thread_count <= MAX_THREADS);
+
+    Tracking_Threaded_Allocator* tracking = (Tracking_Threaded_Allocator*) aligned_alloc(CHAN_CACHE_LINE, sizeof(Tracking_Threaded_Allocator));
+    memset(tracking, 0, sizeof *tracking);
+    tracking_threaded_init(tracking, NULL, "stress tracking");
+
+    CHAN_ATOMIC(void*) exchange[EXCHANGE] = {0};
+    CHAN_ATOMIC(uint32_t) run = 1;
+    Wait_Group done = {0};
+    wait_group_push(&done, thread_count);
+    _Test_Tracking_Threaded_Context contexts[MAX_THREADS] = {0};
+    for(isize i = 0; i < thread_count; i++)
+    {
+        contexts[i].tracking = tracking;
+        contexts[i].exchange = exchange;
+        contexts[i].exchange_count = EXCHANGE;
+        contexts[i].run = &run;
+        contexts[i].done = &done;
+        contexts[i].seed = random_u64();
+        TEST(chan_start_thread(_test_tracking_threaded_runner, &contexts[i]));
+    }
+
+    platform_thread_sleep(max_seconds);
+    atomic_store(&run, 0);
+    wait_group_wait(&done, SYNC_WAIT_BLOCK);
+
+    isize live_bytes = 0;
+    for(isize s = 0; s < TRACKING_THREADED_SHARDS; s++)
+        for(Allocation_List_Block* block = tracking->shards[s].list.last_block; block; block = block->prev_block)
+        {
+            TEST(block->owner == (u64) s);
+            live_bytes += _test_tracking_threaded_check(block + 1) ? (isize) block->size : 0;
+        }
+
+    Allocator_Stats stats = allocator_get_stats(tracking->alloc);
+    TEST(stats.bytes_allocated == live_bytes);
+    TEST(stats.allocation_count - stats.deallocation_count >= 0);
+
+    tracking_threaded_free_all(tracking);
+    TEST(allocator_get_stats(tracking->alloc).bytes_allocated == 0);
+    tracking_threaded_deinit(tracking);
+    free(tracking);
+}
+
+INTERNAL void test_allocator_tracking_threaded(f64 max_seconds)
+{
+    test_allocator_tracking_threaded_unit();
+    test_allocator_tracking_threaded_stress(max_seconds/2, 1);
+    test_allocator_tracking_threaded_stress(max_seconds/2, 8);
+}
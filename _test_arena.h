@@ -1,5 +1,6 @@
 #pragma once
 #include "scratch.h"
+#include "arena.h"
 #include "random.h"
 #include "time.h"
 
@@ -182,9 +183,271 @@ void test_arena_assembly()
         scratch_push_nonzero(&arena, 200, void*);
 }
 
+static void test_arena_page_options()
+{
+    //Explicit huge pages and NUMA binding depend on system configuration (hugetlb pool, mbind being allowed)
+    // so we only check them when init succeeds. Transparent huge pages are just a hint and must always work.
+    enum {RESERVE = 64*MB, PUSH = 5*MB};
+    isize huge = platform_huge_page_size();
+    TEST(huge >= platform_page_size());
+    TEST(platform_numa_node_count() >= 1);
+
+    u32 flag_combinations[] = {
+        0, 
+        ARENA_HUGE_PAGES, 
+        ARENA_HUGE_PAGES_EXPLICIT, 
+        ARENA_NUMA_BIND, 
+        ARENA_HUGE_PAGES | ARENA_NUMA_BIND,
+    };
+    for(isize i = 0; i < ARRAY_LEN(flag_combinations); i++)
+    {
+        u32 flags = flag_combinations[i];
+        bool optional = (flags & (ARENA_HUGE_PAGES_EXPLICIT | ARENA_NUMA_BIND)) != 0;
+
+        Arena arena = {0};
+        Platform_Error error = arena_init_custom(&arena, "test_arena_pages", RESERVE, 0, flags, 0);
+        TEST(error == 0 || optional);
+        if(error == 0)
+        {
+            if(flags & (ARENA_HUGE_PAGES | ARENA_HUGE_PAGES_EXPLICIT))
+            {
+                TEST((uintptr_t) arena.data % (uintptr_t) huge == 0);
+                TEST(arena.commit_granularity % huge == 0);
+            }
+
+            u8* data = (u8*) arena_push_nonzero(&arena, PUSH, 1, NULL);
+            memset(data, 0x33, PUSH);
+            u8* data2 = (u8*) arena_push_nonzero(&arena, PUSH, 1, NULL);
+            memset(data2, 0x44, PUSH);
+            TEST(data[0] == 0x33 && data[PUSH - 1] == 0x33);
+            TEST(data2[0] == 0x44 && data2[PUSH - 1] == 0x44);
+            TEST(arena.commit_to <= arena.reserved_to);
+            TEST((arena.commit_to - arena.data) % arena.commit_granularity == 0);
+        }
+        arena_deinit(&arena);
+
+        Scratch_Arena scratch_arena = {0};
+        error = scratch_arena_init_custom(&scratch_arena, "test_scratch_pages", RESERVE, 0, 0, flags, 0);
+        TEST(error == 0 || optional);
+        if(error == 0)
+        {
+            if(flags & (SCRATCH_ARENA_HUGE_PAGES | SCRATCH_ARENA_HUGE_PAGES_EXPLICIT))
+                for(isize k = 0; k < SCRATCH_ARENA_CHANNELS; k++)
+                    TEST((uintptr_t) scratch_arena.stacks[k].reserved_from % (uintptr_t) huge == 0);
+
+            SCRATCH_SCOPE_FROM(level1, &scratch_arena)
+            {
+                u8* data = scratch_push_nonzero(&level1, PUSH, u8);
+                memset(data, 0x55, PUSH);
+                TEST(data[0] == 0x55 && data[PUSH - 1] == 0x55);
+            }
+            scratch_arena_test_invariants(&scratch_arena);
+        }
+        scratch_arena_deinit(&scratch_arena);
+    }
+}
+
+static void _test_arena_fill_check(u8* data, isize size, u8 pattern)
+{
+    memset(data, pattern, (size_t) size);
+    for(isize i = 0; i < size; i += 4096)
+        TEST(data[i] == pattern);
+}
+
+static u8* _test_arena_async_backed_to(Arena* arena, bool wait_for_helper)
+{
+    //Waits at most a few seconds for the helper to reach its target
+    Arena_Async_Commit* async = arena->async;
+    u8* backed_to = NULL;
+    for(isize i = 0; i < 5000; i++)
+    {
+        platform_mutex_lock(&async->mutex);
+        backed_to = async->backed_to;
+        bool done = async->backed_to == async->wanted_to;
+        platform_mutex_unlock(&async->mutex);
+        if(done || wait_for_helper == false)
+            break;
+        platform_thread_sleep(0.001);
+    }
+    return backed_to;
+}
+
+static void test_arena_commit_modes()
+{
+    enum {RESERVE = 64*MB, GRANULARITY = 1*MB};
+    
+    //Synchronous decommit with hysteresis
+    {
+        Arena arena = {0};
+        TEST(arena_init(&arena, "test_arena_decommit", RESERVE, GRANULARITY) == 0);
+        arena_set_decommit(&arena, 2*GRANULARITY, GRANULARITY);
+        TEST(arena.decommit_above == 3*GRANULARITY);
+
+        _test_arena_fill_check((u8*) arena_push_nonzero(&arena, 10*GRANULARITY, 1, NULL), 10*GRANULARITY, 0x11);
+        TEST(arena.commit_to - arena.data == 10*GRANULARITY);
+
+        arena_reset(&arena, 0);
+        TEST(arena.commit_to - arena.data == 2*GRANULARITY);
+
+        //Within hysteresis nothing gets decommited
+        _test_arena_fill_check((u8*) arena_push_nonzero(&arena, 2*GRANULARITY + GRANULARITY/2, 1, NULL), 2*GRANULARITY + GRANULARITY/2, 0x22);
+        TEST(arena.commit_to - arena.data == 3*GRANULARITY);
+        arena_reset(&arena, 0);
+        TEST(arena.commit_to - arena.data == 3*GRANULARITY);
+        
+        //Reset to the middle keeps everything up to it
+        u8* data = (u8*) arena_push_nonzero(&arena, 8*GRANULARITY, 1, NULL);
+        _test_arena_fill_check(data, 8*GRANULARITY, 0x33);
+        arena_reset(&arena, GRANULARITY);
+        TEST(arena.commit_to - arena.data == 3*GRANULARITY);
+        TEST(data[GRANULARITY - 1] == 0x33);
+
+        //Reallocating through the allocator interface must not decommit its contents
+        arena_reset(&arena, 0);
+        u8* realloced = (u8*) allocator_reallocate(arena.alloc, 8*GRANULARITY, arena.data, 0, 8);
+        _test_arena_fill_check(realloced, 8*GRANULARITY, 0x44);
+        realloced = (u8*) allocator_reallocate(arena.alloc, 9*GRANULARITY, realloced, 8*GRANULARITY, 8);
+        TEST(realloced[8*GRANULARITY - 1] == 0x44);
+
+        arena_set_decommit(&arena, -1, 0);
+        arena_reset(&arena, 0);
+        TEST(arena.commit_to - arena.data == 9*GRANULARITY);
+        arena_deinit(&arena);
+    }
+
+    //Asynchronous commit and decommit
+    {
+        Arena arena = {0};
+        TEST(arena_init(&arena, "test_arena_async", RESERVE, GRANULARITY) == 0);
+        TEST(arena_start_async_commit(&arena, 2*GRANULARITY) == 0);
+        arena_set_decommit(&arena, 0, 0);
+
+        //Helper commits ahead before we ever push
+        TEST(_test_arena_async_backed_to(&arena, true) == arena.data + 2*GRANULARITY);
+        _test_arena_fill_check((u8*) arena_push_nonzero(&arena, GRANULARITY, 1, NULL), GRANULARITY, 0x55);
+        TEST(arena.async->sync_commit_count == 0);
+        TEST(arena.commit_to - arena.data == 2*GRANULARITY);
+
+        //Helper keeps up with us as we grow. If it doesnt we commit on our own.
+        for(isize i = 0; i < 16; i++)
+        {
+            _test_arena_fill_check((u8*) arena_push_nonzero(&arena, GRANULARITY, 1, NULL), GRANULARITY, (u8) i);
+            _test_arena_async_backed_to(&arena, true);
+        }
+        TEST(arena.commit_to - arena.data >= 17*GRANULARITY);
+        TEST(arena.async->async_commit_count >= 17);
+        
+        //Decommit happens on the helper thread
+        arena_reset(&arena, 0);
+        TEST(arena.commit_to == arena.data);
+        TEST(_test_arena_async_backed_to(&arena, true) == arena.data + 2*GRANULARITY);
+        TEST(arena.async->async_decommit_count == 1);
+
+        _test_arena_fill_check((u8*) arena_push_nonzero(&arena, 4*GRANULARITY, 1, NULL), 4*GRANULARITY, 0x66);
+        arena_deinit(&arena);
+    }
+}
+
+typedef struct _Test_Scratch_Pool_Context {
+    PLATFORM_ATOMIC(u8*) reserved_from;
+    isize iters;
+    u8 pattern;
+} _Test_Scratch_Pool_Context;
+
+static int _test_scratch_pool_thread(void* context)
+{
+    PLATFORM_USE_ATOMICS;
+    _Test_Scratch_Pool_Context* c = (_Test_Scratch_Pool_Context*) context;
+    for(isize i = 0; i < c->iters; i++)
+    {
+        SCRATCH_SCOPE(outer)
+        {
+            u8* data = scratch_push_nonzero(&outer, 64*1024, u8);
+            memset(data, c->pattern, 64*1024);
+            SCRATCH_SCOPE(inner)
+                memset(scratch_push_nonzero(&inner, 1024, u8), ~c->pattern, 1024);
+
+            for(isize k = 0; k < 64*1024; k += 512)
+                TEST(data[k] == c->pattern);
+        }
+    }
+
+    //Leave a frame unreleased. It must get cleaned up on thread exit
+    Scratch leaked = global_scratch_acquire();
+    scratch_push_nonzero(&leaked, 100, u8);
+
+    atomic_store(&c->reserved_from, global_scratch_arena()->reserved_from);
+    return 0;
+}
+
+static Scratch_Arena_Pool_Stats _test_scratch_pool_wait(isize returned)
+{
+    //Waits for threads to exit and return their arenas. Each returned arena is either
+    // still pooled, was discarded or was handed out again.
+    Scratch_Arena_Pool_Stats stats = {0};
+    for(isize i = 0; i < 5000; i++)
+    {
+        stats = scratch_arena_pool_get_stats();
+        if(stats.pooled_count + stats.discarded_count + stats.reused_count >= returned)
+            break;
+        platform_thread_sleep(0.001);
+    }
+    return stats;
+}
+
+static void test_arena_thread_pool()
+{
+    enum {THREADS = 8, MAX_POOLED = 4};
+    scratch_arena_pool_configure(64*MB, 1*MB, 0, 0, MAX_POOLED);
+    Scratch_Arena_Pool_Stats before = scratch_arena_pool_get_stats();
+    isize returned = before.discarded_count + before.reused_count;
+    TEST(before.pooled_count == 0);
+
+    //A single thread creates an arena which gets pooled on exit and reused by the next thread
+    _Test_Scratch_Pool_Context first = {0};
+    first.iters = 10;
+    first.pattern = 0x11;
+    TEST(platform_thread_launch(NULL, 0, _test_scratch_pool_thread, &first) == 0);
+    Scratch_Arena_Pool_Stats stats = _test_scratch_pool_wait(returned += 1);
+    TEST(stats.pooled_count == 1);
+    TEST(stats.created_count == before.created_count + 1);
+
+    _Test_Scratch_Pool_Context second = {0};
+    second.iters = 10;
+    second.pattern = 0x22;
+    TEST(platform_thread_launch(NULL, 0, _test_scratch_pool_thread, &second) == 0);
+    stats = _test_scratch_pool_wait(returned += 1);
+    TEST(stats.pooled_count == 1);
+    TEST(stats.reused_count == before.reused_count + 1);
+    TEST(stats.created_count == before.created_count + 1);
+    TEST(atomic_load(&first.reserved_from) == atomic_load(&second.reserved_from));
+
+    //Many concurrent threads each get their own arena. Only MAX_POOLED are kept.
+    _Test_Scratch_Pool_Context contexts[THREADS] = {0};
+    for(isize i = 0; i < THREADS; i++)
+    {
+        contexts[i].iters = 1000;
+        contexts[i].pattern = (u8) i;
+        TEST(platform_thread_launch(NULL, 0, _test_scratch_pool_thread, &contexts[i]) == 0);
+    }
+
+    stats = _test_scratch_pool_wait(returned += THREADS);
+    TEST(stats.pooled_count == MAX_POOLED);
+    for(isize i = 0; i < THREADS; i++)
+        for(isize j = 0; j < i; j++)
+            TEST(atomic_load(&contexts[i].reserved_from) != atomic_load(&contexts[j].reserved_from));
+
+    scratch_arena_pool_trim();
+    TEST(scratch_arena_pool_get_stats().pooled_count == 0);
+    scratch_arena_pool_configure(0, 0, 0, 0, 0);
+}
+
 static void test_arena(f64 time)
 {
     test_arena_unit();
+    test_arena_page_options();
+    test_arena_commit_modes();
+    test_arena_thread_pool();
     test_arena_stress(time);
     test_arena_assembly();
 }
\ No newline at end of file
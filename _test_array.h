@@ -167,7 +167,121 @@ INTERNAL void test_array_stress(f64 max_seconds)
 	debug_allocator_deinit(&debug_alloc);
 }
 
+INTERNAL void test_array_inline()
+{
+	Debug_Allocator debug_alloc = {0};
+	debug_allocator_init_use(&debug_alloc, allocator_get_default(), DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK | DEBUG_ALLOCATOR_USE);
+	{
+		enum {INLINE = 4};
+		typedef Array_Inline(i64, INLINE) i64_Inline_Array;
+		
+		//Works without allocator as long as it fits
+		i64_Inline_Array arr = {0};
+		for(i64 i = 0; i < INLINE; i++)
+			array_push(&arr, i);
+
+		TEST(arr.data == arr.inline_data);
+		TEST(arr.count == INLINE && arr.capacity == INLINE);
+		TEST(generic_array_is_invariant(array_make_generic(&arr)));
+		TEST(array_pop(&arr) == INLINE - 1);
+		array_deinit(&arr);
+		TEST(arr.data == NULL && arr.count == 0 && arr.capacity == 0);
+
+		//Spill to the allocator and back
+		array_init(&arr, debug_alloc.alloc);
+		i64 values[100] = {0};
+		for(i64 i = 0; i < ARRAY_LEN(values); i++)
+			values[i] = i*i;
+
+		array_append(&arr, values, 3);
+		TEST(arr.data == arr.inline_data);
+		TEST(memcmp(arr.data, values, 3*sizeof(i64)) == 0);
+
+		array_append(&arr, values + 3, ARRAY_LEN(values) - 3);
+		TEST(arr.data != arr.inline_data);
+		TEST(arr.count == ARRAY_LEN(values) && arr.capacity > INLINE);
+		TEST(memcmp(arr.data, values, sizeof values) == 0);
+		TEST(generic_array_is_invariant(array_make_generic(&arr)));
+
+		array_resize(&arr, 2);
+		array_set_capacity(&arr, 2);
+		TEST(arr.data == arr.inline_data);
+		TEST(arr.count == 2 && arr.capacity == INLINE);
+		TEST(memcmp(arr.data, values, 2*sizeof(i64)) == 0);
+		
+		//Copying between inline and regular arrays
+		i64_Array regular = {debug_alloc.alloc};
+		array_copy(&regular, arr);
+		TEST(regular.count == 2 && memcmp(regular.data, values, 2*sizeof(i64)) == 0);
+		
+		array_append(&regular, values + 2, 10);
+		array_copy(&arr, regular);
+		TEST(arr.data != arr.inline_data);
+		TEST(arr.count == 12 && memcmp(arr.data, values, 12*sizeof(i64)) == 0);
+
+		array_clear(&arr);
+		array_set_capacity(&arr, 0);
+		TEST(arr.data == NULL && arr.capacity == 0);
+		array_push(&arr, 7);
+		TEST(arr.data == arr.inline_data && arr.data[0] == 7);
+
+		array_deinit(&arr);
+		array_deinit(&regular);
+
+		//Over-aligned items
+		typedef struct Aligned_Item {
+			ATTRIBUTE_ALIGNED(64) u8 bytes[64];
+		} Aligned_Item;
+		
+		Array_Inline(Aligned_Item, 2) aligned = {0};
+		Aligned_Item item = {0};
+		array_push(&aligned, item);
+		TEST(aligned.data == aligned.inline_data);
+		array_deinit(&aligned);
+	}
+	debug_allocator_deinit(&debug_alloc);
+}
+
+INTERNAL void test_array_large_growth()
+{
+	//Crosses MALLOC_ALLOCATOR_MAP_THRESHOLD both ways so exercises heap, mapped and mixed reallocations
+	Allocator* alloc = allocator_get_malloc();
+	isize max_size = 64*MALLOC_ALLOCATOR_MAP_THRESHOLD;
+	isize size = 1024;
+	u32* data = (u32*) allocator_allocate(alloc, size, SIMD_ALIGN);
+	for(isize i = 0; i < size/isizeof(u32); i++)
+		data[i] = (u32) i;
+
+	for(; size < max_size; size *= 2)
+	{
+		data = (u32*) allocator_reallocate(alloc, size*2, data, size, SIMD_ALIGN);
+		TEST((uintptr_t) data % SIMD_ALIGN == 0);
+		TEST(data[size/isizeof(u32) - 1] == (u32) (size/isizeof(u32) - 1));
+		for(isize i = size/isizeof(u32); i < size*2/isizeof(u32); i++)
+			data[i] = (u32) i;
+	}
+
+	for(; size > 1024; size /= 4)
+	{
+		data = (u32*) allocator_reallocate(alloc, size/4, data, size, SIMD_ALIGN);
+		for(isize i = 0; i < size/4/isizeof(u32); i += 997)
+			TEST(data[i] == (u32) i);
+	}
+	allocator_deallocate(alloc, data, size, SIMD_ALIGN);
+
+	//Regular arrays growing past the threshold
+	f32_Array arr = {0};
+	array_init(&arr, alloc);
+	for(isize i = 0; i < 4*MALLOC_ALLOCATOR_MAP_THRESHOLD/isizeof(f32); i++)
+		array_push(&arr, (f32) i);
+	for(isize i = 0; i < arr.count; i += 101)
+		TEST(arr.data[i] == (f32) i);
+	array_deinit(&arr);
+}
+
 INTERNAL void test_array(f64 max_seconds)
 {
+	test_array_inline();
+	test_array_large_growth();
 	test_array_stress(max_seconds);
 }
\ No newline at end of file
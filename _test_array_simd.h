@@ -0,0 +1,249 @@
+#pragma once
+
+#include "array_simd.h"
+#include "random.h"
+#include "time.h"
+#include "allocator_debug.h"
+#include "perf.h"
+#include "log.h"
+
+#include <math.h>
+
+//Small value ranges so that all comparisons have a fair chance of passing
+INTERNAL i32 _test_array_simd_random_i32() { return (i32) random_range(-8, 8); }
+INTERNAL u64 _test_array_simd_random_u64() { return random_bool() ? (u64) random_range(0, 16) : ~(u64) random_range(0, 16); }
+INTERNAL f32 _test_array_simd_random_f32() { return random_range(0, 64) == 0 ? NAN : (f32) random_range(-8, 8) / 2; }
+
+//The reference implementations the tests are checked against
+#define _TEST_ARRAY_SIMD_COMPARE(a, compare, b) (       \
+    (compare) == ARRAY_CMP_EQUAL         ? (a) == (b) : \
+    (compare) == ARRAY_CMP_NOT_EQUAL     ? (a) != (b) : \
+    (compare) == ARRAY_CMP_LESS          ? (a) <  (b) : \
+    (compare) == ARRAY_CMP_LESS_EQUAL    ? (a) <= (b) : \
+    (compare) == ARRAY_CMP_GREATER       ? (a) >  (b) : \
+                                           (a) >= (b)   \
+    )
+
+#define _TEST_ARRAY_SIMD_FILTER_GATHER_SCATTER(T, suffix, alloc, count)                          \
+    {                                                                                           \
+        suffix##_Array from = {alloc};                                                          \
+        suffix##_Array into = {alloc};                                                          \
+        suffix##_Array expected = {alloc};                                                      \
+        u32_Array indices = {alloc};                                                            \
+                                                                                                \
+        for(isize k = 0; k < count; k++)                                                        \
+            array_push(&from, _test_array_simd_random_##suffix());                              \
+                                                                                                \
+        /* filter into non empty array */                                                       \
+        Array_Compare compare = (Array_Compare) random_range(0, ARRAY_CMP_GREATER_EQUAL + 1);   \
+        T with = _test_array_simd_random_##suffix();                                            \
+        T prefix_item = _test_array_simd_random_##suffix();                                     \
+        array_push(&into, prefix_item);                                                         \
+        array_push(&expected, prefix_item);                                                     \
+        for(isize k = 0; k < from.count; k++)                                                   \
+            if(_TEST_ARRAY_SIMD_COMPARE(from.data[k], compare, with))                           \
+                array_push(&expected, from.data[k]);                                            \
+                                                                                                \
+        isize filtered = array_filter_##suffix(&into, from, compare, with);                     \
+        TEST(filtered == expected.count - 1);                                                   \
+        TEST(into.count == expected.count);                                                     \
+        TEST(memcmp(into.data, expected.data, (size_t) into.count*sizeof(T)) == 0);             \
+                                                                                                \
+        array_clear(&into);                                                                     \
+        array_reserve(&into, from.count + ARRAY_SIMD_OVERWRITE);                                \
+        filtered = _array_filter_##suffix##_scalar(into.data, from.data, from.count, compare, with); \
+        TEST(filtered == expected.count - 1);                                                   \
+        TEST(memcmp(into.data, expected.data + 1, (size_t) filtered*sizeof(T)) == 0);           \
+                                                                                                \
+        /* gather */                                                                            \
+        array_clear(&into);                                                                     \
+        array_clear(&expected);                                                                 \
+        if(from.count > 0)                                                                      \
+        {                                                                                       \
+            isize index_count = random_range(0, 2*count);                                       \
+            for(isize k = 0; k < index_count; k++)                                              \
+            {                                                                                   \
+                u32 index = (u32) random_range(0, from.count);                                  \
+                array_push(&indices, index);                                                    \
+                array_push(&expected, from.data[index]);                                        \
+            }                                                                                   \
+        }                                                                                       \
+                                                                                                \
+        array_gather_##suffix(&into, from, indices);                                            \
+        TEST(into.count == indices.count);                                                      \
+        TEST(memcmp(into.data, expected.data, (size_t) into.count*sizeof(T)) == 0);             \
+                                                                                                \
+        /* scatter the gathered items back. Gathered items with the same index */               \
+        /* have the same value so the order of writes does not matter */                        \
+        array_copy(&expected, from);                                                            \
+        for(isize k = 0; k < from.count; k++)                                                   \
+            from.data[k] = _test_array_simd_random_##suffix();                                  \
+                                                                                                \
+        array_scatter_##suffix(&from, into, indices);                                           \
+        for(isize k = 0; k < indices.count; k++)                                                \
+            TEST(memcmp(&from.data[indices.data[k]], &expected.data[indices.data[k]], sizeof(T)) == 0); \
+                                                                                                \
+        array_deinit(&from);                                                                    \
+        array_deinit(&into);                                                                    \
+        array_deinit(&expected);                                                                \
+        array_deinit(&indices);                                                                 \
+    }                                                                                           \
+
+INTERNAL void test_array_simd(f64 max_seconds)
+{
+	Debug_Allocator debug_alloc = {0};
+	debug_allocator_init_use(&debug_alloc, allocator_get_default(), DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK | DEBUG_ALLOCATOR_USE);
+	{
+		enum {
+			MAX_ITERS = 1000*1000,
+			MIN_ITERS = 100,
+			MAX_COUNT = 300,
+		};
+
+		f64 start = clock_s();
+		for(isize i = 0; i < MAX_ITERS; i++)
+		{
+			if(clock_s() - start >= max_seconds && i >= MIN_ITERS)
+				break;
+
+			isize count = random_range(0, MAX_COUNT);
+			_TEST_ARRAY_SIMD_FILTER_GATHER_SCATTER(i32, i32, debug_alloc.alloc, count);
+			_TEST_ARRAY_SIMD_FILTER_GATHER_SCATTER(f32, f32, debug_alloc.alloc, count);
+			_TEST_ARRAY_SIMD_FILTER_GATHER_SCATTER(u64, u64, debug_alloc.alloc, count);
+
+			//prefix sums
+			{
+				i32_Array sum_i32 = {debug_alloc.alloc};
+				f32_Array sum_f32 = {debug_alloc.alloc};
+				u64_Array sum_u64 = {debug_alloc.alloc};
+				for(isize k = 0; k < count; k++)
+				{
+					array_push(&sum_i32, (i32) random_u64());
+					array_push(&sum_f32, random_range_f32(-100, 100));
+					array_push(&sum_u64, random_u64());
+				}
+
+				//The sums are done in place so we keep copies of the input
+				i32_Array original_i32 = {debug_alloc.alloc};
+				f32_Array original_f32 = {debug_alloc.alloc};
+				u64_Array original_u64 = {debug_alloc.alloc};
+				array_copy(&original_i32, sum_i32);
+				array_copy(&original_f32, sum_f32);
+				array_copy(&original_u64, sum_u64);
+
+				i32 total_i32 = array_prefix_sum_i32(&sum_i32);
+				f32 total_f32 = array_prefix_sum_f32(&sum_f32);
+				u64 total_u64 = array_prefix_sum_u64(&sum_u64);
+
+				//f32 sums are done in different order so we only check they are close
+				u32 expected_i32 = 0;
+				u64 expected_u64 = 0;
+				f64 expected_f32 = 0;
+				f64 abs_sum_f32 = 0;
+				for(isize k = 0; k < count; k++)
+				{
+					expected_i32 += (u32) original_i32.data[k];
+					expected_u64 += original_u64.data[k];
+					expected_f32 += original_f32.data[k];
+					abs_sum_f32 += fabs(original_f32.data[k]);
+
+					TEST(sum_i32.data[k] == (i32) expected_i32);
+					TEST(sum_u64.data[k] == expected_u64);
+					TEST(fabs(sum_f32.data[k] - expected_f32) <= 1e-5*abs_sum_f32 + 1e-5);
+				}
+				TEST(total_i32 == (i32) expected_i32);
+				TEST(total_u64 == expected_u64);
+				TEST(fabs(total_f32 - expected_f32) <= 1e-5*abs_sum_f32 + 1e-5);
+
+				array_deinit(&original_i32);
+				array_deinit(&original_f32);
+				array_deinit(&original_u64);
+				array_deinit(&sum_i32);
+				array_deinit(&sum_f32);
+				array_deinit(&sum_u64);
+			}
+		}
+	}
+	debug_allocator_deinit(&debug_alloc);
+}
+
+INTERNAL void benchmark_array_simd(f64 seconds)
+{
+	enum {
+		COUNT = 64*1024,
+	};
+
+	i32_Array from_i32 = {allocator_get_default()};
+	f32_Array from_f32 = {allocator_get_default()};
+	u64_Array from_u64 = {allocator_get_default()};
+	i32_Array into_i32 = {allocator_get_default()};
+	f32_Array into_f32 = {allocator_get_default()};
+	u64_Array into_u64 = {allocator_get_default()};
+	u32_Array indices = {allocator_get_default()};
+
+	for(isize i = 0; i < COUNT; i++)
+	{
+		array_push(&from_i32, (i32) random_range(0, 100));
+		array_push(&from_f32, random_f32());
+		array_push(&from_u64, random_u64());
+		array_push(&indices, (u32) random_range(0, COUNT));
+	}
+
+	array_resize(&into_i32, COUNT + ARRAY_SIMD_OVERWRITE);
+	array_resize(&into_f32, COUNT + ARRAY_SIMD_OVERWRITE);
+	array_resize(&into_u64, COUNT + ARRAY_SIMD_OVERWRITE);
+
+	//Each row is run with the scalar and then with the AVX2 implementation (if available)
+	enum {
+		FILTER_I32, FILTER_F32, FILTER_U64,
+		GATHER_I32, GATHER_F32, GATHER_U64,
+		PREFIX_SUM_I32, PREFIX_SUM_F32, PREFIX_SUM_U64,
+		BENCH_COUNT
+	};
+	const char* names[BENCH_COUNT] = {
+		"filter_i32", "filter_f32", "filter_u64", 
+		"gather_i32", "gather_f32", "gather_u64", 
+		"prefix_sum_i32", "prefix_sum_f32", "prefix_sum_u64",
+	};
+
+	LOG_INFO("BENCH", "Running array_simd benchmarks with %lli items (avx2: %s)", (lli) COUNT, array_simd_has_avx2() ? "true" : "false");
+	for(isize b = 0; b < BENCH_COUNT; b++)
+	{
+		Perf_Stats stats[2] = {0};
+		for(isize use_avx2 = 0; use_avx2 < 1 + array_simd_has_avx2(); use_avx2++)
+		{
+			for(Perf_Benchmark bench = {0}; perf_benchmark_custom(&bench, &stats[use_avx2], seconds/10, seconds, 1); )
+			{
+				isize result = 0;
+				i64 before = perf_now();
+				#define _BENCH_CALL(name, ...) (use_avx2 ? _ARRAY_SIMD_CALL(name, __VA_ARGS__) : name##_scalar(__VA_ARGS__))
+				switch(b) {
+					case FILTER_I32: result = _BENCH_CALL(_array_filter_i32, into_i32.data, from_i32.data, COUNT, ARRAY_CMP_LESS, 50); break;
+					case FILTER_F32: result = _BENCH_CALL(_array_filter_f32, into_f32.data, from_f32.data, COUNT, ARRAY_CMP_LESS, 0.5f); break;
+					case FILTER_U64: result = _BENCH_CALL(_array_filter_u64, into_u64.data, from_u64.data, COUNT, ARRAY_CMP_LESS, (u64) 1 << 63); break;
+					case GATHER_I32: _BENCH_CALL(_array_gather_i32, into_i32.data, from_i32.data, indices.data, COUNT); break;
+					case GATHER_F32: _BENCH_CALL(_array_gather_f32, into_f32.data, from_f32.data, indices.data, COUNT); break;
+					case GATHER_U64: _BENCH_CALL(_array_gather_u64, into_u64.data, from_u64.data, indices.data, COUNT); break;
+					case PREFIX_SUM_I32: result = _BENCH_CALL(_array_prefix_sum_i32, into_i32.data, COUNT, 0); break;
+					case PREFIX_SUM_F32: result = (isize) _BENCH_CALL(_array_prefix_sum_f32, into_f32.data, COUNT, 0); break;
+					case PREFIX_SUM_U64: result = (isize) _BENCH_CALL(_array_prefix_sum_u64, into_u64.data, COUNT, 0); break;
+				}
+				#undef _BENCH_CALL
+				perf_benchmark_submit(&bench, perf_now() - before);
+				perf_do_not_optimize(&result);
+			}
+		}
+
+		f64 speedup = stats[1].average_s > 0 ? stats[0].average_s / stats[1].average_s : 0;
+		LOG_INFO("BENCH", "%-16s scalar: %s avx2: %s speedup: %.2lfx", names[b], 
+			format_seconds(stats[0].average_s).data, format_seconds(stats[1].average_s).data, speedup);
+	}
+
+	array_deinit(&from_i32);
+	array_deinit(&from_f32);
+	array_deinit(&from_u64);
+	array_deinit(&into_i32);
+	array_deinit(&into_f32);
+	array_deinit(&into_u64);
+	array_deinit(&indices);
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "bitset.h"
+#include "random.h"
+#include "time.h"
+#include "allocator_debug.h"
+
+INTERNAL bool _test_bitset_combine_bit(bool a, bool b, Bitset_Op op)
+{
+    switch(op) {
+        case BITSET_AND:    return a && b;
+        case BITSET_OR:     return a || b;
+        case BITSET_ANDNOT: return a && !b;
+        case BITSET_XOR:    return a != b;
+        default: UNREACHABLE(); return false;
+    }
+}
+
+//Checks all queries of bitset against a reference array of bools
+INTERNAL void _test_bitset_check(Bitset* bitset, const u8* reference, isize bit_count)
+{
+    bitset_test_invariants(bitset);
+    TEST(bitset->bit_count == bit_count);
+
+    isize count = 0;
+    for(isize i = 0; i < bit_count; i++)
+    {
+        TEST(bitset_get(bitset, i) == (bool) reference[i]);
+        count += reference[i];
+    }
+    TEST(bitset_count(bitset) == count);
+
+    bitset_build_ranks(bitset);
+    bitset_test_invariants(bitset);
+
+    isize rank = 0;
+    isize next_set = -1;
+    isize next_unset = -1;
+    for(isize i = bit_count; i-- > 0; )
+    {
+        if(reference[i])
+            next_set = i;
+        else
+            next_unset = i;
+
+        TEST(bitset_find_next_set(bitset, i) == next_set);
+        TEST(bitset_find_next_unset(bitset, i) == next_unset);
+    }
+
+    for(isize i = 0; i <= bit_count; i++)
+    {
+        TEST(bitset_rank(bitset, i) == rank);
+        if(i < bit_count && reference[i])
+        {
+            TEST(bitset_select(bitset, rank) == i);
+            rank += 1;
+        }
+    }
+    TEST(bitset_select(bitset, rank) == -1);
+    TEST(bitset_select(bitset, -1) == -1);
+    TEST(bitset_find_next_set(bitset, bit_count) == -1);
+}
+
+INTERNAL void test_bitset_dense(f64 max_seconds)
+{
+    Debug_Allocator debug_alloc = {0};
+    debug_allocator_init_use(&debug_alloc, allocator_get_default(), DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK | DEBUG_ALLOCATOR_USE);
+    {
+        enum {MAX_BITS = 2000, MIN_ITERS = 10};
+        u8 reference_a[MAX_BITS] = {0};
+        u8 reference_b[MAX_BITS] = {0};
+
+        Bitset a = {0};
+        Bitset b = {0};
+        bitset_init(&a, debug_alloc.alloc);
+        bitset_init(&b, debug_alloc.alloc);
+        u32_Array indices = {debug_alloc.alloc};
+
+        f64 start = clock_s();
+        for(isize iter = 0; clock_s() - start < max_seconds || iter < MIN_ITERS; iter++)
+        {
+            isize bit_count = random_range(0, MAX_BITS);
+            bitset_resize(&a, bit_count);
+            bitset_resize(&b, bit_count);
+
+            //Fill with varying density
+            f32 density = random_f32();
+            for(isize i = 0; i < bit_count; i++)
+            {
+                reference_a[i] = random_f32() < density;
+                reference_b[i] = random_f32() < density;
+                bitset_assign(&a, i, reference_a[i]);
+                bitset_assign(&b, i, reference_b[i]);
+            }
+
+            //Fill a random range
+            if(random_bool())
+            {
+                isize from = random_range(0, bit_count + 1);
+                isize to = random_range(from, bit_count + 1);
+                bool value = random_bool();
+                bitset_fill_range(&a, from, to, value);
+                memset(reference_a + from, value, (size_t) (to - from));
+            }
+            _test_bitset_check(&a, reference_a, bit_count);
+
+            //Combine a random range
+            Bitset_Op op = (Bitset_Op) random_range(0, 4);
+            isize from = random_range(0, bit_count + 1);
+            isize to = random_range(from, bit_count + 1);
+            bitset_combine(&a, &b, op, from, to);
+            for(isize i = from; i < to; i++)
+                reference_a[i] = _test_bitset_combine_bit(reference_a[i], reference_b[i], op);
+            _test_bitset_check(&a, reference_a, bit_count);
+
+            //Indices
+            array_clear(&indices);
+            from = random_range(0, bit_count + 1);
+            to = random_range(from, bit_count + 1);
+            isize appended = bitset_append_indices(&a, &indices, from, to);
+            TEST(appended == indices.count);
+            TEST(appended == bitset_count_range(&a, from, to));
+            isize k = 0;
+            for(isize i = from; i < to; i++)
+                if(reference_a[i])
+                    TEST(indices.data[k++] == i);
+            TEST(k == indices.count);
+        }
+
+        array_deinit(&indices);
+        bitset_deinit(&a);
+        bitset_deinit(&b);
+    }
+    debug_allocator_deinit(&debug_alloc);
+}
+
+//Generates a random set spread across few containers with mixed density so that both container forms get used
+INTERNAL void _test_bitset_random_set(Compressed_Bitset* compressed, Bitset* reference, isize chunks)
+{
+    compressed_bitset_clear(compressed);
+    bitset_fill(reference, false);
+    for(isize c = 0; c < chunks; c++)
+    {
+        u32 base = (u32) random_range(0, reference->bit_count >> 16) << 16;
+        isize count = random_bool() ? random_range(0, 100) : random_range(0, 10000);
+        for(isize i = 0; i < count; i++)
+        {
+            u32 val = base + (u32) random_range(0, 1 << 16);
+            bool was_set = bitset_get(reference, val);
+            TEST(compressed_bitset_set(compressed, val) == !was_set);
+            bitset_set(reference, val);
+        }
+    }
+}
+
+INTERNAL void _test_compressed_bitset_check(const Compressed_Bitset* compressed, const Bitset* reference, Bitset* temp)
+{
+    compressed_bitset_test_invariants(compressed);
+    TEST(compressed->count == bitset_count(reference));
+
+    for(isize i = bitset_find_next_set(reference, 0); i != -1; i = bitset_find_next_set(reference, i + 1))
+        TEST(compressed_bitset_get(compressed, (u32) i));
+
+    //Check iteration matches and also sample a few random positions
+    isize from = random_range(0, reference->bit_count);
+    TEST(compressed_bitset_find_next_set(compressed, from) == bitset_find_next_set(reference, from));
+    for(isize i = 0; i < 100; i++)
+    {
+        u32 val = (u32) random_range(0, reference->bit_count);
+        TEST(compressed_bitset_get(compressed, val) == bitset_get(reference, val));
+    }
+
+    compressed_bitset_to_bitset(temp, compressed);
+    for(isize i = 0; i < temp->words.count; i++)
+    {
+        u64 expected = i < reference->words.count ? reference->words.data[i] : 0;
+        TEST(temp->words.data[i] == expected);
+    }
+}
+
+INTERNAL void test_bitset_compressed(f64 max_seconds)
+{
+    Debug_Allocator debug_alloc = {0};
+    debug_allocator_init_use(&debug_alloc, allocator_get_default(), DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK | DEBUG_ALLOCATOR_USE);
+    {
+        enum {CHUNKS = 8, MIN_ITERS = 5};
+        Compressed_Bitset a = {0};
+        Compressed_Bitset b = {0};
+        compressed_bitset_init(&a, debug_alloc.alloc);
+        compressed_bitset_init(&b, debug_alloc.alloc);
+
+        Bitset ref_a = {0};
+        Bitset ref_b = {0};
+        Bitset temp = {0};
+        bitset_init(&ref_a, debug_alloc.alloc);
+        bitset_init(&ref_b, debug_alloc.alloc);
+        bitset_init(&temp, debug_alloc.alloc);
+        bitset_resize(&ref_a, (isize) CHUNKS << 16);
+        bitset_resize(&ref_b, (isize) CHUNKS << 16);
+
+        //Values at the very top of the key space
+        TEST(compressed_bitset_set(&a, UINT32_MAX));
+        TEST(compressed_bitset_get(&a, UINT32_MAX));
+        TEST(compressed_bitset_find_next_set(&a, 0) == UINT32_MAX);
+        TEST(compressed_bitset_find_next_set(&a, (isize) UINT32_MAX + 1) == -1);
+        TEST(compressed_bitset_unset(&a, UINT32_MAX));
+        TEST(compressed_bitset_unset(&a, UINT32_MAX) == false);
+        TEST(a.count == 0 && a.containers.count == 0);
+
+        f64 start = clock_s();
+        for(isize iter = 0; clock_s() - start < max_seconds || iter < MIN_ITERS; iter++)
+        {
+            _test_bitset_random_set(&a, &ref_a, random_range(0, CHUNKS));
+            _test_bitset_random_set(&b, &ref_b, random_range(0, CHUNKS));
+            _test_compressed_bitset_check(&a, &ref_a, &temp);
+            _test_compressed_bitset_check(&b, &ref_b, &temp);
+
+            //Remove some values making containers go from bitmap to array form and to nothing
+            for(isize i = bitset_find_next_set(&ref_a, 0); i != -1; i = bitset_find_next_set(&ref_a, i + 1))
+            {
+                if(random_range(0, 4) != 0)
+                {
+                    TEST(compressed_bitset_unset(&a, (u32) i));
+                    bitset_unset(&ref_a, i);
+                }
+            }
+            _test_compressed_bitset_check(&a, &ref_a, &temp);
+
+            Bitset_Op op = (Bitset_Op) random_range(0, 4);
+            compressed_bitset_combine(&a, &b, op);
+            bitset_combine(&ref_a, &ref_b, op, 0, ref_a.bit_count);
+            _test_compressed_bitset_check(&a, &ref_a, &temp);
+
+            compressed_bitset_from_bitset(&b, &ref_b);
+            _test_compressed_bitset_check(&b, &ref_b, &temp);
+        }
+
+        compressed_bitset_deinit(&a);
+        compressed_bitset_deinit(&b);
+        bitset_deinit(&ref_a);
+        bitset_deinit(&ref_b);
+        bitset_deinit(&temp);
+    }
+    debug_allocator_deinit(&debug_alloc);
+}
+
+INTERNAL void test_bitset(f64 max_seconds)
+{
+    test_bitset_dense(max_seconds/2);
+    test_bitset_compressed(max_seconds/2);
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "block_list.h"
+#include "array.h"
+#include "random.h"
+#include "time.h"
+#include "allocator_debug.h"
+
+//Checks the list against a reference array. Uses both the macros and manual block iteration.
+INTERNAL void _test_block_list_check(const Block_List* list, const i64_Array* reference)
+{
+    block_list_test_invariants(list, true);
+    TEST(list->count == reference->count);
+
+    isize i = 0;
+    BLOCK_LIST_FOR_EACH_BEGIN(*list, i64*, item)
+        TEST(*item == reference->data[i]);
+        i += 1;
+    BLOCK_LIST_FOR_EACH_END
+    TEST(i == reference->count);
+
+    if(reference->count > 0)
+    {
+        TEST(*(i64*) block_list_front(list) == reference->data[0]);
+        TEST(*(i64*) block_list_back(list) == reference->data[reference->count - 1]);
+
+        isize index = random_range(0, reference->count);
+        TEST(*(i64*) block_list_at(list, index) == reference->data[index]);
+    }
+}
+
+INTERNAL void test_block_list_unit()
+{
+    Debug_Allocator debug_alloc = {0};
+    debug_allocator_init_use(&debug_alloc, allocator_get_default(), DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK | DEBUG_ALLOCATOR_USE);
+    {
+        Block_List list = {0};
+        block_list_init(&list, debug_alloc.alloc, sizeof(i64));
+        TEST(list.block_size % CACHE_LINE == 0);
+
+        //Alternating push/pop across the block boundary does not leave empty blocks around
+        for(i64 i = 0; i < 1000; i++)
+        {
+            i64 val = 0;
+            block_list_push_front(&list, &i);
+            block_list_pop_back(&list, &val);
+            TEST(val == i);
+            TEST(list.count == 0 && list.first == NULL);
+        }
+
+        enum {COUNT = 1000};
+        for(i64 i = 0; i < COUNT; i++)
+            *(i64*) block_list_push_back(&list, NULL) = i;
+        TEST(list.count == COUNT);
+
+        //Break out of the iteration early
+        isize iterated = 0;
+        BLOCK_LIST_FOR_EACH_BEGIN(list, i64*, item)
+            if(*item == 100)
+                break;
+            iterated += 1;
+        BLOCK_LIST_FOR_EACH_END
+        TEST(iterated == 100);
+
+        //Splicing
+        Block_List other = {0};
+        block_list_init(&other, debug_alloc.alloc, sizeof(i64));
+        for(i64 i = 0; i < 10; i++)
+            block_list_push_front(&other, &i);
+
+        block_list_prepend(&list, &other);
+        TEST(other.count == 0 && other.first == NULL);
+        TEST(list.count == COUNT + 10);
+        for(i64 i = 10; i-- > 0; )
+        {
+            i64 val = -1;
+            block_list_pop_front(&list, &val);
+            TEST(val == i);
+        }
+
+        block_list_append(&other, &list);
+        TEST(list.count == 0);
+        TEST(other.count == COUNT);
+        for(i64 i = 0; i < COUNT; i++)
+            TEST(*(i64*) block_list_at(&other, i) == i);
+
+        block_list_deinit(&list);
+        block_list_deinit(&other);
+    }
+    debug_allocator_deinit(&debug_alloc);
+}
+
+INTERNAL void test_block_list_stress(f64 max_seconds)
+{
+    Debug_Allocator debug_alloc = {0};
+    debug_allocator_init_use(&debug_alloc, allocator_get_default(), DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK | DEBUG_ALLOCATOR_USE);
+    {
+        enum Action {
+            INIT,
+            CLEAR,
+            PUSH_BACK,
+            PUSH_FRONT,
+            POP_BACK,
+            POP_FRONT,
+            APPEND,
+            PREPEND,
+        };
+
+        Discrete_Distribution dist[] = {
+            {INIT,          1},
+            {CLEAR,         1},
+            {PUSH_BACK,     40},
+            {PUSH_FRONT,    40},
+            {POP_BACK,      25},
+            {POP_FRONT,     25},
+            {APPEND,        3},
+            {PREPEND,       3},
+        };
+        random_discrete_make(dist, ARRAY_LEN(dist));
+
+        enum {
+            MAX_ITERS = 1000*1000*10,
+            MIN_ITERS = 100,
+            MAX_SPLICED = 300,
+        };
+
+        Block_List list = {0};
+        Block_List other = {0};
+        i64_Array reference = {debug_alloc.alloc};
+        i64_Array spliced = {debug_alloc.alloc};
+
+        //Use a small block size so that we exercise block boundaries often
+        isize block_size = 2*CACHE_LINE;
+        block_list_init_custom(&list, debug_alloc.alloc, sizeof(i64), sizeof(i64), block_size);
+        block_list_init_custom(&other, debug_alloc.alloc, sizeof(i64), sizeof(i64), block_size);
+
+        f64 start = clock_s();
+        for(isize i = 0; i < MAX_ITERS; i++)
+        {
+            if(clock_s() - start >= max_seconds && i >= MIN_ITERS)
+                break;
+
+            i64 val = (i64) random_u64();
+            isize action = random_discrete(dist, ARRAY_LEN(dist));
+            if(reference.count == 0 && (action == POP_BACK || action == POP_FRONT))
+                action = PUSH_BACK;
+
+            switch(action)
+            {
+                case INIT: {
+                    block_list_init_custom(&list, debug_alloc.alloc, sizeof(i64), sizeof(i64), block_size);
+                    array_clear(&reference);
+                } break;
+
+                case CLEAR: {
+                    block_list_clear(&list);
+                    array_clear(&reference);
+                } break;
+
+                case PUSH_BACK: {
+                    TEST(*(i64*) block_list_push_back(&list, &val) == val);
+                    array_push(&reference, val);
+                } break;
+
+                case PUSH_FRONT: {
+                    TEST(*(i64*) block_list_push_front(&list, &val) == val);
+                    array_push(&reference, 0);
+                    memmove(reference.data + 1, reference.data, (size_t) (reference.count - 1)*sizeof(i64));
+                    reference.data[0] = val;
+                } break;
+
+                case POP_BACK: {
+                    i64 popped = 0;
+                    block_list_pop_back(&list, &popped);
+                    TEST(popped == *array_last(reference));
+                    array_pop(&reference);
+                } break;
+
+                case POP_FRONT: {
+                    i64 popped = 0;
+                    block_list_pop_front(&list, &popped);
+                    TEST(popped == reference.data[0]);
+                    memmove(reference.data, reference.data + 1, (size_t) (reference.count - 1)*sizeof(i64));
+                    array_pop(&reference);
+                } break;
+
+                case APPEND:
+                case PREPEND: {
+                    //Build a list with partially filled blocks on both ends and splice it
+                    array_clear(&spliced);
+                    isize count = random_range(0, MAX_SPLICED);
+                    for(isize k = 0; k < count; k++)
+                    {
+                        i64 item = (i64) random_u64();
+                        if(random_bool())
+                        {
+                            block_list_push_back(&other, &item);
+                            array_push(&spliced, item);
+                        }
+                        else
+                        {
+                            block_list_push_front(&other, &item);
+                            array_push(&spliced, 0);
+                            memmove(spliced.data + 1, spliced.data, (size_t) (spliced.count - 1)*sizeof(i64));
+                            spliced.data[0] = item;
+                        }
+                    }
+                    _test_block_list_check(&other, &spliced);
+
+                    if(action == APPEND)
+                    {
+                        block_list_append(&list, &other);
+                        array_append(&reference, spliced.data, spliced.count);
+                    }
+                    else
+                    {
+                        block_list_prepend(&list, &other);
+                        array_append(&spliced, reference.data, reference.count);
+                        array_copy(&reference, spliced);
+                    }
+                    TEST(other.count == 0);
+                } break;
+
+                default: UNREACHABLE();
+            }
+
+            _test_block_list_check(&list, &reference);
+        }
+
+        block_list_deinit(&list);
+        block_list_deinit(&other);
+        array_deinit(&reference);
+        array_deinit(&spliced);
+    }
+    debug_allocator_deinit(&debug_alloc);
+}
+
+INTERNAL void test_block_list(f64 max_seconds)
+{
+    test_block_list_unit();
+    test_block_list_stress(max_seconds);
+}
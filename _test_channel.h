@@ -8,6 +8,7 @@ typedef long long unsigned  llu;
 
 //Inject debug stuff
 #define CHANNEL_DEBUG
+#define CHANNEL_STATS
 #ifdef CHANNEL_DEBUG
     static void _chan_wait_n(int n);
     static void _chan_mem_log(const char* msg, uint64_t custom1, uint64_t custom2);
@@ -772,6 +773,1146 @@ void test_channel_sequential(isize capacity, bool block)
     channel_deinit(chan);
 }
 
+typedef struct _Test_Sync_Queue_Node {
+    struct _Test_Sync_Queue_Node* next;
+    uint32_t producer;
+    uint32_t seq;
+} _Test_Sync_Queue_Node;
+
+typedef struct _Test_Sync_Queue_Producer {
+    Sync_Queue* queue;
+    Wait_Group* done;
+    _Test_Sync_Queue_Node* nodes;
+    isize count;
+    CHAN_ATOMIC(isize)* pushed; //optional, incremented after each finished push
+} _Test_Sync_Queue_Producer;
+
+void _test_sync_queue_producer(void* arg)
+{
+    _Test_Sync_Queue_Producer* context = (_Test_Sync_Queue_Producer*) arg;
+    for(isize i = 0; i < context->count; )
+    {
+        //Alternate between single pushes and chains
+        isize chain = rand() % 4 == 0 ? rand() % 8 + 1 : 1;
+        if(chain > context->count - i)
+            chain = context->count - i;
+        for(isize k = 0; k < chain - 1; k++)
+            context->nodes[i + k].next = &context->nodes[i + k + 1];
+
+        sync_queue_push_chain(context->queue, &context->nodes[i], &context->nodes[i + chain - 1]);
+        i += chain;
+        if(context->pushed)
+            atomic_fetch_add(context->pushed, chain);
+    }
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void test_sync_queue(isize producer_count, isize per_producer)
+{
+    Sync_Queue queue = {0};
+    sync_queue_init_for(&queue, _Test_Sync_Queue_Node);
+
+    //Sequential
+    {
+        _Test_Sync_Queue_Node nodes[5] = {0};
+        TEST(sync_queue_is_empty(&queue));
+        TEST(sync_queue_pop(&queue) == NULL);
+        TEST(sync_queue_pop_wait(&queue) == NULL);
+
+        for(uint32_t i = 0; i < 5; i++)
+        {
+            nodes[i].seq = i;
+            sync_queue_push(&queue, &nodes[i]);
+            TEST(sync_queue_is_empty(&queue) == false);
+        }
+
+        for(uint32_t i = 0; i < 3; i++)
+        {
+            _Test_Sync_Queue_Node* popped = (_Test_Sync_Queue_Node*) sync_queue_pop(&queue);
+            TEST(popped == &nodes[i]);
+        }
+
+        //push again after the stub was recycled
+        sync_queue_push(&queue, &nodes[0]);
+
+        isize count = 0;
+        _Test_Sync_Queue_Node* first = (_Test_Sync_Queue_Node*) sync_queue_pop_batch(&queue, 10, &count);
+        TEST(count == 3);
+        TEST(first == &nodes[3] && first->next == &nodes[4] && first->next->next == &nodes[0] && nodes[0].next == NULL);
+        TEST(sync_queue_is_empty(&queue));
+        TEST(sync_queue_pop(&queue) == NULL);
+    }
+
+    //Concurrent
+    {
+        isize total = producer_count*per_producer;
+        _Test_Sync_Queue_Node* nodes = (_Test_Sync_Queue_Node*) calloc((size_t) total, sizeof *nodes);
+        _Test_Sync_Queue_Producer* producers = (_Test_Sync_Queue_Producer*) calloc((size_t) producer_count, sizeof *producers);
+        uint32_t* expected = (uint32_t*) calloc((size_t) producer_count, sizeof *expected);
+
+        Wait_Group done = {0};
+        wait_group_push(&done, producer_count);
+        for(isize p = 0; p < producer_count; p++)
+        {
+            producers[p].queue = &queue;
+            producers[p].done = &done;
+            producers[p].nodes = nodes + p*per_producer;
+            producers[p].count = per_producer;
+            for(isize i = 0; i < per_producer; i++)
+            {
+                producers[p].nodes[i].producer = (uint32_t) p;
+                producers[p].nodes[i].seq = (uint32_t) i;
+            }
+            TEST(chan_start_thread(_test_sync_queue_producer, &producers[p]));
+        }
+
+        //Each producer's nodes must arrive in the order they were pushed
+        for(isize received = 0; received < total; )
+        {
+            isize count = 0;
+            _Test_Sync_Queue_Node* first = NULL;
+            if(rand() % 2)
+                first = (_Test_Sync_Queue_Node*) sync_queue_pop_batch(&queue, rand() % 16 + 1, &count);
+            else if((first = (_Test_Sync_Queue_Node*) sync_queue_pop(&queue)) != NULL)
+                count = 1;
+
+            if(first == NULL)
+                chan_yield();
+
+            for(isize i = 0; i < count; i++, first = first->next)
+            {
+                TEST(first != NULL);
+                TEST(first->seq == expected[first->producer]);
+                expected[first->producer] += 1;
+            }
+            received += count;
+        }
+
+        wait_group_wait(&done, SYNC_WAIT_BLOCK);
+        TEST(sync_queue_is_empty(&queue));
+        TEST(sync_queue_pop_wait(&queue) == NULL);
+
+        free(nodes);
+        free(producers);
+        free(expected);
+    }
+}
+
+//Keeps the queue near empty so that the consumer often pushes the stub while producers are mid push.
+// pop_wait must never report empty while some already finished push was not yet popped.
+void test_sync_queue_pop_wait(isize producer_count, isize per_producer)
+{
+    Sync_Queue queue = {0};
+    sync_queue_init_for(&queue, _Test_Sync_Queue_Node);
+
+    isize total = producer_count*per_producer;
+    _Test_Sync_Queue_Node* nodes = (_Test_Sync_Queue_Node*) calloc((size_t) total, sizeof *nodes);
+    _Test_Sync_Queue_Producer* producers = (_Test_Sync_Queue_Producer*) calloc((size_t) producer_count, sizeof *producers);
+    CHAN_ATOMIC(isize) pushed = 0;
+
+    Wait_Group done = {0};
+    wait_group_push(&done, producer_count);
+    for(isize p = 0; p < producer_count; p++)
+    {
+        producers[p].queue = &queue;
+        producers[p].done = &done;
+        producers[p].nodes = nodes + p*per_producer;
+        producers[p].count = per_producer;
+        producers[p].pushed = &pushed;
+        TEST(chan_start_thread(_test_sync_queue_producer, &producers[p]));
+    }
+
+    for(isize received = 0; received < total; )
+    {
+        isize pushed_before = atomic_load(&pushed);
+        _Test_Sync_Queue_Node* node = (_Test_Sync_Queue_Node*) sync_queue_pop_wait(&queue);
+        if(node)
+            received += 1;
+        else
+            TEST(pushed_before <= received);
+    }
+
+    wait_group_wait(&done, SYNC_WAIT_BLOCK);
+    TEST(atomic_load(&pushed) == total);
+    TEST(sync_queue_is_empty(&queue));
+    TEST(sync_queue_pop_wait(&queue) == NULL);
+
+    free(nodes);
+    free(producers);
+}
+
+void test_channel_batch_sequential(isize capacity, bool block)
+{
+    Channel_Info info = {0};
+    if(block)
+        info = _CHAN_SINIT(Channel_Info){sizeof(int), chan_wait_block, chan_wake_block};
+    else
+        info = _CHAN_SINIT(Channel_Info){sizeof(int), chan_wait_yield};
+
+    Channel* chan = channel_malloc(capacity, info);
+    int* items = (int*) calloc((size_t) capacity*2 + 1, sizeof(int));
+    int* popped = (int*) calloc((size_t) capacity*2 + 1, sizeof(int));
+    for(int i = 0; i < capacity*2 + 1; i++)
+        items[i] = i;
+
+    //Blocking 
+    {
+        TEST(channel_push_many(chan, items, 0, info) == 0);
+        TEST(channel_push_many(chan, items, capacity, info) == capacity);
+        TEST(channel_count(chan) == capacity);
+        TEST(channel_try_push(chan, items, info) == CHANNEL_FULL);
+        TEST(channel_is_invariant_converged_state(chan, info));
+
+        TEST(channel_pop_many(chan, popped, capacity, info) == capacity);
+        TEST(memcmp(popped, items, (size_t) capacity*sizeof(int)) == 0);
+        TEST(channel_count(chan) == 0);
+        TEST(channel_is_invariant_converged_state(chan, info));
+    }
+
+    //Non blocking stops at full/empty
+    {
+        TEST(channel_try_pop_many(chan, popped, capacity, info) == 0);
+        TEST(channel_try_push_many(chan, items, capacity*2 + 1, info) == capacity);
+        TEST(channel_try_push_many(chan, items, 1, info) == 0);
+        TEST(channel_is_invariant_converged_state(chan, info));
+
+        isize half = capacity/2;
+        TEST(channel_try_pop_many(chan, popped, half, info) == half);
+        TEST(channel_try_pop_many(chan, popped + half, capacity*2 + 1, info) == capacity - half);
+        TEST(memcmp(popped, items, (size_t) capacity*sizeof(int)) == 0);
+        TEST(channel_try_pop_many(chan, popped, 1, info) == 0);
+        TEST(channel_is_invariant_converged_state(chan, info));
+    }
+
+    //Closing stops the batches at the barrier
+    {
+        isize push_count = capacity - 1;
+        TEST(channel_try_push_many(chan, items, push_count, info) == push_count);
+        TEST(channel_close_push(chan, info));
+        TEST(channel_push_many(chan, items, 2, info) == 0);
+        TEST(channel_try_push_many(chan, items, 2, info) == 0);
+        TEST(channel_is_invariant_converged_state(chan, info));
+
+        isize first = push_count/2;
+        TEST(channel_try_pop_many(chan, popped, first, info) == first);
+        TEST(channel_pop_many(chan, popped + first, capacity, info) == push_count - first);
+        TEST(memcmp(popped, items, (size_t) push_count*sizeof(int)) == 0);
+        TEST(channel_pop_many(chan, popped, 1, info) == 0);
+        TEST(channel_try_pop_many(chan, popped, 1, info) == 0);
+        TEST(channel_count(chan) == 0);
+        TEST(channel_is_invariant_converged_state(chan, info));
+        TEST(channel_reopen(chan, info));
+    }
+
+    free(items);
+    free(popped);
+    channel_deinit(chan);
+}
+
+typedef struct _Test_Channel_Batch_Thread {
+    Channel* chan;
+    Channel_Info info;
+    Wait_Group* done;
+    uint32_t producer;
+    uint32_t _;
+    isize count;
+    uint64_t* received; //per producer count of received items. Only used by consumers
+    CHAN_ATOMIC(isize)* total_received;
+} _Test_Channel_Batch_Thread;
+
+enum {_TEST_CHANNEL_BATCH_MAX = 64};
+
+void _test_channel_batch_producer(void* arg)
+{
+    _Test_Channel_Batch_Thread* context = (_Test_Channel_Batch_Thread*) arg;
+    uint64_t items[_TEST_CHANNEL_BATCH_MAX] = {0};
+    for(isize i = 0; i < context->count; )
+    {
+        isize batch = rand() % _TEST_CHANNEL_BATCH_MAX + 1;
+        if(batch > context->count - i)
+            batch = context->count - i;
+        for(isize k = 0; k < batch; k++)
+            items[k] = (uint64_t) context->producer << 32 | (uint64_t) (i + k);
+
+        isize pushed = 0;
+        if(rand() % 2)
+            pushed = channel_push_many(context->chan, items, batch, context->info);
+        else
+            pushed = channel_try_push_many(context->chan, items, batch, context->info);
+        i += pushed;
+        if(pushed == 0)
+            chan_yield();
+    }
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void _test_channel_batch_consumer(void* arg)
+{
+    _Test_Channel_Batch_Thread* context = (_Test_Channel_Batch_Thread*) arg;
+    uint64_t items[_TEST_CHANNEL_BATCH_MAX] = {0};
+    for(;;)
+    {
+        isize popped = 0;
+        if(rand() % 2)
+            popped = channel_pop_many(context->chan, items, rand() % _TEST_CHANNEL_BATCH_MAX + 1, context->info);
+        else
+        {
+            popped = channel_try_pop_many(context->chan, items, rand() % _TEST_CHANNEL_BATCH_MAX + 1, context->info);
+            if(popped == 0 && channel_is_closed(context->chan))
+                break;
+        }
+        
+        //Items of a single producer popped by a single consumer must be in order
+        for(isize k = 0; k < popped; k++)
+        {
+            uint32_t producer = (uint32_t) (items[k] >> 32);
+            uint32_t index = (uint32_t) items[k];
+            TEST(index >= context->received[producer]);
+            context->received[producer] = index + 1;
+        }
+        atomic_fetch_add(context->total_received, popped);
+
+        if(popped == 0)
+        {
+            if(channel_is_closed(context->chan))
+                break;
+            chan_yield();
+        }
+    }
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void test_channel_batch_threaded(isize capacity, isize producer_count, isize consumer_count, isize per_producer, bool block)
+{
+    Channel_Info info = {0};
+    if(block)
+        info = _CHAN_SINIT(Channel_Info){sizeof(uint64_t), chan_wait_block, chan_wake_block};
+    else
+        info = _CHAN_SINIT(Channel_Info){sizeof(uint64_t), chan_wait_yield};
+
+    Channel* chan = channel_malloc(capacity, info);
+    _Test_Channel_Batch_Thread threads[TEST_CHAN_MAX_THREADS] = {0};
+    uint64_t* received = (uint64_t*) calloc((size_t) (producer_count*consumer_count), sizeof(uint64_t));
+    CHAN_ATOMIC(isize) total_received = 0;
+    TEST(producer_count + consumer_count <= TEST_CHAN_MAX_THREADS);
+
+    Wait_Group producers_done = {0};
+    Wait_Group consumers_done = {0};
+    wait_group_push(&producers_done, producer_count);
+    wait_group_push(&consumers_done, consumer_count);
+    for(isize i = 0; i < producer_count + consumer_count; i++)
+    {
+        _Test_Channel_Batch_Thread* thread = &threads[i];
+        thread->chan = chan;
+        thread->info = info;
+        thread->total_received = &total_received;
+        if(i < producer_count)
+        {
+            thread->done = &producers_done;
+            thread->producer = (uint32_t) i;
+            thread->count = per_producer;
+            TEST(chan_start_thread(_test_channel_batch_producer, thread));
+        }
+        else
+        {
+            thread->done = &consumers_done;
+            thread->received = received + (i - producer_count)*producer_count;
+            TEST(chan_start_thread(_test_channel_batch_consumer, thread));
+        }
+    }
+
+    wait_group_wait(&producers_done, SYNC_WAIT_BLOCK);
+    channel_close_push(chan, info);
+    wait_group_wait(&consumers_done, SYNC_WAIT_BLOCK);
+
+    TEST(total_received == producer_count*per_producer);
+    TEST(channel_count(chan) == 0);
+    free(received);
+    channel_deinit(chan);
+}
+
+void test_channel_select_sequential(bool block)
+{
+    Channel_Info info = {0};
+    if(block)
+        info = _CHAN_SINIT(Channel_Info){sizeof(int), chan_wait_block, chan_wake_block};
+    else
+        info = _CHAN_SINIT(Channel_Info){sizeof(int), chan_wait_yield};
+
+    Channel* a = channel_malloc(2, info);
+    Channel* b = channel_malloc(2, info);
+    int a_item = 0;
+    int b_item = 0;
+    Channel_Select_Case cases[3] = {0};
+    cases[0].chan = a; cases[0].item = &a_item; cases[0].info = info;
+    cases[1].chan = NULL; //ignored
+    cases[2].chan = b; cases[2].item = &b_item; cases[2].info = info;
+
+    //Nothing ready
+    Channel_Res res = CHANNEL_OK;
+    TEST(channel_select(cases, 3, 0, &res) == -1 && res == CHANNEL_EMPTY);
+    int64_t before = chan_perf_counter();
+    TEST(channel_select(cases, 3, 0.01, &res) == -1 && res == CHANNEL_EMPTY);
+    TEST((double) (chan_perf_counter() - before)/(double) chan_perf_frequency() >= 0.01);
+    TEST(a->select_count == 0 && b->select_count == 0);
+
+    //Pops from whichever is ready
+    int value = 7;
+    TEST(channel_push(b, &value, info));
+    TEST(channel_select(cases, 3, -1, &res) == 2 && res == CHANNEL_OK && b_item == 7);
+    value = 8;
+    TEST(channel_push(a, &value, info));
+    TEST(channel_select(cases, 3, -1, &res) == 0 && res == CHANNEL_OK && a_item == 8);
+
+    //Both ready are picked fairly
+    isize picked[3] = {0};
+    for(int i = 0; i < 100; i++)
+    {
+        TEST(channel_push(a, &i, info));
+        TEST(channel_push(b, &i, info));
+        isize first = channel_select(cases, 3, -1, NULL);
+        isize second = channel_select(cases, 3, -1, NULL);
+        TEST(first != second && first != 1 && second != 1);
+        picked[first] += 1;
+    }
+    TEST(picked[0] > 0 && picked[2] > 0);
+    TEST(channel_count(a) == 0 && channel_count(b) == 0);
+
+    //Pushes into whichever is not full
+    cases[0].is_push = true;
+    cases[2].is_push = true;
+    a_item = 1; b_item = 2;
+    for(isize i = 0; i < 4; i++)
+        TEST(channel_select(cases, 3, -1, &res) != -1 && res == CHANNEL_OK);
+    TEST(channel_count(a) == 2 && channel_count(b) == 2);
+    TEST(channel_select(cases, 3, 0.001, &res) == -1 && res == CHANNEL_EMPTY);
+    TEST(channel_pop(b, &value, info) && value == 2);
+    TEST(channel_select(cases, 3, -1, &res) == 2 && res == CHANNEL_OK);
+
+    //Closed channels complete with CHANNEL_CLOSED
+    TEST(channel_close_soft(a, info));
+    TEST(channel_select(cases, 3, -1, &res) == 0 && res == CHANNEL_CLOSED);
+    cases[0].chan = NULL;
+    cases[2].chan = NULL;
+    TEST(channel_select(cases, 3, -1, &res) == -1);
+
+    TEST(channel_is_invariant_converged_state(a, info));
+    TEST(channel_is_invariant_converged_state(b, info));
+    channel_deinit(a);
+    channel_deinit(b);
+}
+
+typedef struct _Test_Channel_Select_Thread {
+    Channel* chans[2];
+    Channel_Info info;
+    Wait_Group* done;
+    uint32_t producer;
+    uint32_t _;
+    isize count;
+    uint64_t* received; //per producer sum of received indices. Only used by consumers
+} _Test_Channel_Select_Thread;
+
+void _test_channel_select_producer(void* arg)
+{
+    _Test_Channel_Select_Thread* context = (_Test_Channel_Select_Thread*) arg;
+    uint64_t item = 0;
+    Channel_Select_Case cases[2] = {0};
+    for(isize i = 0; i < 2; i++)
+    {
+        cases[i].chan = context->chans[i];
+        cases[i].info = context->info;
+        cases[i].item = &item;
+        cases[i].is_push = true;
+    }
+
+    for(isize i = 0; i < context->count; i++)
+    {
+        Channel_Res res = CHANNEL_OK;
+        item = (uint64_t) context->producer << 32 | (uint64_t) i;
+        TEST(channel_select(cases, 2, -1, &res) != -1 && res == CHANNEL_OK);
+    }
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void _test_channel_select_consumer(void* arg)
+{
+    _Test_Channel_Select_Thread* context = (_Test_Channel_Select_Thread*) arg;
+    uint64_t items[2] = {0};
+    Channel_Select_Case cases[2] = {0};
+    for(isize i = 0; i < 2; i++)
+    {
+        cases[i].chan = context->chans[i];
+        cases[i].info = context->info;
+        cases[i].item = &items[i];
+    }
+
+    for(;;)
+    {
+        Channel_Res res = CHANNEL_OK;
+        isize index = channel_select(cases, 2, -1, &res);
+        if(index == -1)
+            break;
+        if(res == CHANNEL_CLOSED)
+            cases[index].chan = NULL;
+        else
+        {
+            uint32_t producer = (uint32_t) (items[index] >> 32);
+            context->received[producer] += (uint32_t) items[index];
+        }
+    }
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void test_channel_select_threaded(isize capacity, isize producer_count, isize consumer_count, isize per_producer, bool block)
+{
+    Channel_Info info = {0};
+    if(block)
+        info = _CHAN_SINIT(Channel_Info){sizeof(uint64_t), chan_wait_block, chan_wake_block};
+    else
+        info = _CHAN_SINIT(Channel_Info){sizeof(uint64_t), chan_wait_yield};
+
+    Channel* chans[2] = {channel_malloc(capacity, info), channel_malloc(capacity, info)};
+    _Test_Channel_Select_Thread threads[TEST_CHAN_MAX_THREADS] = {0};
+    uint64_t* received = (uint64_t*) calloc((size_t) (producer_count*consumer_count), sizeof(uint64_t));
+    TEST(producer_count + consumer_count <= TEST_CHAN_MAX_THREADS);
+
+    Wait_Group producers_done = {0};
+    Wait_Group consumers_done = {0};
+    wait_group_push(&producers_done, producer_count);
+    wait_group_push(&consumers_done, consumer_count);
+    for(isize i = 0; i < producer_count + consumer_count; i++)
+    {
+        _Test_Channel_Select_Thread* thread = &threads[i];
+        thread->chans[0] = chans[0];
+        thread->chans[1] = chans[1];
+        thread->info = info;
+        if(i < producer_count)
+        {
+            thread->done = &producers_done;
+            thread->producer = (uint32_t) i;
+            thread->count = per_producer;
+            TEST(chan_start_thread(_test_channel_select_producer, thread));
+        }
+        else
+        {
+            thread->done = &consumers_done;
+            thread->received = received + (i - producer_count)*producer_count;
+            TEST(chan_start_thread(_test_channel_select_consumer, thread));
+        }
+    }
+
+    wait_group_wait(&producers_done, SYNC_WAIT_BLOCK);
+    channel_close_push(chans[0], info);
+    channel_close_push(chans[1], info);
+    wait_group_wait(&consumers_done, SYNC_WAIT_BLOCK);
+
+    //Every item was received exactly once
+    for(isize p = 0; p < producer_count; p++)
+    {
+        uint64_t sum = 0;
+        for(isize c = 0; c < consumer_count; c++)
+            sum += received[c*producer_count + p];
+        TEST(sum == (uint64_t) per_producer*(uint64_t) (per_producer - 1)/2);
+    }
+
+    for(isize i = 0; i < 2; i++)
+    {
+        TEST(channel_count(chans[i]) == 0);
+        TEST(chans[i]->select_count == 0);
+        channel_deinit(chans[i]);
+    }
+    free(received);
+}
+
+void test_channel_unbounded_sequential(bool block)
+{
+    Channel_Info info = {0};
+    if(block)
+        info = _CHAN_SINIT(Channel_Info){sizeof(int), chan_wait_block, chan_wake_block};
+    else
+        info = _CHAN_SINIT(Channel_Info){sizeof(int), chan_wait_yield};
+
+    enum {COUNT = 1000};
+    Channel_Unbounded chan = {0};
+    TEST(channel_unbounded_init(&chan, 2, info));
+
+    //Grows instead of blocking
+    for(int i = 0; i < COUNT; i++)
+        TEST(channel_unbounded_push(&chan, &i, info));
+    TEST(channel_unbounded_count(&chan) == COUNT);
+    TEST(channel_unbounded_capacity(&chan) >= COUNT/2);
+    TEST(chan.segment_count > 1 && chan.segment_count < 16);
+
+    //Pops in order across segments
+    for(int i = 0; i < COUNT; i++)
+    {
+        int popped = -1;
+        if(i % 2)
+            TEST(channel_unbounded_pop(&chan, &popped, info));
+        else
+            TEST(channel_unbounded_try_pop(&chan, &popped, info) == CHANNEL_OK);
+        TEST(popped == i);
+    }
+    int value = 0;
+    TEST(channel_unbounded_try_pop(&chan, &value, info) == CHANNEL_EMPTY);
+    TEST(channel_unbounded_count(&chan) == 0);
+
+    //The drained segments can be freed and the grown capacity is kept
+    isize capacity = channel_unbounded_capacity(&chan);
+    TEST(channel_unbounded_trim(&chan) > 0);
+    TEST(chan.segment_count == 1 && channel_unbounded_capacity(&chan) == capacity);
+    for(int i = 0; i < COUNT/2; i++)
+        TEST(channel_unbounded_push(&chan, &i, info));
+    TEST(chan.segment_count == 1);
+
+    //Closing lets consumers drain the remaining items 
+    TEST(channel_unbounded_close_push(&chan, info));
+    TEST(channel_unbounded_close_push(&chan, info) == false);
+    TEST(channel_unbounded_is_closed(&chan));
+    TEST(channel_unbounded_push(&chan, &value, info) == false);
+    for(int i = 0; i < COUNT/2; i++)
+        TEST(channel_unbounded_pop(&chan, &value, info) && value == i);
+    TEST(channel_unbounded_pop(&chan, &value, info) == false);
+    TEST(channel_unbounded_try_pop(&chan, &value, info) == CHANNEL_CLOSED);
+
+    TEST(channel_unbounded_reopen(&chan, info));
+    TEST(channel_unbounded_is_closed(&chan) == false);
+    for(int i = 0; i < COUNT; i++)
+        TEST(channel_unbounded_push(&chan, &i, info));
+    TEST(channel_unbounded_pop(&chan, &value, info) && value == 0);
+
+    TEST(channel_unbounded_close_hard(&chan, info));
+    TEST(channel_unbounded_reopen(&chan, info) == false);
+    TEST(channel_unbounded_push(&chan, &value, info) == false);
+    TEST(channel_unbounded_pop(&chan, &value, info) == false);
+    channel_unbounded_deinit(&chan);
+}
+
+typedef struct _Test_Channel_Unbounded_Thread {
+    Channel_Unbounded* chan;
+    Channel_Info info;
+    Wait_Group* done;
+    uint32_t producer;
+    uint32_t _;
+    isize count;
+    uint64_t* received; //per producer count of received items. Only used by consumers
+    CHAN_ATOMIC(isize)* total_received;
+} _Test_Channel_Unbounded_Thread;
+
+void _test_channel_unbounded_producer(void* arg)
+{
+    _Test_Channel_Unbounded_Thread* context = (_Test_Channel_Unbounded_Thread*) arg;
+    for(isize i = 0; i < context->count; i++)
+    {
+        uint64_t item = (uint64_t) context->producer << 32 | (uint64_t) i;
+        TEST(channel_unbounded_push(context->chan, &item, context->info));
+    }
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void _test_channel_unbounded_consumer(void* arg)
+{
+    _Test_Channel_Unbounded_Thread* context = (_Test_Channel_Unbounded_Thread*) arg;
+    for(;;)
+    {
+        uint64_t item = 0;
+        if(rand() % 2)
+        {
+            if(channel_unbounded_pop(context->chan, &item, context->info) == false)
+                break;
+        }
+        else
+        {
+            Channel_Res res = channel_unbounded_try_pop(context->chan, &item, context->info);
+            if(res == CHANNEL_CLOSED)
+                break;
+            if(res == CHANNEL_EMPTY)
+            {
+                chan_yield();
+                continue;
+            }
+        }
+        
+        //Items of a single producer popped by a single consumer must be in order
+        uint32_t producer = (uint32_t) (item >> 32);
+        uint32_t index = (uint32_t) item;
+        TEST(index >= context->received[producer]);
+        context->received[producer] = index + 1;
+        atomic_fetch_add(context->total_received, 1);
+    }
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void test_channel_unbounded_threaded(isize initial_capacity, isize producer_count, isize consumer_count, isize per_producer, bool block)
+{
+    Channel_Info info = {0};
+    if(block)
+        info = _CHAN_SINIT(Channel_Info){sizeof(uint64_t), chan_wait_block, chan_wake_block};
+    else
+        info = _CHAN_SINIT(Channel_Info){sizeof(uint64_t), chan_wait_yield};
+
+    Channel_Unbounded chan = {0};
+    TEST(channel_unbounded_init(&chan, initial_capacity, info));
+    _Test_Channel_Unbounded_Thread threads[TEST_CHAN_MAX_THREADS] = {0};
+    uint64_t* received = (uint64_t*) calloc((size_t) (producer_count*consumer_count), sizeof(uint64_t));
+    CHAN_ATOMIC(isize) total_received = 0;
+    TEST(producer_count + consumer_count <= TEST_CHAN_MAX_THREADS);
+
+    Wait_Group producers_done = {0};
+    Wait_Group consumers_done = {0};
+    wait_group_push(&producers_done, producer_count);
+    wait_group_push(&consumers_done, consumer_count);
+    for(isize i = 0; i < producer_count + consumer_count; i++)
+    {
+        _Test_Channel_Unbounded_Thread* thread = &threads[i];
+        thread->chan = &chan;
+        thread->info = info;
+        thread->total_received = &total_received;
+        if(i < producer_count)
+        {
+            thread->done = &producers_done;
+            thread->producer = (uint32_t) i;
+            thread->count = per_producer;
+            TEST(chan_start_thread(_test_channel_unbounded_producer, thread));
+        }
+        else
+        {
+            thread->done = &consumers_done;
+            thread->received = received + (i - producer_count)*producer_count;
+            TEST(chan_start_thread(_test_channel_unbounded_consumer, thread));
+        }
+    }
+
+    wait_group_wait(&producers_done, SYNC_WAIT_BLOCK);
+    channel_unbounded_close_push(&chan, info);
+    wait_group_wait(&consumers_done, SYNC_WAIT_BLOCK);
+
+    TEST(total_received == producer_count*per_producer);
+    TEST(channel_unbounded_count(&chan) == 0);
+    free(received);
+    channel_unbounded_deinit(&chan);
+}
+
+enum {_TEST_CHANNEL_IN_PLACE_SIZE = 256};
+
+void test_channel_in_place_sequential(isize capacity, bool block)
+{
+    Channel_Info info = {0};
+    if(block)
+        info = _CHAN_SINIT(Channel_Info){_TEST_CHANNEL_IN_PLACE_SIZE, chan_wait_block, chan_wake_block};
+    else
+        info = _CHAN_SINIT(Channel_Info){_TEST_CHANNEL_IN_PLACE_SIZE, chan_wait_yield};
+
+    Channel* chan = channel_malloc(capacity, info);
+    uint8_t item[_TEST_CHANNEL_IN_PLACE_SIZE] = {0};
+    for(int round = 0; round < 3; round++)
+    {
+        //Slots point directly into the channel and tickets are consecutive
+        uint64_t first_ticket = 0;
+        for(isize i = 0; i < capacity; i++)
+        {
+            uint64_t ticket = 0;
+            uint8_t* slot = (uint8_t*) channel_push_reserve(chan, &ticket, info);
+            TEST(chan->items <= slot && slot < chan->items + capacity*info.item_size);
+            if(i == 0)
+                first_ticket = ticket;
+            TEST(ticket == first_ticket + (uint64_t) i);
+            memset(slot, (int) i, sizeof item);
+            channel_push_commit(chan, ticket, info);
+        }
+        TEST(channel_count(chan) == capacity);
+        TEST(channel_try_push(chan, item, info) == CHANNEL_FULL);
+
+        //In place and copying interfaces can be mixed
+        for(isize i = 0; i < capacity; i++)
+        {
+            if(i % 2)
+            {
+                TEST(channel_pop(chan, item, info));
+                TEST(item[0] == (uint8_t) i && item[sizeof item - 1] == (uint8_t) i);
+            }
+            else
+            {
+                uint64_t ticket = 0;
+                const uint8_t* slot = (const uint8_t*) channel_pop_acquire(chan, &ticket, info);
+                TEST(slot && ticket == first_ticket + (uint64_t) i);
+                TEST(slot[0] == (uint8_t) i && slot[sizeof item - 1] == (uint8_t) i);
+                channel_pop_release(chan, ticket, info);
+            }
+        }
+        TEST(channel_count(chan) == 0);
+        TEST(channel_is_invariant_converged_state(chan, info));
+    }
+
+    //Closed channel gives out no slots
+    uint64_t ticket = 0;
+    TEST(channel_close_soft(chan, info));
+    TEST(channel_push_reserve(chan, &ticket, info) == NULL);
+    TEST(channel_pop_acquire(chan, &ticket, info) == NULL);
+    TEST(channel_is_invariant_converged_state(chan, info));
+    TEST(channel_reopen(chan, info));
+    channel_deinit(chan);
+}
+
+typedef struct _Test_Channel_In_Place_Thread {
+    Channel* chan;
+    Channel_Info info;
+    Wait_Group* done;
+    uint32_t producer;
+    uint32_t _;
+    isize count;
+    CHAN_ATOMIC(isize)* total_received;
+} _Test_Channel_In_Place_Thread;
+
+//Each item is filled with the low byte of its index after the header so that torn reads/writes are detected
+void _test_channel_in_place_producer(void* arg)
+{
+    _Test_Channel_In_Place_Thread* context = (_Test_Channel_In_Place_Thread*) arg;
+    for(isize i = 0; i < context->count; i++)
+    {
+        uint64_t ticket = 0;
+        uint8_t* slot = (uint8_t*) channel_push_reserve(context->chan, &ticket, context->info);
+        TEST(slot);
+        uint64_t header = (uint64_t) context->producer << 32 | (uint64_t) i;
+        memcpy(slot, &header, sizeof header);
+        memset(slot + sizeof header, (uint8_t) i, _TEST_CHANNEL_IN_PLACE_SIZE - sizeof header);
+        channel_push_commit(context->chan, ticket, context->info);
+    }
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void _test_channel_in_place_consumer(void* arg)
+{
+    _Test_Channel_In_Place_Thread* context = (_Test_Channel_In_Place_Thread*) arg;
+    for(;;)
+    {
+        uint64_t ticket = 0;
+        const uint8_t* slot = (const uint8_t*) channel_pop_acquire(context->chan, &ticket, context->info);
+        if(slot == NULL)
+            break;
+
+        uint64_t header = 0;
+        memcpy(&header, slot, sizeof header);
+        for(isize k = sizeof header; k < _TEST_CHANNEL_IN_PLACE_SIZE; k++)
+            TEST(slot[k] == (uint8_t) header);
+        channel_pop_release(context->chan, ticket, context->info);
+        atomic_fetch_add(context->total_received, 1);
+    }
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void test_channel_in_place_threaded(isize capacity, isize producer_count, isize consumer_count, isize per_producer, bool block)
+{
+    Channel_Info info = {0};
+    if(block)
+        info = _CHAN_SINIT(Channel_Info){_TEST_CHANNEL_IN_PLACE_SIZE, chan_wait_block, chan_wake_block};
+    else
+        info = _CHAN_SINIT(Channel_Info){_TEST_CHANNEL_IN_PLACE_SIZE, chan_wait_yield};
+
+    Channel* chan = channel_malloc(capacity, info);
+    _Test_Channel_In_Place_Thread threads[TEST_CHAN_MAX_THREADS] = {0};
+    CHAN_ATOMIC(isize) total_received = 0;
+    TEST(producer_count + consumer_count <= TEST_CHAN_MAX_THREADS);
+
+    Wait_Group producers_done = {0};
+    Wait_Group consumers_done = {0};
+    wait_group_push(&producers_done, producer_count);
+    wait_group_push(&consumers_done, consumer_count);
+    for(isize i = 0; i < producer_count + consumer_count; i++)
+    {
+        _Test_Channel_In_Place_Thread* thread = &threads[i];
+        thread->chan = chan;
+        thread->info = info;
+        thread->total_received = &total_received;
+        thread->producer = (uint32_t) i;
+        thread->count = per_producer;
+        thread->done = i < producer_count ? &producers_done : &consumers_done;
+        TEST(chan_start_thread(i < producer_count ? _test_channel_in_place_producer : _test_channel_in_place_consumer, thread));
+    }
+
+    wait_group_wait(&producers_done, SYNC_WAIT_BLOCK);
+    channel_close_push(chan, info);
+    wait_group_wait(&consumers_done, SYNC_WAIT_BLOCK);
+
+    TEST(total_received == producer_count*per_producer);
+    TEST(channel_count(chan) == 0);
+    channel_deinit(chan);
+}
+
+typedef struct _Test_Channel_Stats_Thread {
+    Channel* chan;
+    Channel_Info info;
+    Wait_Group* done;
+    bool push;
+} _Test_Channel_Stats_Thread;
+
+void _test_channel_stats_runner(void* arg)
+{
+    _Test_Channel_Stats_Thread* context = (_Test_Channel_Stats_Thread*) arg;
+    int item = 0;
+    if(context->push)
+        TEST(channel_push(context->chan, &item, context->info));
+    else
+        TEST(channel_pop(context->chan, &item, context->info));
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void test_channel_stats()
+{
+    Channel_Info info = _CHAN_SINIT(Channel_Info){sizeof(int), chan_wait_block, chan_wake_block};
+    Channel* chan = channel_malloc(4, info);
+    int item = 0;
+    for(int i = 0; i < 4; i++)
+        TEST(channel_push(chan, &i, info));
+
+    Channel_Stats stats = channel_get_stats(chan);
+    TEST(stats.max_count == 4);
+    TEST(stats.push_waits == 0 && stats.pop_waits == 0 && stats.wakes == 0);
+
+    //Push into full channel has to wait for a pop
+    Wait_Group done = {0};
+    _Test_Channel_Stats_Thread thread = {chan, info, &done, true};
+    wait_group_push(&done, 1);
+    TEST(chan_start_thread(_test_channel_stats_runner, &thread));
+    chan_sleep(0.01);
+    TEST(channel_pop(chan, &item, info));
+    wait_group_wait(&done, SYNC_WAIT_BLOCK);
+    
+    stats = channel_get_stats(chan);
+    TEST(stats.push_waits == 1 && stats.pop_waits == 0);
+    TEST(stats.push_wait_ticks > 0);
+    TEST(stats.wakes >= 1);
+    TEST(stats.max_count == 4);
+
+    //Pop from empty channel has to wait for a push
+    for(int i = 0; i < 4; i++)
+        TEST(channel_pop(chan, &item, info));
+    thread.push = false;
+    wait_group_push(&done, 1);
+    TEST(chan_start_thread(_test_channel_stats_runner, &thread));
+    chan_sleep(0.01);
+    TEST(channel_push(chan, &item, info));
+    wait_group_wait(&done, SYNC_WAIT_BLOCK);
+
+    stats = channel_get_stats(chan);
+    TEST(stats.pop_waits == 1);
+    TEST(stats.pop_wait_ticks > 0);
+    TEST(stats.wakes >= 2);
+
+    channel_reset_stats(chan);
+    stats = channel_get_stats(chan);
+    TEST(stats.push_waits == 0 && stats.pop_waits == 0 && stats.wakes == 0 && stats.max_count == 0);
+    channel_deinit(chan);
+}
+
+typedef struct _Test_Channel_Adaptive_Thread {
+    Channel* to;
+    Channel* from;
+    Channel_Info info;
+    Wait_Group* done;
+    isize round_trips;
+} _Test_Channel_Adaptive_Thread;
+
+void _test_channel_adaptive_echo(void* arg)
+{
+    _Test_Channel_Adaptive_Thread* context = (_Test_Channel_Adaptive_Thread*) arg;
+    for(isize i = 0; i < context->round_trips; i++)
+    {
+        isize item = 0;
+        TEST(channel_pop(context->to, &item, context->info));
+        TEST(item == i);
+        item += 1;
+        TEST(channel_push(context->from, &item, context->info));
+    }
+    wait_group_pop(context->done, 1, SYNC_WAIT_ADAPTIVE);
+}
+
+void test_channel_adaptive_wait(isize round_trips)
+{
+    //Gives up after the timeout and returns immediately if the value differs
+    uint32_t state = 1;
+    int64_t before = chan_perf_counter();
+    TEST(chan_wait_adaptive(&state, 1, 0.01) == false);
+    TEST((double) (chan_perf_counter() - before)/(double) chan_perf_frequency() >= 0.009);
+    TEST(chan_wait_adaptive(&state, 0, -1));
+
+    //Ping pong between two threads where every pop and push waits on the other side
+    Channel_Info info = _CHAN_SINIT(Channel_Info){sizeof(isize), chan_wait_adaptive, chan_wake_block};
+    Channel* to = channel_malloc(1, info);
+    Channel* from = channel_malloc(1, info);
+    
+    Wait_Group done = {0};
+    wait_group_push(&done, 1);
+    _Test_Channel_Adaptive_Thread thread = {to, from, info, &done, round_trips};
+    TEST(chan_start_thread(_test_channel_adaptive_echo, &thread));
+    for(isize i = 0; i < round_trips; i++)
+    {
+        isize item = i;
+        TEST(channel_push(to, &item, info));
+        TEST(channel_pop(from, &item, info));
+        TEST(item == i + 1);
+    }
+    wait_group_wait(&done, SYNC_WAIT_ADAPTIVE);
+    TEST(wait_group_count(&done) == 0);
+
+    channel_deinit(to);
+    channel_deinit(from);
+}
+
+Channel_Info _test_channel_spsc_info(isize item_size, int mode)
+{
+    switch(mode)
+    {
+        case 0: return _CHAN_SINIT(Channel_Info){item_size};
+        case 1: return _CHAN_SINIT(Channel_Info){item_size, chan_wait_yield};
+        case 2: return _CHAN_SINIT(Channel_Info){item_size, chan_wait_block, chan_wake_block};
+        default: return _CHAN_SINIT(Channel_Info){item_size, chan_wait_adaptive, chan_wake_block};
+    }
+}
+
+void test_channel_spsc_sequential(isize capacity, int mode)
+{
+    Channel_Info info = _test_channel_spsc_info(sizeof(int), mode);
+    Channel_Spsc* chan = channel_spsc_malloc(capacity, info);
+    TEST(chan && channel_spsc_capacity(chan) == capacity && channel_spsc_count(chan) == 0);
+
+    int value = -1;
+    TEST(channel_spsc_try_pop(chan, &value, info) == CHANNEL_EMPTY);
+    for(int i = 0; i < capacity; i++)
+        TEST(channel_spsc_try_push(chan, &i, info) == CHANNEL_OK);
+    TEST(channel_spsc_try_push(chan, &value, info) == CHANNEL_FULL);
+    TEST(channel_spsc_count(chan) == capacity);
+    for(int i = 0; i < capacity; i++)
+        TEST(channel_spsc_pop(chan, &value, info) && value == i);
+    TEST(channel_spsc_try_pop(chan, &value, info) == CHANNEL_EMPTY);
+
+    //Batches wrap around the end of the ring
+    enum {BATCH = 64};
+    int items[3*BATCH] = {0};
+    int popped[3*BATCH] = {0};
+    int next_push = 0;
+    int next_pop = 0;
+    for(int round = 0; round < 100; round++)
+    {
+        isize count = round % BATCH + 1;
+        for(isize i = 0; i < count; i++)
+            items[i] = next_push + (int) i;
+
+        isize pushed = channel_spsc_try_push_batch(chan, items, count, info);
+        TEST(pushed == (count < capacity ? count : capacity));
+        next_push += (int) pushed;
+
+        isize got = channel_spsc_try_pop_batch(chan, popped, 3*BATCH, info);
+        TEST(got == pushed);
+        for(isize i = 0; i < got; i++)
+            TEST(popped[i] == next_pop++);
+    }
+
+    //Closing lets the consumer drain the remaining items 
+    isize half = capacity/2 > 0 ? capacity/2 : 1;
+    for(int i = 0; i < half; i++)
+        TEST(channel_spsc_push(chan, &i, info));
+    TEST(channel_spsc_close(chan, info));
+    TEST(channel_spsc_close(chan, info) == false);
+    TEST(channel_spsc_is_closed(chan));
+    TEST(channel_spsc_push(chan, &value, info) == false);
+    TEST(channel_spsc_try_push(chan, &value, info) == CHANNEL_CLOSED);
+    int* drained = (int*) malloc((size_t) half*sizeof(int));
+    TEST(channel_spsc_pop_batch(chan, drained, half, info) == half);
+    for(int i = 0; i < half; i++)
+        TEST(drained[i] == i);
+    free(drained);
+    TEST(channel_spsc_pop(chan, &value, info) == false);
+    TEST(channel_spsc_try_pop(chan, &value, info) == CHANNEL_CLOSED);
+    channel_spsc_deinit(chan);
+
+    //Works when placed into memory which is later accessed through a different address 
+    isize size = channel_spsc_memory_size(capacity, info);
+    void* memory = chan_aligned_alloc((size + CHAN_CACHE_LINE - 1)/CHAN_CACHE_LINE*CHAN_CACHE_LINE, CHAN_CACHE_LINE);
+    void* moved = chan_aligned_alloc((size + CHAN_CACHE_LINE - 1)/CHAN_CACHE_LINE*CHAN_CACHE_LINE, CHAN_CACHE_LINE);
+    Channel_Spsc* placed = channel_spsc_init_into_memory(memory, capacity, info);
+    for(int i = 0; i < capacity; i++)
+        TEST(channel_spsc_push(placed, &i, info));
+    memcpy(moved, memory, (size_t) size);
+    for(int i = 0; i < capacity; i++)
+        TEST(channel_spsc_pop((Channel_Spsc*) moved, &value, info) && value == i);
+
+    //Deinit of placed channel does not free the callers memory
+    channel_spsc_deinit(placed);
+    TEST(placed->capacity == 0);
+    chan_aligned_free(memory);
+    chan_aligned_free(moved);
+}
+
+typedef struct _Test_Channel_Spsc_Thread {
+    Channel_Spsc* chan;
+    Channel_Info info;
+    Wait_Group* done;
+    isize count;
+    isize batch;
+    uint64_t received;
+} _Test_Channel_Spsc_Thread;
+
+void _test_channel_spsc_producer(void* arg)
+{
+    enum {MAX_BATCH = 256};
+    _Test_Channel_Spsc_Thread* context = (_Test_Channel_Spsc_Thread*) arg;
+    uint64_t items[MAX_BATCH] = {0};
+    for(isize i = 0; i < context->count; )
+    {
+        isize count = context->count - i < context->batch ? context->count - i : context->batch;
+        for(isize k = 0; k < count; k++)
+            items[k] = (uint64_t) (i + k);
+
+        if(count == 1)
+            TEST(channel_spsc_push(context->chan, items, context->info));
+        else
+            TEST(channel_spsc_push_batch(context->chan, items, count, context->info) == count);
+        i += count;
+    }
+    channel_spsc_close(context->chan, context->info);
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void _test_channel_spsc_consumer(void* arg)
+{
+    enum {MAX_BATCH = 256};
+    _Test_Channel_Spsc_Thread* context = (_Test_Channel_Spsc_Thread*) arg;
+    uint64_t items[MAX_BATCH] = {0};
+    for(;;)
+    {
+        isize count = 0;
+        if(context->batch == 1)
+            count = channel_spsc_pop(context->chan, items, context->info);
+        else
+            count = channel_spsc_pop_batch(context->chan, items, context->batch, context->info);
+        if(count == 0)
+            break;
+
+        for(isize k = 0; k < count; k++)
+            TEST(items[k] == context->received++);
+    }
+    wait_group_pop(context->done, 1, SYNC_WAIT_BLOCK);
+}
+
+void test_channel_spsc_threaded(isize capacity, isize count, isize batch, int mode)
+{
+    Channel_Info info = _test_channel_spsc_info(sizeof(uint64_t), mode);
+    Channel_Spsc* chan = channel_spsc_malloc(capacity, info);
+
+    Wait_Group done = {0};
+    wait_group_push(&done, 2);
+    _Test_Channel_Spsc_Thread producer = {chan, info, &done, count, batch};
+    _Test_Channel_Spsc_Thread consumer = {chan, info, &done, count, batch};
+    TEST(chan_start_thread(_test_channel_spsc_consumer, &consumer));
+    TEST(chan_start_thread(_test_channel_spsc_producer, &producer));
+    wait_group_wait(&done, SYNC_WAIT_BLOCK);
+
+    TEST(consumer.received == (uint64_t) count);
+    TEST(channel_spsc_count(chan) == 0);
+    channel_spsc_deinit(chan);
+}
+
 void test_channel(double total_time)
 {
     //channel_push_int(NULL, NULL);
@@ -779,6 +1920,11 @@ void test_channel(double total_time)
     //Channel chan = {0};
     //channel_ticket_pop_int(&chan, NULL);
     srand(clock());
+    test_sync_queue(1, 1000);
+    test_sync_queue(4, 10000);
+    test_sync_queue(16, 5000);
+    test_sync_queue_pop_wait(2, 20000);
+    test_sync_queue_pop_wait(8, 5000);
 
     TEST(channel_ticket_is_less(0, 1));
     TEST(channel_ticket_is_less(1, 2));
@@ -799,6 +1945,72 @@ void test_channel(double total_time)
         test_channel_sequential(100, true);
         test_channel_sequential(1000, true);
     }
+
+    {
+        isize capacities[] = {1, 2, 7, 100, 1000};
+        for(isize i = 0; i < (isize) (sizeof capacities / sizeof *capacities); i++)
+        {
+            test_channel_batch_sequential(capacities[i], false);
+            test_channel_batch_sequential(capacities[i], true);
+        }
+
+        test_channel_batch_threaded(1, 1, 1, 10000, true);
+        test_channel_batch_threaded(16, 4, 4, 100000, true);
+        test_channel_batch_threaded(1000, 8, 2, 100000, false);
+        test_channel_batch_threaded(100, 2, 8, 100000, true);
+    }
+
+    {
+        test_channel_select_sequential(false);
+        test_channel_select_sequential(true);
+
+        test_channel_select_threaded(1, 1, 1, 10000, true);
+        test_channel_select_threaded(4, 4, 4, 50000, true);
+        test_channel_select_threaded(100, 8, 2, 50000, false);
+        test_channel_select_threaded(2, 2, 8, 50000, true);
+    }
+
+    {
+        test_channel_unbounded_sequential(false);
+        test_channel_unbounded_sequential(true);
+
+        test_channel_unbounded_threaded(1, 1, 1, 100000, true);
+        test_channel_unbounded_threaded(1, 8, 1, 50000, true);
+        test_channel_unbounded_threaded(4, 4, 4, 100000, false);
+        test_channel_unbounded_threaded(16, 2, 8, 100000, true);
+    }
+
+    test_channel_stats();
+
+    {
+        for(int mode = 0; mode < 4; mode++)
+        {
+            test_channel_spsc_sequential(1, mode);
+            test_channel_spsc_sequential(8, mode);
+            test_channel_spsc_sequential(1024, mode);
+        }
+
+        test_channel_spsc_threaded(1, 10000, 1, 1);
+        test_channel_spsc_threaded(1, 10000, 1, 2);
+        test_channel_spsc_threaded(16, 100000, 1, 2);
+        test_channel_spsc_threaded(16, 100000, 7, 3);
+        test_channel_spsc_threaded(1024, 1000000, 1, 1);
+        test_channel_spsc_threaded(1024, 1000000, 100, 2);
+        test_channel_spsc_threaded(64, 1000000, 256, 3);
+    }
+
+    test_channel_adaptive_wait(1000);
+    test_channel_adaptive_wait(100000);
+
+    {
+        test_channel_in_place_sequential(1, false);
+        test_channel_in_place_sequential(7, true);
+        test_channel_in_place_sequential(100, true);
+
+        test_channel_in_place_threaded(1, 1, 1, 10000, true);
+        test_channel_in_place_threaded(16, 4, 4, 50000, true);
+        test_channel_in_place_threaded(100, 2, 8, 50000, false);
+    }
     
     //test_channel_cycle(100, 4, 4, 10, 0, true, true, true);
     bool main_print = true;
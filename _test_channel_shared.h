@@ -0,0 +1,185 @@
+#pragma once
+
+#include "channel_shared.h"
+#include "sync.h"
+
+#include <stdio.h>
+
+#if PLATFORM_OS == PLATFORM_OS_UNIX
+    #include <unistd.h>
+    #include <sys/wait.h>
+#endif
+
+typedef struct _Test_Channel_Shared_Producer {
+    Channel_Shared* shared;
+    Wait_Group* done;
+    isize count;
+} _Test_Channel_Shared_Producer;
+
+INTERNAL void _test_channel_shared_producer(void* context)
+{
+    enum {BATCH = 37};
+    _Test_Channel_Shared_Producer* c = (_Test_Channel_Shared_Producer*) context;
+    u64 items[BATCH] = {0};
+    for(isize i = 0; i < c->count; )
+    {
+        isize count = MIN(c->count - i, BATCH);
+        for(isize k = 0; k < count; k++)
+            items[k] = (u64) (i + k);
+
+        if(count == 1)
+            TEST(channel_shared_push(c->shared, items));
+        else
+            TEST(channel_shared_push_batch(c->shared, items, count) == count);
+        i += count;
+    }
+    wait_group_pop(c->done, 1, SYNC_WAIT_BLOCK);
+}
+
+INTERNAL Platform_String _test_channel_shared_name(char* buffer, isize buffer_size, const char* kind)
+{
+    snprintf(buffer, (size_t) buffer_size, "test_channel_shared_%s_%lli", kind, (long long) platform_process_get_current_id());
+    Platform_String out = {buffer, (int64_t) strlen(buffer)};
+    return out;
+}
+
+INTERNAL void test_channel_shared_unit()
+{
+    char name_buffer[128] = {0};
+    Platform_String name = _test_channel_shared_name(name_buffer, sizeof name_buffer, "unit");
+
+    Channel_Shared missing = {0};
+    TEST(channel_shared_open(&missing, name, sizeof(u64), CHANNEL_SHARED_CONSUMER) != PLATFORM_ERROR_OK);
+
+    Channel_Shared consumer = {0};
+    Channel_Shared producer = {0};
+    Channel_Shared other = {0};
+    TEST(channel_shared_create(&consumer, name, 64, sizeof(u64), CHANNEL_SHARED_CONSUMER) == PLATFORM_ERROR_OK);
+    TEST(channel_shared_open(&other, name, sizeof(u32), CHANNEL_SHARED_PRODUCER) == PLATFORM_ERROR_OTHER);
+    TEST(channel_shared_open(&other, name, sizeof(u64), CHANNEL_SHARED_CONSUMER) == PLATFORM_ERROR_OTHER);
+    TEST(channel_shared_open(&producer, name, sizeof(u64), CHANNEL_SHARED_PRODUCER) == PLATFORM_ERROR_OK);
+
+    //Both sides see the same channel through different addresses
+    TEST(producer.mapping.address != consumer.mapping.address);
+    TEST(channel_spsc_capacity(producer.chan) == 64);
+    for(u64 i = 0; i < 64; i++)
+        TEST(channel_shared_push(&producer, &i));
+    u64 extra = 64;
+    TEST(channel_spsc_try_push(producer.chan, &extra, producer.info) == CHANNEL_FULL);
+
+    u64 items[64] = {0};
+    TEST(channel_shared_pop_batch(&consumer, items, 64) == 64);
+    for(u64 i = 0; i < 64; i++)
+        TEST(items[i] == i);
+
+    //Closing lets the other side drain the remaining items
+    for(u64 i = 0; i < 10; i++)
+        TEST(channel_shared_push(&producer, &i));
+    channel_shared_close(&producer);
+    for(u64 i = 0; i < 10; i++)
+        TEST(channel_shared_pop(&consumer, items) && items[0] == i);
+    TEST(channel_shared_pop(&consumer, items) == false);
+
+    channel_shared_close(&consumer);
+    TEST(channel_shared_remove(name) == PLATFORM_ERROR_OK);
+    TEST(channel_shared_open(&missing, name, sizeof(u64), CHANNEL_SHARED_CONSUMER) != PLATFORM_ERROR_OK);
+}
+
+INTERNAL void test_channel_shared_threaded(isize capacity, isize count)
+{
+    char name_buffer[128] = {0};
+    Platform_String name = _test_channel_shared_name(name_buffer, sizeof name_buffer, "threaded");
+
+    Channel_Shared consumer = {0};
+    Channel_Shared producer = {0};
+    TEST(channel_shared_create(&consumer, name, capacity, sizeof(u64), CHANNEL_SHARED_CONSUMER) == PLATFORM_ERROR_OK);
+    TEST(channel_shared_open(&producer, name, sizeof(u64), CHANNEL_SHARED_PRODUCER) == PLATFORM_ERROR_OK);
+
+    Wait_Group done = {0};
+    wait_group_push(&done, 1);
+    _Test_Channel_Shared_Producer context = {&producer, &done, count};
+    TEST(chan_start_thread(_test_channel_shared_producer, &context));
+
+    u64 items[64] = {0};
+    for(u64 received = 0; received < (u64) count; )
+    {
+        isize popped = channel_shared_pop_batch(&consumer, items, 1 + (isize) received % 64);
+        TEST(popped > 0);
+        for(isize k = 0; k < popped; k++)
+            TEST(items[k] == received++);
+    }
+    wait_group_wait(&done, SYNC_WAIT_BLOCK);
+
+    channel_shared_close(&producer);
+    channel_shared_close(&consumer);
+    channel_shared_remove(name);
+}
+
+#if PLATFORM_OS == PLATFORM_OS_UNIX
+//The producer is a child process which dies without detaching after pushing some items.
+INTERNAL void test_channel_shared_peer_death()
+{
+    enum {PUSHED = 100};
+    char name_buffer[128] = {0};
+    Platform_String name = _test_channel_shared_name(name_buffer, sizeof name_buffer, "death");
+
+    Channel_Shared consumer = {0};
+    TEST(channel_shared_create(&consumer, name, 256, sizeof(u64), CHANNEL_SHARED_CONSUMER) == PLATFORM_ERROR_OK);
+
+    pid_t child = fork();
+    TEST(child != -1);
+    if(child == 0)
+    {
+        Channel_Shared producer = {0};
+        if(channel_shared_open(&producer, name, sizeof(u64), CHANNEL_SHARED_PRODUCER) != PLATFORM_ERROR_OK)
+            _exit(1);
+        for(u64 i = 0; i < PUSHED; i++)
+            channel_shared_push(&producer, &i);
+        _exit(0);
+    }
+
+    //The child is not reaped until the end so it lingers as a zombie, which must still count as dead.
+    //All pushed items are still there, after them the channel is closed
+    u64 item = 0;
+    for(u64 i = 0; i < PUSHED; i++)
+        TEST(channel_shared_pop(&consumer, &item) && item == i);
+    TEST(channel_shared_pop(&consumer, &item) == false);
+    TEST(channel_spsc_is_closed(consumer.chan));
+    TEST(consumer.header->process_ids[CHANNEL_SHARED_PRODUCER] == child);
+    TEST(platform_process_is_running(child) == false);
+
+    //The role of the dead process can be taken over which reopens the channel
+    Channel_Shared producer = {0};
+    TEST(channel_shared_open(&producer, name, sizeof(u64), CHANNEL_SHARED_PRODUCER) == PLATFORM_ERROR_OK);
+    TEST(channel_spsc_is_closed(consumer.chan) == false);
+    TEST(channel_shared_check_peer(&consumer));
+    for(u64 i = 0; i < PUSHED; i++)
+        TEST(channel_shared_push(&producer, &i));
+    for(u64 i = 0; i < PUSHED; i++)
+        TEST(channel_shared_pop(&consumer, &item) && item == i);
+
+    //Channel closed by detaching stays closed even when the role is taken again
+    channel_shared_close(&producer);
+    TEST(channel_shared_open(&producer, name, sizeof(u64), CHANNEL_SHARED_PRODUCER) == PLATFORM_ERROR_OK);
+    TEST(channel_spsc_is_closed(consumer.chan));
+    TEST(channel_shared_push(&producer, &item) == false);
+    channel_shared_close(&producer);
+
+    int status = 0;
+    TEST(waitpid(child, &status, 0) == child);
+    TEST(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    channel_shared_close(&consumer);
+    channel_shared_remove(name);
+}
+#endif
+
+INTERNAL void test_channel_shared()
+{
+    test_channel_shared_unit();
+    test_channel_shared_threaded(1, 10000);
+    test_channel_shared_threaded(64, 200000);
+    #if PLATFORM_OS == PLATFORM_OS_UNIX
+    test_channel_shared_peer_death();
+    #endif
+}
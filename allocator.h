@@ -36,6 +36,7 @@ typedef Allocator_Stats (*Allocator_Get_Stats)(Allocator* alloc);
 typedef struct Allocator {
     Allocator_Func func;
     Allocator_Get_Stats get_stats;
+    bool is_registered; //set while in the allocator registry. Lets deinit skip the registry entirely when it was not used.
 } Allocator;
 
 typedef enum Allocator_Error_Type {
@@ -124,12 +125,30 @@ EXTERNAL Allocator* allocator_get_default(); //returns the default allocator use
 EXTERNAL Allocator* allocator_or_default(Allocator* allocator_or_null); //Returns the passed in allocator_or_null. If allocator_or_null is NULL returns the current set default allocator
 EXTERNAL Allocator* allocator_get_malloc(); //returns the global malloc allocator. This is the default allocator.
 
+//Blocks of the malloc allocator of at least this size (and align at most page size) are served directly from 
+// the OS with platform_virtual_resize. Growing them remaps pages instead of copying bytes, which matters 
+// for arrays growing to gigabytes. Because of this the malloc allocator requires correct old_size just like any other.
+#ifndef MALLOC_ALLOCATOR_MAP_THRESHOLD
+    #define MALLOC_ALLOCATOR_MAP_THRESHOLD (1 << 20)
+#endif
+
 EXTERNAL bool allocator_is_scratch(Allocator* allocator);
 
 //All of these return the previously used Allocator_Set. This enables simple set/restore pair. 
 EXTERNAL Allocator_Set allocator_set_default(Allocator* new_default);
 EXTERNAL Allocator_Set allocator_set(Allocator_Set backup); 
 
+//Registry of live allocators used for inspecting memory usage of the whole program (see allocator_stats.h).
+//While enabled allocators of this library register themselves on init and unregister on deinit. 
+//Other allocators can be registered manually with allocator_registry_add and must be removed before they are deinited.
+EXTERNAL void  allocator_registry_enable(bool enable); //Is disabled by default
+EXTERNAL bool  allocator_registry_is_enabled();
+EXTERNAL void  allocator_registry_add(Allocator* alloc);
+EXTERNAL void  allocator_registry_track(Allocator* alloc); //Calls allocator_registry_add if the registry is enabled. Is used by allocators of this library on init.
+EXTERNAL void  allocator_registry_remove(Allocator* alloc); //Does nothing if alloc is not registered
+//Calls visit for each registered allocator while holding the registry lock so that no allocator can be deinited meanwhile.
+EXTERNAL void  allocator_registry_iterate(void (*visit)(void* context, Allocator* alloc), void* context);
+
 EXTERNAL bool  is_power_of_two(isize num);
 EXTERNAL bool  is_power_of_two_or_zero(isize num);
 EXTERNAL void* align_forward(void* ptr, isize align_to);
@@ -259,15 +278,45 @@ EXTERNAL void* stack_allocate(isize bytes, isize align_to) {(void) align_to; (vo
         return (void*) ptr_num;
     }
     
+    INTERNAL bool _malloc_allocator_is_mapped(isize size, isize align)
+    {
+        return size >= MALLOC_ALLOCATOR_MAP_THRESHOLD && align <= platform_page_size();
+    }
+
     INTERNAL void* _malloc_allocator_func(Allocator* alloc, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error_or_null)
     {
         void* out = NULL;
         PROFILE_SCOPE(malloc)
         {
-            (void) alloc; (void) old_size; (void) align; (void) error_or_null;
-            out = platform_heap_reallocate(new_size, old_ptr, align);
-            if(out == NULL && new_size != 0)
-                allocator_error(error_or_null, ALLOCATOR_ERROR_OUT_OF_MEM, alloc, new_size, old_ptr, old_size, align, "malloc failed!");
+            bool old_mapped = old_ptr != NULL && _malloc_allocator_is_mapped(old_size, align);
+            bool new_mapped = new_size != 0 && _malloc_allocator_is_mapped(new_size, align);
+            if(old_mapped == false && new_mapped == false)
+            {
+                out = platform_heap_reallocate(new_size, old_ptr, align);
+                if(out == NULL && new_size != 0)
+                    allocator_error(error_or_null, ALLOCATOR_ERROR_OUT_OF_MEM, alloc, new_size, old_ptr, old_size, align, "malloc failed!");
+            }
+            //Moving between heap and mapped memory. Only happens once per block crossing the threshold.
+            else if(old_mapped != new_mapped && old_ptr != NULL && new_size != 0)
+            {
+                out = _malloc_allocator_func(alloc, new_size, NULL, 0, align, error_or_null);
+                if(out != NULL)
+                {
+                    memcpy(out, old_ptr, (size_t) MIN(old_size, new_size));
+                    _malloc_allocator_func(alloc, 0, old_ptr, old_size, align, NULL);
+                }
+            }
+            else
+            {
+                Platform_Error platform_error = platform_virtual_resize(&out, old_mapped ? old_ptr : NULL, old_mapped ? old_size : 0, new_size);
+                if(platform_error != PLATFORM_ERROR_OK)
+                {
+                    char message[256] = {0};
+                    platform_translate_error(platform_error, message, sizeof message);
+                    allocator_error(error_or_null, ALLOCATOR_ERROR_OUT_OF_MEM, alloc, new_size, old_ptr, old_size, align, "mapping failed: %s", message);
+                    ASSERT(new_size != 0, "Failed to unmap a block. Was old_size passed in correctly?");
+                }
+            }
         }
         return out;
     }
@@ -327,6 +376,89 @@ EXTERNAL void* stack_allocate(isize bytes, isize align_to) {(void) align_to; (vo
         return prev;
     }
 
+    typedef struct _Allocator_Registry {
+        Platform_Mutex mutex;
+        Allocator** allocators;
+        isize count;
+        isize capacity;
+        PLATFORM_ATOMIC(uint32_t) enabled;
+    } _Allocator_Registry;
+
+    INTERNAL _Allocator_Registry* _allocator_registry()
+    {
+        static _Allocator_Registry registry = {0};
+        static volatile uint32_t init = 0;
+        if(platform_once_begin(&init))
+        {
+            platform_mutex_init(&registry.mutex);
+            platform_once_end(&init);
+        }
+        return &registry;
+    }
+
+    EXTERNAL void allocator_registry_enable(bool enable)
+    {
+        PLATFORM_USE_ATOMICS;
+        atomic_store(&_allocator_registry()->enabled, (uint32_t) enable);
+    }
+
+    EXTERNAL bool allocator_registry_is_enabled()
+    {
+        PLATFORM_USE_ATOMICS;
+        return atomic_load_explicit(&_allocator_registry()->enabled, memory_order_relaxed) != 0;
+    }
+
+    EXTERNAL void allocator_registry_add(Allocator* alloc)
+    {
+        _Allocator_Registry* registry = _allocator_registry();
+        platform_mutex_lock(&registry->mutex);
+        if(registry->count >= registry->capacity)
+        {
+            isize new_capacity = registry->capacity*2 + 16;
+            Allocator** new_allocators = (Allocator**) platform_heap_reallocate(new_capacity*isizeof(Allocator*), registry->allocators, DEF_ALIGN);
+            REQUIRE(new_allocators, "Out of memory!");
+            registry->allocators = new_allocators;
+            registry->capacity = new_capacity;
+        }
+        registry->allocators[registry->count++] = alloc;
+        alloc->is_registered = true;
+        platform_mutex_unlock(&registry->mutex);
+    }
+
+    EXTERNAL void allocator_registry_track(Allocator* alloc)
+    {
+        if(allocator_registry_is_enabled())
+            allocator_registry_add(alloc);
+    }
+
+    EXTERNAL void allocator_registry_remove(Allocator* alloc)
+    {
+        if(alloc->is_registered == false)
+            return;
+
+        //Keep the registration order (see allocator_stats_snapshot)
+        _Allocator_Registry* registry = _allocator_registry();
+        platform_mutex_lock(&registry->mutex);
+        for(isize i = registry->count; i-- > 0; )
+            if(registry->allocators[i] == alloc)
+            {
+                memmove(registry->allocators + i, registry->allocators + i + 1, (size_t) (registry->count - i - 1)*sizeof(Allocator*));
+                registry->count -= 1;
+                break;
+            }
+        alloc->is_registered = false;
+        platform_mutex_unlock(&registry->mutex);
+    }
+
+    EXTERNAL void allocator_registry_iterate(void (*visit)(void* context, Allocator* alloc), void* context)
+    {
+        _Allocator_Registry* registry = _allocator_registry();
+        platform_mutex_lock(&registry->mutex);
+        for(isize i = 0; i < registry->count; i++)
+            visit(context, registry->allocators[i]);
+        platform_mutex_unlock(&registry->mutex);
+    }
+
     EXTERNAL Allocator_Stats log_allocator_stats(const char* log_name, Log_Type log_type, Allocator* allocator)
     {
         Allocator_Stats stats = {0};
@@ -45,6 +45,21 @@
 // Prior to each access the block address is looked up in the alive_allocations_hash. If it is found
 // the dead zones and header is checked for validity (invalidity would indicate overwrites). Only then
 // any allocation/deallocation takes place.
+//
+// Dead zones only catch overwrites after the fact and only when the block is checked. For catching them
+// at the faulting instruction we additionally provide a guard page mode (electric fence style). In it each
+// *BLOCK* is obtained directly from the OS as its own page range followed by an inaccessible guard page. 
+// The user data is placed at the very end of the range so that writing (or reading) past it crashes 
+// immediately. The few bytes between the end of user data and the guard page (due to alignment) act as 
+// the after dead zone. The parent allocator is then only used for the control structures.
+// 
+//  |--------------------------------------------------------------------|-------------|
+//  | unused | header | call stack | dead | USER DATA | dead (< align)    | GUARD PAGE  |
+//  |--------------------------------------------------------------------|-------------|
+//  ^ page aligned                                                       ^ page aligned
+//
+// Optionally freed blocks can be kept inaccessible for some time (guard_delay_free_count) before their 
+// address space is released, so that use after free also crashes instead of touching reused memory.
 
 #include "allocator.h"
 #include "array.h"
@@ -61,6 +76,13 @@ typedef struct Debug_Allocator_Options  Debug_Allocator_Options;
 
 typedef Array_Aligned(Debug_Allocation, DEF_ALIGN) Debug_Allocation_Array;
 
+typedef struct Debug_Allocator_Guard_Range {
+    void* address;
+    isize size;
+} Debug_Allocator_Guard_Range;
+
+typedef Array(Debug_Allocator_Guard_Range) Debug_Allocator_Guard_Range_Array;
+
 typedef enum Debug_Allocator_Panic_Reason {
     DEBUG_ALLOC_PANIC_NONE = 0, //no error
     DEBUG_ALLOC_PANIC_INVALID_PTR, //the provided pointer does not point to previously allocated block
@@ -92,6 +114,13 @@ typedef struct Debug_Allocator
                                    //If this is greater than 0 replaces passed source info in reports
     isize dead_zone_size;        //size in bytes of the dead zone. CANNOT be changed after creation!
     
+    bool use_guard_pages;        //whether each block gets its own pages followed by an inaccessible guard page. CANNOT be changed after creation!
+    bool _[7];
+    isize guard_delay_free_count; //number of freed guard page blocks kept inaccessible before releasing their address space. 
+                                  //can be changed during runtime.
+    Debug_Allocator_Guard_Range_Array guard_delayed_frees; //ring buffer of freed but not yet released blocks
+    isize guard_delayed_frees_next;
+
     Debug_Allocator_Panic panic_handler;
     void* panic_context;
 
@@ -112,6 +141,8 @@ typedef struct Debug_Allocator
 #define DEBUG_ALLOCATOR_DEINIT_LEAK_CHECK   16 /* do_deinit_leak_check = true */
 #define DEBUG_ALLOCATOR_CAPTURE_CALLSTACK   32 /* captured_callstack_size = 16 */
 #define DEBUG_ALLOCATOR_USE                 64
+#define DEBUG_ALLOCATOR_GUARD_PAGES         128 /* use_guard_pages = true */
+#define DEBUG_ALLOCATOR_GUARD_DELAY_FREE    256 /* guard_delay_free_count = 1024 */
 
 
 //Initalizes the debug allocator using a parent and options. 
@@ -163,7 +194,10 @@ typedef struct Debug_Allocator_Options
     bool do_printing;        //prints all allocations/deallocation
     bool do_continual_checks; //continually checks all allocations
     bool do_deinit_leak_check;   //If the memory use on initialization and deinitialization does not match panics.
-    bool _[5];
+    bool use_guard_pages;        //places each allocation before its own inaccessible guard page. See the top of the file.
+    bool _[4];
+    //number of freed guard page blocks kept inaccessible before being released. Only used with use_guard_pages.
+    isize guard_delay_free_count;
     //Optional name of this allocator for printing and debugging. No default is set
     const char* name;
 } Debug_Allocator_Options;
@@ -195,6 +229,9 @@ EXTERNAL void debug_allocator_init_custom(Debug_Allocator* debug, Allocator* par
     debug->do_continual_checks = options.do_continual_checks;
     debug->dead_zone_size = options.dead_zone_size;
     debug->do_printing = options.do_printing;
+    debug->use_guard_pages = options.use_guard_pages;
+    debug->guard_delay_free_count = MAX(options.guard_delay_free_count, 0);
+    array_init(&debug->guard_delayed_frees, parent);
     debug->parent = parent;
     debug->alloc[0].func = debug_allocator_func;
     debug->alloc[0].get_stats = debug_allocator_get_stats;
@@ -203,6 +240,7 @@ EXTERNAL void debug_allocator_init_custom(Debug_Allocator* debug, Allocator* par
 
     debug->alive_allocations_hash.do_in_place_rehash = true;
     debug->is_init = true;
+    allocator_registry_track(debug->alloc);
 }
 
 EXTERNAL void debug_allocator_init(Debug_Allocator* allocator, Allocator* parent, u64 flags)
@@ -220,6 +258,10 @@ EXTERNAL void debug_allocator_init(Debug_Allocator* allocator, Allocator* parent
         options.dead_zone_size = 0;
     if(flags & DEBUG_ALLOCATOR_CAPTURE_CALLSTACK)
         options.captured_callstack_size = 16;
+    if(flags & DEBUG_ALLOCATOR_GUARD_PAGES)
+        options.use_guard_pages = true;
+    if(flags & DEBUG_ALLOCATOR_GUARD_DELAY_FREE)
+        options.guard_delay_free_count = 1024;
 
     debug_allocator_init_custom(allocator, parent, options);
 }
@@ -262,13 +304,6 @@ INTERNAL Debug_Allocation_Pre_Block _debug_allocator_get_pre_block(const Debug_A
     return pre_block;
 }
 
-INTERNAL Debug_Allocation_Post_Block _debug_allocator_get_post_block(const Debug_Allocator* self, void* user_ptr, isize size)
-{
-    Debug_Allocation_Post_Block post_block = {0};
-    post_block.dead_zone = (u8*) user_ptr + size;
-    post_block.dead_zone_size = self->dead_zone_size;
-    return post_block;
-}
 typedef struct Debug_Alloc_Sizes {
     isize preamble_size;
     isize postamble_size;
@@ -289,6 +324,77 @@ INTERNAL Debug_Alloc_Sizes _debug_allocator_allocation_sizes(const Debug_Allocat
     return out;
 }
 
+//Size of the accessible part of guard page block. Is followed by a single guard page.
+INTERNAL isize _debug_allocator_guard_data_size(const Debug_Allocator* self, isize size, isize align)
+{
+    Debug_Alloc_Sizes sizes = _debug_allocator_allocation_sizes(self, size, align);
+    isize page_size = platform_page_size();
+    return DIV_CEIL(sizes.preamble_size + size + MAX(align, DEF_ALIGN), page_size)*page_size;
+}
+
+//block_ptr and align are only used with guard pages
+INTERNAL Debug_Allocation_Post_Block _debug_allocator_get_post_block(const Debug_Allocator* self, const u8* block_ptr, void* user_ptr, isize size, isize align)
+{
+    Debug_Allocation_Post_Block post_block = {0};
+    post_block.dead_zone = (u8*) user_ptr + size;
+    post_block.dead_zone_size = self->dead_zone_size;
+    //The block ends with a guard page. The alignment padding before it is the dead zone.
+    // When align is bigger than a page the padding can span multiple pages so we need the guard page itself.
+    if(self->use_guard_pages)
+        post_block.dead_zone_size = block_ptr + _debug_allocator_guard_data_size(self, size, align) - post_block.dead_zone;
+    return post_block;
+}
+
+INTERNAL u8* _debug_allocator_guard_map(Debug_Allocator* self, isize size, isize align, Allocator_Error* error)
+{
+    if(size == 0)
+        return NULL;
+
+    //Only the data part is commited so the guard page stays reserved and inaccessible
+    isize data_size = _debug_allocator_guard_data_size(self, size, align);
+    void* block = NULL;
+    Platform_Error platform_error = platform_virtual_reallocate(&block, NULL, data_size + platform_page_size(), PLATFORM_VIRTUAL_ALLOC_RESERVE, PLATFORM_MEMORY_PROT_NO_ACCESS);
+    if(platform_error == PLATFORM_ERROR_OK)
+    {
+        platform_error = platform_virtual_reallocate(NULL, block, data_size, PLATFORM_VIRTUAL_ALLOC_COMMIT, PLATFORM_MEMORY_PROT_READ_WRITE);
+        if(platform_error != PLATFORM_ERROR_OK)
+            platform_virtual_reallocate(NULL, block, data_size + platform_page_size(), PLATFORM_VIRTUAL_ALLOC_RELEASE, PLATFORM_MEMORY_PROT_NO_ACCESS);
+    }
+    
+    if(platform_error != PLATFORM_ERROR_OK)
+    {
+        char message[256] = {0};
+        platform_translate_error(platform_error, message, sizeof message);
+        allocator_error(error, ALLOCATOR_ERROR_OUT_OF_MEM, self->alloc, size, NULL, 0, align, "guard page mapping failed: %s", message);
+        return NULL;
+    }
+
+    return (u8*) block;
+}
+
+INTERNAL void _debug_allocator_guard_unmap(Debug_Allocator* self, u8* block, isize size, isize align)
+{
+    isize data_size = _debug_allocator_guard_data_size(self, size, align);
+    Debug_Allocator_Guard_Range range = {block, data_size + platform_page_size()};
+    if(self->guard_delay_free_count > 0)
+    {
+        //Make the whole block inaccessible and give back its physical memory. 
+        // Release the oldest delayed block if there are too many.
+        platform_virtual_reallocate(NULL, block, data_size, PLATFORM_VIRTUAL_ALLOC_DECOMMIT, PLATFORM_MEMORY_PROT_NO_ACCESS);
+        if(self->guard_delayed_frees.count < self->guard_delay_free_count)
+        {
+            array_push(&self->guard_delayed_frees, range);
+            return;
+        }
+
+        self->guard_delayed_frees_next %= self->guard_delayed_frees.count;
+        SWAP(&self->guard_delayed_frees.data[self->guard_delayed_frees_next], &range);
+        self->guard_delayed_frees_next += 1;
+    }
+
+    platform_virtual_reallocate(NULL, range.address, range.size, PLATFORM_VIRTUAL_ALLOC_RELEASE, PLATFORM_MEMORY_PROT_NO_ACCESS);
+}
+
 INTERNAL int _debug_allocation_alloc_time_compare(const void* a_, const void* b_)
 {
     Debug_Allocation* a = (Debug_Allocation*) a_;
@@ -331,7 +437,8 @@ INTERNAL Debug_Allocator_Panic_Reason _debug_allocator_check_block(const Debug_A
     if((size_t) user_ptr % (size_t) pre.header->align != 0)
         return DEBUG_ALLOC_PANIC_INVALID_PARAMS;
 
-    Debug_Allocation_Post_Block post = _debug_allocator_get_post_block(self, user_ptr, pre.header->size);
+    u8* block_ptr = (u8*) pre.header - pre.header->block_start_offset;
+    Debug_Allocation_Post_Block post = _debug_allocator_get_post_block(self, block_ptr, user_ptr, pre.header->size, pre.header->align);
     for(isize i = 0; i < post.dead_zone_size; i++)
     {
         if(post.dead_zone[i] != DEBUG_ALLOCATOR_MAGIC_NUM8)
@@ -423,6 +530,8 @@ INTERNAL void* _debug_allocator_panic(Debug_Allocator* self, Debug_Allocator_Pan
 }
 EXTERNAL void debug_allocator_deinit(Debug_Allocator* allocator)
 {
+    if(allocator->is_init)
+        allocator_registry_remove(allocator->alloc);
     if(allocator->bytes_allocated != 0 && allocator->do_deinit_leak_check)
         _debug_allocator_panic(allocator, DEBUG_ALLOC_PANIC_DEINIT_MEMORY_LEAKED, NULL, 0);
 
@@ -436,7 +545,14 @@ EXTERNAL void debug_allocator_deinit(Debug_Allocator* allocator)
         }
     }
 
+    for(isize i = 0; i < allocator->guard_delayed_frees.count; i++)
+    {
+        Debug_Allocator_Guard_Range range = allocator->guard_delayed_frees.data[i];
+        platform_virtual_reallocate(NULL, range.address, range.size, PLATFORM_VIRTUAL_ALLOC_RELEASE, PLATFORM_MEMORY_PROT_NO_ACCESS);
+    }
+
     allocator_set(allocator->allocator_backup);
+    array_deinit(&allocator->guard_delayed_frees);
     hash_deinit(&allocator->alive_allocations_hash);
     
     Debug_Allocator null = {0};
@@ -540,7 +656,10 @@ EXTERNAL void* debug_allocator_func(Allocator* self_, isize new_size, void* old_
         old_block_ptr = (u8*) pre.header - pre.header->block_start_offset;
     }
 
-    new_block_ptr = (u8*) self->parent->func(self->parent, new_sizes.total_size, old_block_ptr, old_sizes.total_size, DEF_ALIGN, error);
+    if(self->use_guard_pages)
+        new_block_ptr = _debug_allocator_guard_map(self, new_size, align, error);
+    else
+        new_block_ptr = (u8*) self->parent->func(self->parent, new_sizes.total_size, old_block_ptr, old_sizes.total_size, DEF_ALIGN, error);
     
     //if failed return failiure and do nothing
     if(new_block_ptr == NULL && new_size != 0)
@@ -561,15 +680,23 @@ EXTERNAL void* debug_allocator_func(Allocator* self_, isize new_size, void* old_
     {
         isize fixed_align = MAX(align, DEF_ALIGN);
         u8* user_ptr = (u8*) align_forward(new_block_ptr + new_sizes.preamble_size, fixed_align);
+        if(self->use_guard_pages)
+        {
+            //Place user data right before the guard page and move over the old data
+            u8* guard_page = new_block_ptr + _debug_allocator_guard_data_size(self, new_size, align);
+            user_ptr = (u8*) align_backward(guard_page - new_size, fixed_align);
+            if(old_ptr != NULL)
+                memcpy(user_ptr, old_ptr, (size_t) MIN(old_size, new_size));
+        }
 
         Debug_Allocation_Pre_Block new_pre = _debug_allocator_get_pre_block(self, user_ptr);
-        Debug_Allocation_Post_Block new_post = _debug_allocator_get_post_block(self, user_ptr, new_size);
+        Debug_Allocation_Post_Block new_post = _debug_allocator_get_post_block(self, new_block_ptr, user_ptr, new_size, align);
 
         new_pre.header->align = (i32) align;
         new_pre.header->size = new_size;
         new_pre.header->block_start_offset = (i32) ((u8*) new_pre.header - new_block_ptr);
         new_pre.header->allocation_epoch_time = platform_epoch_time();
-        ASSERT(new_pre.header->block_start_offset <= fixed_align && "must be less then align");
+        ASSERT(self->use_guard_pages || new_pre.header->block_start_offset <= fixed_align, "must be less then align");
 
         if(self->captured_callstack_size > 0)
             platform_capture_call_stack(new_pre.call_stack, new_pre.call_stack_size, 1);
@@ -585,6 +712,9 @@ EXTERNAL void* debug_allocator_func(Allocator* self_, isize new_size, void* old_
         _debug_allocator_assert_block(self, new_ptr);
     }
 
+    if(self->use_guard_pages && old_ptr != NULL)
+        _debug_allocator_guard_unmap(self, old_block_ptr, old_size, align);
+
     self->bytes_allocated -= old_size;
     self->bytes_allocated += new_size;
     self->max_bytes_allocated = MAX(self->max_bytes_allocated, self->bytes_allocated);
@@ -0,0 +1,497 @@
+#ifndef MODULE_ALLOCATOR_POOL
+#define MODULE_ALLOCATOR_POOL
+
+// A fixed size object pool usable through the Allocator interface.
+//
+// Lots of data structures allocate many small objects of the same size - list nodes, tree nodes, Stable_Array
+// blocks, hash map entries. Going to a general purpose allocator for each of these is wasteful: every allocation
+// pays for size class lookup, headers and splitting/merging. A pool does none of that.
+//
+// The pool requests big "slabs" from its parent allocator and cuts them into equally sized chunks. Free chunks
+// are kept in an intrusive singly linked free list threaded through their first 8 bytes. Thus both allocation
+// and deallocation are a pop/push onto a list and there is no per chunk overhead at all.
+//
+//  Pool_Allocator
+//  |-----------------|      slab                                          slab
+//  | slabs ------------->| next | XXX | chunk | chunk | chunk | chunk |---->| next | XXX | chunk | ... |
+//  | free_list ----o |   |------------------^---------------^----------|    |--------------------------|
+//  | bump ---------|---------------------------------------------------o
+//  |_______________| |                      |               |
+//                  o------------------------o               |
+//                          (first 8 bytes) o----------------o
+//
+// New slabs are not cut up front. Instead the most recent slab is handed out through a bump pointer and only
+// once its exhausted do we start growing the free list. This means we never touch memory we dont need to.
+//
+// When used through the Allocator interface requests that fit into a chunk (size <= chunk_size and
+// align <= chunk_align) are served by the pool and everything else is forwarded to the parent. Because
+// of this the old_size and align passed to deallocate/reallocate MUST match those used for allocation.
+// Reallocations within a chunk return the same pointer. pool_allocator_free_all() returns all slabs to the parent
+// at once but does not free the forwarded allocations.
+//
+// The pool itself is single threaded by default. It can be made thread safe by passing POOL_ALLOCATOR_THREAD_SAFE
+// upon init, in which case all operations take a mutex. Taking the mutex on every operation is however quite costly
+// thus for hot paths each thread can additionally use its own Pool_Magazine. A magazine is a small stack of chunks
+// which is refilled from/flushed into the pool in batches of POOL_MAGAZINE_BATCH chunks, taking the lock once per batch.
+// Chunks can be freed into any magazine of the same pool regardless of where they were allocated.
+
+#include "allocator.h"
+#include "platform.h"
+
+#define POOL_ALLOCATOR_DEF_SLAB_SIZE    (64*1024)
+#define POOL_ALLOCATOR_THREAD_SAFE      1
+#define POOL_MAGAZINE_CAPACITY          64
+#define POOL_MAGAZINE_BATCH             (POOL_MAGAZINE_CAPACITY/2)
+
+typedef struct Pool_Slab {
+    struct Pool_Slab* next;
+    isize size;
+} Pool_Slab;
+
+typedef struct Pool_Allocator {
+    Allocator alloc[1];
+    Allocator* parent;
+    const char* name;
+
+    void* free_list;
+    Pool_Slab* slabs;
+    u8* bump;
+    u8* bump_end;
+
+    isize chunk_size;
+    isize chunk_align;
+    isize slab_size;
+    isize slab_count;
+    isize chunks_per_slab;
+    isize chunks_allocated;         //Chunks currently given out (including the ones held by magazines)
+
+    isize bytes_allocated;          //Bytes in chunks given out (including the ones held by magazines) plus forwarded allocations
+    isize max_bytes_allocated;
+    isize concurrent_allocations;
+    isize max_concurrent_allocations;
+    isize allocation_count;
+    isize deallocation_count;
+    isize reallocation_count;
+
+    bool is_thread_safe;
+    Platform_Mutex mutex;
+    Allocator_Set allocator_backup;
+} Pool_Allocator;
+
+typedef struct Pool_Magazine {
+    Pool_Allocator* pool;
+    isize count;
+    void* chunks[POOL_MAGAZINE_CAPACITY];
+} Pool_Magazine;
+
+//Initializes the pool to give out chunks of chunk_size bytes aligned to chunk_align (0 means DEF_ALIGN).
+//If parent is NULL uses the default allocator. Name is optional.
+EXTERNAL void pool_allocator_init(Pool_Allocator* pool, Allocator* parent, isize chunk_size, isize chunk_align, const char* name);
+//Initializes the pool with custom slab size (0 means POOL_ALLOCATOR_DEF_SLAB_SIZE) and flags (POOL_ALLOCATOR_THREAD_SAFE).
+EXTERNAL void pool_allocator_init_custom(Pool_Allocator* pool, Allocator* parent, isize chunk_size, isize chunk_align, isize slab_size, u64 flags, const char* name);
+//Initializes the pool and makes it the default allocator. Restores the old allocators on deinit.
+EXTERNAL void pool_allocator_init_use(Pool_Allocator* pool, Allocator* parent, isize chunk_size, isize chunk_align, const char* name);
+//Returns all memory to the parent allocator
+EXTERNAL void pool_allocator_deinit(Pool_Allocator* pool);
+//Frees all chunks at once returning the slabs to the parent. Does not free allocations forwarded to the parent!
+EXTERNAL void pool_allocator_free_all(Pool_Allocator* pool);
+
+//Returns whether allocation of given size and align would be served by the pool
+EXTERNAL bool  pool_allocator_fits(const Pool_Allocator* pool, isize size, isize align);
+//Allocates a single chunk. Returns NULL if the parent allocator fails.
+EXTERNAL void* pool_allocator_allocate(Pool_Allocator* pool);
+//Returns a chunk to the pool. Does nothing for NULL.
+EXTERNAL void  pool_allocator_deallocate(Pool_Allocator* pool, void* chunk);
+
+EXTERNAL void* pool_allocator_func(Allocator* self, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error);
+EXTERNAL Allocator_Stats pool_allocator_get_stats(Allocator* self);
+EXTERNAL void pool_allocator_test_invariants(Pool_Allocator* pool);
+
+//Magazines must be flushed by deinit before the pool is deinited or free_all-ed.
+EXTERNAL void  pool_magazine_init(Pool_Magazine* magazine, Pool_Allocator* pool);
+EXTERNAL void  pool_magazine_deinit(Pool_Magazine* magazine);
+EXTERNAL void* pool_magazine_allocate(Pool_Magazine* magazine);
+EXTERNAL void  pool_magazine_deallocate(Pool_Magazine* magazine, void* chunk);
+#endif
+
+#if (defined(MODULE_IMPL_ALL) || defined(MODULE_IMPL_ALLOCATOR_POOL)) && !defined(MODULE_HAS_IMPL_ALLOCATOR_POOL)
+#define MODULE_HAS_IMPL_ALLOCATOR_POOL
+
+INTERNAL void _pool_allocator_lock(Pool_Allocator* pool)
+{
+    if(pool->is_thread_safe)
+        platform_mutex_lock(&pool->mutex);
+}
+
+INTERNAL void _pool_allocator_unlock(Pool_Allocator* pool)
+{
+    if(pool->is_thread_safe)
+        platform_mutex_unlock(&pool->mutex);
+}
+
+INTERNAL void _pool_allocator_track(Pool_Allocator* pool, isize chunks, isize bytes)
+{
+    pool->bytes_allocated += bytes;
+    pool->concurrent_allocations += chunks;
+    pool->max_bytes_allocated = MAX(pool->max_bytes_allocated, pool->bytes_allocated);
+    pool->max_concurrent_allocations = MAX(pool->max_concurrent_allocations, pool->concurrent_allocations);
+}
+
+INTERNAL isize _pool_allocator_slab_header_size(const Pool_Allocator* pool)
+{
+    return DIV_CEIL(isizeof(Pool_Slab), pool->chunk_align)*pool->chunk_align;
+}
+
+INTERNAL bool _pool_allocator_add_slab(Pool_Allocator* pool)
+{
+    isize slab_align = MAX(pool->chunk_align, DEF_ALIGN);
+    Pool_Slab* slab = (Pool_Slab*) allocator_try_reallocate(pool->parent, pool->slab_size, NULL, 0, slab_align, NULL);
+    if(slab == NULL)
+        return false;
+
+    slab->next = pool->slabs;
+    slab->size = pool->slab_size;
+    pool->slabs = slab;
+    pool->slab_count += 1;
+    pool->bump = (u8*) slab + _pool_allocator_slab_header_size(pool);
+    pool->bump_end = pool->bump + pool->chunks_per_slab*pool->chunk_size;
+    return true;
+}
+
+INTERNAL void* _pool_allocator_pop(Pool_Allocator* pool)
+{
+    void* chunk = pool->free_list;
+    if(chunk)
+        pool->free_list = *(void**) chunk;
+    else
+    {
+        if(pool->bump >= pool->bump_end && _pool_allocator_add_slab(pool) == false)
+            return NULL;
+
+        chunk = pool->bump;
+        pool->bump += pool->chunk_size;
+    }
+
+    pool->chunks_allocated += 1;
+    return chunk;
+}
+
+INTERNAL void _pool_allocator_push(Pool_Allocator* pool, void* chunk)
+{
+    #ifdef DO_ASSERTS_SLOW
+    bool is_from_slab = false;
+    for(Pool_Slab* slab = pool->slabs; slab; slab = slab->next)
+    {
+        u8* first = (u8*) slab + _pool_allocator_slab_header_size(pool);
+        if(first <= (u8*) chunk && (u8*) chunk < first + pool->chunks_per_slab*pool->chunk_size)
+        {
+            ASSERT(((u8*) chunk - first) % pool->chunk_size == 0, "misaligned chunk pointer");
+            is_from_slab = true;
+            break;
+        }
+    }
+    ASSERT(is_from_slab, "the chunk was not allocated from this pool");
+    #endif
+
+    *(void**) chunk = pool->free_list;
+    pool->free_list = chunk;
+    pool->chunks_allocated -= 1;
+}
+
+EXTERNAL void pool_allocator_init_custom(Pool_Allocator* pool, Allocator* parent, isize chunk_size, isize chunk_align, isize slab_size, u64 flags, const char* name)
+{
+    pool_allocator_deinit(pool);
+    if(chunk_align <= 0)
+        chunk_align = DEF_ALIGN;
+    if(slab_size <= 0)
+        slab_size = POOL_ALLOCATOR_DEF_SLAB_SIZE;
+
+    ASSERT(chunk_size > 0 && is_power_of_two(chunk_align));
+    chunk_align = MAX(chunk_align, isizeof(void*));
+    chunk_size = DIV_CEIL(chunk_size, chunk_align)*chunk_align;
+
+    pool->parent = allocator_or_default(parent);
+    pool->name = name;
+    pool->chunk_size = chunk_size;
+    pool->chunk_align = chunk_align;
+
+    //Always fit at least a few chunks into a slab
+    isize header_size = _pool_allocator_slab_header_size(pool);
+    pool->slab_size = MAX(slab_size, header_size + 4*chunk_size);
+    pool->chunks_per_slab = (pool->slab_size - header_size)/chunk_size;
+
+    pool->alloc[0].func = pool_allocator_func;
+    pool->alloc[0].get_stats = pool_allocator_get_stats;
+    pool->is_thread_safe = !!(flags & POOL_ALLOCATOR_THREAD_SAFE);
+    if(pool->is_thread_safe)
+        TEST(platform_mutex_init(&pool->mutex) == PLATFORM_ERROR_OK);
+    allocator_registry_track(pool->alloc);
+}
+
+EXTERNAL void pool_allocator_init(Pool_Allocator* pool, Allocator* parent, isize chunk_size, isize chunk_align, const char* name)
+{
+    pool_allocator_init_custom(pool, parent, chunk_size, chunk_align, 0, 0, name);
+}
+
+EXTERNAL void pool_allocator_init_use(Pool_Allocator* pool, Allocator* parent, isize chunk_size, isize chunk_align, const char* name)
+{
+    pool_allocator_init(pool, parent, chunk_size, chunk_align, name);
+    pool->allocator_backup = allocator_set_default(pool->alloc);
+}
+
+EXTERNAL void pool_allocator_free_all(Pool_Allocator* pool)
+{
+    _pool_allocator_lock(pool);
+    isize slab_align = MAX(pool->chunk_align, DEF_ALIGN);
+    for(Pool_Slab* slab = pool->slabs; slab; )
+    {
+        Pool_Slab* next = slab->next;
+        allocator_deallocate(pool->parent, slab, slab->size, slab_align);
+        slab = next;
+    }
+
+    pool->bytes_allocated -= pool->chunks_allocated*pool->chunk_size;
+    pool->concurrent_allocations -= pool->chunks_allocated;
+    pool->chunks_allocated = 0;
+    pool->slabs = NULL;
+    pool->slab_count = 0;
+    pool->free_list = NULL;
+    pool->bump = NULL;
+    pool->bump_end = NULL;
+    _pool_allocator_unlock(pool);
+}
+
+EXTERNAL void pool_allocator_deinit(Pool_Allocator* pool)
+{
+    if(pool->alloc[0].func == NULL)
+        return;
+
+    allocator_registry_remove(pool->alloc);
+    pool_allocator_free_all(pool);
+    allocator_set(pool->allocator_backup);
+    if(pool->is_thread_safe)
+        platform_mutex_deinit(&pool->mutex);
+    memset(pool, 0, sizeof *pool);
+}
+
+EXTERNAL bool pool_allocator_fits(const Pool_Allocator* pool, isize size, isize align)
+{
+    return size <= pool->chunk_size && align <= pool->chunk_align;
+}
+
+EXTERNAL void* pool_allocator_allocate(Pool_Allocator* pool)
+{
+    _pool_allocator_lock(pool);
+    void* chunk = _pool_allocator_pop(pool);
+    if(chunk)
+    {
+        pool->allocation_count += 1;
+        _pool_allocator_track(pool, 1, pool->chunk_size);
+    }
+    _pool_allocator_unlock(pool);
+    return chunk;
+}
+
+EXTERNAL void pool_allocator_deallocate(Pool_Allocator* pool, void* chunk)
+{
+    if(chunk == NULL)
+        return;
+
+    _pool_allocator_lock(pool);
+    _pool_allocator_push(pool, chunk);
+    pool->deallocation_count += 1;
+    _pool_allocator_track(pool, -1, -pool->chunk_size);
+    _pool_allocator_unlock(pool);
+}
+
+EXTERNAL void* pool_allocator_func(Allocator* self, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error)
+{
+    Pool_Allocator* pool = (Pool_Allocator*) (void*) self;
+    bool old_fits = old_size > 0 && pool_allocator_fits(pool, old_size, align);
+    bool new_fits = new_size > 0 && pool_allocator_fits(pool, new_size, align);
+
+    //Reallocation within a chunk is a no-op. When neither fits let the parent reallocate in place if it can.
+    void* new_ptr = old_ptr;
+    if(old_fits == false && new_fits == false)
+        new_ptr = allocator_try_reallocate(pool->parent, new_size, old_ptr, old_size, align, error);
+    else if(old_fits == false || new_fits == false)
+    {
+        new_ptr = NULL;
+        if(new_fits)
+        {
+            _pool_allocator_lock(pool);
+            new_ptr = _pool_allocator_pop(pool);
+            _pool_allocator_unlock(pool);
+            if(new_ptr == NULL)
+                allocator_error(error, ALLOCATOR_ERROR_OUT_OF_MEM, self, new_size, old_ptr, old_size, align, "parent failed to allocate slab of size %lli", (lli) pool->slab_size);
+        }
+        else if(new_size > 0)
+            new_ptr = allocator_try_reallocate(pool->parent, new_size, NULL, 0, align, error);
+
+        if(new_ptr && old_size > 0)
+        {
+            ASSERT(old_ptr);
+            memcpy(new_ptr, old_ptr, (size_t) MIN(old_size, new_size));
+        }
+
+        //Free the old block once the new one was successfully obtained
+        if(old_size > 0 && (new_ptr || new_size == 0))
+        {
+            if(old_fits)
+            {
+                _pool_allocator_lock(pool);
+                _pool_allocator_push(pool, old_ptr);
+                _pool_allocator_unlock(pool);
+            }
+            else
+                allocator_deallocate(pool->parent, old_ptr, old_size, align);
+        }
+    }
+
+    if(new_ptr || new_size == 0)
+    {
+        //Pooled allocations occupy the whole chunk
+        isize old_bytes = old_fits ? pool->chunk_size : old_size;
+        isize new_bytes = new_fits ? pool->chunk_size : new_size;
+
+        _pool_allocator_lock(pool);
+        if(new_size > 0 && old_size == 0)   pool->allocation_count += 1;
+        if(new_size == 0 && old_size > 0)   pool->deallocation_count += 1;
+        if(new_size > 0 && old_size > 0)    pool->reallocation_count += 1;
+        _pool_allocator_track(pool, (new_size > 0) - (old_size > 0), new_bytes - old_bytes);
+        _pool_allocator_unlock(pool);
+    }
+
+    return new_ptr;
+}
+
+EXTERNAL Allocator_Stats pool_allocator_get_stats(Allocator* self)
+{
+    Pool_Allocator* pool = (Pool_Allocator*) (void*) self;
+    Allocator_Stats out = {0};
+    _pool_allocator_lock(pool);
+    out.type_name = "Pool_Allocator";
+    out.name = pool->name;
+    out.parent = pool->parent;
+    out.is_top_level = false;
+    out.is_growing = true;
+    out.is_capable_of_resize = false;
+    out.is_capable_of_free_all = true;
+    out.bytes_allocated = pool->bytes_allocated;
+    out.max_bytes_allocated = pool->max_bytes_allocated;
+    out.max_concurent_allocations = pool->max_concurrent_allocations;
+    out.allocation_count = pool->allocation_count;
+    out.deallocation_count = pool->deallocation_count;
+    out.reallocation_count = pool->reallocation_count;
+    _pool_allocator_unlock(pool);
+    return out;
+}
+
+EXTERNAL void pool_allocator_test_invariants(Pool_Allocator* pool)
+{
+    _pool_allocator_lock(pool);
+    TEST(is_power_of_two(pool->chunk_align) && pool->chunk_size % pool->chunk_align == 0);
+    TEST(pool->chunks_per_slab > 0);
+    TEST(pool->bump <= pool->bump_end);
+    TEST((pool->slabs == NULL) == (pool->slab_count == 0));
+
+    //Every free chunk must lie inside some slab, at a chunk boundary and below the bump pointer
+    isize header_size = _pool_allocator_slab_header_size(pool);
+    isize slab_count = 0;
+    isize free_count = 0;
+    for(Pool_Slab* slab = pool->slabs; slab; slab = slab->next)
+    {
+        TEST(slab->size == pool->slab_size);
+        TEST((uintptr_t) slab % (uintptr_t) pool->chunk_align == 0);
+        slab_count += 1;
+    }
+
+    for(void* chunk = pool->free_list; chunk; chunk = *(void**) chunk)
+    {
+        bool found = false;
+        for(Pool_Slab* slab = pool->slabs; slab; slab = slab->next)
+        {
+            u8* first = (u8*) slab + header_size;
+            u8* end = slab == pool->slabs ? pool->bump : first + pool->chunks_per_slab*pool->chunk_size;
+            if(first <= (u8*) chunk && (u8*) chunk < end)
+            {
+                TEST(((u8*) chunk - first) % pool->chunk_size == 0);
+                found = true;
+                break;
+            }
+        }
+        TEST(found);
+        TEST(free_count++ <= slab_count*pool->chunks_per_slab);
+    }
+
+    TEST(slab_count == pool->slab_count);
+    TEST(0 <= pool->chunks_allocated && pool->chunks_allocated <= pool->concurrent_allocations);
+    TEST(pool->chunks_allocated + free_count + (pool->bump_end - pool->bump)/pool->chunk_size == slab_count*pool->chunks_per_slab);
+    TEST(pool->bytes_allocated <= pool->max_bytes_allocated);
+    _pool_allocator_unlock(pool);
+}
+
+EXTERNAL void pool_magazine_init(Pool_Magazine* magazine, Pool_Allocator* pool)
+{
+    magazine->pool = pool;
+    magazine->count = 0;
+}
+
+EXTERNAL void pool_magazine_deinit(Pool_Magazine* magazine)
+{
+    Pool_Allocator* pool = magazine->pool;
+    if(pool && magazine->count > 0)
+    {
+        _pool_allocator_lock(pool);
+        for(isize i = 0; i < magazine->count; i++)
+            _pool_allocator_push(pool, magazine->chunks[i]);
+        _pool_allocator_track(pool, -magazine->count, -magazine->count*pool->chunk_size);
+        pool->deallocation_count += magazine->count;
+        _pool_allocator_unlock(pool);
+    }
+    magazine->count = 0;
+}
+
+EXTERNAL void* pool_magazine_allocate(Pool_Magazine* magazine)
+{
+    if(magazine->count == 0)
+    {
+        Pool_Allocator* pool = magazine->pool;
+        _pool_allocator_lock(pool);
+        for(; magazine->count < POOL_MAGAZINE_BATCH; magazine->count++)
+        {
+            void* chunk = _pool_allocator_pop(pool);
+            if(chunk == NULL)
+                break;
+            magazine->chunks[magazine->count] = chunk;
+        }
+        _pool_allocator_track(pool, magazine->count, magazine->count*pool->chunk_size);
+        pool->allocation_count += magazine->count;
+        _pool_allocator_unlock(pool);
+
+        if(magazine->count == 0)
+            return NULL;
+    }
+
+    return magazine->chunks[--magazine->count];
+}
+
+EXTERNAL void pool_magazine_deallocate(Pool_Magazine* magazine, void* chunk)
+{
+    if(chunk == NULL)
+        return;
+
+    if(magazine->count >= POOL_MAGAZINE_CAPACITY)
+    {
+        Pool_Allocator* pool = magazine->pool;
+        _pool_allocator_lock(pool);
+        for(isize i = 0; i < POOL_MAGAZINE_BATCH; i++)
+            _pool_allocator_push(pool, magazine->chunks[--magazine->count]);
+        _pool_allocator_track(pool, -POOL_MAGAZINE_BATCH, -POOL_MAGAZINE_BATCH*pool->chunk_size);
+        pool->deallocation_count += POOL_MAGAZINE_BATCH;
+        _pool_allocator_unlock(pool);
+    }
+
+    magazine->chunks[magazine->count++] = chunk;
+}
+#endif
@@ -0,0 +1,374 @@
+#ifndef MODULE_ALLOCATOR_SAMPLING
+#define MODULE_ALLOCATOR_SAMPLING
+
+// A sampling heap profiler implemented as an Allocator wrapper.
+//
+// Debug_Allocator with DEBUG_ALLOCATOR_CAPTURE_CALLSTACK captures the call stack of every single allocation.
+// That is invaluable for tracking down a specific bug but way too slow to leave on in production. This allocator
+// instead captures the call stack only for a random subset of allocations such that on average one allocation is
+// sampled for every sample_period (512KB by default) bytes allocated. The live sampled allocations are kept in a Hash
+// and can be dumped at any moment as a heap profile showing which call stacks hold how much memory.
+//
+// The sampling is the same as tcmalloc/jemalloc/Go use: allocated bytes are treated as a Poisson process. Each thread
+// keeps a countdown of bytes until the next sample which is drawn from exponential distribution with mean sample_period.
+// Each allocation subtracts its size from the countdown and when it crosses zero the allocation is sampled. This means:
+//  1. The common case is a thread local decrement and a compare. No locks, no atomics.
+//  2. Allocation of size S is sampled with probability P = 1 - exp(-S/sample_period) regardless of the sizes allocated
+//     before it. Thus each sample stands for S/P bytes (its weight) and the sum of weights is an unbiased estimate
+//     of the live heap. Big allocations are almost always sampled and have weight close to their size.
+//
+// Deallocations need to find out whether the pointer was sampled. To not lock on every free we keep a small counting
+// filter indexed by the hashed pointer. Only when the counter is nonzero we lock and look into the hash.
+// The countdown is shared by all sampling allocators used on the thread. Sampled allocations are attributed
+// to whichever allocator crossed the countdown which is statistically correct as long as all use the same period.
+//
+// The profile can be written either as folded stacks (one "frame;frame;frame bytes" line per unique call stack, the input
+// of flamegraph.pl and speedscope) or in the legacy gperftools heap profile format understood by `pprof`. The latter stores
+// raw sample counts along with the sampling period and lets pprof do the scaling.
+//
+// Is thread safe as long as the parent allocator is.
+
+#include "allocator.h"
+#include "array.h"
+#include "hash.h"
+#include "hash_func.h"
+#include "string.h"
+
+#define SAMPLING_ALLOCATOR_DEFAULT_PERIOD   (512*1024)
+#define SAMPLING_ALLOCATOR_MAX_CALL_STACK   32
+#define SAMPLING_ALLOCATOR_FILTER_SIZE      4096 /* must be power of two */
+
+typedef struct Sampling_Allocator_Sample {
+    void* ptr;
+    isize size;
+    isize align;
+    isize weight;       //estimated number of bytes allocated from this call stack this sample stands for
+    i64 epoch_time;
+    i64 call_stack_size;
+    void* call_stack[SAMPLING_ALLOCATOR_MAX_CALL_STACK];
+} Sampling_Allocator_Sample;
+
+typedef Array(Sampling_Allocator_Sample) Sampling_Allocator_Sample_Array;
+
+typedef struct Sampling_Allocator {
+    Allocator alloc[1];
+    Allocator* parent;
+    const char* name;
+    isize sample_period;
+
+    Platform_Mutex mutex;
+    Hash samples_hash; //hash64_bijective(ptr) -> Sampling_Allocator_Sample*
+    PLATFORM_ATOMIC(uint32_t) filter[SAMPLING_ALLOCATOR_FILTER_SIZE]; //number of live samples with given (hashed ptr % SIZE)
+
+    //All guarded by mutex
+    isize sample_count;
+    isize live_sample_count;
+    isize live_sampled_bytes;   //sum of sizes of live samples
+    isize live_estimated_bytes; //sum of weights of live samples
+    isize max_live_estimated_bytes;
+} Sampling_Allocator;
+
+EXTERNAL void sampling_allocator_init(Sampling_Allocator* allocator, Allocator* parent, isize sample_period_or_zero, const char* name);
+//Frees the book keeping of samples. Does not free any allocations made through it.
+EXTERNAL void sampling_allocator_deinit(Sampling_Allocator* allocator);
+
+EXTERNAL void* sampling_allocator_func(Allocator* self, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error);
+EXTERNAL Allocator_Stats sampling_allocator_get_stats(Allocator* self);
+
+//Appends copies of all currently live samples to into. Returns the number of samples appended.
+EXTERNAL isize sampling_allocator_get_samples(Sampling_Allocator* allocator, Sampling_Allocator_Sample_Array* into);
+//Appends folded stacks of the live heap to into. Each line is "root;...;leaf estimated_bytes".
+EXTERNAL void sampling_allocator_write_folded(Sampling_Allocator* allocator, String_Builder* into);
+//Appends the live heap in the legacy gperftools (heap_v2) text format readable by pprof.
+EXTERNAL void sampling_allocator_write_pprof(Sampling_Allocator* allocator, String_Builder* into);
+
+#endif
+
+#if (defined(MODULE_IMPL_ALL) || defined(MODULE_IMPL_ALLOCATOR_SAMPLING)) && !defined(MODULE_HAS_IMPL_ALLOCATOR_SAMPLING)
+#define MODULE_HAS_IMPL_ALLOCATOR_SAMPLING
+
+    #include "random.h"
+    #include "vformat.h"
+    #include <math.h>
+    #include <stdlib.h> //qsort
+
+    //Bytes left until the next sample on this thread. Zero means not yet drawn.
+    INTERNAL ATTRIBUTE_THREAD_LOCAL isize _sampling_allocator_countdown = 0;
+
+    INTERNAL isize _sampling_allocator_draw_interval(isize period)
+    {
+        //Exponential distribution with mean period. random_f64 is in [0, 1) so the log is finite.
+        f64 interval = -log(1.0 - random_f64()) * (f64) period;
+        if(interval > (f64) period * 64)
+            interval = (f64) period * 64;
+        return (isize) interval + 1;
+    }
+
+    EXTERNAL void sampling_allocator_init(Sampling_Allocator* allocator, Allocator* parent, isize sample_period_or_zero, const char* name)
+    {
+        sampling_allocator_deinit(allocator);
+        allocator->parent = parent ? parent : allocator_get_default();
+        allocator->name = name;
+        allocator->sample_period = sample_period_or_zero > 0 ? sample_period_or_zero : SAMPLING_ALLOCATOR_DEFAULT_PERIOD;
+        allocator->alloc[0].func = sampling_allocator_func;
+        allocator->alloc[0].get_stats = sampling_allocator_get_stats;
+
+        platform_mutex_init(&allocator->mutex);
+        hash_init(&allocator->samples_hash, allocator->parent);
+        allocator_registry_track(allocator->alloc);
+    }
+
+    EXTERNAL void sampling_allocator_deinit(Sampling_Allocator* allocator)
+    {
+        if(allocator->alloc[0].func == NULL)
+            return;
+
+        allocator_registry_remove(allocator->alloc);
+        for(isize i = 0; i < allocator->samples_hash.entries_count; i++)
+        {
+            Hash_Entry entry = allocator->samples_hash.entries[i];
+            if(hash_is_entry_used(entry))
+                allocator_deallocate(allocator->parent, entry.value_ptr, isizeof(Sampling_Allocator_Sample), DEF_ALIGN);
+        }
+        hash_deinit(&allocator->samples_hash);
+        platform_mutex_deinit(&allocator->mutex);
+        memset(allocator, 0, sizeof *allocator);
+    }
+
+    //Removes the sample of ptr if any and returns it. The sample is still owned by the caller who
+    // must either give it back through _sampling_allocator_insert or deallocate it.
+    INTERNAL Sampling_Allocator_Sample* _sampling_allocator_remove(Sampling_Allocator* self, void* ptr)
+    {
+        PLATFORM_USE_ATOMICS;
+        u64 hashed = hash64_bijective((u64) ptr);
+        PLATFORM_ATOMIC(uint32_t)* slot = &self->filter[hashed & (SAMPLING_ALLOCATOR_FILTER_SIZE - 1)];
+        if(atomic_load_explicit(slot, memory_order_relaxed) == 0)
+            return NULL;
+
+        Sampling_Allocator_Sample* sample = NULL;
+        platform_mutex_lock(&self->mutex);
+        Hash_Entry removed = {0};
+        if(hash_remove(&self->samples_hash, hashed, &removed))
+        {
+            sample = (Sampling_Allocator_Sample*) removed.value_ptr;
+            atomic_fetch_sub_explicit(slot, 1, memory_order_relaxed);
+            self->live_sample_count -= 1;
+            self->live_sampled_bytes -= sample->size;
+            self->live_estimated_bytes -= sample->weight;
+        }
+        platform_mutex_unlock(&self->mutex);
+        return sample;
+    }
+
+    INTERNAL void _sampling_allocator_insert(Sampling_Allocator* self, Sampling_Allocator_Sample* sample, bool is_new)
+    {
+        PLATFORM_USE_ATOMICS;
+        u64 hashed = hash64_bijective((u64) sample->ptr);
+        platform_mutex_lock(&self->mutex);
+        self->sample_count += is_new;
+        hash_insert(&self->samples_hash, hashed, (u64) sample);
+        atomic_fetch_add_explicit(&self->filter[hashed & (SAMPLING_ALLOCATOR_FILTER_SIZE - 1)], 1, memory_order_relaxed);
+        self->live_sample_count += 1;
+        self->live_sampled_bytes += sample->size;
+        self->live_estimated_bytes += sample->weight;
+        self->max_live_estimated_bytes = MAX(self->max_live_estimated_bytes, self->live_estimated_bytes);
+        platform_mutex_unlock(&self->mutex);
+    }
+
+    INTERNAL ATTRIBUTE_INLINE_NEVER void _sampling_allocator_take_sample(Sampling_Allocator* self, Sampling_Allocator_Sample* reuse_or_null, void* ptr, isize size, isize align)
+    {
+        Sampling_Allocator_Sample* sample = reuse_or_null;
+        if(sample == NULL)
+            sample = (Sampling_Allocator_Sample*) allocator_try_reallocate(self->parent, isizeof(Sampling_Allocator_Sample), NULL, 0, DEF_ALIGN, NULL);
+
+        //Not being able to sample is not an error of the allocation itself
+        if(sample == NULL)
+            return;
+
+        f64 probability = 1.0 - exp(-(f64) size / (f64) self->sample_period);
+        sample->ptr = ptr;
+        sample->size = size;
+        sample->align = align;
+        sample->weight = (isize) ((f64) size / probability + 0.5);
+        sample->epoch_time = platform_epoch_time();
+        //Skip this function and sampling_allocator_func
+        sample->call_stack_size = platform_capture_call_stack(sample->call_stack, SAMPLING_ALLOCATOR_MAX_CALL_STACK, 2);
+
+        _sampling_allocator_insert(self, sample, true);
+    }
+
+    EXTERNAL void* sampling_allocator_func(Allocator* self_, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error)
+    {
+        Sampling_Allocator* self = (Sampling_Allocator*) (void*) self_;
+        PROFILE_START();
+
+        //Remove the old sample before the block is given back to the parent so that
+        // other thread getting the same address cannot race with us.
+        Sampling_Allocator_Sample* old_sample = NULL;
+        if(old_ptr != NULL)
+            old_sample = _sampling_allocator_remove(self, old_ptr);
+
+        void* new_ptr = self->parent->func(self->parent, new_size, old_ptr, old_size, align, error);
+        if(new_ptr == NULL && new_size != 0)
+        {
+            //Failed realloc leaves the old block as it was
+            if(old_sample)
+                _sampling_allocator_insert(self, old_sample, false);
+            PROFILE_STOP();
+            return NULL;
+        }
+
+        //Reallocations count as new allocations of new_size
+        bool sampled = false;
+        if(new_size != 0)
+        {
+            isize countdown = _sampling_allocator_countdown;
+            if(countdown == 0)
+                countdown = _sampling_allocator_draw_interval(self->sample_period);
+
+            countdown -= new_size;
+            if(countdown <= 0)
+            {
+                //Sizes bigger than the interval still produce just one sample. Their weight accounts for that.
+                sampled = true;
+                countdown = _sampling_allocator_draw_interval(self->sample_period);
+            }
+            _sampling_allocator_countdown = countdown;
+        }
+
+        if(sampled)
+            _sampling_allocator_take_sample(self, old_sample, new_ptr, new_size, align);
+        else if(old_sample)
+            allocator_deallocate(self->parent, old_sample, isizeof(Sampling_Allocator_Sample), DEF_ALIGN);
+
+        PROFILE_STOP();
+        return new_ptr;
+    }
+
+    EXTERNAL Allocator_Stats sampling_allocator_get_stats(Allocator* self_)
+    {
+        Sampling_Allocator* self = (Sampling_Allocator*) (void*) self_;
+        Allocator_Stats out = {0};
+        out.type_name = "Sampling_Allocator";
+        out.name = self->name;
+        out.parent = self->parent;
+        out.is_capable_of_resize = true;
+
+        //We only know estimates which are not locally stable thus not bytes_allocated.
+        //Those are reported by the parent anyway.
+        platform_mutex_lock(&self->mutex);
+        out.allocation_count = self->sample_count;
+        out.max_concurent_allocations = self->live_sample_count;
+        platform_mutex_unlock(&self->mutex);
+        return out;
+    }
+
+    EXTERNAL isize sampling_allocator_get_samples(Sampling_Allocator* self, Sampling_Allocator_Sample_Array* into)
+    {
+        isize count_before = into->count;
+        platform_mutex_lock(&self->mutex);
+        array_reserve(into, into->count + self->samples_hash.count);
+        for(isize i = 0; i < self->samples_hash.entries_count; i++)
+        {
+            Hash_Entry entry = self->samples_hash.entries[i];
+            if(hash_is_entry_used(entry))
+                array_push(into, *(Sampling_Allocator_Sample*) entry.value_ptr);
+        }
+        platform_mutex_unlock(&self->mutex);
+        return into->count - count_before;
+    }
+
+    INTERNAL int _sampling_allocator_call_stack_compare(const void* a_, const void* b_)
+    {
+        const Sampling_Allocator_Sample* a = (const Sampling_Allocator_Sample*) a_;
+        const Sampling_Allocator_Sample* b = (const Sampling_Allocator_Sample*) b_;
+        if(a->call_stack_size != b->call_stack_size)
+            return a->call_stack_size < b->call_stack_size ? -1 : 1;
+        return memcmp(a->call_stack, b->call_stack, (size_t) a->call_stack_size*sizeof(void*));
+    }
+
+    //Returns the live samples sorted such that samples with the same call stack are next to each other.
+    INTERNAL Sampling_Allocator_Sample_Array _sampling_allocator_get_sorted_samples(Sampling_Allocator* self)
+    {
+        Sampling_Allocator_Sample_Array samples = {0};
+        array_init(&samples, self->parent);
+        sampling_allocator_get_samples(self, &samples);
+        qsort(samples.data, (size_t) samples.count, sizeof *samples.data, _sampling_allocator_call_stack_compare);
+        return samples;
+    }
+
+    EXTERNAL void sampling_allocator_write_folded(Sampling_Allocator* self, String_Builder* into)
+    {
+        Sampling_Allocator_Sample_Array samples = _sampling_allocator_get_sorted_samples(self);
+        Platform_Stack_Trace_Entry translated[SAMPLING_ALLOCATOR_MAX_CALL_STACK];
+        for(isize i = 0; i < samples.count; )
+        {
+            Sampling_Allocator_Sample* first = &samples.data[i];
+            isize weight = 0;
+            for(; i < samples.count && _sampling_allocator_call_stack_compare(first, &samples.data[i]) == 0; i++)
+                weight += samples.data[i].weight;
+
+            //Folded stacks go from the root to the leaf
+            platform_translate_call_stack(translated, first->call_stack, first->call_stack_size);
+            for(isize k = first->call_stack_size; k-- > 0; )
+            {
+                if(translated[k].function[0] != '\0')
+                    builder_append(into, string_of(translated[k].function));
+                else
+                    format_append_into(into, "%p", translated[k].address);
+                if(k > 0)
+                    builder_push(into, ';');
+            }
+            format_append_into(into, " %lli\n", (lli) weight);
+        }
+        array_deinit(&samples);
+    }
+
+    EXTERNAL void sampling_allocator_write_pprof(Sampling_Allocator* self, String_Builder* into)
+    {
+        Sampling_Allocator_Sample_Array samples = _sampling_allocator_get_sorted_samples(self);
+        isize total_bytes = 0;
+        for(isize i = 0; i < samples.count; i++)
+            total_bytes += samples.data[i].size;
+
+        //We only track live allocations so the in use and allocated columns are the same
+        format_append_into(into, "heap profile: %lli: %lli [%lli: %lli] @ heap_v2/%lli\n",
+            (lli) samples.count, (lli) total_bytes, (lli) samples.count, (lli) total_bytes, (lli) self->sample_period);
+        for(isize i = 0; i < samples.count; )
+        {
+            Sampling_Allocator_Sample* first = &samples.data[i];
+            isize count = 0;
+            isize bytes = 0;
+            for(; i < samples.count && _sampling_allocator_call_stack_compare(first, &samples.data[i]) == 0; i++)
+            {
+                count += 1;
+                bytes += samples.data[i].size;
+            }
+
+            format_append_into(into, "%lli: %lli [%lli: %lli] @", (lli) count, (lli) bytes, (lli) count, (lli) bytes);
+            for(isize k = 0; k < first->call_stack_size; k++)
+                format_append_into(into, " %p", first->call_stack[k]);
+            builder_push(into, '\n');
+        }
+        array_deinit(&samples);
+
+        //pprof needs the memory map to symbolize the addresses
+        #if PLATFORM_OS == PLATFORM_OS_UNIX
+        Platform_File maps = {0};
+        if(platform_file_open(&maps, STRING("/proc/self/maps"), PLATFORM_FILE_MODE_READ) == 0)
+        {
+            builder_append(into, STRING("\nMAPPED_LIBRARIES:\n"));
+            enum {CHUNK = 4096};
+            for(isize read = CHUNK; read == CHUNK; )
+            {
+                isize before = into->count;
+                builder_resize(into, before + CHUNK);
+                platform_file_read(&maps, into->data + before, CHUNK, &read);
+                builder_resize(into, before + read);
+            }
+            platform_file_close(&maps);
+        }
+        #endif
+    }
+
+#endif
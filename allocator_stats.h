@@ -0,0 +1,368 @@
+#ifndef MODULE_ALLOCATOR_STATS
+#define MODULE_ALLOCATOR_STATS
+
+// Whole program view of memory usage built from the allocator registry (see allocator_registry_enable in allocator.h).
+//
+// allocator_stats_snapshot collects Allocator_Stats of every registered allocator along with all of their
+// (even unregistered) parents and arranges them into a tree following Allocator_Stats::parent. The nodes are
+// stored in depth first order so a simple for loop visits the tree the same way it would be printed.
+//
+// The snapshot can be logged as an indented tree or serialized into a compact binary stream. The stream is
+// meant to be periodically appended to a file or sent over a socket to an external viewer which can then plot
+// memory usage of each allocator over time. allocator_stats_deserialize reads it back.
+
+#include "allocator.h"
+#include "string.h"
+#include "log.h"
+
+typedef struct Allocator_Stats_Node {
+    Allocator* allocator;   //NULL for deserialized nodes
+    Allocator_Stats stats;
+    i32 parent;             //index of the parent node or -1 for roots
+    i32 depth;              //0 for roots
+    i32 first_child;        //-1 if none
+    i32 next_sibling;       //-1 if none
+    isize children_bytes_allocated; //sum of bytes_allocated of the direct children. Can be compared against own bytes_allocated to see overhead/waste.
+    bool is_registered;     //false if this node was only reached through Allocator_Stats::parent of some registered allocator
+    bool _[7];
+} Allocator_Stats_Node;
+
+typedef Array(Allocator_Stats_Node) Allocator_Stats_Node_Array;
+
+#define ALLOCATOR_STATS_MAGIC   0x54534C41 /* "ALST" when written on little endian */
+#define ALLOCATOR_STATS_VERSION 1
+#define ALLOCATOR_STATS_MAX_DEPTH 64
+
+//Clears nodes (initializing them with the default allocator if not yet) and fills it with the current state of all registered allocators in depth first order. Returns the number of nodes.
+EXTERNAL isize allocator_stats_snapshot(Allocator_Stats_Node_Array* nodes);
+//Logs the nodes as an indented tree
+EXTERNAL void  allocator_stats_log(const char* log_name, Log_Type log_type, const Allocator_Stats_Node* nodes, isize node_count);
+//Appends a single serialized snapshot to into. time is arbitrary user value (for example clock_ns()) stored alongside.
+EXTERNAL void  allocator_stats_serialize(String_Builder* into, const Allocator_Stats_Node* nodes, isize node_count, i64 time);
+//Reads a single snapshot at the start of data. Names of the allocators are stored in names and pointed to from the nodes.
+//Returns the number of bytes consumed or 0 if the data is invalid/truncated.
+EXTERNAL isize allocator_stats_deserialize(String data, Allocator_Stats_Node_Array* nodes, String_Builder* names, i64* time_or_null);
+
+#endif
+
+#if (defined(MODULE_IMPL_ALL) || defined(MODULE_IMPL_ALLOCATOR_STATS)) && !defined(MODULE_HAS_IMPL_ALLOCATOR_STATS)
+#define MODULE_HAS_IMPL_ALLOCATOR_STATS
+
+    //Serialized format (all host endian - the viewer is expected to run on the same kind of machine.
+    // Stream written with the other endianness is rejected by the magic check in allocator_stats_deserialize):
+    // header: u32 magic, u32 version, i64 time, i64 node_count
+    // node:   i32 parent, i32 depth, u32 flags, u16 type_name_len, u16 name_len,
+    //         i64 fixed_memory_pool_size, bytes_allocated, max_bytes_allocated, max_concurent_allocations, allocation_count, deallocation_count, reallocation_count
+    //         type_name and name without the null terminator
+    typedef struct _Allocator_Stats_Header {
+        u32 magic;
+        u32 version;
+        i64 time;
+        i64 node_count;
+    } _Allocator_Stats_Header;
+
+    typedef struct _Allocator_Stats_Record {
+        i32 parent;
+        i32 depth;
+        u32 flags;
+        u16 type_name_len;
+        u16 name_len;
+        i64 fixed_memory_pool_size;
+        i64 bytes_allocated;
+        i64 max_bytes_allocated;
+        i64 max_concurent_allocations;
+        i64 allocation_count;
+        i64 deallocation_count;
+        i64 reallocation_count;
+    } _Allocator_Stats_Record;
+
+    enum {
+        _ALLOCATOR_STATS_REGISTERED = 1,
+        _ALLOCATOR_STATS_TOP_LEVEL = 2,
+        _ALLOCATOR_STATS_GROWING = 4,
+        _ALLOCATOR_STATS_RESIZE = 8,
+        _ALLOCATOR_STATS_FREE_ALL = 16,
+    };
+
+    INTERNAL isize _allocator_stats_find(Allocator_Stats_Node_Array* nodes, Allocator* allocator)
+    {
+        for(isize i = 0; i < nodes->count; i++)
+            if(nodes->data[i].allocator == allocator)
+                return i;
+        return -1;
+    }
+
+    INTERNAL void _allocator_stats_push(Allocator_Stats_Node_Array* nodes, Allocator* allocator, bool is_registered)
+    {
+        Allocator_Stats_Node node = {0};
+        node.allocator = allocator;
+        node.is_registered = is_registered;
+        if(allocator->get_stats)
+            node.stats = allocator->get_stats(allocator);
+        array_push(nodes, node);
+    }
+
+    //Called while holding the registry lock so that neither the allocator nor its parents can be deinited.
+    INTERNAL void _allocator_stats_visit(void* context, Allocator* allocator)
+    {
+        Allocator_Stats_Node_Array* nodes = (Allocator_Stats_Node_Array*) context;
+        isize found = _allocator_stats_find(nodes, allocator);
+        if(found != -1)
+            nodes->data[found].is_registered = true;
+        else
+            _allocator_stats_push(nodes, allocator, true);
+
+        //Add parents not registered. Depth limited so that broken parent chains dont hang us.
+        isize curr = found != -1 ? found : nodes->count - 1;
+        for(isize depth = 0; depth < ALLOCATOR_STATS_MAX_DEPTH; depth++)
+        {
+            Allocator* parent = nodes->data[curr].stats.parent;
+            if(parent == NULL || _allocator_stats_find(nodes, parent) != -1)
+                break;
+
+            _allocator_stats_push(nodes, parent, false);
+            curr = nodes->count - 1;
+        }
+    }
+
+    EXTERNAL isize allocator_stats_snapshot(Allocator_Stats_Node_Array* nodes)
+    {
+        PROFILE_START();
+        if(nodes->allocator == NULL)
+            array_init(nodes, allocator_get_default());
+
+        Allocator_Stats_Node_Array unordered = {0};
+        array_init(&unordered, nodes->allocator);
+        allocator_registry_iterate(_allocator_stats_visit, &unordered);
+
+        //Link each node to its parent and children. The children lists are built in reverse so that
+        // iterating them gives back the registration order.
+        for(isize i = 0; i < unordered.count; i++)
+        {
+            Allocator_Stats_Node* node = &unordered.data[i];
+            node->first_child = -1;
+            node->next_sibling = -1;
+            node->parent = node->stats.parent ? (i32) _allocator_stats_find(&unordered, node->stats.parent) : -1;
+        }
+        for(isize i = unordered.count; i-- > 0; )
+        {
+            Allocator_Stats_Node* node = &unordered.data[i];
+            if(node->parent != -1)
+            {
+                Allocator_Stats_Node* parent = &unordered.data[node->parent];
+                node->next_sibling = parent->first_child;
+                parent->first_child = (i32) i;
+                parent->children_bytes_allocated += node->stats.bytes_allocated;
+            }
+        }
+
+        //Depth first walk from each root. Cycles (which should never happen) are not reachable from
+        // any root so they are added as roots after everything else.
+        i32_Array remap = {0};
+        i32_Array stack = {0};
+        array_init(&remap, nodes->allocator);
+        array_init(&stack, nodes->allocator);
+        array_resize(&remap, unordered.count);
+        for(isize i = 0; i < unordered.count; i++)
+            remap.data[i] = -1;
+
+        array_clear(nodes);
+        array_reserve(nodes, unordered.count);
+        for(isize pass = 0; pass < 2; pass++)
+            for(isize root = 0; root < unordered.count; root++)
+            {
+                if(remap.data[root] != -1 || (pass == 0 && unordered.data[root].parent != -1))
+                    continue;
+
+                unordered.data[root].parent = -1;
+                array_push(&stack, (i32) root);
+                while(stack.count > 0)
+                {
+                    i32 i = stack.data[--stack.count];
+                    if(remap.data[i] != -1)
+                        continue;
+
+                    Allocator_Stats_Node node = unordered.data[i];
+                    remap.data[i] = (i32) nodes->count;
+                    node.parent = node.parent != -1 ? remap.data[node.parent] : -1;
+                    node.depth = node.parent != -1 ? nodes->data[node.parent].depth + 1 : 0;
+                    array_push(nodes, node);
+
+                    //Push in reverse so that the first child is visited first
+                    isize first = stack.count;
+                    for(i32 child = unordered.data[i].first_child; child != -1; child = unordered.data[child].next_sibling)
+                        array_push(&stack, child);
+                    for(isize l = first, r = stack.count - 1; l < r; l++, r--)
+                        SWAP(&stack.data[l], &stack.data[r]);
+                }
+            }
+
+        //Relink in the new order
+        for(isize i = 0; i < nodes->count; i++)
+        {
+            nodes->data[i].first_child = -1;
+            nodes->data[i].next_sibling = -1;
+        }
+        for(isize i = nodes->count; i-- > 0; )
+        {
+            Allocator_Stats_Node* node = &nodes->data[i];
+            if(node->parent != -1)
+            {
+                node->next_sibling = nodes->data[node->parent].first_child;
+                nodes->data[node->parent].first_child = (i32) i;
+            }
+        }
+
+        array_deinit(&stack);
+        array_deinit(&remap);
+        array_deinit(&unordered);
+        PROFILE_STOP();
+        return nodes->count;
+    }
+
+    EXTERNAL void allocator_stats_log(const char* log_name, Log_Type log_type, const Allocator_Stats_Node* nodes, isize node_count)
+    {
+        for(isize i = 0; i < node_count; i++)
+        {
+            const Allocator_Stats_Node* node = &nodes[i];
+            const char* type_name = node->stats.type_name ? node->stats.type_name : "<no type name>";
+            const char* name = node->stats.name ? node->stats.name : "<no name>";
+            int indent = (int) MIN(node->depth, ALLOCATOR_STATS_MAX_DEPTH)*2;
+
+            LOG(log_type, log_name, "%*s%s '%s'%s: %s (max %s) in %lli allocs%s%s",
+                indent, "", type_name, name, node->is_registered ? "" : " (unregistered)",
+                format_bytes(node->stats.bytes_allocated).data, format_bytes(node->stats.max_bytes_allocated).data,
+                (lli) (node->stats.allocation_count - node->stats.deallocation_count),
+                node->first_child != -1 ? " children: " : "",
+                node->first_child != -1 ? format_bytes(node->children_bytes_allocated).data : "");
+        }
+    }
+
+    EXTERNAL void allocator_stats_serialize(String_Builder* into, const Allocator_Stats_Node* nodes, isize node_count, i64 time)
+    {
+        _Allocator_Stats_Header header = {ALLOCATOR_STATS_MAGIC, ALLOCATOR_STATS_VERSION, time, node_count};
+        builder_append(into, string_make((char*) (void*) &header, isizeof header));
+        for(isize i = 0; i < node_count; i++)
+        {
+            const Allocator_Stats_Node* node = &nodes[i];
+            String type_name = node->stats.type_name ? string_of(node->stats.type_name) : STRING("");
+            String name = node->stats.name ? string_of(node->stats.name) : STRING("");
+            type_name = string_safe_head(type_name, UINT16_MAX);
+            name = string_safe_head(name, UINT16_MAX);
+
+            _Allocator_Stats_Record record = {0};
+            record.parent = node->parent;
+            record.depth = node->depth;
+            record.flags = (node->is_registered ? _ALLOCATOR_STATS_REGISTERED : 0)
+                | (node->stats.is_top_level ? _ALLOCATOR_STATS_TOP_LEVEL : 0)
+                | (node->stats.is_growing ? _ALLOCATOR_STATS_GROWING : 0)
+                | (node->stats.is_capable_of_resize ? _ALLOCATOR_STATS_RESIZE : 0)
+                | (node->stats.is_capable_of_free_all ? _ALLOCATOR_STATS_FREE_ALL : 0);
+            record.type_name_len = (u16) type_name.count;
+            record.name_len = (u16) name.count;
+            record.fixed_memory_pool_size = node->stats.fixed_memory_pool_size;
+            record.bytes_allocated = node->stats.bytes_allocated;
+            record.max_bytes_allocated = node->stats.max_bytes_allocated;
+            record.max_concurent_allocations = node->stats.max_concurent_allocations;
+            record.allocation_count = node->stats.allocation_count;
+            record.deallocation_count = node->stats.deallocation_count;
+            record.reallocation_count = node->stats.reallocation_count;
+
+            builder_append(into, string_make((char*) (void*) &record, isizeof record));
+            builder_append(into, type_name);
+            builder_append(into, name);
+        }
+    }
+
+    EXTERNAL isize allocator_stats_deserialize(String data, Allocator_Stats_Node_Array* nodes, String_Builder* names, i64* time_or_null)
+    {
+        _Allocator_Stats_Header header = {0};
+        if(data.count < isizeof header)
+            return 0;
+
+        //Byte swapped magic means the data was written on machine with different endianness. We dont convert.
+        memcpy(&header, data.data, sizeof header);
+        if(header.magic != ALLOCATOR_STATS_MAGIC || header.version != ALLOCATOR_STATS_VERSION || header.node_count < 0)
+            return 0;
+
+        //First pass validates the data and sums up the name sizes so that the names
+        // builder does not reallocate while we point into it
+        isize names_size = 0;
+        isize offset = isizeof header;
+        for(i64 i = 0; i < header.node_count; i++)
+        {
+            _Allocator_Stats_Record record = {0};
+            if(data.count - offset < isizeof record)
+                return 0;
+
+            memcpy(&record, data.data + offset, sizeof record);
+            offset += isizeof record + record.type_name_len + record.name_len;
+            names_size += record.type_name_len + record.name_len + 2;
+            if(offset > data.count || record.parent < -1 || record.parent >= i)
+                return 0;
+        }
+
+        if(nodes->allocator == NULL)
+            array_init(nodes, allocator_get_default());
+
+        builder_clear(names);
+        builder_reserve(names, names_size);
+        array_clear(nodes);
+        array_reserve(nodes, header.node_count);
+
+        offset = isizeof header;
+        for(i64 i = 0; i < header.node_count; i++)
+        {
+            _Allocator_Stats_Record record = {0};
+            memcpy(&record, data.data + offset, sizeof record);
+            offset += isizeof record;
+
+            Allocator_Stats_Node node = {0};
+            node.parent = record.parent;
+            node.depth = record.depth;
+            node.first_child = -1;
+            node.next_sibling = -1;
+            node.is_registered = !!(record.flags & _ALLOCATOR_STATS_REGISTERED);
+            node.stats.is_top_level = !!(record.flags & _ALLOCATOR_STATS_TOP_LEVEL);
+            node.stats.is_growing = !!(record.flags & _ALLOCATOR_STATS_GROWING);
+            node.stats.is_capable_of_resize = !!(record.flags & _ALLOCATOR_STATS_RESIZE);
+            node.stats.is_capable_of_free_all = !!(record.flags & _ALLOCATOR_STATS_FREE_ALL);
+            node.stats.fixed_memory_pool_size = record.fixed_memory_pool_size;
+            node.stats.bytes_allocated = record.bytes_allocated;
+            node.stats.max_bytes_allocated = record.max_bytes_allocated;
+            node.stats.max_concurent_allocations = record.max_concurent_allocations;
+            node.stats.allocation_count = record.allocation_count;
+            node.stats.deallocation_count = record.deallocation_count;
+            node.stats.reallocation_count = record.reallocation_count;
+
+            node.stats.type_name = names->data + names->count;
+            builder_append(names, string_make(data.data + offset, record.type_name_len));
+            builder_push(names, '\0');
+            offset += record.type_name_len;
+
+            node.stats.name = names->data + names->count;
+            builder_append(names, string_make(data.data + offset, record.name_len));
+            builder_push(names, '\0');
+            offset += record.name_len;
+
+            array_push(nodes, node);
+        }
+
+        for(isize i = nodes->count; i-- > 0; )
+        {
+            Allocator_Stats_Node* node = &nodes->data[i];
+            if(node->parent != -1)
+            {
+                Allocator_Stats_Node* parent = &nodes->data[node->parent];
+                node->next_sibling = parent->first_child;
+                parent->first_child = (i32) i;
+                parent->children_bytes_allocated += node->stats.bytes_allocated;
+            }
+        }
+
+        if(time_or_null)
+            *time_or_null = header.time;
+        return offset;
+    }
+
+#endif
@@ -166,6 +166,26 @@
 //   This "test" variant is available in even release builds but is not called internally. 
 //   The other kind is _tlsf_check_[thing]_invariants() which is a simple wrapper around the test variant. 
 //   This wrapper is used internally upon entry/exit of each function and gets turned into a noop in release builds.
+//
+// - Small allocations are expensive relative to their size. Each one consumes a whole 24B node, a 4B header 
+//   and goes through the bin search and in memory order relinking. For this reason tlsf_malloc optionally has a
+//   small object tier (see tlsf_set_small_tier()). Allocations up to TLSF_SMALL_MAX_SIZE are rounded up to one of
+//   TLSF_SMALL_CLASSES size classes. Each class has a list of TLSF_SMALL_PAGE_SIZE pages with free chunks.
+//   The pages themselves are just ordinary tlsf allocations aligned to their size. Each page starts with a header 
+//   holding a bitmap of its free chunks. 
+//
+//   page (aligned to TLSF_SMALL_PAGE_SIZE)
+//   |--------------------------------------|
+//   | free_mask | next/prev | ... |  TAG   | chunk  |  TAG   | chunk  |  TAG   | chunk  | ...
+//   |--------------------------------------|--------------------------------------------------
+//                                          ^ ptr             ^ ptr             ^ ptr
+//
+//   Allocation finds the first set bit in the first page of the class (at most TLSF_SMALL_PAGE_MASKS ffs operations)
+//   and deallocation aligns the pointer down to get its page, thus both are still O(1). The 4 bytes before each
+//   chunk (where tlsf_malloc normally stores the node index) hold TLSF_SMALL_TAG so that tlsf_free can tell which kind
+//   of allocation it was given. This brings the overhead of small allocations to mere 4B with no nodes used.
+//   Once a page becomes entirely free its returned, unless its the last page with free chunks in its class.
+//   This prevents repeatedly allocating and freeing pages when a single allocation is allocated and freed in a loop.
 
 #include <string.h>
 #include <stdint.h>
@@ -203,6 +223,14 @@
 #define TLSF_INVALID        0xFFFFFFFF //used internally to signal missing. As user you never have to think about this.
 #define TLSF_MAGIC          0x46534C54 //"TLSF" in ascii little endian. Placed before malloc blocks in debug builds to detect overflows.
 
+#define TLSF_SMALL_MAX_SIZE     256  //Biggest allocation served by the small object tier
+#define TLSF_SMALL_MAX_ALIGN    16   //Biggest alignment served by the small object tier
+#define TLSF_SMALL_PAGE_SIZE    4096 //Size and alignment of the pages the small object tier carves chunks from
+#define TLSF_SMALL_HEADER_SIZE  64   //Size of the page header. Chunks start right after it.
+#define TLSF_SMALL_CLASSES      13
+#define TLSF_SMALL_PAGE_MASKS   4    //Enough for (TLSF_SMALL_PAGE_SIZE - TLSF_SMALL_HEADER_SIZE)/16 chunks
+#define TLSF_SMALL_TAG          0xFFFFFFFE //Placed before each small chunk in place of the node index. Marks the chunk as small.
+
 #define TLSF_BIN_MANTISSA_LOG2  3
 #define TLSF_BIN_MANTISSA_SIZE  ((uint32_t) 1 << TLSF_BIN_MANTISSA_LOG2)
 #define TLSF_BIN_MANTISSA_MASK  (TLSF_BIN_MANTISSA_SIZE - 1)
@@ -268,6 +296,14 @@ typedef struct Tlsf_Allocator {
     //That is the size of the bin the failed allocation belongs to.
     isize    last_fail_needed_size; 
     uint64_t last_fail_reason; //combination of the TLSF_FAIL_REASON_XXX flags.
+
+    //Small object tier. See tlsf_set_small_tier().
+    bool     small_tier_enabled;
+    uint32_t small_page_count;
+    isize    small_allocation_count;
+    isize    small_deallocation_count;
+    isize    small_bytes_allocated;
+    Tlsf_Size small_first_page[TLSF_SMALL_CLASSES]; //offset of the first page with free chunks for each size class or TLSF_INVALID
 } Tlsf_Allocator;
 
 //Initializes the allocator. `memory_or_null` can be NULL in which case the allocator can only be used with the tlsf_allocate/tlsf_deallocate
@@ -280,6 +316,18 @@ EXTERNAL void     tlsf_grow_memory(Tlsf_Allocator* allocator, void* new_memory,
 //Grows available node capacity
 EXTERNAL void     tlsf_grow_nodes(Tlsf_Allocator* allocator, void* new_node_memory, isize new_node_memory_size);
 
+//Called by tlsf_defragment() for each moved allocation. The user is responsible for moving the `size` bytes 
+// of data from `old_offset` to `new_offset` (the ranges can overlap, new_offset is always smaller) and updating 
+// whatever was referencing the allocation. The node handle stays the same.
+typedef void (*Tlsf_Move_Func)(void* context, uint32_t node, isize old_offset, isize new_offset, isize size);
+
+//Slides allocations towards the start of the memory block closing the free space between them. 
+// Goes through the allocations in memory order and stops once at least `budget_bytes` bytes were moved, 
+// thus can be called repeatedly (say once per frame) to incrementally compact the memory.
+// Each allocation is moved by a multiple of `align` which preserves any alignment up to `align`. 
+// Thus `align` should be the biggest alignment ever requested. Returns the number of bytes moved.
+EXTERNAL isize    tlsf_defragment(Tlsf_Allocator* allocator, isize budget_bytes, isize align, Tlsf_Move_Func move, void* context);
+
 //Allocates a `size` bytes of the potentially non local memory (ie. maybe on GPU) and returns an offset into the memory block. 
 //Aligns the returned `offset` so that `(offset + align_offset) % align == 0`.
 //Saves the allocated node handle into `node_output`. If fails to allocate returns 0 and saves 0 into `node_output`.
@@ -294,9 +342,19 @@ EXTERNAL void*    tlsf_malloc(Tlsf_Allocator* allocator, isize size, isize align
 //Frees an allocation represented by a `ptr` obtained from tlsf_malloc. if `ptr` is NULL does not do anything.
 EXTERNAL void     tlsf_free(Tlsf_Allocator* allocator, void* ptr);
 
+//Enables or disables the small object tier for tlsf_malloc. When enabled allocations of at most TLSF_SMALL_MAX_SIZE bytes
+// aligned to at most TLSF_SMALL_MAX_ALIGN (and with align_offset == 0) are served from size class pages instead of 
+// getting their own node. tlsf_free handles both kinds regardless of this setting. Pages are ordinary tlsf allocations
+// thus while there are any, tlsf_defragment() cannot be used and tlsf_grow_memory() must keep the memory aligned
+// to TLSF_SMALL_PAGE_SIZE the same way.
+EXTERNAL void     tlsf_set_small_tier(Tlsf_Allocator* allocator, bool enabled);
+//Returns the empty pages the small object tier keeps around to avoid repeatedly allocating and freeing a page.
+EXTERNAL void     tlsf_trim_small_pages(Tlsf_Allocator* allocator);
+
 //Returns the size of the given node. If the `node_i` is invalid returns 0. If the `node_i` was freed returns 0xFFFFFFFF.
 EXTERNAL isize    tlsf_node_size(Tlsf_Allocator* allocator, uint32_t node_i);
 //Returns a node of the allocation done by calling tlsf_malloc. If `ptr` is NULL returns 0. 
+// For allocations from the small object tier returns the node of the page containing it.
 EXTERNAL uint32_t tlsf_get_node(Tlsf_Allocator* allocator, void* ptr); 
 
 EXTERNAL int32_t  tlsf_bin_index_from_size(isize size, bool round_up);
@@ -330,6 +388,11 @@ EXTERNAL void tlsf_test_node_invariants(Tlsf_Allocator* allocator, uint32_t node
         _BitScanForward64(&out, (unsigned long long) num);
         return (int32_t) out;
     }
+
+    INTERNAL int32_t _tlsf_pop_count64(uint64_t num)
+    {
+        return (int32_t) __popcnt64((unsigned __int64) num);
+    }
     
     #define TLSF_INLINE_NEVER  __declspec(noinline)
 #elif defined(__GNUC__) || defined(__clang__)
@@ -345,6 +408,11 @@ EXTERNAL void tlsf_test_node_invariants(Tlsf_Allocator* allocator, uint32_t node
         return __builtin_ffsll((long long) num) - 1;
     }
 
+    INTERNAL int32_t _tlsf_pop_count64(uint64_t num)
+    {
+        return __builtin_popcountll((unsigned long long) num);
+    }
+
     #define TLSF_INLINE_NEVER   __attribute__((noinline))
 #else
     #error unsupported compiler!
@@ -627,6 +695,8 @@ EXTERNAL void tlsf_grow_memory(Tlsf_Allocator* allocator, void* new_memory, isiz
 {
     _tlsf_check_invariants(allocator);
     ASSERT(new_memory_size >= allocator->memory_size && (new_memory != NULL || allocator->memory == NULL));
+    ASSERT(allocator->small_page_count == 0 || (uintptr_t) new_memory % TLSF_SMALL_PAGE_SIZE == (uintptr_t) allocator->memory % TLSF_SMALL_PAGE_SIZE, 
+        "small object tier pages would get misaligned");
     
     //copy over allocation memory (if both are present and the pointer changed)
     if(new_memory && allocator->memory && new_memory != allocator->memory)
@@ -665,6 +735,7 @@ EXTERNAL void tlsf_grow_nodes(Tlsf_Allocator* allocator, void* new_node_memory,
 
     isize new_node_capacity = new_node_memory_size / sizeof(Tlsf_Node);
     ASSERT(new_node_capacity >= allocator->node_capacity && new_node_memory != NULL);
+    ASSERT(new_node_capacity < TLSF_SMALL_TAG);
 
     //copy over node memory
     if(new_node_memory != allocator->nodes)
@@ -689,6 +760,70 @@ EXTERNAL void tlsf_grow_nodes(Tlsf_Allocator* allocator, void* new_node_memory,
     _tlsf_check_invariants(allocator);
 }
 
+//Defragmentation works by moving each node back over the free space in front of it. 
+// Since the free space is implicit this only means changing the offset of the node,
+// and relinking it and its next node into bins of their new free sizes. All else stays the same.
+//
+//  [####] <--> [_______####] <--> [___######] 
+//                   |                  |
+//                   | move `####` back
+//                   V   
+//  [####] <--> [####] <--> [__________######] 
+//                                      |
+//
+// We always go from the start of memory. That way the already compacted nodes at the start 
+// have no free space and are merely walked over. Its thus unnecessary to remember where we have stopped.
+EXTERNAL isize tlsf_defragment(Tlsf_Allocator* allocator, isize budget_bytes, isize align, Tlsf_Move_Func move, void* context)
+{
+    ASSERT(move != NULL);
+    ASSERT(_tlsf_is_pow2_or_zero(align) && align > 0);
+    ASSERT(allocator->small_page_count == 0, "cannot move small object tier pages");
+    _tlsf_check_invariants(allocator);
+
+    isize moved = 0;
+    Tlsf_Size align_mask = (Tlsf_Size) align - 1;
+    for(uint32_t node_i = allocator->nodes[TLSF_FIRST_NODE].next; node_i != TLSF_LAST_NODE && moved < budget_bytes; )
+    {
+        _tlsf_check_node(allocator, node_i, TLSF_CHECK_USED);
+        Tlsf_Node* __restrict node = &allocator->nodes[node_i]; 
+        Tlsf_Node* __restrict prev = &allocator->nodes[node->prev];
+        Tlsf_Node* __restrict next = &allocator->nodes[node->next];
+
+        Tlsf_Size node_unused = node->offset - (prev->offset + prev->size);
+        Tlsf_Size shift = node_unused & ~align_mask;
+        if(shift > 0)
+        {
+            Tlsf_Size old_next_unused = next->offset - (node->offset + node->size);
+            Tlsf_Size new_next_unused = old_next_unused + shift;
+            Tlsf_Size new_node_unused = node_unused - shift;
+
+            if(node_unused >= TLSF_MIN_SIZE)
+                _tlsf_unlink_node_in_bin(allocator, node_i, tlsf_bin_index_from_size(node_unused, false));
+            node->next_in_bin = TLSF_INVALID;
+            node->prev_in_bin = TLSF_INVALID;
+            if(new_node_unused >= TLSF_MIN_SIZE)
+                _tlsf_link_node_in_bin(allocator, node_i, tlsf_bin_index_from_size(new_node_unused, false));
+
+            if(old_next_unused >= TLSF_MIN_SIZE)
+                _tlsf_unlink_node_in_bin(allocator, node->next, tlsf_bin_index_from_size(old_next_unused, false));
+            next->next_in_bin = TLSF_INVALID;
+            next->prev_in_bin = TLSF_INVALID;
+            if(new_next_unused >= TLSF_MIN_SIZE)
+                _tlsf_link_node_in_bin(allocator, node->next, tlsf_bin_index_from_size(new_next_unused, false));
+
+            isize old_offset = node->offset;
+            node->offset -= shift;
+            move(context, node_i, old_offset, node->offset, node->size);
+            moved += node->size;
+        }
+
+        node_i = node->next;
+    }
+    
+    _tlsf_check_invariants(allocator);
+    return moved;
+}
+
 #ifdef MODULE_ALLOCATOR
     INTERNAL void* _tlsf_allocator_func(Allocator* self, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error)
     {
@@ -744,6 +879,7 @@ EXTERNAL bool tlsf_init(Tlsf_Allocator* allocator, void* memory_or_null, isize m
     isize node_capacity = node_memory_size / sizeof(Tlsf_Node);
     if(node_memory == NULL || node_capacity < 2)
         return false;
+    ASSERT(node_capacity < TLSF_SMALL_TAG);
         
     allocator->nodes = (Tlsf_Node*) node_memory;
     allocator->memory = (uint8_t*) memory_or_null;
@@ -758,6 +894,8 @@ EXTERNAL bool tlsf_init(Tlsf_Allocator* allocator, void* memory_or_null, isize m
     
     memset(allocator->nodes, TLSF_INVALID, (size_t) node_capacity*sizeof(Tlsf_Node));
     memset(allocator->bin_first_free, TLSF_INVALID, sizeof allocator->bin_first_free);
+    for(int32_t i = 0; i < TLSF_SMALL_CLASSES; i++)
+        allocator->small_first_page[i] = TLSF_INVALID;
 
     allocator->node_first_free = TLSF_INVALID;
     for(uint32_t i = allocator->node_capacity; i-- > 0;)
@@ -807,7 +945,9 @@ EXTERNAL bool tlsf_init(Tlsf_Allocator* allocator, void* memory_or_null, isize m
 
 EXTERNAL void tlsf_reset(Tlsf_Allocator* allocator)
 {
-    tlsf_init(allocator, allocator->memory, allocator->memory_size, allocator->nodes, allocator->node_capacity);
+    bool small_tier_enabled = allocator->small_tier_enabled;
+    tlsf_init(allocator, allocator->memory, allocator->memory_size, allocator->nodes, (isize) (allocator->node_capacity*sizeof(Tlsf_Node)));
+    allocator->small_tier_enabled = small_tier_enabled;
 }
 
 EXTERNAL isize tlsf_allocate(Tlsf_Allocator* allocator, uint32_t* node_output, isize size, isize align, isize align_offset)
@@ -827,6 +967,202 @@ EXTERNAL isize tlsf_allocate(Tlsf_Allocator* allocator, uint32_t* node_output, i
     return _tlsf_allocate(allocator, size, align, align_offset, false, node_output);
 }
 
+typedef struct _Tlsf_Small_Page {
+    uint64_t free_mask[TLSF_SMALL_PAGE_MASKS]; //set bit means the chunk is free
+    Tlsf_Size next; //offset of the next page with free chunks in this class or TLSF_INVALID
+    Tlsf_Size prev; //offset of the prev page with free chunks in this class or TLSF_INVALID
+    uint32_t node;  //node of the tlsf allocation of this page
+    uint16_t used;  //number of allocated chunks
+    uint8_t class_i;
+    uint8_t is_linked; //whether is in the class list
+} _Tlsf_Small_Page;
+
+//Strides of chunks in each class. Chunk of stride S fits (S - 4) bytes because of the tag.
+static const uint16_t _tlsf_small_class_strides[TLSF_SMALL_CLASSES] = {16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+
+//Maps DIV_CEIL(size + 4, 16) to the smallest class which fits it
+static const uint8_t _tlsf_small_class_from_granule[(TLSF_SMALL_MAX_SIZE + 4 + 15)/16 + 1] = {0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12};
+
+INTERNAL isize _tlsf_small_capacity(int32_t class_i)
+{
+    return (TLSF_SMALL_PAGE_SIZE - TLSF_SMALL_HEADER_SIZE)/_tlsf_small_class_strides[class_i];
+}
+
+INTERNAL bool _tlsf_small_is_small(void* ptr)
+{
+    uint32_t tag = 0;
+    memcpy(&tag, (uint8_t*) ptr - sizeof(uint32_t), sizeof(uint32_t));
+    return tag == TLSF_SMALL_TAG;
+}
+
+INTERNAL _Tlsf_Small_Page* _tlsf_small_page(Tlsf_Allocator* allocator, Tlsf_Size page_offset)
+{
+    ASSERT(page_offset != TLSF_INVALID && page_offset + TLSF_SMALL_PAGE_SIZE <= allocator->memory_size);
+    return (_Tlsf_Small_Page*) (void*) (allocator->memory + page_offset);
+}
+
+INTERNAL void _tlsf_small_link_page(Tlsf_Allocator* allocator, _Tlsf_Small_Page* page)
+{
+    ASSERT(page->is_linked == false);
+    Tlsf_Size page_offset = (Tlsf_Size) ((uint8_t*) page - allocator->memory);
+    Tlsf_Size* first = &allocator->small_first_page[page->class_i];
+    if(*first != TLSF_INVALID)
+        _tlsf_small_page(allocator, *first)->prev = page_offset;
+
+    page->next = *first;
+    page->prev = TLSF_INVALID;
+    page->is_linked = true;
+    *first = page_offset;
+}
+
+INTERNAL void _tlsf_small_unlink_page(Tlsf_Allocator* allocator, _Tlsf_Small_Page* page)
+{
+    ASSERT(page->is_linked);
+    if(page->prev != TLSF_INVALID)
+        _tlsf_small_page(allocator, page->prev)->next = page->next;
+    else
+        allocator->small_first_page[page->class_i] = page->next;
+
+    if(page->next != TLSF_INVALID)
+        _tlsf_small_page(allocator, page->next)->prev = page->prev;
+
+    page->next = TLSF_INVALID;
+    page->prev = TLSF_INVALID;
+    page->is_linked = false;
+}
+
+INTERNAL _Tlsf_Small_Page* _tlsf_small_page_push(Tlsf_Allocator* allocator, int32_t class_i)
+{
+    uint32_t node = 0;
+    isize offset = _tlsf_allocate(allocator, TLSF_SMALL_PAGE_SIZE, TLSF_SMALL_PAGE_SIZE, 0, true, &node);
+    if(node == 0)
+        return NULL;
+
+    _Tlsf_Small_Page* page = (_Tlsf_Small_Page*) (void*) (allocator->memory + offset);
+    ASSERT((uintptr_t) page % TLSF_SMALL_PAGE_SIZE == 0);
+    memset(page, 0, sizeof *page);
+    page->node = node;
+    page->class_i = (uint8_t) class_i;
+
+    //Mark all chunks free and write the tags in front of them
+    isize stride = _tlsf_small_class_strides[class_i];
+    isize capacity = _tlsf_small_capacity(class_i);
+    uint32_t tag = TLSF_SMALL_TAG;
+    for(isize i = 0; i < capacity; i++)
+    {
+        page->free_mask[i/64] |= (uint64_t) 1 << (i%64);
+        memcpy((uint8_t*) page + TLSF_SMALL_HEADER_SIZE + i*stride - sizeof(uint32_t), &tag, sizeof(uint32_t));
+    }
+
+    _tlsf_small_link_page(allocator, page);
+    allocator->small_page_count += 1;
+    return page;
+}
+
+INTERNAL void _tlsf_small_page_pop(Tlsf_Allocator* allocator, _Tlsf_Small_Page* page)
+{
+    ASSERT(page->used == 0);
+    _tlsf_small_unlink_page(allocator, page);
+    allocator->small_page_count -= 1;
+    tlsf_deallocate(allocator, page->node);
+}
+
+INTERNAL void* _tlsf_small_malloc(Tlsf_Allocator* allocator, isize size)
+{
+    ASSERT(0 < size && size <= TLSF_SMALL_MAX_SIZE);
+    int32_t class_i = _tlsf_small_class_from_granule[(size + sizeof(uint32_t) + 15)/16];
+    _Tlsf_Small_Page* page = NULL;
+    if(allocator->small_first_page[class_i] != TLSF_INVALID)
+        page = _tlsf_small_page(allocator, allocator->small_first_page[class_i]);
+    else
+    {
+        page = _tlsf_small_page_push(allocator, class_i);
+        if(page == NULL)
+            return NULL;
+    }
+
+    isize chunk_i = -1;
+    for(isize i = 0; i < TLSF_SMALL_PAGE_MASKS; i++)
+        if(page->free_mask[i])
+        {
+            int32_t bit = _tlsf_find_first_set_bit64(page->free_mask[i]);
+            page->free_mask[i] &= ~((uint64_t) 1 << bit);
+            chunk_i = i*64 + bit;
+            break;
+        }
+
+    //Pages without free chunks are never linked
+    ASSERT(chunk_i != -1);
+    page->used += 1;
+    if(page->used == _tlsf_small_capacity(class_i))
+        _tlsf_small_unlink_page(allocator, page);
+
+    isize stride = _tlsf_small_class_strides[class_i];
+    allocator->small_allocation_count += 1;
+    allocator->small_bytes_allocated += stride;
+
+    uint8_t* ptr = (uint8_t*) page + TLSF_SMALL_HEADER_SIZE + chunk_i*stride;
+    ASSERT(_tlsf_small_is_small(ptr));
+    #ifdef TLSF_DEBUG
+        memset(ptr, 0x55, size);
+    #endif
+    return ptr;
+}
+
+INTERNAL _Tlsf_Small_Page* _tlsf_small_page_of(void* ptr)
+{
+    return (_Tlsf_Small_Page*) (void*) ((uintptr_t) ptr & ~(uintptr_t) (TLSF_SMALL_PAGE_SIZE - 1));
+}
+
+INTERNAL void _tlsf_small_free(Tlsf_Allocator* allocator, void* ptr)
+{
+    _Tlsf_Small_Page* page = _tlsf_small_page_of(ptr);
+    ASSERT(page->class_i < TLSF_SMALL_CLASSES && page->used > 0);
+    ASSERT(allocator->nodes[page->node].offset == (Tlsf_Size) ((uint8_t*) page - allocator->memory));
+
+    isize stride = _tlsf_small_class_strides[page->class_i];
+    isize from_start = (uint8_t*) ptr - (uint8_t*) page - TLSF_SMALL_HEADER_SIZE;
+    isize chunk_i = from_start/stride;
+    uint64_t bit = (uint64_t) 1 << (chunk_i%64);
+    //If Crash occurred here it most likely means you have double free or invalid pointer!
+    ASSERT(from_start % stride == 0 && chunk_i < _tlsf_small_capacity(page->class_i));
+    ASSERT((page->free_mask[chunk_i/64] & bit) == 0);
+
+    page->free_mask[chunk_i/64] |= bit;
+    if(page->is_linked == false)
+        _tlsf_small_link_page(allocator, page);
+    page->used -= 1;
+
+    allocator->small_deallocation_count += 1;
+    allocator->small_bytes_allocated -= stride;
+
+    //Keep the page if its the only one left with free chunks
+    if(page->used == 0 && (page->next != TLSF_INVALID || page->prev != TLSF_INVALID))
+        _tlsf_small_page_pop(allocator, page);
+}
+
+EXTERNAL void tlsf_set_small_tier(Tlsf_Allocator* allocator, bool enabled)
+{
+    ASSERT(enabled == false || allocator->memory != NULL, "small object tier requires memory block");
+    allocator->small_tier_enabled = enabled;
+}
+
+EXTERNAL void tlsf_trim_small_pages(Tlsf_Allocator* allocator)
+{
+    _tlsf_check_invariants(allocator);
+    for(int32_t class_i = 0; class_i < TLSF_SMALL_CLASSES; class_i++)
+    {
+        Tlsf_Size first = allocator->small_first_page[class_i];
+        if(first != TLSF_INVALID)
+        {
+            _Tlsf_Small_Page* page = _tlsf_small_page(allocator, first);
+            if(page->used == 0)
+                _tlsf_small_page_pop(allocator, page);
+        }
+    }
+    _tlsf_check_invariants(allocator);
+}
+
 EXTERNAL void* tlsf_malloc(Tlsf_Allocator* allocator, isize size, isize align, isize align_offset)
 {
     ASSERT(allocator);
@@ -836,7 +1172,11 @@ EXTERNAL void* tlsf_malloc(Tlsf_Allocator* allocator, isize size, isize align, i
     ASSERT(allocator->memory);
 
     uint8_t* ptr = NULL;
-    if(size > 0)
+    if(allocator->small_tier_enabled && 0 < size && size <= TLSF_SMALL_MAX_SIZE && align <= TLSF_SMALL_MAX_ALIGN && align_offset == 0)
+        ptr = (uint8_t*) _tlsf_small_malloc(allocator, size);
+    
+    //If we failed to get a page fall back to an ordinary allocation which might still fit
+    if(ptr == NULL && size > 0)
     {
         #ifdef TLSF_DEBUG
             uint32_t magic = TLSF_MAGIC;
@@ -871,6 +1211,9 @@ EXTERNAL uint32_t tlsf_get_node(Tlsf_Allocator* allocator, void* ptr)
     if(ptr == NULL)
         return 0;
         
+    if(_tlsf_small_is_small(ptr))
+        return _tlsf_small_page_of(ptr)->node;
+
     //If Crash occurred here it most likely means you have buffer overwrite somewhere!
     uint32_t node_i = 0;
     #ifdef TLSF_DEBUG
@@ -895,8 +1238,17 @@ EXTERNAL uint32_t tlsf_get_node(Tlsf_Allocator* allocator, void* ptr)
 
 EXTERNAL void tlsf_free(Tlsf_Allocator* allocator, void* ptr)
 {
-    uint32_t node = tlsf_get_node(allocator, ptr);
-    tlsf_deallocate(allocator, node);
+    if(ptr && _tlsf_small_is_small(ptr))
+    {
+        _tlsf_check_invariants(allocator);
+        _tlsf_small_free(allocator, ptr);
+        _tlsf_check_invariants(allocator);
+    }
+    else
+    {
+        uint32_t node = tlsf_get_node(allocator, ptr);
+        tlsf_deallocate(allocator, node);
+    }
 }
 
 EXTERNAL isize tlsf_node_size(Tlsf_Allocator* allocator, uint32_t node_i)
@@ -1060,6 +1412,43 @@ EXTERNAL void tlsf_test_invariants(Tlsf_Allocator* allocator, uint32_t flags)
         TEST(allocator->node_capacity == nodes_counted + nodes_in_free_list);
         int vs_debugger_stupid = 0; (void) vs_debugger_stupid;
     }
+
+    //Check small object tier pages with free chunks. Full pages are not reachable.
+    TEST(allocator->small_deallocation_count <= allocator->small_allocation_count);
+    TEST(allocator->small_bytes_allocated >= 0);
+    TEST(allocator->small_page_count == 0 || allocator->memory != NULL);
+    if(flags & TLSF_CHECK_ALL_NODES)
+    {
+        uint32_t pages_counted = 0;
+        for(int32_t class_i = 0; class_i < TLSF_SMALL_CLASSES; class_i++)
+        {
+            Tlsf_Size prev_offset = TLSF_INVALID;
+            for(Tlsf_Size page_offset = allocator->small_first_page[class_i]; page_offset != TLSF_INVALID; pages_counted++)
+            {
+                TEST(pages_counted < allocator->small_page_count);
+                TEST(page_offset + TLSF_SMALL_PAGE_SIZE <= allocator->memory_size);
+
+                _Tlsf_Small_Page* page = (_Tlsf_Small_Page*) (void*) (allocator->memory + page_offset);
+                TEST((uintptr_t) page % TLSF_SMALL_PAGE_SIZE == 0);
+                TEST(page->class_i == class_i);
+                TEST(page->is_linked);
+                TEST(page->prev == prev_offset);
+                TEST(page->node > TLSF_LAST_NODE && page->node < allocator->node_capacity);
+                TEST(allocator->nodes[page->node].offset == page_offset);
+                TEST(allocator->nodes[page->node].size == TLSF_SMALL_PAGE_SIZE);
+
+                isize capacity = _tlsf_small_capacity(class_i);
+                isize free_count = 0;
+                for(isize i = 0; i < TLSF_SMALL_PAGE_MASKS; i++)
+                    free_count += _tlsf_pop_count64(page->free_mask[i]);
+                TEST(page->used < capacity);
+                TEST(free_count == capacity - page->used);
+
+                prev_offset = page_offset;
+                page_offset = page->next;
+            }
+        }
+    }
 }
 
 INTERNAL void _tlsf_check_node(Tlsf_Allocator* allocator, uint32_t node_i, uint32_t flags)
@@ -1177,9 +1566,97 @@ INTERNAL double _tlsf_random_interval(double from, double to)
     return (to - from)*random + from;
 }
 
-void test_allocator_tlsf_stress(double seconds, isize at_once)
+void test_tlsf_small_unit()
+{
+    enum {NODES = 256, SMALL_ALLOCS = 4000};
+    isize memory_size = 4*1024*1024;
+    isize node_memory_size = NODES*sizeof(Tlsf_Node);
+    void* memory = malloc(memory_size);
+    void* nodes = malloc(node_memory_size);
+    uint8_t** ptrs = (uint8_t**) malloc(SMALL_ALLOCS*sizeof(uint8_t*));
+
+    Tlsf_Allocator allocator = {0};
+    TEST(tlsf_init(&allocator, memory, memory_size, nodes, node_memory_size));
+    tlsf_set_small_tier(&allocator, true);
+
+    //Many more small allocations than there are nodes
+    for(isize i = 0; i < SMALL_ALLOCS; i++)
+    {
+        isize size = _tlsf_random_range(1, TLSF_SMALL_MAX_SIZE + 1);
+        isize align = (isize) 1 << _tlsf_random_range(0, 5);
+        ptrs[i] = (uint8_t*) tlsf_malloc(&allocator, size, align, 0);
+        TEST(ptrs[i] != NULL);
+        TEST((uintptr_t) ptrs[i] % (uintptr_t) align == 0);
+        memset(ptrs[i], (uint8_t) i, size);
+        ptrs[i][0] = (uint8_t) size;
+    }
+    tlsf_test_invariants(&allocator, TLSF_CHECK_DETAILED | TLSF_CHECK_ALL_NODES);
+    TEST(allocator.small_allocation_count == SMALL_ALLOCS);
+    TEST(allocator.node_count == allocator.small_page_count + 2);
+
+    //Big and overaligned allocations still go through nodes
+    void* big = tlsf_malloc(&allocator, TLSF_SMALL_MAX_SIZE + 1, 8, 0);
+    void* overaligned = tlsf_malloc(&allocator, 8, 64, 0);
+    TEST(big && overaligned && (uintptr_t) overaligned % 64 == 0);
+    TEST(allocator.node_count == allocator.small_page_count + 4);
+    tlsf_free(&allocator, big);
+    tlsf_free(&allocator, overaligned);
+
+    for(isize i = 0; i < SMALL_ALLOCS; i++)
+    {
+        isize size = ptrs[i][0];
+        if(size > 1)
+            TEST(memtest(ptrs[i] + 1, (uint8_t) i, size - 1));
+        tlsf_free(&allocator, ptrs[i]);
+        if(i % 128 == 0)
+            tlsf_test_invariants(&allocator, TLSF_CHECK_DETAILED | TLSF_CHECK_ALL_NODES);
+    }
+
+    //At most one empty page per class is kept around
+    TEST(allocator.small_bytes_allocated == 0);
+    TEST(allocator.small_page_count <= TLSF_SMALL_CLASSES);
+
+    //Alloc/free in a loop reuses the same kept page
+    uint32_t page_count = allocator.small_page_count;
+    for(isize i = 0; i < 100; i++)
+    {
+        void* ptr = tlsf_malloc(&allocator, 24, 8, 0);
+        TEST(ptr != NULL);
+        tlsf_free(&allocator, ptr);
+        TEST(allocator.small_page_count == page_count);
+    }
+
+    tlsf_trim_small_pages(&allocator);
+    tlsf_test_invariants(&allocator, TLSF_CHECK_DETAILED | TLSF_CHECK_ALL_NODES);
+    TEST(allocator.small_page_count == 0);
+    TEST(allocator.bytes_allocated == 0);
+    TEST(allocator.node_count == 2);
+
+    //Running out of nodes for pages falls back to ordinary allocations which also fail cleanly
+    tlsf_reset(&allocator);
+    TEST(allocator.small_tier_enabled);
+    isize allocated = 0;
+    for(; allocated < SMALL_ALLOCS; allocated++)
+    {
+        ptrs[allocated] = (uint8_t*) tlsf_malloc(&allocator, TLSF_SMALL_MAX_SIZE, 16, 0);
+        if(ptrs[allocated] == NULL)
+            break;
+    }
+    TEST(allocator.last_fail_reason & TLSF_FAIL_REASON_NEED_MORE_NODES);
+    TEST(allocator.small_page_count == NODES - 2);
+    for(isize i = 0; i < allocated; i++)
+        tlsf_free(&allocator, ptrs[i]);
+    tlsf_trim_small_pages(&allocator);
+    TEST(allocator.node_count == 2);
+
+    free(ptrs);
+    free(nodes);
+    free(memory);
+}
+
+void test_allocator_tlsf_stress(double seconds, isize at_once, bool small_tier)
 {
-    printf("[TEST]: test_allocator_tlsf_stress(seconds:%lf, at_once:%lli)\n", seconds, (long long) at_once);
+    printf("[TEST]: test_allocator_tlsf_stress(seconds:%lf, at_once:%lli, small_tier:%i)\n", seconds, (long long) at_once, (int) small_tier);
 
     typedef struct {
         uint32_t size;
@@ -1194,7 +1671,8 @@ void test_allocator_tlsf_stress(double seconds, isize at_once)
     const double MAX_PERTURBATION = 0.2;
     
     isize memory_size = 256*1024*1024;
-    isize node_memory_size = (at_once + 2)*sizeof(Tlsf_Node);
+    //Each small page takes a node. There can be at most one page per small allocation plus one kept empty page per class.
+    isize node_memory_size = (at_once + 2 + (small_tier ? TLSF_SMALL_CLASSES : 0))*sizeof(Tlsf_Node);
 
     void* nodes = malloc(node_memory_size);
     void* memory = malloc(memory_size);
@@ -1203,6 +1681,7 @@ void test_allocator_tlsf_stress(double seconds, isize at_once)
 
     Tlsf_Allocator allocator = {0};
     TEST(tlsf_init(&allocator, memory, 0, nodes, 2*sizeof(Tlsf_Node)));
+    tlsf_set_small_tier(&allocator, small_tier);
 
     isize iter = 0;
     for(double start = _tlsf_clock_s(); _tlsf_clock_s() - start < seconds;)
@@ -1269,6 +1748,133 @@ void test_allocator_tlsf_stress(double seconds, isize at_once)
     free(memory);
 }
 
+typedef struct _Test_Tlsf_Defrag_Alloc {
+    uint32_t node;
+    uint32_t size;
+    uint32_t align;
+    uint32_t offset;
+} _Test_Tlsf_Defrag_Alloc;
+
+typedef struct _Test_Tlsf_Defrag_Context {
+    Tlsf_Allocator* allocator;
+    _Test_Tlsf_Defrag_Alloc* allocs;
+    uint32_t* node_to_alloc;
+    isize move_count;
+} _Test_Tlsf_Defrag_Context;
+
+INTERNAL void _test_tlsf_defragment_move(void* context, uint32_t node, isize old_offset, isize new_offset, isize size)
+{
+    _Test_Tlsf_Defrag_Context* c = (_Test_Tlsf_Defrag_Context*) context;
+    _Test_Tlsf_Defrag_Alloc* alloc = &c->allocs[c->node_to_alloc[node]];
+    TEST(alloc->node == node);
+    TEST(alloc->offset == old_offset);
+    TEST(alloc->size == size);
+    TEST(new_offset < old_offset);
+
+    memmove(c->allocator->memory + new_offset, c->allocator->memory + old_offset, (size_t) size);
+    alloc->offset = (uint32_t) new_offset;
+    c->move_count += 1;
+}
+
+void test_tlsf_defragment(double seconds)
+{
+    printf("[TEST]: test_tlsf_defragment(seconds:%lf)\n", seconds);
+    enum {
+        MAX_ALLOCS = 1000, 
+        MAX_SIZE = 2000, 
+        MAX_ALIGN_LOG2 = 7,
+        DEFRAG_ALIGN = 1 << (MAX_ALIGN_LOG2 - 1),
+    };
+    
+    isize memory_size = MAX_ALLOCS*(MAX_SIZE + (1 << MAX_ALIGN_LOG2));
+    isize node_memory_size = (MAX_ALLOCS + 2)*sizeof(Tlsf_Node);
+    uint8_t* memory = (uint8_t*) malloc(memory_size);
+    void* nodes = malloc(node_memory_size);
+    _Test_Tlsf_Defrag_Alloc* allocs = (_Test_Tlsf_Defrag_Alloc*) malloc(MAX_ALLOCS*sizeof(_Test_Tlsf_Defrag_Alloc));
+    uint32_t* node_to_alloc = (uint32_t*) malloc((MAX_ALLOCS + 2)*sizeof(uint32_t));
+
+    Tlsf_Allocator allocator = {0};
+    _Test_Tlsf_Defrag_Context context = {&allocator, allocs, node_to_alloc};
+    for(double start = _tlsf_clock_s(); _tlsf_clock_s() - start < seconds;)
+    {
+        TEST(tlsf_init(&allocator, memory, memory_size, nodes, node_memory_size));
+        
+        //Fill the memory and then free random allocations to create holes
+        isize alloc_count = 0;
+        for(; alloc_count < MAX_ALLOCS; alloc_count++)
+        {
+            _Test_Tlsf_Defrag_Alloc* alloc = &allocs[alloc_count];
+            alloc->size = (uint32_t) _tlsf_random_range(1, MAX_SIZE);
+            alloc->align = (uint32_t) 1 << _tlsf_random_range(0, MAX_ALIGN_LOG2);
+            alloc->offset = (uint32_t) tlsf_allocate(&allocator, &alloc->node, alloc->size, alloc->align, 0);
+            if(alloc->node == 0)
+                break;
+
+            node_to_alloc[alloc->node] = (uint32_t) alloc_count;
+            memset(memory + alloc->offset, (uint8_t) alloc->node, alloc->size);
+        }
+
+        isize free_chance = _tlsf_random_range(1, 10);
+        for(isize i = 0; i < alloc_count; i++)
+        {
+            if(_tlsf_random_range(0, 10) < free_chance)
+            {
+                tlsf_deallocate(&allocator, allocs[i].node);
+                allocs[i] = allocs[--alloc_count];
+                node_to_alloc[allocs[i].node] = (uint32_t) i;
+                i -= 1;
+            }
+        }
+
+        //Defragment in small steps checking everything stays where it should
+        isize budget = _tlsf_random_range(1, MAX_SIZE*10);
+        for(bool done = false; done == false; )
+        {
+            isize moved = tlsf_defragment(&allocator, budget, DEFRAG_ALIGN, _test_tlsf_defragment_move, &context);
+            //Moving less than the budget means we went through everything. Nothing is left to do.
+            if(moved < budget)
+            {
+                isize moves_before = context.move_count;
+                TEST(tlsf_defragment(&allocator, budget, DEFRAG_ALIGN, _test_tlsf_defragment_move, &context) == 0);
+                TEST(context.move_count == moves_before);
+                done = true;
+            }
+
+            tlsf_test_invariants(&allocator, TLSF_CHECK_DETAILED | TLSF_CHECK_ALL_NODES);
+            for(isize i = 0; i < alloc_count; i++)
+            {
+                _Test_Tlsf_Defrag_Alloc* alloc = &allocs[i];
+                TEST(allocator.nodes[alloc->node].offset == alloc->offset);
+                TEST(alloc->offset % alloc->align == 0);
+                TEST(memtest(memory + alloc->offset, (uint8_t) alloc->node, alloc->size));
+            }
+        }
+
+        //Once fully compacted no gap can be bigger than the alignment and all the remaining space is at the end
+        isize used = 0;
+        for(uint32_t node_i = allocator.nodes[TLSF_FIRST_NODE].next; node_i != TLSF_INVALID; node_i = allocator.nodes[node_i].next)
+        {
+            Tlsf_Node* node = &allocator.nodes[node_i];
+            Tlsf_Node* prev = &allocator.nodes[node->prev];
+            if(node_i != TLSF_LAST_NODE)
+                TEST(node->offset - (prev->offset + prev->size) < DEFRAG_ALIGN);
+            used = prev->offset + prev->size;
+        }
+
+        if(memory_size - used >= 4)
+        {
+            uint32_t big_node = 0;
+            tlsf_allocate(&allocator, &big_node, (memory_size - used)*3/4, 1, 0);
+            TEST(big_node != 0);
+        }
+    }
+
+    free(memory);
+    free(nodes);
+    free(allocs);
+    free(node_to_alloc);
+}
+
 void test_allocator_tlsf(double seconds)
 {
     for(int32_t i = 0; i < TLSF_BINS; i++)
@@ -1291,10 +1897,14 @@ void test_allocator_tlsf(double seconds)
     }
 
     test_tlsf_alloc_unit();
-    test_allocator_tlsf_stress(seconds/4, 1);
-    test_allocator_tlsf_stress(seconds/4, 10);
-    test_allocator_tlsf_stress(seconds/4, 100);
-    test_allocator_tlsf_stress(seconds/4, 200);
+    test_tlsf_small_unit();
+    test_allocator_tlsf_stress(seconds/7, 1, false);
+    test_allocator_tlsf_stress(seconds/7, 10, false);
+    test_allocator_tlsf_stress(seconds/7, 100, false);
+    test_allocator_tlsf_stress(seconds/7, 200, false);
+    test_allocator_tlsf_stress(seconds/7, 10, true);
+    test_allocator_tlsf_stress(seconds/7, 1000, true);
+    test_tlsf_defragment(seconds/7);
 
     printf("[TEST]: test_allocator_tlsf(%lf) success!\n", seconds);
 }
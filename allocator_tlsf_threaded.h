@@ -0,0 +1,645 @@
+#ifndef MODULE_ALLOCATOR_TLSF_THREADED
+#define MODULE_ALLOCATOR_TLSF_THREADED
+
+// A thread caching front end for Tlsf_Allocator.
+//
+// Tlsf_Allocator is single threaded. Using it as a process wide heap would require a single lock around every
+// tlsf_malloc/tlsf_free which serializes all threads and makes the lock cache line bounce between cores on
+// every single operation. This is what this file tries to solve while keeping the nice properties of TLSF
+// (owning the memory block, known maximum size, hard O(1) operations).
+//
+// The structure is the classic "thread cache + central heap" design (tcmalloc, mimalloc):
+//  1. There is one shared Tlsf_Allocator guarded by a mutex. It is only touched in batches.
+//  2. Each thread acquires a Tlsf_Thread_Cache. The cache has a singly linked free list per size class.
+//     Size classes are exactly the TLSF bins given by tlsf_bin_index_from_size(). Only sizes up to
+//     TLSF_THREADED_MAX_CACHED_SIZE are cached, bigger allocations go straight to the shared allocator.
+//  3. When the free list of a class is empty we lock the shared allocator once and allocate a whole batch
+//     of blocks of that class. When the free list grows over two batches worth of blocks we lock once and
+//     give a batch back. The batch size is such that it covers roughly TLSF_THREADED_BATCH_BYTES.
+//  4. Each block remembers which cache it was allocated from (its "owner"). When a block is freed
+//     by a different thread it is pushed onto the owners remote free queue (Sync_Queue from sync.h)
+//     instead of the freeing threads cache. The owner drains the queue once it needs to refill.
+//     This keeps blocks from slowly migrating into the caches of "consumer" threads in producer/consumer
+//     setups and also means the free lists are only ever touched by a single thread.
+//
+// Thus in the common case allocation and deallocation are a couple of instructions touching only
+// thread local memory. The lock is taken once per batch which makes it uncontended in practice
+// even with tens of threads.
+//
+// Each block is prefixed with 8B Tlsf_Threaded_Header containing the tlsf node, size class and owner.
+// All returned pointers are aligned to at least TLSF_THREADED_ALIGN. Allocations with bigger alignment
+// are not cached.
+//
+// Caches are not allocated by this allocator. Instead the user passes in an array of them upon init
+// (just like node memory is given to tlsf_init). A cache is acquired by a thread through tlsf_threaded_acquire_cache()
+// and released by tlsf_threaded_release_cache(). Releasing returns all cached blocks. Blocks allocated from a cache
+// can outlive its release - their remote frees simply wait in the queue until the cache is acquired by some other
+// thread or until tlsf_threaded_collect() is called.
+//
+// For convenience a cache can also be attached to the calling thread via tlsf_threaded_attach(). Then tlsf_threaded_malloc(),
+// tlsf_threaded_free() and the Allocator interface automatically use it. Threads without an attached cache still work, they
+// just go through the lock on every operation. Each thread must call tlsf_threaded_detach() before it exits. We dont
+// detach automatically through platform_thread_attach_deinit() because that registration cannot be undone, so the
+// callback could run after the cache was already detached or the allocator deinited.
+
+#include "allocator.h"
+#include "allocator_tlsf.h"
+#include "sync.h"
+
+#define TLSF_THREADED_ALIGN             16
+#define TLSF_THREADED_MIN_SIZE          16
+#define TLSF_THREADED_MAX_CACHED_SIZE   1024
+#define TLSF_THREADED_CACHE_BINS        65 //== tlsf_bin_index_from_size(TLSF_THREADED_MAX_CACHED_SIZE, true) + 1
+#define TLSF_THREADED_BATCH_BYTES       (16*1024)
+#define TLSF_THREADED_MIN_BATCH         4
+#define TLSF_THREADED_MAX_BATCH         128
+#define TLSF_THREADED_MAX_CACHES        UINT16_MAX
+#define TLSF_THREADED_NOT_CACHED        0xFF //Size class of blocks going directly to the shared allocator.
+#define TLSF_THREADED_MAGIC             0xA5
+
+typedef struct Tlsf_Threaded_Header {
+    uint32_t node;  //tlsf node of this block
+    uint8_t bin;    //size class or TLSF_THREADED_NOT_CACHED
+    uint8_t magic;  //TLSF_THREADED_MAGIC
+    uint16_t owner; //index + 1 of the owning cache or 0 if not owned by any
+} Tlsf_Threaded_Header;
+
+typedef struct Tlsf_Thread_Cache_Bin {
+    void* first; //singly linked list of free blocks through their first 8 bytes
+    uint32_t count;
+    uint32_t batch;
+} Tlsf_Thread_Cache_Bin;
+
+typedef struct Tlsf_Thread_Cache_Stats {
+    isize allocation_count;
+    isize deallocation_count;
+    isize remote_free_count;   //Number of blocks freed by this cache but owned by a different one.
+    isize refill_count;        //Number of times the shared allocator was locked to obtain a batch of blocks.
+    isize flush_count;         //Number of times the shared allocator was locked to return a batch of blocks.
+} Tlsf_Thread_Cache_Stats;
+
+typedef struct Tlsf_Thread_Cache {
+    //Blocks freed by other threads. Pushed by anyone, popped only by the thread which acquired this cache.
+    Sync_Queue remote_frees;
+
+    ATTRIBUTE_ALIGNED(CACHE_LINE)
+    struct Tlsf_Threaded_Allocator* shared;
+    struct Tlsf_Thread_Cache* next_attached; //next cache attached to the same thread
+    PLATFORM_ATOMIC(uint32_t) is_acquired;
+    uint32_t index;
+
+    //Written only by the owning thread. Can be read from anywhere with tlsf_thread_cache_get_stats.
+    PLATFORM_ATOMIC(isize) allocation_count;
+    PLATFORM_ATOMIC(isize) deallocation_count;
+    PLATFORM_ATOMIC(isize) remote_free_count;
+    PLATFORM_ATOMIC(isize) refill_count;
+    PLATFORM_ATOMIC(isize) flush_count;
+
+    Tlsf_Thread_Cache_Bin bins[TLSF_THREADED_CACHE_BINS];
+} Tlsf_Thread_Cache;
+
+typedef struct Tlsf_Threaded_Allocator {
+    //Allocator "virtual" interface. Uses the cache attached to the calling thread if any.
+    Allocator allocator;
+
+    //The shared allocator. Must only be touched while holding lock.
+    Tlsf_Allocator tlsf;
+    Platform_Mutex lock;
+    isize lock_count;           //Number of times lock was taken. Guarded by lock.
+    isize lock_contended_count; //Number of times lock was already held by someone else. Guarded by lock.
+
+    Tlsf_Thread_Cache* caches;
+    isize cache_count;
+} Tlsf_Threaded_Allocator;
+
+//Initializes the allocator over `memory` with the given node memory (see tlsf_init()) and `cache_count` thread caches.
+// `memory` must be aligned to at least TLSF_THREADED_ALIGN. Returns false if the arguments are invalid.
+EXTERNAL bool tlsf_threaded_init(Tlsf_Threaded_Allocator* allocator, void* memory, isize memory_size, void* node_memory, isize node_memory_size, Tlsf_Thread_Cache* caches, isize cache_count);
+//Deinitializes the allocator. All caches must be released before (possibly by detaching them).
+EXTERNAL void tlsf_threaded_deinit(Tlsf_Threaded_Allocator* allocator);
+
+//Acquires a cache which is not in use by any other thread. Returns NULL if all are in use.
+EXTERNAL Tlsf_Thread_Cache* tlsf_threaded_acquire_cache(Tlsf_Threaded_Allocator* allocator);
+//Returns all blocks cached in `cache` to the shared allocator and makes the cache available for acquiring.
+EXTERNAL void tlsf_threaded_release_cache(Tlsf_Thread_Cache* cache);
+//Returns the blocks freed remotely into currently unacquired caches to the shared allocator.
+EXTERNAL void tlsf_threaded_collect(Tlsf_Threaded_Allocator* allocator);
+
+//Acquires a cache and attaches it to the calling thread. Returns false if there are no free caches.
+// If the thread already has a cache attached for this allocator does nothing and returns true.
+EXTERNAL bool tlsf_threaded_attach(Tlsf_Threaded_Allocator* allocator);
+//Releases the cache attached to the calling thread (if any).
+EXTERNAL void tlsf_threaded_detach(Tlsf_Threaded_Allocator* allocator);
+//Returns the cache attached to the calling thread or NULL.
+EXTERNAL Tlsf_Thread_Cache* tlsf_threaded_get_cache(Tlsf_Threaded_Allocator* allocator);
+
+//Allocates `size` bytes aligned to `align` using the cache attached to the calling thread. Returns NULL on failure.
+EXTERNAL void* tlsf_threaded_malloc(Tlsf_Threaded_Allocator* allocator, isize size, isize align);
+//Frees a pointer obtained from this allocator on any thread. If `ptr` is NULL does nothing.
+EXTERNAL void  tlsf_threaded_free(Tlsf_Threaded_Allocator* allocator, void* ptr);
+
+//Same as tlsf_threaded_malloc/free only with an explicitly given cache (which must be acquired by the calling thread).
+// If `cache_or_null` is NULL uses the shared allocator directly.
+EXTERNAL void* tlsf_thread_cache_malloc(Tlsf_Threaded_Allocator* allocator, Tlsf_Thread_Cache* cache_or_null, isize size, isize align);
+EXTERNAL void  tlsf_thread_cache_free(Tlsf_Threaded_Allocator* allocator, Tlsf_Thread_Cache* cache_or_null, void* ptr);
+//Returns all blocks cached in `cache` (including the remotely freed ones) to the shared allocator.
+EXTERNAL void  tlsf_thread_cache_flush(Tlsf_Thread_Cache* cache);
+EXTERNAL Tlsf_Thread_Cache_Stats tlsf_thread_cache_get_stats(Tlsf_Thread_Cache* cache);
+
+//Checks whether the allocator and all unacquired caches are in valid state. If is not aborts.
+EXTERNAL void tlsf_threaded_test_invariants(Tlsf_Threaded_Allocator* allocator);
+
+#endif
+
+#if (defined(MODULE_IMPL_ALL) || defined(MODULE_IMPL_ALLOCATOR_TLSF_THREADED)) && !defined(MODULE_HAS_IMPL_ALLOCATOR_TLSF_THREADED)
+#define MODULE_HAS_IMPL_ALLOCATOR_TLSF_THREADED
+
+INTERNAL ATTRIBUTE_THREAD_LOCAL Tlsf_Thread_Cache* _tlsf_threaded_attached = NULL;
+
+INTERNAL void* _tlsf_threaded_allocator_func(Allocator* self, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error);
+INTERNAL Allocator_Stats _tlsf_threaded_allocator_get_stats(Allocator* self);
+
+INTERNAL Tlsf_Threaded_Header* _tlsf_threaded_header(void* ptr)
+{
+    Tlsf_Threaded_Header* header = (Tlsf_Threaded_Header*) ptr - 1;
+    //If Crash occurred here it most likely means you have buffer overwrite somewhere!
+    ASSERT(header->magic == TLSF_THREADED_MAGIC);
+    ASSERT(header->bin < TLSF_THREADED_CACHE_BINS || header->bin == TLSF_THREADED_NOT_CACHED);
+    return header;
+}
+
+//Single writer counters. Plain load and store is enough but they must be atomic so that readers are not racing.
+INTERNAL void _tlsf_threaded_stat_add(PLATFORM_ATOMIC(isize)* stat, isize value)
+{
+    PLATFORM_USE_ATOMICS;
+    isize prev = atomic_load_explicit(stat, memory_order_relaxed);
+    atomic_store_explicit(stat, prev + value, memory_order_relaxed);
+}
+
+INTERNAL void _tlsf_threaded_lock(Tlsf_Threaded_Allocator* allocator)
+{
+    bool contended = platform_mutex_try_lock(&allocator->lock) == false;
+    if(contended)
+        platform_mutex_lock(&allocator->lock);
+
+    allocator->lock_count += 1;
+    allocator->lock_contended_count += contended;
+}
+
+INTERNAL void _tlsf_threaded_unlock(Tlsf_Threaded_Allocator* allocator)
+{
+    platform_mutex_unlock(&allocator->lock);
+}
+
+INTERNAL isize _tlsf_threaded_bin_size(int32_t bin)
+{
+    return tlsf_size_from_bin_index(bin);
+}
+
+INTERNAL uint32_t _tlsf_threaded_bin_batch(int32_t bin)
+{
+    isize batch = TLSF_THREADED_BATCH_BYTES / _tlsf_threaded_bin_size(bin);
+    if(batch < TLSF_THREADED_MIN_BATCH)
+        batch = TLSF_THREADED_MIN_BATCH;
+    if(batch > TLSF_THREADED_MAX_BATCH)
+        batch = TLSF_THREADED_MAX_BATCH;
+    return (uint32_t) batch;
+}
+
+//Allocates from the shared allocator. Lock must be held.
+INTERNAL void* _tlsf_threaded_allocate_locked(Tlsf_Threaded_Allocator* allocator, isize size, isize align, uint8_t bin, uint16_t owner)
+{
+    //tlsf_allocate aligns offsets, not addresses. Account for the alignment of memory itself.
+    uint32_t node = 0;
+    isize align_offset = isizeof(Tlsf_Threaded_Header) + (isize) ((uintptr_t) allocator->tlsf.memory % (uintptr_t) align);
+    isize offset = tlsf_allocate(&allocator->tlsf, &node, size + isizeof(Tlsf_Threaded_Header), align, align_offset);
+    if(node == 0)
+        return NULL;
+
+    Tlsf_Threaded_Header* header = (Tlsf_Threaded_Header*) (void*) (allocator->tlsf.memory + offset);
+    header->node = node;
+    header->bin = bin;
+    header->magic = TLSF_THREADED_MAGIC;
+    header->owner = owner;
+    return header + 1;
+}
+
+//Returns a block to the shared allocator. Lock must be held.
+INTERNAL void _tlsf_threaded_deallocate_locked(Tlsf_Threaded_Allocator* allocator, void* ptr)
+{
+    Tlsf_Threaded_Header* header = _tlsf_threaded_header(ptr);
+    header->magic = 0;
+    tlsf_deallocate(&allocator->tlsf, header->node);
+}
+
+INTERNAL void _tlsf_thread_cache_flush_bin(Tlsf_Threaded_Allocator* allocator, Tlsf_Thread_Cache* cache, Tlsf_Thread_Cache_Bin* bin, uint32_t count)
+{
+    ASSERT(count <= bin->count);
+    if(count == 0)
+        return;
+
+    _tlsf_threaded_lock(allocator);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        void* block = bin->first;
+        bin->first = *(void**) block;
+        _tlsf_threaded_deallocate_locked(allocator, block);
+    }
+    _tlsf_threaded_unlock(allocator);
+
+    bin->count -= count;
+    _tlsf_threaded_stat_add(&cache->flush_count, 1);
+}
+
+//Places a block owned by this cache into its free list. Flushes half of the list when it grows too big.
+INTERNAL void _tlsf_thread_cache_push(Tlsf_Threaded_Allocator* allocator, Tlsf_Thread_Cache* cache, void* ptr, uint8_t bin_i)
+{
+    Tlsf_Thread_Cache_Bin* bin = &cache->bins[bin_i];
+    *(void**) ptr = bin->first;
+    bin->first = ptr;
+    bin->count += 1;
+
+    if(bin->count > 2*bin->batch)
+        _tlsf_thread_cache_flush_bin(allocator, cache, bin, bin->batch);
+}
+
+//Moves all remotely freed blocks into the free lists. Returns the number of moved blocks.
+INTERNAL isize _tlsf_thread_cache_drain(Tlsf_Threaded_Allocator* allocator, Tlsf_Thread_Cache* cache)
+{
+    isize count = 0;
+    for(void* block; (block = sync_queue_pop_wait(&cache->remote_frees)) != NULL; count++)
+    {
+        Tlsf_Threaded_Header* header = _tlsf_threaded_header(block);
+        ASSERT(header->owner == cache->index + 1);
+        _tlsf_thread_cache_push(allocator, cache, block, header->bin);
+    }
+    return count;
+}
+
+INTERNAL bool _tlsf_thread_cache_refill(Tlsf_Threaded_Allocator* allocator, Tlsf_Thread_Cache* cache, Tlsf_Thread_Cache_Bin* bin, int32_t bin_i)
+{
+    //Remotely freed blocks are usually the ones most recently used by this thread. Prefer them.
+    if(sync_queue_is_empty(&cache->remote_frees) == false)
+    {
+        _tlsf_thread_cache_drain(allocator, cache);
+        if(bin->count > 0)
+            return true;
+    }
+
+    isize size = _tlsf_threaded_bin_size(bin_i);
+    _tlsf_threaded_lock(allocator);
+    for(uint32_t i = 0; i < bin->batch; i++)
+    {
+        void* block = _tlsf_threaded_allocate_locked(allocator, size, TLSF_THREADED_ALIGN, (uint8_t) bin_i, (uint16_t) (cache->index + 1));
+        if(block == NULL)
+            break;
+
+        *(void**) block = bin->first;
+        bin->first = block;
+        bin->count += 1;
+    }
+    _tlsf_threaded_unlock(allocator);
+
+    _tlsf_threaded_stat_add(&cache->refill_count, 1);
+    return bin->count > 0;
+}
+
+INTERNAL void* _tlsf_thread_cache_malloc_slow(Tlsf_Threaded_Allocator* allocator, Tlsf_Thread_Cache* cache, isize size, isize align)
+{
+    if(cache != NULL && size <= TLSF_THREADED_MAX_CACHED_SIZE && align <= TLSF_THREADED_ALIGN)
+    {
+        int32_t bin_i = tlsf_bin_index_from_size(size, true);
+        Tlsf_Thread_Cache_Bin* bin = &cache->bins[bin_i];
+        //If we fail its likely that our other bins are hoarding the memory.
+        // Give it back and try again.
+        if(_tlsf_thread_cache_refill(allocator, cache, bin, bin_i) == false)
+        {
+            tlsf_thread_cache_flush(cache);
+            _tlsf_thread_cache_refill(allocator, cache, bin, bin_i);
+        }
+
+        if(bin->count == 0)
+            return NULL;
+
+        void* block = bin->first;
+        bin->first = *(void**) block;
+        bin->count -= 1;
+        return block;
+    }
+    else
+    {
+        if(align < TLSF_THREADED_ALIGN)
+            align = TLSF_THREADED_ALIGN;
+
+        _tlsf_threaded_lock(allocator);
+        void* block = _tlsf_threaded_allocate_locked(allocator, size, align, TLSF_THREADED_NOT_CACHED, 0);
+        _tlsf_threaded_unlock(allocator);
+        return block;
+    }
+}
+
+EXTERNAL void* tlsf_thread_cache_malloc(Tlsf_Threaded_Allocator* allocator, Tlsf_Thread_Cache* cache_or_null, isize size, isize align)
+{
+    ASSERT(allocator);
+    ASSERT(size >= 0);
+    ASSERT(is_power_of_two(align));
+    ASSERT(cache_or_null == NULL || cache_or_null->shared == allocator);
+    if(size == 0)
+        return NULL;
+
+    if(size < TLSF_THREADED_MIN_SIZE)
+        size = TLSF_THREADED_MIN_SIZE;
+
+    Tlsf_Thread_Cache* cache = cache_or_null;
+    void* block = NULL;
+    if(cache && size <= TLSF_THREADED_MAX_CACHED_SIZE && align <= TLSF_THREADED_ALIGN)
+    {
+        Tlsf_Thread_Cache_Bin* bin = &cache->bins[tlsf_bin_index_from_size(size, true)];
+        if(bin->count > 0)
+        {
+            block = bin->first;
+            bin->first = *(void**) block;
+            bin->count -= 1;
+        }
+    }
+
+    if(block == NULL)
+        block = _tlsf_thread_cache_malloc_slow(allocator, cache, size, align);
+
+    if(block && cache)
+        _tlsf_threaded_stat_add(&cache->allocation_count, 1);
+    return block;
+}
+
+EXTERNAL void tlsf_thread_cache_free(Tlsf_Threaded_Allocator* allocator, Tlsf_Thread_Cache* cache_or_null, void* ptr)
+{
+    ASSERT(allocator);
+    ASSERT(cache_or_null == NULL || cache_or_null->shared == allocator);
+    if(ptr == NULL)
+        return;
+
+    Tlsf_Thread_Cache* cache = cache_or_null;
+    Tlsf_Threaded_Header* header = _tlsf_threaded_header(ptr);
+    if(cache)
+        _tlsf_threaded_stat_add(&cache->deallocation_count, 1);
+
+    if(header->owner == 0)
+    {
+        _tlsf_threaded_lock(allocator);
+        _tlsf_threaded_deallocate_locked(allocator, ptr);
+        _tlsf_threaded_unlock(allocator);
+    }
+    else if(cache && header->owner == cache->index + 1)
+        _tlsf_thread_cache_push(allocator, cache, ptr, header->bin);
+    else
+    {
+        ASSERT(header->owner <= allocator->cache_count);
+        Tlsf_Thread_Cache* owner = &allocator->caches[header->owner - 1];
+        sync_queue_push(&owner->remote_frees, ptr);
+        if(cache)
+            _tlsf_threaded_stat_add(&cache->remote_free_count, 1);
+    }
+}
+
+EXTERNAL void tlsf_thread_cache_flush(Tlsf_Thread_Cache* cache)
+{
+    Tlsf_Threaded_Allocator* allocator = cache->shared;
+    _tlsf_thread_cache_drain(allocator, cache);
+    for(int32_t i = 0; i < TLSF_THREADED_CACHE_BINS; i++)
+        _tlsf_thread_cache_flush_bin(allocator, cache, &cache->bins[i], cache->bins[i].count);
+}
+
+EXTERNAL Tlsf_Thread_Cache_Stats tlsf_thread_cache_get_stats(Tlsf_Thread_Cache* cache)
+{
+    PLATFORM_USE_ATOMICS;
+    Tlsf_Thread_Cache_Stats stats = {0};
+    stats.allocation_count = atomic_load_explicit(&cache->allocation_count, memory_order_relaxed);
+    stats.deallocation_count = atomic_load_explicit(&cache->deallocation_count, memory_order_relaxed);
+    stats.remote_free_count = atomic_load_explicit(&cache->remote_free_count, memory_order_relaxed);
+    stats.refill_count = atomic_load_explicit(&cache->refill_count, memory_order_relaxed);
+    stats.flush_count = atomic_load_explicit(&cache->flush_count, memory_order_relaxed);
+    return stats;
+}
+
+EXTERNAL void* tlsf_threaded_malloc(Tlsf_Threaded_Allocator* allocator, isize size, isize align)
+{
+    return tlsf_thread_cache_malloc(allocator, tlsf_threaded_get_cache(allocator), size, align);
+}
+
+EXTERNAL void tlsf_threaded_free(Tlsf_Threaded_Allocator* allocator, void* ptr)
+{
+    tlsf_thread_cache_free(allocator, tlsf_threaded_get_cache(allocator), ptr);
+}
+
+INTERNAL bool _tlsf_threaded_try_acquire(Tlsf_Thread_Cache* cache)
+{
+    PLATFORM_USE_ATOMICS;
+    uint32_t expected = false;
+    if(atomic_load_explicit(&cache->is_acquired, memory_order_relaxed))
+        return false;
+    return atomic_compare_exchange_strong(&cache->is_acquired, &expected, true);
+}
+
+EXTERNAL Tlsf_Thread_Cache* tlsf_threaded_acquire_cache(Tlsf_Threaded_Allocator* allocator)
+{
+    for(isize i = 0; i < allocator->cache_count; i++)
+    {
+        Tlsf_Thread_Cache* cache = &allocator->caches[i];
+        if(_tlsf_threaded_try_acquire(cache))
+        {
+            cache->next_attached = NULL;
+            return cache;
+        }
+    }
+    return NULL;
+}
+
+EXTERNAL void tlsf_threaded_release_cache(Tlsf_Thread_Cache* cache)
+{
+    PLATFORM_USE_ATOMICS;
+    ASSERT(atomic_load(&cache->is_acquired));
+    tlsf_thread_cache_flush(cache);
+    atomic_store(&cache->is_acquired, false);
+}
+
+EXTERNAL void tlsf_threaded_collect(Tlsf_Threaded_Allocator* allocator)
+{
+    for(isize i = 0; i < allocator->cache_count; i++)
+    {
+        Tlsf_Thread_Cache* cache = &allocator->caches[i];
+        if(sync_queue_is_empty(&cache->remote_frees) == false && _tlsf_threaded_try_acquire(cache))
+            tlsf_threaded_release_cache(cache);
+    }
+}
+
+EXTERNAL Tlsf_Thread_Cache* tlsf_threaded_get_cache(Tlsf_Threaded_Allocator* allocator)
+{
+    for(Tlsf_Thread_Cache* cache = _tlsf_threaded_attached; cache; cache = cache->next_attached)
+        if(cache->shared == allocator)
+            return cache;
+
+    return NULL;
+}
+
+EXTERNAL bool tlsf_threaded_attach(Tlsf_Threaded_Allocator* allocator)
+{
+    if(tlsf_threaded_get_cache(allocator))
+        return true;
+
+    Tlsf_Thread_Cache* cache = tlsf_threaded_acquire_cache(allocator);
+    if(cache)
+    {
+        cache->next_attached = _tlsf_threaded_attached;
+        _tlsf_threaded_attached = cache;
+    }
+    return cache != NULL;
+}
+
+EXTERNAL void tlsf_threaded_detach(Tlsf_Threaded_Allocator* allocator)
+{
+    for(Tlsf_Thread_Cache** prev = &_tlsf_threaded_attached; *prev; prev = &(*prev)->next_attached)
+    {
+        Tlsf_Thread_Cache* cache = *prev;
+        if(cache->shared == allocator)
+        {
+            *prev = cache->next_attached;
+            cache->next_attached = NULL;
+            tlsf_threaded_release_cache(cache);
+            break;
+        }
+    }
+}
+
+EXTERNAL bool tlsf_threaded_init(Tlsf_Threaded_Allocator* allocator, void* memory, isize memory_size, void* node_memory, isize node_memory_size, Tlsf_Thread_Cache* caches, isize cache_count)
+{
+    ASSERT(allocator);
+    ASSERT(cache_count >= 0);
+    memset(allocator, 0, sizeof *allocator);
+
+    if(memory == NULL || (uintptr_t) memory % TLSF_THREADED_ALIGN != 0 || cache_count > TLSF_THREADED_MAX_CACHES)
+        return false;
+    if(tlsf_init(&allocator->tlsf, memory, memory_size, node_memory, node_memory_size) == false)
+        return false;
+    if(platform_mutex_init(&allocator->lock) != PLATFORM_ERROR_OK)
+        return false;
+
+    allocator->allocator.func = _tlsf_threaded_allocator_func;
+    allocator->allocator.get_stats = _tlsf_threaded_allocator_get_stats;
+    allocator->caches = caches;
+    allocator->cache_count = cache_count;
+    for(isize i = 0; i < cache_count; i++)
+    {
+        Tlsf_Thread_Cache* cache = &caches[i];
+        memset(cache, 0, sizeof *cache);
+        sync_queue_init(&cache->remote_frees, 0);
+        cache->shared = allocator;
+        cache->index = (uint32_t) i;
+        for(int32_t bin_i = 0; bin_i < TLSF_THREADED_CACHE_BINS; bin_i++)
+            cache->bins[bin_i].batch = _tlsf_threaded_bin_batch(bin_i > 0 ? bin_i : 1);
+    }
+
+    allocator_registry_track(&allocator->allocator);
+    return true;
+}
+
+EXTERNAL void tlsf_threaded_deinit(Tlsf_Threaded_Allocator* allocator)
+{
+    PLATFORM_USE_ATOMICS;
+    allocator_registry_remove(&allocator->allocator);
+    tlsf_threaded_detach(allocator);
+    for(isize i = 0; i < allocator->cache_count; i++)
+        ASSERT(atomic_load(&allocator->caches[i].is_acquired) == false, "All caches must be released before deinit!");
+
+    platform_mutex_deinit(&allocator->lock);
+    memset(allocator, 0, sizeof *allocator);
+}
+
+EXTERNAL void tlsf_threaded_test_invariants(Tlsf_Threaded_Allocator* allocator)
+{
+    PLATFORM_USE_ATOMICS;
+    TEST(tlsf_bin_index_from_size(TLSF_THREADED_MAX_CACHED_SIZE, true) + 1 == TLSF_THREADED_CACHE_BINS);
+
+    _tlsf_threaded_lock(allocator);
+    tlsf_test_invariants(&allocator->tlsf, TLSF_CHECK_DETAILED | TLSF_CHECK_ALL_NODES);
+    for(isize i = 0; i < allocator->cache_count; i++)
+    {
+        Tlsf_Thread_Cache* cache = &allocator->caches[i];
+        TEST(cache->shared == allocator);
+        TEST(cache->index == i);
+
+        //We only check caches which cannot be concurrently modified
+        if(_tlsf_threaded_try_acquire(cache) == false)
+            continue;
+
+        for(int32_t bin_i = 0; bin_i < TLSF_THREADED_CACHE_BINS; bin_i++)
+        {
+            Tlsf_Thread_Cache_Bin* bin = &cache->bins[bin_i];
+            TEST(TLSF_THREADED_MIN_BATCH <= bin->batch && bin->batch <= TLSF_THREADED_MAX_BATCH);
+            TEST(bin->count <= 2*bin->batch);
+
+            uint32_t count = 0;
+            for(void* block = bin->first; block; block = *(void**) block, count++)
+            {
+                Tlsf_Threaded_Header* header = (Tlsf_Threaded_Header*) block - 1;
+                TEST(count < bin->count);
+                TEST((uintptr_t) block % TLSF_THREADED_ALIGN == 0);
+                TEST(header->magic == TLSF_THREADED_MAGIC);
+                TEST(header->bin == bin_i);
+                TEST(header->owner == cache->index + 1);
+                TEST(tlsf_node_size(&allocator->tlsf, header->node) >= _tlsf_threaded_bin_size(bin_i));
+            }
+            TEST(count == bin->count);
+        }
+        atomic_store(&cache->is_acquired, false);
+    }
+    _tlsf_threaded_unlock(allocator);
+}
+
+INTERNAL void* _tlsf_threaded_allocator_func(Allocator* self, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error)
+{
+    Tlsf_Threaded_Allocator* allocator = (Tlsf_Threaded_Allocator*) (void*) self;
+    Tlsf_Thread_Cache* cache = tlsf_threaded_get_cache(allocator);
+    void* new_ptr = NULL;
+    if(new_size > 0)
+    {
+        new_ptr = tlsf_thread_cache_malloc(allocator, cache, new_size, align);
+        if(new_ptr == NULL)
+            allocator_error(error, ALLOCATOR_ERROR_OUT_OF_MEM, self, new_size, old_ptr, old_size, align, "Out of memory");
+    }
+    if(new_ptr && old_size > 0)
+    {
+        ASSERT(old_ptr);
+        memcpy(new_ptr, old_ptr, (size_t) (old_size < new_size ? old_size : new_size));
+    }
+
+    if(old_size > 0 && (new_ptr || new_size == 0))
+        tlsf_thread_cache_free(allocator, cache, old_ptr);
+
+    return new_ptr;
+}
+
+INTERNAL Allocator_Stats _tlsf_threaded_allocator_get_stats(Allocator* self)
+{
+    Tlsf_Threaded_Allocator* allocator = (Tlsf_Threaded_Allocator*) (void*) self;
+    Allocator_Stats stats = {0};
+    stats.type_name = "Tlsf_Threaded_Allocator";
+    stats.fixed_memory_pool_size = allocator->tlsf.memory_size;
+
+    //The shared allocator also counts the blocks sitting in caches.
+    // These numbers are thus upper bounds of what was given out to the program.
+    _tlsf_threaded_lock(allocator);
+    stats.bytes_allocated = allocator->tlsf.bytes_allocated;
+    stats.max_bytes_allocated = allocator->tlsf.max_bytes_allocated;
+    stats.max_concurent_allocations = allocator->tlsf.max_concurent_allocations;
+    _tlsf_threaded_unlock(allocator);
+
+    for(isize i = 0; i < allocator->cache_count; i++)
+    {
+        Tlsf_Thread_Cache_Stats cache_stats = tlsf_thread_cache_get_stats(&allocator->caches[i]);
+        stats.allocation_count += cache_stats.allocation_count;
+        stats.deallocation_count += cache_stats.deallocation_count;
+    }
+    return stats;
+}
+
+#endif
@@ -12,13 +12,15 @@
 
 #include "allocator.h"
 #define ALLOCATION_LIST_MAGIC "TrackAl"
+#define ALLOCATION_LIST_MAX_SIZE (((isize) 1 << 41) - 1)
 
 typedef struct Allocation_List_Block {
     struct Allocation_List_Block* next_block; 
     struct Allocation_List_Block* prev_block;
 
     u64 align       : 16;
-    u64 size        : 47;
+    u64 size        : 41;
+    u64 owner       : 6; //Not used by Allocation_List. Users can use it to tell apart blocks from multiple lists (see allocator_tracking_threaded.h)
     u64 is_offset   : 1;
 
     #ifdef DO_ASSERTS_SLOW
@@ -50,7 +52,7 @@ EXTERNAL void  allocation_list_free_all(Allocation_List* self, Allocator* parent
 EXTERNAL void* allocation_list_allocate(Allocation_List* self, Allocator* parent_or_null, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error);
 
 EXTERNAL isize allocation_list_get_block_size(Allocation_List* self, void* old_ptr);
-EXTERNAL Allocation_List_Block* allocation_list_get_block_header(Allocation_List* self, void* old_ptr);
+EXTERNAL Allocation_List_Block* allocation_list_get_block_header(Allocation_List* self_or_null, void* old_ptr); //If self is null checks only the block and not its neighbours
 
 EXTERNAL void tracking_allocator_init(Tracking_Allocator* self, const char* name);
 EXTERNAL void tracking_allocator_init_use(Tracking_Allocator* self, const char* name, u64 flags);  //convenience function that inits the allocator then imidietely makes it the default or scratch. On deinit restores to previous defaults
@@ -82,11 +84,6 @@ EXTERNAL Allocator_Stats tracking_allocator_get_stats(Allocator* self);
         #define MALLOC_ALLOCATOR_FREE(pointer) platform_heap_reallocate(0, pointer, DEF_ALIGN)
     #endif 
 
-    #define ALLOCATION_LIST_SIZE_BITS       46
-    #define ALLOCATION_LIST_ALIGN_BITS      17
-    #define ALLOCATION_LIST_IS_OFFSET_BIT   63
-    #define ALLOCATION_LIST_SIZE_MASK       (((u64) 1 << ALLOCATION_LIST_SIZE_BITS) - 1)
-    #define ALLOCATION_LIST_ALIGN_MASK      (((u64) 1 << ALLOCATION_LIST_ALIGN_BITS) - 1)
 
     INTERNAL void _allocation_list_assert_block_coherency(Allocation_List* self, Allocation_List_Block* block)
     {
@@ -96,6 +93,9 @@ EXTERNAL Allocator_Stats tracking_allocator_get_stats(Allocator* self);
 
         #ifdef DO_ASSERTS_SLOW
             ASSERT_SLOW(memcmp(block->magic, ALLOCATION_LIST_MAGIC, sizeof ALLOCATION_LIST_MAGIC) == 0);
+            if(self == NULL)
+                return;
+
             ASSERT_SLOW((block->next_block == NULL) == (self->last_block == block));
             if(block->prev_block != NULL)
                 ASSERT_SLOW(block->prev_block->next_block == block);
@@ -127,6 +127,7 @@ EXTERNAL Allocator_Stats tracking_allocator_get_stats(Allocator* self);
         void* out_ptr = NULL;
         if(new_size != 0)
         {
+            REQUIRE(new_size <= ALLOCATION_LIST_MAX_SIZE, "Allocation too big!");
             isize new_allocation_size = new_size + capped_align - DEF_ALIGN + (isize) sizeof(Allocation_List_Block);
             void* new_allocation = NULL;
             if(parent_or_null != NULL)
@@ -151,10 +152,11 @@ EXTERNAL Allocator_Stats tracking_allocator_get_stats(Allocator* self);
             if(is_offset)
             {
                 u64* offset = (u64*) (void*) new_block_ptr - 1;
-                *offset = (u64) new_allocation - (u64) new_block_ptr;
+                *offset = (u64) new_block_ptr - (u64) new_allocation;
             }
 
             new_block_ptr->is_offset = is_offset; 
+            new_block_ptr->owner = 0; 
             #pragma GCC diagnostic push
             #pragma GCC diagnostic ignored "-Wconversion"
             new_block_ptr->align = (u64) align; 
@@ -246,6 +248,7 @@ EXTERNAL Allocator_Stats tracking_allocator_get_stats(Allocator* self);
         self->alloc[0].func = tracking_allocator_func;
         self->alloc[0].get_stats = tracking_allocator_get_stats;
         self->name = name;
+        allocator_registry_track(self->alloc);
     }
 
     EXTERNAL void tracking_allocator_init_use(Tracking_Allocator* self, const char* name, u64 flags)
@@ -257,6 +260,8 @@ EXTERNAL Allocator_Stats tracking_allocator_get_stats(Allocator* self);
     
     EXTERNAL void tracking_allocator_deinit(Tracking_Allocator* self)
     {
+        if(self->alloc[0].func)
+            allocator_registry_remove(self->alloc);
         allocation_list_free_all(&self->list, self->parent);
         allocator_set(self->allocator_backup);
         memset(self, 0, sizeof *self);
@@ -0,0 +1,185 @@
+#ifndef MODULE_ALLOCATOR_TRACKING_THREADED
+#define MODULE_ALLOCATOR_TRACKING_THREADED
+
+// A thread safe variant of Tracking_Allocator.
+//
+// Tracking_Allocator keeps all of its blocks in a single doubly linked Allocation_List and plain counters.
+// Sharing it between threads means wrapping every operation in one mutex, which serializes all allocations
+// of for example a worker pool. Here we instead split the allocator into TRACKING_THREADED_SHARDS shards
+// each with its own Allocation_List, lock and stats. Each thread is assigned a shard on its first allocation
+// (round robin over all threads of the process) and allocates into it. Thus as long as there are fewer threads
+// than shards the locks are uncontended and their cache lines stay with the owning thread.
+//
+// Each block remembers the shard it was allocated from in Allocation_List_Block::owner. Deallocation
+// locks that shard and unlinks the block from there, so blocks can be freed by any thread. Reallocation
+// by a thread other than the owner allocates the new block in the callers shard and frees the old one
+// in the owners shard.
+//
+// The stats of each shard are only touched under its lock and tracking_threaded_get_stats sums them.
+// Because no single place sees the total at all times max_bytes_allocated is the largest total any
+// call to get stats observed.
+//
+// tracking_threaded_free_all frees all blocks of all shards, keeping the hierarchical "free everything at once"
+// property of Tracking_Allocator. It must not race with allocations made through the allocator.
+
+#include "allocator_tracking.h"
+#include "sync.h"
+
+#define TRACKING_THREADED_SHARDS 64 /* at most 64 because of the width of Allocation_List_Block::owner */
+
+typedef struct Tracking_Threaded_Shard {
+    ATTRIBUTE_ALIGNED(CACHE_LINE)
+    Ticket_Lock lock;
+    Allocation_List list;
+
+    isize bytes_allocated;
+    isize allocation_count;
+    isize deallocation_count;
+    isize reallocation_count;
+} Tracking_Threaded_Shard;
+
+typedef struct Tracking_Threaded_Allocator {
+    Allocator alloc[1];
+    Allocator* parent; //parent allocator. If parent is null uses malloc/free. Must be thread safe.
+    const char* name;
+    PLATFORM_ATOMIC(isize) max_bytes_allocated;
+
+    Tracking_Threaded_Shard shards[TRACKING_THREADED_SHARDS];
+} Tracking_Threaded_Allocator;
+
+EXTERNAL void tracking_threaded_init(Tracking_Threaded_Allocator* self, Allocator* parent_or_null, const char* name);
+EXTERNAL void tracking_threaded_deinit(Tracking_Threaded_Allocator* self);
+EXTERNAL void tracking_threaded_free_all(Tracking_Threaded_Allocator* self);
+
+EXTERNAL void* tracking_threaded_func(Allocator* self, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error);
+EXTERNAL Allocator_Stats tracking_threaded_get_stats(Allocator* self);
+
+#endif
+
+#if (defined(MODULE_IMPL_ALL) || defined(MODULE_IMPL_ALLOCATOR_TRACKING_THREADED)) && !defined(MODULE_HAS_IMPL_ALLOCATOR_TRACKING_THREADED)
+#define MODULE_HAS_IMPL_ALLOCATOR_TRACKING_THREADED
+
+    INTERNAL ATTRIBUTE_THREAD_LOCAL uint32_t _tracking_threaded_thread_shard = 0; //shard index + 1 or 0 if not yet assigned
+    INTERNAL PLATFORM_ATOMIC(uint32_t) _tracking_threaded_thread_count = 0;
+
+    INTERNAL uint32_t _tracking_threaded_get_shard()
+    {
+        PLATFORM_USE_ATOMICS;
+        if(_tracking_threaded_thread_shard == 0)
+            _tracking_threaded_thread_shard = atomic_fetch_add_explicit(&_tracking_threaded_thread_count, 1, memory_order_relaxed) % TRACKING_THREADED_SHARDS + 1;
+        return _tracking_threaded_thread_shard - 1;
+    }
+
+    EXTERNAL void tracking_threaded_init(Tracking_Threaded_Allocator* self, Allocator* parent_or_null, const char* name)
+    {
+        tracking_threaded_deinit(self);
+        self->parent = parent_or_null;
+        self->name = name;
+        self->alloc[0].func = tracking_threaded_func;
+        self->alloc[0].get_stats = tracking_threaded_get_stats;
+        allocator_registry_track(self->alloc);
+    }
+
+    EXTERNAL void tracking_threaded_deinit(Tracking_Threaded_Allocator* self)
+    {
+        if(self->alloc[0].func)
+            allocator_registry_remove(self->alloc);
+        tracking_threaded_free_all(self);
+        memset(self, 0, sizeof *self);
+    }
+
+    EXTERNAL void tracking_threaded_free_all(Tracking_Threaded_Allocator* self)
+    {
+        for(isize i = 0; i < TRACKING_THREADED_SHARDS; i++)
+        {
+            Tracking_Threaded_Shard* shard = &self->shards[i];
+            ticket_lock(&shard->lock, SYNC_WAIT_BLOCK);
+            allocation_list_free_all(&shard->list, self->parent);
+            shard->bytes_allocated = 0;
+            ticket_unlock(&shard->lock, SYNC_WAIT_BLOCK);
+        }
+    }
+
+    //is_moving is set for the two halves of reallocating other shards block. The whole operation is
+    // counted as a single reallocation.
+    INTERNAL void* _tracking_threaded_shard_allocate(Tracking_Threaded_Allocator* self, uint32_t shard_i, bool is_moving, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error)
+    {
+        Tracking_Threaded_Shard* shard = &self->shards[shard_i];
+        ticket_lock(&shard->lock, SYNC_WAIT_BLOCK);
+        void* out = allocation_list_allocate(&shard->list, self->parent, new_size, old_ptr, old_size, align, error);
+        if(out != NULL || new_size == 0)
+        {
+            if(out != NULL)
+                allocation_list_get_block_header(&shard->list, out)->owner = shard_i;
+
+            if(is_moving)
+                shard->reallocation_count += new_size != 0;
+            else if(old_ptr == NULL)
+                shard->allocation_count += 1;
+            else if(new_size == 0)
+                shard->deallocation_count += 1;
+            else
+                shard->reallocation_count += 1;
+            shard->bytes_allocated += new_size - old_size;
+        }
+        ticket_unlock(&shard->lock, SYNC_WAIT_BLOCK);
+        return out;
+    }
+
+    EXTERNAL void* tracking_threaded_func(Allocator* self_, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error)
+    {
+        PROFILE_START();
+        Tracking_Threaded_Allocator* self = (Tracking_Threaded_Allocator*) (void*) self_;
+        uint32_t shard_i = _tracking_threaded_get_shard();
+
+        void* out = NULL;
+        //The owner is written once before the block is given out so it is safe to read without the lock.
+        // We dont yet know the owners list so only the block itself can be checked.
+        uint32_t owner_i = old_ptr ? (uint32_t) allocation_list_get_block_header(NULL, old_ptr)->owner : shard_i;
+        if(owner_i == shard_i || new_size == 0)
+            out = _tracking_threaded_shard_allocate(self, owner_i, false, new_size, old_ptr, old_size, align, error);
+        else
+        {
+            //Realloc of other shards block. Allocate in ours then free in theirs.
+            out = _tracking_threaded_shard_allocate(self, shard_i, true, new_size, NULL, 0, align, error);
+            if(out != NULL)
+            {
+                memcpy(out, old_ptr, (size_t) MIN(old_size, new_size));
+                _tracking_threaded_shard_allocate(self, owner_i, true, 0, old_ptr, old_size, align, NULL);
+            }
+        }
+
+        PROFILE_STOP();
+        return out;
+    }
+
+    EXTERNAL Allocator_Stats tracking_threaded_get_stats(Allocator* self_)
+    {
+        PLATFORM_USE_ATOMICS;
+        Tracking_Threaded_Allocator* self = (Tracking_Threaded_Allocator*) (void*) self_;
+        Allocator_Stats out = {0};
+        out.type_name = "Tracking_Threaded_Allocator";
+        out.name = self->name;
+        out.parent = self->parent;
+        out.is_top_level = self->parent == NULL;
+        out.is_growing = true;
+        out.is_capable_of_resize = true;
+        out.is_capable_of_free_all = true;
+
+        for(isize i = 0; i < TRACKING_THREADED_SHARDS; i++)
+        {
+            Tracking_Threaded_Shard* shard = &self->shards[i];
+            ticket_lock(&shard->lock, SYNC_WAIT_BLOCK);
+            out.bytes_allocated += shard->bytes_allocated;
+            out.allocation_count += shard->allocation_count;
+            out.deallocation_count += shard->deallocation_count;
+            out.reallocation_count += shard->reallocation_count;
+            ticket_unlock(&shard->lock, SYNC_WAIT_BLOCK);
+        }
+
+        isize max_bytes = atomic_load(&self->max_bytes_allocated);
+        while(max_bytes < out.bytes_allocated && !atomic_compare_exchange_weak(&self->max_bytes_allocated, &max_bytes, out.bytes_allocated));
+        out.max_bytes_allocated = MAX(max_bytes, out.bytes_allocated);
+        return out;
+    }
+#endif
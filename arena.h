@@ -7,6 +7,11 @@
 #define ARENA_DEF_RESERVE_SIZE (16*GB)
 #define ARENA_DEF_COMMIT_SIZE  ( 4*MB) 
 
+//Flags for arena_init_custom
+#define ARENA_HUGE_PAGES           1 //Backs the arena with transparent huge pages where possible. Commit granularity is rounded to platform_huge_page_size(). 
+#define ARENA_HUGE_PAGES_EXPLICIT  2 //Backs the arena with preallocated huge pages. Init fails if the system does not have enough for the whole reserve size.
+#define ARENA_NUMA_BIND            4 //Binds all memory of the arena to the given NUMA node. Init fails if binding is not supported.
+
 //Contiguous chunk of virtual memory. 
 // This struct is combination of two separate concepts (for simplicity of implementation):
 //  1: Normal arena interface - push/pop/reset etc.
@@ -22,11 +27,41 @@ typedef struct Arena {
     u8* commit_to;
     u8* reserved_to;
     isize commit_granularity;
+    u32 flags;
+    i32 numa_node;
+
+    //Decommit on reset. See arena_set_decommit()
+    isize decommit_keep;
+    isize decommit_above;
+    struct Arena_Async_Commit* async;
 
     const char* name;
 } Arena;
 
+//State shared between an arena and its helper thread. See arena_start_async_commit().
+//Memory in [data, backed_to) is commited by the OS. The helper moves backed_to towards wanted_to 
+// one commit granularity at a time, pre-faulting the pages it commits. The arena itself only ever uses 
+// memory below its commit_to which is always <= backed_to.
+typedef struct Arena_Async_Commit {
+    Platform_Mutex mutex;
+    u8* data;
+    u8* reserved_to;
+    u8* backed_to;
+    u8* wanted_to;
+    isize commit_step;
+    isize commit_ahead;
+    bool stopping;
+
+    //purely informative
+    isize async_commit_count; //number of granules commited by the helper 
+    isize async_decommit_count; 
+    isize sync_commit_count;  //number of times the arena had to commit on its own because the helper did not keep up
+
+    PLATFORM_ATOMIC(uint32_t) wake;
+} Arena_Async_Commit;
+
 EXTERNAL Platform_Error arena_init(Arena* arena, const char* name, isize reserve_size_or_zero, isize commit_granularity_or_zero);
+EXTERNAL Platform_Error arena_init_custom(Arena* arena, const char* name, isize reserve_size_or_zero, isize commit_granularity_or_zero, u32 flags, i32 numa_node_or_zero);
 EXTERNAL void arena_deinit(Arena* arena);
 EXTERNAL void* arena_push_nonzero(Arena* arena, isize size, isize align, Allocator_Error* error_or_null);
 EXTERNAL void* arena_push(Arena* arena, isize size, isize align);
@@ -35,6 +70,16 @@ EXTERNAL void arena_commit_ptr(Arena* arena, const void* position, Allocator_Err
 EXTERNAL void arena_reset(Arena* arena, isize to);
 EXTERNAL void arena_commit(Arena* arena, isize to);
 
+//Starts a helper thread which keeps commit_ahead_or_zero bytes (default: one commit granularity) commited 
+// and pre-faulted past the used region so that pushes crossing the commit boundary dont stall on page faults. 
+//Also makes decommits done by arena_reset happen on the helper thread. Is stopped by arena_deinit.
+EXTERNAL Platform_Error arena_start_async_commit(Arena* arena, isize commit_ahead_or_zero);
+EXTERNAL void arena_stop_async_commit(Arena* arena);
+//Makes arena_reset/arena_reset_ptr decommit memory which is no longer needed. Once more than keep_commited + hysteresis
+// bytes are commited past the used region everything past keep_commited is decommited. The hysteresis prevents 
+// repeatedly commiting and decommiting the same memory when usage oscillates. Negative keep_commited disables decommit (default).
+EXTERNAL void arena_set_decommit(Arena* arena, isize keep_commited, isize hysteresis);
+
 EXTERNAL void* arena_allocator_func(Allocator* self, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* stats);
 EXTERNAL Allocator_Stats arena_allocator_get_stats(Allocator* self);
 
@@ -45,14 +90,29 @@ EXTERNAL Allocator_Stats arena_allocator_get_stats(Allocator* self);
 #define MODULE_HAS_IMPL_ARENA
 
 EXTERNAL Platform_Error arena_init(Arena* arena, const char* name, isize reserve_size_or_zero, isize commit_granularity_or_zero)
+{
+    return arena_init_custom(arena, name, reserve_size_or_zero, commit_granularity_or_zero, 0, 0);
+}
+
+EXTERNAL Platform_Error arena_init_custom(Arena* arena, const char* name, isize reserve_size_or_zero, isize commit_granularity_or_zero, u32 flags, i32 numa_node_or_zero)
 {
     arena_deinit(arena);
     isize alloc_granularity = platform_allocation_granularity();
     
     REQUIRE(reserve_size_or_zero >= 0);
     REQUIRE(commit_granularity_or_zero >= 0);
+    REQUIRE(numa_node_or_zero >= 0);
     REQUIRE(alloc_granularity >= 0);
 
+    //Huge pages only make sense if we commit whole huge pages at a time
+    Platform_Virtual_Allocation page_flags = (Platform_Virtual_Allocation) 0;
+    if(flags & ARENA_HUGE_PAGES)
+        page_flags = (Platform_Virtual_Allocation) (page_flags | PLATFORM_VIRTUAL_ALLOC_HUGE_PAGES);
+    if(flags & ARENA_HUGE_PAGES_EXPLICIT)
+        page_flags = (Platform_Virtual_Allocation) (page_flags | PLATFORM_VIRTUAL_ALLOC_HUGE_PAGES_EXPLICIT);
+    if(page_flags)
+        alloc_granularity = MAX(alloc_granularity, platform_huge_page_size());
+
     isize reserve_size = reserve_size_or_zero > 0 ? reserve_size_or_zero : ARENA_DEF_RESERVE_SIZE;
     isize commit_granularity = commit_granularity_or_zero > 0 ? commit_granularity_or_zero : ARENA_DEF_COMMIT_SIZE;
 
@@ -60,7 +120,14 @@ EXTERNAL Platform_Error arena_init(Arena* arena, const char* name, isize reserve
     commit_granularity = DIV_CEIL(commit_granularity, alloc_granularity)*alloc_granularity;
 
     u8* data = NULL;
-    Platform_Error error = platform_virtual_reallocate((void**) &data, NULL, reserve_size, PLATFORM_VIRTUAL_ALLOC_RESERVE, PLATFORM_MEMORY_PROT_NO_ACCESS);
+    Platform_Error error = platform_virtual_reallocate((void**) &data, NULL, reserve_size, (Platform_Virtual_Allocation) (PLATFORM_VIRTUAL_ALLOC_RESERVE | page_flags), PLATFORM_MEMORY_PROT_NO_ACCESS);
+    if(error == 0 && (flags & ARENA_NUMA_BIND))
+    {
+        error = platform_virtual_bind_numa_node(data, reserve_size, numa_node_or_zero);
+        if(error)
+            platform_virtual_reallocate(NULL, data, reserve_size, PLATFORM_VIRTUAL_ALLOC_RELEASE, PLATFORM_MEMORY_PROT_NO_ACCESS);
+    }
+
     if(error == 0)
     {
         arena->alloc[0].func = arena_allocator_func;
@@ -71,51 +138,236 @@ EXTERNAL Platform_Error arena_init(Arena* arena, const char* name, isize reserve
         arena->commit_to = data;
         arena->reserved_to = data + reserve_size;
         arena->commit_granularity = commit_granularity;
+        arena->flags = flags;
+        arena->numa_node = numa_node_or_zero;
         arena->name = name;
+        allocator_registry_track(arena->alloc);
     }
     return error;
 }
 
 EXTERNAL void arena_deinit(Arena* arena)
 {
+    arena_stop_async_commit(arena);
     if(arena->data)
+    {
+        allocator_registry_remove(arena->alloc);
         platform_virtual_reallocate(NULL, arena->data, arena->reserved_to - arena->data, PLATFORM_VIRTUAL_ALLOC_RELEASE, PLATFORM_MEMORY_PROT_NO_ACCESS);
+    }
 
     memset(arena, 0, sizeof *arena);
 }
 
 INTERNAL ATTRIBUTE_INLINE_NEVER void _arena_commit_no_inline(Arena* arena, const void* to, Allocator_Error* error_or_null)
 {
+    PLATFORM_USE_ATOMICS;
     PROFILE_START();
+    Arena_Async_Commit* async = arena->async;
+    if(async)
+        platform_mutex_lock(&async->mutex);
     {
-        isize size = (u8*) to - arena->commit_to;
-        isize commit = DIV_CEIL(size, arena->commit_granularity)*arena->commit_granularity;
+        //Take whatever the helper thread has already commited for us
+        u8* backed_to = async ? async->backed_to : arena->commit_to;
+        if(backed_to < (u8*) to)
+        {
+            isize size = (u8*) to - backed_to;
+            isize commit = DIV_CEIL(size, arena->commit_granularity)*arena->commit_granularity;
+
+            u8* new_commit_to = backed_to + commit;
+            if(new_commit_to > arena->reserved_to)
+            {
+                allocator_error(error_or_null, ALLOCATOR_ERROR_OUT_OF_MEM, arena->alloc, size, NULL, 0, 1, 
+                    "More memory is needed then reserved! Reserved: %.2lf MB, commit: %.2lf MB", 
+                    (double) (arena->reserved_to - arena->data)/MB, (double) (arena->commit_to - arena->data)/MB);
+                goto end;
+            }
+            
+            Platform_Error platform_error = platform_virtual_reallocate(NULL, backed_to, new_commit_to - backed_to, PLATFORM_VIRTUAL_ALLOC_COMMIT, PLATFORM_MEMORY_PROT_READ_WRITE);
+            if(platform_error)
+            {
+                char buffer[4096];
+                platform_translate_error(platform_error, buffer, sizeof buffer);
+                allocator_error(error_or_null, ALLOCATOR_ERROR_OUT_OF_MEM, arena->alloc, size, NULL, 0, 1, 
+                    "Virtual memory commit failed! Error: %s", buffer);
+                goto end;
+            }
 
-        u8* new_commit_to = arena->used_to + commit;
-        if(new_commit_to > arena->reserved_to)
+            backed_to = new_commit_to;
+            if(async)
+                async->sync_commit_count += 1;
+        }
+
+        arena->commit_to = backed_to;
+        if(async)
         {
-            allocator_error(error_or_null, ALLOCATOR_ERROR_OUT_OF_MEM, arena->alloc, size, NULL, 0, 1, 
-                "More memory is needed then reserved! Reserved: %.2lf MB, commit: %.2lf MB", 
-                (double) (arena->reserved_to - arena->data)/MB, (double) (arena->commit_to - arena->data)/MB);
-            goto end;
+            async->backed_to = backed_to;
+            async->wanted_to = MIN(backed_to + async->commit_ahead, arena->reserved_to);
         }
-            
-        Platform_Error platform_error = platform_virtual_reallocate(NULL, arena->commit_to, new_commit_to - arena->commit_to, PLATFORM_VIRTUAL_ALLOC_COMMIT, PLATFORM_MEMORY_PROT_READ_WRITE);
-        if(platform_error)
+    }
+    end:
+    if(async)
+    {
+        platform_mutex_unlock(&async->mutex);
+        atomic_fetch_add(&async->wake, 1);
+        platform_futex_wake((void*) &async->wake);
+    }
+    PROFILE_STOP();
+}
+
+INTERNAL ATTRIBUTE_INLINE_NEVER void _arena_decommit_no_inline(Arena* arena)
+{
+    PLATFORM_USE_ATOMICS;
+    PROFILE_START();
+    isize keep = arena->used_to - arena->data + arena->decommit_keep;
+    u8* new_commit_to = arena->data + DIV_CEIL(keep, arena->commit_granularity)*arena->commit_granularity;
+    if(new_commit_to < arena->commit_to)
+    {
+        Arena_Async_Commit* async = arena->async;
+        if(async)
         {
-            char buffer[4096];
-            platform_translate_error(platform_error, buffer, sizeof buffer);
-            allocator_error(error_or_null, ALLOCATOR_ERROR_OUT_OF_MEM, arena->alloc, size, NULL, 0, 1, 
-                "Virtual memory commit failed! Error: %s", buffer);
-            goto end;
+            //The helper decommits [wanted_to, backed_to) later. We never use memory past commit_to 
+            // so we can continue right away.
+            platform_mutex_lock(&async->mutex);
+            async->wanted_to = MIN(new_commit_to + async->commit_ahead, arena->reserved_to);
+            platform_mutex_unlock(&async->mutex);
+
+            atomic_fetch_add(&async->wake, 1);
+            platform_futex_wake((void*) &async->wake);
         }
+        else
+            platform_virtual_reallocate(NULL, new_commit_to, arena->commit_to - new_commit_to, PLATFORM_VIRTUAL_ALLOC_DECOMMIT, PLATFORM_MEMORY_PROT_NO_ACCESS);
 
         arena->commit_to = new_commit_to;
     }
-    end:
     PROFILE_STOP();
 }
 
+INTERNAL int _arena_async_commit_func(void* context)
+{
+    PLATFORM_USE_ATOMICS;
+    Arena_Async_Commit* async = (Arena_Async_Commit*) context;
+    isize page_size = platform_page_size();
+    for(;;)
+    {
+        uint32_t wake = atomic_load(&async->wake);
+        bool did_work = false;
+
+        platform_mutex_lock(&async->mutex);
+        if(async->stopping)
+        {
+            platform_mutex_unlock(&async->mutex);
+            break;
+        }
+
+        if(async->backed_to < async->wanted_to)
+        {
+            u8* from = async->backed_to;
+            u8* to = MIN(from + async->commit_step, async->wanted_to);
+            if(platform_virtual_reallocate(NULL, from, to - from, PLATFORM_VIRTUAL_ALLOC_COMMIT, PLATFORM_MEMORY_PROT_READ_WRITE) == 0)
+            {
+                //Pre-fault so that the arena does not pay for it on first touch.
+                // Nobody else uses this memory yet and it is fresh so writing zero is fine.
+                for(volatile u8* page = from; page < to; page += page_size)
+                    *page = 0;
+
+                async->backed_to = to;
+                async->async_commit_count += 1;
+            }
+            else
+                async->wanted_to = async->backed_to; //let the arena try on its own and report the error
+
+            did_work = true;
+        }
+        else if(async->backed_to > async->wanted_to)
+        {
+            platform_virtual_reallocate(NULL, async->wanted_to, async->backed_to - async->wanted_to, PLATFORM_VIRTUAL_ALLOC_DECOMMIT, PLATFORM_MEMORY_PROT_NO_ACCESS);
+            async->backed_to = async->wanted_to;
+            async->async_decommit_count += 1;
+            did_work = true;
+        }
+        platform_mutex_unlock(&async->mutex);
+
+        if(did_work == false)
+            platform_futex_wait((void*) &async->wake, wake, -1);
+    }
+
+    //The arena gave up ownership when it set stopping
+    platform_mutex_deinit(&async->mutex);
+    platform_heap_reallocate(0, async, DEF_ALIGN);
+    return 0;
+}
+
+EXTERNAL Platform_Error arena_start_async_commit(Arena* arena, isize commit_ahead_or_zero)
+{
+    REQUIRE(arena->data, "Arena must be initialized!");
+    REQUIRE(commit_ahead_or_zero >= 0);
+    arena_stop_async_commit(arena);
+
+    Arena_Async_Commit* async = (Arena_Async_Commit*) platform_heap_reallocate(isizeof(Arena_Async_Commit), NULL, DEF_ALIGN);
+    if(async == NULL)
+        return PLATFORM_ERROR_OTHER;
+
+    isize commit_ahead = commit_ahead_or_zero > 0 ? commit_ahead_or_zero : arena->commit_granularity;
+    memset(async, 0, sizeof *async);
+    async->data = arena->data;
+    async->reserved_to = arena->reserved_to;
+    async->backed_to = arena->commit_to;
+    async->commit_step = arena->commit_granularity;
+    async->commit_ahead = DIV_CEIL(commit_ahead, arena->commit_granularity)*arena->commit_granularity;
+    async->wanted_to = MIN(arena->commit_to + async->commit_ahead, arena->reserved_to);
+
+    Platform_Thread thread = {0};
+    Platform_Error error = platform_mutex_init(&async->mutex);
+    if(error == 0)
+        error = platform_thread_launch(&thread, 0, _arena_async_commit_func, async);
+
+    if(error == 0)
+    {
+        //Nobody ever joins the helper. It cannot exit before arena_stop_async_commit so detaching here is safe.
+        platform_thread_detach(&thread);
+        arena->async = async;
+    }
+    else
+    {
+        platform_mutex_deinit(&async->mutex);
+        platform_heap_reallocate(0, async, DEF_ALIGN);
+    }
+    return error;
+}
+
+EXTERNAL void arena_stop_async_commit(Arena* arena)
+{
+    PLATFORM_USE_ATOMICS;
+    Arena_Async_Commit* async = arena->async;
+    if(async)
+    {
+        //The helper might have commited past our commit_to. Adopt it so that decommit and release cover it.
+        //After setting stopping we must not touch async anymore since the helper frees it.
+        platform_mutex_lock(&async->mutex);
+        arena->commit_to = async->backed_to;
+        async->stopping = true;
+        atomic_fetch_add(&async->wake, 1);
+        platform_futex_wake((void*) &async->wake);
+        platform_mutex_unlock(&async->mutex);
+        arena->async = NULL;
+    }
+}
+
+EXTERNAL void arena_set_decommit(Arena* arena, isize keep_commited, isize hysteresis)
+{
+    REQUIRE(hysteresis >= 0);
+    if(keep_commited < 0)
+    {
+        arena->decommit_keep = 0;
+        arena->decommit_above = 0;
+    }
+    else
+    {
+        arena->decommit_keep = DIV_CEIL(keep_commited, arena->commit_granularity)*arena->commit_granularity;
+        arena->decommit_above = arena->decommit_keep + MAX(hysteresis, arena->commit_granularity);
+    }
+}
+
 EXTERNAL void arena_commit_ptr(Arena* arena, const void* to, Allocator_Error* error_or_null)
 {
     //If + function call to not pollute the call site with code that will 
@@ -142,6 +394,8 @@ EXTERNAL void* arena_push(Arena* arena, isize size, isize align)
 EXTERNAL void arena_reset_ptr(Arena* arena, const void* position)
 {
     arena->used_to = (u8*) position;
+    if(arena->decommit_above > 0 && arena->commit_to - arena->used_to > arena->decommit_above)
+        _arena_decommit_no_inline(arena);
 }
 
 EXTERNAL void arena_reset(Arena* arena, isize to)
@@ -162,7 +416,8 @@ EXTERNAL void* arena_allocator_func(Allocator* self, isize new_size, void* old_p
     REQUIRE(old_size == arena->used_to - arena->data);
     REQUIRE(is_power_of_two(align));
 
-    arena_reset_ptr(arena, arena->data);
+    //Not arena_reset_ptr since that could decommit the data we are reallocating
+    arena->used_to = arena->data;
     return arena_push_nonzero(arena, new_size, align, error);
 }
 
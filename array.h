@@ -21,6 +21,15 @@
 //    what kind of array it is/if it even is a dynamic array. This is another issue with the stb style.
 //
 // This file is also fully freestanding. To compile the function definitions #define MODULE_IMPL_ALL and include it again in .c file. 
+//
+// Additionally we provide Array_Inline(Type, N) which stores up to N items inside the struct itself and 
+// only allocates once it grows past that. This is useful for the very common case of arrays holding 
+// just a handful of items where the allocation would dominate. It works with all of the macros below.
+// The inline capacity is smuggled into Generic_Array through the size of the pointed to type of INLINE 
+// member (the same trick we use for ALIGN). The inline items always sit right after the Untyped_Array 
+// header so given the header and item align we can find them. 
+// The array is considered inline when its data points to its own inline items. This means inline 
+// array must not be moved in memory (memcpy-ed, returned by value, etc.) while it uses the inline storage!
 
 #if !defined(MODULE_INLINE_ALLOCATOR) && !defined(MODULE_ALLOCATOR) && !defined(MODULE_ALL_COUPLED)
     #define MODULE_INLINE_ALLOCATOR
@@ -63,7 +72,8 @@ typedef struct Untyped_Array {
 typedef struct Generic_Array {   
     Untyped_Array* array;
     uint32_t item_size;                        
-    uint32_t item_align;                    
+    uint16_t item_align;                    
+    uint16_t inline_capacity; //0 for regular arrays
 } Generic_Array;
 
 #define Array_Aligned(Type, align)               \
@@ -76,10 +86,28 @@ typedef struct Generic_Array {
             isize capacity;                      \
         };                                       \
         uint8_t (*ALIGN)[align];                 \
+        uint8_t (*INLINE)[1];                    \
     }                                            \
 
 #define Array(Type) Array_Aligned(Type, __alignof(Type) > 0 ? __alignof(Type) : 8)
 
+//Array storing up to N items inline (without allocating). N must be in [1, UINT16_MAX).
+#define Array_Inline(Type, N)                    \
+    struct {                                     \
+        union {                                  \
+            Untyped_Array untyped;               \
+            struct {                             \
+                Allocator* allocator;            \
+                Type* data;                      \
+                isize count;                     \
+                isize capacity;                  \
+            };                                   \
+            uint8_t (*ALIGN)[__alignof(Type) > 0 ? __alignof(Type) : 8]; \
+            uint8_t (*INLINE)[(N) + 1];          \
+        };                                       \
+        Type inline_data[N];                     \
+    }                                            \
+
 typedef Array(uint8_t)  u8_Array;
 typedef Array(uint16_t) u16_Array;
 typedef Array(uint32_t) u32_Array;
@@ -106,9 +134,9 @@ EXTERNAL void generic_array_reserve(Generic_Array gen, isize to_capacity);
 EXTERNAL void generic_array_append(Generic_Array gen, const void* data, isize data_count);
 
 #ifdef __cplusplus
-    #define array_make_generic(array_ptr) (Generic_Array{&(array_ptr)->untyped, sizeof *(array_ptr)->data, sizeof *(array_ptr)->ALIGN})
+    #define array_make_generic(array_ptr) (Generic_Array{&(array_ptr)->untyped, sizeof *(array_ptr)->data, sizeof *(array_ptr)->ALIGN, sizeof *(array_ptr)->INLINE - 1})
 #else
-    #define array_make_generic(array_ptr) ((Generic_Array){&(array_ptr)->untyped, sizeof *(array_ptr)->data, sizeof *(array_ptr)->ALIGN})
+    #define array_make_generic(array_ptr) ((Generic_Array){&(array_ptr)->untyped, sizeof *(array_ptr)->data, sizeof *(array_ptr)->ALIGN, sizeof *(array_ptr)->INLINE - 1})
 #endif 
 
 #define array_set_capacity(array_ptr, capacity) \
@@ -195,14 +223,30 @@ EXTERNAL void generic_array_append(Generic_Array gen, const void* data, isize da
 #define MODULE_HAS_IMPL_ARRAY
 #include <string.h>
 
+INTERNAL uint8_t* _generic_array_inline_data(Generic_Array gen)
+{
+    size_t offset = (sizeof(Untyped_Array) + gen.item_align - 1) & ~((size_t) gen.item_align - 1);
+    return (uint8_t*) (void*) gen.array + offset;
+}
+
+INTERNAL bool _generic_array_is_inline(Generic_Array gen)
+{
+    return gen.inline_capacity > 0 && gen.array->data == _generic_array_inline_data(gen);
+}
+
 EXTERNAL bool generic_array_is_invariant(Generic_Array gen)
 {
+    bool is_inline = _generic_array_is_inline(gen);
     bool is_capacity_correct = 0 <= gen.array->capacity;
     bool is_size_correct = (0 <= gen.array->count && gen.array->count <= gen.array->capacity);
     #ifndef MODULE_INLINE_ALLOCATOR
-    if(gen.array->capacity > 0)
+    if(gen.array->capacity > 0 && is_inline == false)
         is_capacity_correct = is_capacity_correct && gen.array->allocator != NULL;
     #endif
+    if(is_inline)
+        is_capacity_correct = is_capacity_correct && gen.array->capacity == gen.inline_capacity;
+    else if(gen.inline_capacity > 0 && gen.array->capacity > 0)
+        is_capacity_correct = is_capacity_correct && gen.array->capacity > gen.inline_capacity;
 
     bool is_data_correct = (gen.array->data == NULL) == (gen.array->capacity == 0);
     bool item_size_correct = gen.item_size > 0;
@@ -222,7 +266,7 @@ EXTERNAL void generic_array_init(Generic_Array gen, Allocator* allocator)
 EXTERNAL void generic_array_deinit(Generic_Array gen)
 {
     ASSERT(generic_array_is_invariant(gen));
-    if(gen.array->capacity > 0)
+    if(gen.array->capacity > 0 && _generic_array_is_inline(gen) == false)
         allocator_reallocate(gen.array->allocator, 0, gen.array->data, gen.array->capacity * gen.item_size, gen.item_align);
     
     memset(gen.array, 0, sizeof *gen.array);
@@ -237,16 +281,59 @@ EXTERNAL void generic_array_set_capacity(Generic_Array gen, isize capacity)
     PROFILE_SCOPE()
     {
         ASSERT(generic_array_is_invariant(gen));
-        REQUIRE(capacity >= 0 && gen.array->allocator != NULL);
+        REQUIRE(capacity >= 0);
+
+        //trim the size if too big
+        if(gen.array->count > capacity)
+            gen.array->count = capacity;
 
         isize old_byte_size = gen.item_size * gen.array->capacity;
         isize new_byte_size = gen.item_size * capacity;
-        gen.array->data = (uint8_t*) allocator_reallocate(gen.array->allocator, new_byte_size, gen.array->data, old_byte_size, gen.item_align);
-
-        //trim the size if too big
-        gen.array->capacity = capacity;
-        if(gen.array->count > gen.array->capacity)
-            gen.array->count = gen.array->capacity;
+        if(gen.inline_capacity == 0)
+        {
+            REQUIRE(gen.array->allocator != NULL);
+            gen.array->data = (uint8_t*) allocator_reallocate(gen.array->allocator, new_byte_size, gen.array->data, old_byte_size, gen.item_align);
+            gen.array->capacity = capacity;
+        }
+        //Inline arrays move their items between the inline storage and the allocator.
+        //Their capacity is either 0, inline_capacity or bigger than inline_capacity
+        else
+        {
+            bool was_inline = _generic_array_is_inline(gen);
+            if(capacity > gen.inline_capacity && was_inline == false)
+            {
+                REQUIRE(gen.array->allocator != NULL);
+                gen.array->data = (uint8_t*) allocator_reallocate(gen.array->allocator, new_byte_size, gen.array->data, old_byte_size, gen.item_align);
+                gen.array->capacity = capacity;
+            }
+            else
+            {
+                uint8_t* new_data = NULL;
+                isize new_capacity = 0;
+                if(capacity > gen.inline_capacity)
+                {
+                    REQUIRE(gen.array->allocator != NULL);
+                    new_data = (uint8_t*) allocator_reallocate(gen.array->allocator, new_byte_size, NULL, 0, gen.item_align);
+                    new_capacity = capacity;
+                }
+                else if(capacity > 0)
+                {
+                    new_data = _generic_array_inline_data(gen);
+                    new_capacity = gen.inline_capacity;
+                }
+
+                if(new_data != gen.array->data)
+                {
+                    if(gen.array->count > 0)
+                        memcpy(new_data, gen.array->data, (size_t) (gen.array->count*gen.item_size));
+                    if(was_inline == false && gen.array->capacity > 0)
+                        allocator_reallocate(gen.array->allocator, 0, gen.array->data, old_byte_size, gen.item_align);
+                }
+
+                gen.array->data = new_data;
+                gen.array->capacity = new_capacity;
+            }
+        }
         
         ASSERT(generic_array_is_invariant(gen));
     }
@@ -267,6 +354,14 @@ EXTERNAL void generic_array_reserve(Generic_Array gen, isize to_fit)
     ASSERT(generic_array_is_invariant(gen));
     if(gen.array->capacity > to_fit)
         return;
+
+    //Unlike the allocated storage the inline storage can be filled up completely
+    if(to_fit <= gen.inline_capacity)
+    {
+        if(gen.array->capacity == 0)
+            generic_array_set_capacity(gen, gen.inline_capacity);
+        return;
+    }
         
     isize new_capacity = to_fit;
     isize growth_step = gen.array->capacity * 3/2 + 8;
@@ -0,0 +1,500 @@
+#ifndef MODULE_ARRAY_SIMD
+#define MODULE_ARRAY_SIMD
+
+// Bulk operations over the typed arrays from array.h. Implements filter, gather, scatter and 
+// prefix sum for i32_Array, f32_Array and u64_Array. These are the typical building blocks of
+// columnar query code where the same scalar loop gets written over and over again.
+//
+// Each operation has a scalar implementation and an AVX2 implementation. The AVX2 one is compiled 
+// using function level target attributes so the rest of the codebase does not need to be built 
+// with -mavx2. The path is selected at runtime based on cpuid. Define ARRAY_SIMD_NO_AVX2 to 
+// always use the scalar path (for example when comparing the two). 
+//
+// Filter: 
+//   Is the left packing problem. We compare 8 (or 4 for u64) items at once obtaining a bitmask of 
+//   passing lanes. This mask indexes into a table of permutations that move all passing lanes to the 
+//   front of the register. We store the whole register and advance the output by popcount(mask). 
+//   This means we write up to 8 items past the final count, which is why we reserve a bit more. 
+//   The comparison is expressed as a union of less/equal/greater masks so that the hot loop contains 
+//   no branches and all comparisons go through the same code. Not equal is negated equal because 
+//   of floats: NaN != x is true yet NaN is neither less nor greater than x. 
+//
+// Gather: 
+//   Uses the hardware gather instructions. Indices are u32 and must fit into i32 since gather 
+//   sign extends them. On older AMD chips gather is microcoded and only marginally faster than scalar.
+//
+// Scatter: 
+//   AVX2 has no scatter instruction (thats AVX-512) so both paths are the same scalar loop. 
+//   Its kept for the sake of a complete interface.
+//
+// Prefix sum: 
+//   Inclusive in place prefix sum. We do two shift+add steps within each 128 bit half, then
+//   propagate the sum of the lower half to the upper half and finally add the running carry.
+//   For f32 this changes the order of additions so the results can differ from the sequential 
+//   sum in the last few bits. Integer sums wrap on overflow.
+//
+// This file is freestanding in the same way array.h is.
+
+#include "array.h"
+
+typedef enum Array_Compare {
+    ARRAY_CMP_EQUAL,
+    ARRAY_CMP_NOT_EQUAL,
+    ARRAY_CMP_LESS,
+    ARRAY_CMP_LESS_EQUAL,
+    ARRAY_CMP_GREATER,
+    ARRAY_CMP_GREATER_EQUAL,
+} Array_Compare;
+
+//Appends all items of from for which `item <compare> with` holds to into, keeping their order. 
+//Returns the number of appended items. into must not be the same array as from.
+EXTERNAL isize array_filter_i32(i32_Array* into, i32_Array from, Array_Compare compare, int32_t with);
+EXTERNAL isize array_filter_f32(f32_Array* into, f32_Array from, Array_Compare compare, float with);
+EXTERNAL isize array_filter_u64(u64_Array* into, u64_Array from, Array_Compare compare, uint64_t with);
+
+//Appends from.data[indices.data[i]] for each i to into. All indices must be smaller than from.count and INT32_MAX.
+//into must not be the same array as from.
+EXTERNAL void array_gather_i32(i32_Array* into, i32_Array from, u32_Array indices);
+EXTERNAL void array_gather_f32(f32_Array* into, f32_Array from, u32_Array indices);
+EXTERNAL void array_gather_u64(u64_Array* into, u64_Array from, u32_Array indices);
+
+//Sets into->data[indices.data[i]] = from.data[i] for each i. All indices must be smaller than into->count. 
+//If indices contain duplicates the item with the highest i wins. 
+EXTERNAL void array_scatter_i32(i32_Array* into, i32_Array from, u32_Array indices);
+EXTERNAL void array_scatter_f32(f32_Array* into, f32_Array from, u32_Array indices);
+EXTERNAL void array_scatter_u64(u64_Array* into, u64_Array from, u32_Array indices);
+
+//Replaces each item with the sum of itself and all items before it. Returns the sum of all items.
+EXTERNAL int32_t  array_prefix_sum_i32(i32_Array* array);
+EXTERNAL float    array_prefix_sum_f32(f32_Array* array);
+EXTERNAL uint64_t array_prefix_sum_u64(u64_Array* array);
+
+//Returns true if the AVX2 paths are used.
+EXTERNAL bool array_simd_has_avx2();
+
+//The maximum number of items the filter functions write past the final count of the output array.
+#define ARRAY_SIMD_OVERWRITE 8
+#endif
+
+#if (defined(MODULE_IMPL_ALL) || defined(MODULE_IMPL_ARRAY_SIMD)) && !defined(MODULE_HAS_IMPL_ARRAY_SIMD)
+#define MODULE_HAS_IMPL_ARRAY_SIMD
+
+#if !defined(ARRAY_SIMD_NO_AVX2) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define _ARRAY_SIMD_AVX2
+    #define _ARRAY_SIMD_AVX2_FUNC       __attribute__((target("avx2,popcnt")))
+    #define _ARRAY_SIMD_AVX2_INLINE     __attribute__((target("avx2,popcnt"), always_inline)) inline
+    #define _array_simd_popcount(x)     __builtin_popcount(x)
+    #define _array_simd_cpu_has_avx2()  (__builtin_cpu_supports("avx2") != 0)
+#elif !defined(ARRAY_SIMD_NO_AVX2) && defined(_MSC_VER) && defined(__AVX2__)
+    #include <immintrin.h>
+    #include <intrin.h>
+    #define _ARRAY_SIMD_AVX2
+    #define _ARRAY_SIMD_AVX2_FUNC
+    #define _ARRAY_SIMD_AVX2_INLINE     __forceinline
+    #define _array_simd_popcount(x)     __popcnt(x)
+    #define _array_simd_cpu_has_avx2()  true
+#endif
+
+#define _ARRAY_SIMD_DEFINE_SCALAR(T, suffix)                                                                \
+    INTERNAL isize _array_filter_##suffix##_scalar(T* into, const T* from, isize count, Array_Compare compare, T with) \
+    {                                                                                                       \
+        isize out = 0;                                                                                      \
+        switch(compare) {                                                                                   \
+            case ARRAY_CMP_EQUAL:           for(isize i = 0; i < count; i++) {into[out] = from[i]; out += from[i] == with;} break; \
+            case ARRAY_CMP_NOT_EQUAL:       for(isize i = 0; i < count; i++) {into[out] = from[i]; out += from[i] != with;} break; \
+            case ARRAY_CMP_LESS:            for(isize i = 0; i < count; i++) {into[out] = from[i]; out += from[i] <  with;} break; \
+            case ARRAY_CMP_LESS_EQUAL:      for(isize i = 0; i < count; i++) {into[out] = from[i]; out += from[i] <= with;} break; \
+            case ARRAY_CMP_GREATER:         for(isize i = 0; i < count; i++) {into[out] = from[i]; out += from[i] >  with;} break; \
+            case ARRAY_CMP_GREATER_EQUAL:   for(isize i = 0; i < count; i++) {into[out] = from[i]; out += from[i] >= with;} break; \
+            default: REQUIRE(false && "invalid compare");                                                   \
+        }                                                                                                   \
+        return out;                                                                                         \
+    }                                                                                                       \
+                                                                                                            \
+    INTERNAL void _array_gather_##suffix##_scalar(T* into, const T* from, const uint32_t* indices, isize count) \
+    {                                                                                                       \
+        for(isize i = 0; i < count; i++)                                                                    \
+            into[i] = from[indices[i]];                                                                     \
+    }                                                                                                       \
+                                                                                                            \
+    INTERNAL void _array_scatter_##suffix##_scalar(T* into, const T* from, const uint32_t* indices, isize count) \
+    {                                                                                                       \
+        for(isize i = 0; i < count; i++)                                                                    \
+            into[indices[i]] = from[i];                                                                     \
+    }                                                                                                       \
+
+_ARRAY_SIMD_DEFINE_SCALAR(int32_t, i32)
+_ARRAY_SIMD_DEFINE_SCALAR(float, f32)
+_ARRAY_SIMD_DEFINE_SCALAR(uint64_t, u64)
+
+//Integer sums are done in unsigned to get defined wrap around
+INTERNAL int32_t _array_prefix_sum_i32_scalar(int32_t* items, isize count, int32_t carry)
+{
+    uint32_t sum = (uint32_t) carry;
+    for(isize i = 0; i < count; i++)
+    {
+        sum += (uint32_t) items[i];
+        items[i] = (int32_t) sum;
+    }
+    return (int32_t) sum;
+}
+
+INTERNAL float _array_prefix_sum_f32_scalar(float* items, isize count, float carry)
+{
+    float sum = carry;
+    for(isize i = 0; i < count; i++)
+    {
+        sum += items[i];
+        items[i] = sum;
+    }
+    return sum;
+}
+
+INTERNAL uint64_t _array_prefix_sum_u64_scalar(uint64_t* items, isize count, uint64_t carry)
+{
+    uint64_t sum = carry;
+    for(isize i = 0; i < count; i++)
+    {
+        sum += items[i];
+        items[i] = sum;
+    }
+    return sum;
+}
+
+#ifdef _ARRAY_SIMD_AVX2
+//For each 8 bit mask of passing lanes contains the indices of the passing lanes packed to the front
+// (one index per byte). Unused bytes are zero.
+static const uint64_t _array_simd_compress_table[256] = {
+    0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000001ULL, 0x0000000000000100ULL,
+    0x0000000000000002ULL, 0x0000000000000200ULL, 0x0000000000000201ULL, 0x0000000000020100ULL,
+    0x0000000000000003ULL, 0x0000000000000300ULL, 0x0000000000000301ULL, 0x0000000000030100ULL,
+    0x0000000000000302ULL, 0x0000000000030200ULL, 0x0000000000030201ULL, 0x0000000003020100ULL,
+    0x0000000000000004ULL, 0x0000000000000400ULL, 0x0000000000000401ULL, 0x0000000000040100ULL,
+    0x0000000000000402ULL, 0x0000000000040200ULL, 0x0000000000040201ULL, 0x0000000004020100ULL,
+    0x0000000000000403ULL, 0x0000000000040300ULL, 0x0000000000040301ULL, 0x0000000004030100ULL,
+    0x0000000000040302ULL, 0x0000000004030200ULL, 0x0000000004030201ULL, 0x0000000403020100ULL,
+    0x0000000000000005ULL, 0x0000000000000500ULL, 0x0000000000000501ULL, 0x0000000000050100ULL,
+    0x0000000000000502ULL, 0x0000000000050200ULL, 0x0000000000050201ULL, 0x0000000005020100ULL,
+    0x0000000000000503ULL, 0x0000000000050300ULL, 0x0000000000050301ULL, 0x0000000005030100ULL,
+    0x0000000000050302ULL, 0x0000000005030200ULL, 0x0000000005030201ULL, 0x0000000503020100ULL,
+    0x0000000000000504ULL, 0x0000000000050400ULL, 0x0000000000050401ULL, 0x0000000005040100ULL,
+    0x0000000000050402ULL, 0x0000000005040200ULL, 0x0000000005040201ULL, 0x0000000504020100ULL,
+    0x0000000000050403ULL, 0x0000000005040300ULL, 0x0000000005040301ULL, 0x0000000504030100ULL,
+    0x0000000005040302ULL, 0x0000000504030200ULL, 0x0000000504030201ULL, 0x0000050403020100ULL,
+    0x0000000000000006ULL, 0x0000000000000600ULL, 0x0000000000000601ULL, 0x0000000000060100ULL,
+    0x0000000000000602ULL, 0x0000000000060200ULL, 0x0000000000060201ULL, 0x0000000006020100ULL,
+    0x0000000000000603ULL, 0x0000000000060300ULL, 0x0000000000060301ULL, 0x0000000006030100ULL,
+    0x0000000000060302ULL, 0x0000000006030200ULL, 0x0000000006030201ULL, 0x0000000603020100ULL,
+    0x0000000000000604ULL, 0x0000000000060400ULL, 0x0000000000060401ULL, 0x0000000006040100ULL,
+    0x0000000000060402ULL, 0x0000000006040200ULL, 0x0000000006040201ULL, 0x0000000604020100ULL,
+    0x0000000000060403ULL, 0x0000000006040300ULL, 0x0000000006040301ULL, 0x0000000604030100ULL,
+    0x0000000006040302ULL, 0x0000000604030200ULL, 0x0000000604030201ULL, 0x0000060403020100ULL,
+    0x0000000000000605ULL, 0x0000000000060500ULL, 0x0000000000060501ULL, 0x0000000006050100ULL,
+    0x0000000000060502ULL, 0x0000000006050200ULL, 0x0000000006050201ULL, 0x0000000605020100ULL,
+    0x0000000000060503ULL, 0x0000000006050300ULL, 0x0000000006050301ULL, 0x0000000605030100ULL,
+    0x0000000006050302ULL, 0x0000000605030200ULL, 0x0000000605030201ULL, 0x0000060503020100ULL,
+    0x0000000000060504ULL, 0x0000000006050400ULL, 0x0000000006050401ULL, 0x0000000605040100ULL,
+    0x0000000006050402ULL, 0x0000000605040200ULL, 0x0000000605040201ULL, 0x0000060504020100ULL,
+    0x0000000006050403ULL, 0x0000000605040300ULL, 0x0000000605040301ULL, 0x0000060504030100ULL,
+    0x0000000605040302ULL, 0x0000060504030200ULL, 0x0000060504030201ULL, 0x0006050403020100ULL,
+    0x0000000000000007ULL, 0x0000000000000700ULL, 0x0000000000000701ULL, 0x0000000000070100ULL,
+    0x0000000000000702ULL, 0x0000000000070200ULL, 0x0000000000070201ULL, 0x0000000007020100ULL,
+    0x0000000000000703ULL, 0x0000000000070300ULL, 0x0000000000070301ULL, 0x0000000007030100ULL,
+    0x0000000000070302ULL, 0x0000000007030200ULL, 0x0000000007030201ULL, 0x0000000703020100ULL,
+    0x0000000000000704ULL, 0x0000000000070400ULL, 0x0000000000070401ULL, 0x0000000007040100ULL,
+    0x0000000000070402ULL, 0x0000000007040200ULL, 0x0000000007040201ULL, 0x0000000704020100ULL,
+    0x0000000000070403ULL, 0x0000000007040300ULL, 0x0000000007040301ULL, 0x0000000704030100ULL,
+    0x0000000007040302ULL, 0x0000000704030200ULL, 0x0000000704030201ULL, 0x0000070403020100ULL,
+    0x0000000000000705ULL, 0x0000000000070500ULL, 0x0000000000070501ULL, 0x0000000007050100ULL,
+    0x0000000000070502ULL, 0x0000000007050200ULL, 0x0000000007050201ULL, 0x0000000705020100ULL,
+    0x0000000000070503ULL, 0x0000000007050300ULL, 0x0000000007050301ULL, 0x0000000705030100ULL,
+    0x0000000007050302ULL, 0x0000000705030200ULL, 0x0000000705030201ULL, 0x0000070503020100ULL,
+    0x0000000000070504ULL, 0x0000000007050400ULL, 0x0000000007050401ULL, 0x0000000705040100ULL,
+    0x0000000007050402ULL, 0x0000000705040200ULL, 0x0000000705040201ULL, 0x0000070504020100ULL,
+    0x0000000007050403ULL, 0x0000000705040300ULL, 0x0000000705040301ULL, 0x0000070504030100ULL,
+    0x0000000705040302ULL, 0x0000070504030200ULL, 0x0000070504030201ULL, 0x0007050403020100ULL,
+    0x0000000000000706ULL, 0x0000000000070600ULL, 0x0000000000070601ULL, 0x0000000007060100ULL,
+    0x0000000000070602ULL, 0x0000000007060200ULL, 0x0000000007060201ULL, 0x0000000706020100ULL,
+    0x0000000000070603ULL, 0x0000000007060300ULL, 0x0000000007060301ULL, 0x0000000706030100ULL,
+    0x0000000007060302ULL, 0x0000000706030200ULL, 0x0000000706030201ULL, 0x0000070603020100ULL,
+    0x0000000000070604ULL, 0x0000000007060400ULL, 0x0000000007060401ULL, 0x0000000706040100ULL,
+    0x0000000007060402ULL, 0x0000000706040200ULL, 0x0000000706040201ULL, 0x0000070604020100ULL,
+    0x0000000007060403ULL, 0x0000000706040300ULL, 0x0000000706040301ULL, 0x0000070604030100ULL,
+    0x0000000706040302ULL, 0x0000070604030200ULL, 0x0000070604030201ULL, 0x0007060403020100ULL,
+    0x0000000000070605ULL, 0x0000000007060500ULL, 0x0000000007060501ULL, 0x0000000706050100ULL,
+    0x0000000007060502ULL, 0x0000000706050200ULL, 0x0000000706050201ULL, 0x0000070605020100ULL,
+    0x0000000007060503ULL, 0x0000000706050300ULL, 0x0000000706050301ULL, 0x0000070605030100ULL,
+    0x0000000706050302ULL, 0x0000070605030200ULL, 0x0000070605030201ULL, 0x0007060503020100ULL,
+    0x0000000007060504ULL, 0x0000000706050400ULL, 0x0000000706050401ULL, 0x0000070605040100ULL,
+    0x0000000706050402ULL, 0x0000070605040200ULL, 0x0000070605040201ULL, 0x0007060504020100ULL,
+    0x0000000706050403ULL, 0x0000070605040300ULL, 0x0000070605040301ULL, 0x0007060504030100ULL,
+    0x0000070605040302ULL, 0x0007060504030200ULL, 0x0007060504030201ULL, 0x0706050403020100ULL,
+};
+
+typedef struct _Array_Simd_Compare {
+    uint32_t less;
+    uint32_t equal;
+    uint32_t greater;
+    uint32_t negate;
+} _Array_Simd_Compare;
+
+INTERNAL _Array_Simd_Compare _array_simd_compare_masks(Array_Compare compare)
+{
+    _Array_Simd_Compare out = {0};
+    switch(compare) {
+        case ARRAY_CMP_EQUAL:           out.equal = 0xFF; break;
+        case ARRAY_CMP_NOT_EQUAL:       out.equal = 0xFF; out.negate = 0xFF; break;
+        case ARRAY_CMP_LESS:            out.less = 0xFF; break;
+        case ARRAY_CMP_LESS_EQUAL:      out.less = 0xFF; out.equal = 0xFF; break;
+        case ARRAY_CMP_GREATER:         out.greater = 0xFF; break;
+        case ARRAY_CMP_GREATER_EQUAL:   out.greater = 0xFF; out.equal = 0xFF; break;
+        default: REQUIRE(false && "invalid compare");
+    }
+    return out;
+}
+
+INTERNAL _ARRAY_SIMD_AVX2_INLINE __m256i _array_simd_compress_permutation(uint32_t mask)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (const void*) &_array_simd_compress_table[mask]));
+}
+
+INTERNAL _ARRAY_SIMD_AVX2_FUNC isize _array_filter_i32_avx2(int32_t* into, const int32_t* from, isize count, Array_Compare compare, int32_t with)
+{
+    _Array_Simd_Compare masks = _array_simd_compare_masks(compare);
+    __m256i with_vec = _mm256_set1_epi32(with);
+    isize out = 0;
+    isize i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i items = _mm256_loadu_si256((const __m256i*) (const void*) (from + i));
+        uint32_t less    = (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(with_vec, items)));
+        uint32_t equal   = (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(items, with_vec)));
+        uint32_t greater = (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(items, with_vec)));
+        uint32_t mask = ((less & masks.less) | (equal & masks.equal) | (greater & masks.greater)) ^ masks.negate;
+
+        __m256i packed = _mm256_permutevar8x32_epi32(items, _array_simd_compress_permutation(mask));
+        _mm256_storeu_si256((__m256i*) (void*) (into + out), packed);
+        out += _array_simd_popcount(mask);
+    }
+
+    return out + _array_filter_i32_scalar(into + out, from + i, count - i, compare, with);
+}
+
+INTERNAL _ARRAY_SIMD_AVX2_FUNC isize _array_filter_f32_avx2(float* into, const float* from, isize count, Array_Compare compare, float with)
+{
+    _Array_Simd_Compare masks = _array_simd_compare_masks(compare);
+    __m256 with_vec = _mm256_set1_ps(with);
+    isize out = 0;
+    isize i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 items = _mm256_loadu_ps(from + i);
+        uint32_t less    = (uint32_t) _mm256_movemask_ps(_mm256_cmp_ps(items, with_vec, _CMP_LT_OQ));
+        uint32_t equal   = (uint32_t) _mm256_movemask_ps(_mm256_cmp_ps(items, with_vec, _CMP_EQ_OQ));
+        uint32_t greater = (uint32_t) _mm256_movemask_ps(_mm256_cmp_ps(items, with_vec, _CMP_GT_OQ));
+        uint32_t mask = ((less & masks.less) | (equal & masks.equal) | (greater & masks.greater)) ^ masks.negate;
+
+        __m256 packed = _mm256_permutevar8x32_ps(items, _array_simd_compress_permutation(mask));
+        _mm256_storeu_ps(into + out, packed);
+        out += _array_simd_popcount(mask);
+    }
+
+    return out + _array_filter_f32_scalar(into + out, from + i, count - i, compare, with);
+}
+
+INTERNAL _ARRAY_SIMD_AVX2_FUNC isize _array_filter_u64_avx2(uint64_t* into, const uint64_t* from, isize count, Array_Compare compare, uint64_t with)
+{
+    //AVX2 only has signed 64 bit compare. Flipping the sign bit of both sides 
+    // makes the signed compare give the unsigned result. 
+    //Each 64 bit lane produces two bits in the mask so we can reuse the 32 bit compress table.
+    _Array_Simd_Compare masks = _array_simd_compare_masks(compare);
+    __m256i sign = _mm256_set1_epi64x((long long) 0x8000000000000000ULL);
+    __m256i with_vec = _mm256_xor_si256(_mm256_set1_epi64x((long long) with), sign);
+    isize out = 0;
+    isize i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m256i items = _mm256_loadu_si256((const __m256i*) (const void*) (from + i));
+        __m256i flipped = _mm256_xor_si256(items, sign);
+        uint32_t less    = (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi64(with_vec, flipped)));
+        uint32_t equal   = (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi64(flipped, with_vec)));
+        uint32_t greater = (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi64(flipped, with_vec)));
+        uint32_t mask = ((less & masks.less) | (equal & masks.equal) | (greater & masks.greater)) ^ masks.negate;
+
+        __m256i packed = _mm256_permutevar8x32_epi32(items, _array_simd_compress_permutation(mask));
+        _mm256_storeu_si256((__m256i*) (void*) (into + out), packed);
+        out += _array_simd_popcount(mask) / 2;
+    }
+
+    return out + _array_filter_u64_scalar(into + out, from + i, count - i, compare, with);
+}
+
+INTERNAL _ARRAY_SIMD_AVX2_FUNC void _array_gather_i32_avx2(int32_t* into, const int32_t* from, const uint32_t* indices, isize count)
+{
+    isize i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i index = _mm256_loadu_si256((const __m256i*) (const void*) (indices + i));
+        __m256i items = _mm256_i32gather_epi32((const int*) (const void*) from, index, 4);
+        _mm256_storeu_si256((__m256i*) (void*) (into + i), items);
+    }
+    _array_gather_i32_scalar(into + i, from, indices + i, count - i);
+}
+
+INTERNAL _ARRAY_SIMD_AVX2_FUNC void _array_gather_f32_avx2(float* into, const float* from, const uint32_t* indices, isize count)
+{
+    isize i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i index = _mm256_loadu_si256((const __m256i*) (const void*) (indices + i));
+        _mm256_storeu_ps(into + i, _mm256_i32gather_ps(from, index, 4));
+    }
+    _array_gather_f32_scalar(into + i, from, indices + i, count - i);
+}
+
+INTERNAL _ARRAY_SIMD_AVX2_FUNC void _array_gather_u64_avx2(uint64_t* into, const uint64_t* from, const uint32_t* indices, isize count)
+{
+    isize i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i index = _mm_loadu_si128((const __m128i*) (const void*) (indices + i));
+        __m256i items = _mm256_i32gather_epi64((const long long*) (const void*) from, index, 8);
+        _mm256_storeu_si256((__m256i*) (void*) (into + i), items);
+    }
+    _array_gather_u64_scalar(into + i, from, indices + i, count - i);
+}
+
+//There is no scatter in AVX2
+#define _array_scatter_i32_avx2 _array_scatter_i32_scalar
+#define _array_scatter_f32_avx2 _array_scatter_f32_scalar
+#define _array_scatter_u64_avx2 _array_scatter_u64_scalar
+
+INTERNAL _ARRAY_SIMD_AVX2_FUNC int32_t _array_prefix_sum_i32_avx2(int32_t* items, isize count, int32_t carry)
+{
+    __m256i carry_vec = _mm256_set1_epi32(carry);
+    __m256i last_lane = _mm256_set1_epi32(7);
+    isize i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (const void*) (items + i));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+
+        //Add the last item of the lower half to the upper half
+        __m256i half_sum = _mm256_shuffle_epi32(x, 0xFF);
+        x = _mm256_add_epi32(x, _mm256_permute2x128_si256(half_sum, half_sum, 0x08));
+        x = _mm256_add_epi32(x, carry_vec);
+
+        _mm256_storeu_si256((__m256i*) (void*) (items + i), x);
+        carry_vec = _mm256_permutevar8x32_epi32(x, last_lane);
+    }
+
+    carry = _mm_cvtsi128_si32(_mm256_castsi256_si128(carry_vec));
+    return _array_prefix_sum_i32_scalar(items + i, count - i, carry);
+}
+
+INTERNAL _ARRAY_SIMD_AVX2_FUNC float _array_prefix_sum_f32_avx2(float* items, isize count, float carry)
+{
+    __m256 carry_vec = _mm256_set1_ps(carry);
+    __m256i last_lane = _mm256_set1_epi32(7);
+    isize i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(items + i);
+        x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 4)));
+        x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 8)));
+
+        __m256 half_sum = _mm256_permute_ps(x, 0xFF);
+        x = _mm256_add_ps(x, _mm256_permute2f128_ps(half_sum, half_sum, 0x08));
+        x = _mm256_add_ps(x, carry_vec);
+
+        _mm256_storeu_ps(items + i, x);
+        carry_vec = _mm256_permutevar8x32_ps(x, last_lane);
+    }
+
+    carry = _mm_cvtss_f32(_mm256_castps256_ps128(carry_vec));
+    return _array_prefix_sum_f32_scalar(items + i, count - i, carry);
+}
+
+INTERNAL _ARRAY_SIMD_AVX2_FUNC uint64_t _array_prefix_sum_u64_avx2(uint64_t* items, isize count, uint64_t carry)
+{
+    __m256i carry_vec = _mm256_set1_epi64x((long long) carry);
+    isize i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (const void*) (items + i));
+        x = _mm256_add_epi64(x, _mm256_slli_si256(x, 8));
+
+        __m256i half_sum = _mm256_permute4x64_epi64(x, 0x55);
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_setzero_si256(), half_sum, 0xF0));
+        x = _mm256_add_epi64(x, carry_vec);
+
+        _mm256_storeu_si256((__m256i*) (void*) (items + i), x);
+        carry_vec = _mm256_permute4x64_epi64(x, 0xFF);
+    }
+
+    _mm_storel_epi64((__m128i*) (void*) &carry, _mm256_castsi256_si128(carry_vec));
+    return _array_prefix_sum_u64_scalar(items + i, count - i, carry);
+}
+
+#define _ARRAY_SIMD_CALL(name, ...) (array_simd_has_avx2() ? name##_avx2(__VA_ARGS__) : name##_scalar(__VA_ARGS__))
+#else
+#define _ARRAY_SIMD_CALL(name, ...) name##_scalar(__VA_ARGS__)
+#endif
+
+EXTERNAL bool array_simd_has_avx2()
+{
+    #ifdef _ARRAY_SIMD_AVX2
+        return _array_simd_cpu_has_avx2();
+    #else
+        return false;
+    #endif
+}
+
+INTERNAL void _array_simd_check_indices(const uint32_t* indices, isize count, isize bound)
+{
+    #ifdef DO_BOUNDS_CHECKS
+        for(isize i = 0; i < count; i++)
+            ASSERT_BOUNDS((isize) indices[i] < bound && indices[i] <= INT32_MAX);
+    #else
+        (void) indices; (void) count; (void) bound;
+    #endif
+}
+
+#define _ARRAY_SIMD_DEFINE_EXTERNAL(T, suffix)                                                              \
+    EXTERNAL isize array_filter_##suffix(suffix##_Array* into, suffix##_Array from, Array_Compare compare, T with) \
+    {                                                                                                       \
+        REQUIRE(into->data != from.data || from.count == 0);                                                \
+        array_reserve(into, into->count + from.count + ARRAY_SIMD_OVERWRITE);                               \
+        isize filtered = _ARRAY_SIMD_CALL(_array_filter_##suffix, into->data + into->count, from.data, from.count, compare, with); \
+        into->count += filtered;                                                                            \
+        return filtered;                                                                                    \
+    }                                                                                                       \
+                                                                                                            \
+    EXTERNAL void array_gather_##suffix(suffix##_Array* into, suffix##_Array from, u32_Array indices)       \
+    {                                                                                                       \
+        REQUIRE(into->data != from.data || from.count == 0);                                                \
+        _array_simd_check_indices(indices.data, indices.count, from.count);                                 \
+        array_reserve(into, into->count + indices.count);                                                   \
+        _ARRAY_SIMD_CALL(_array_gather_##suffix, into->data + into->count, from.data, indices.data, indices.count); \
+        into->count += indices.count;                                                                       \
+    }                                                                                                       \
+                                                                                                            \
+    EXTERNAL void array_scatter_##suffix(suffix##_Array* into, suffix##_Array from, u32_Array indices)      \
+    {                                                                                                       \
+        REQUIRE(from.count == indices.count);                                                               \
+        _array_simd_check_indices(indices.data, indices.count, into->count);                                \
+        _ARRAY_SIMD_CALL(_array_scatter_##suffix, into->data, from.data, indices.data, indices.count);      \
+    }                                                                                                       \
+                                                                                                            \
+    EXTERNAL T array_prefix_sum_##suffix(suffix##_Array* array)                                             \
+    {                                                                                                       \
+        return _ARRAY_SIMD_CALL(_array_prefix_sum_##suffix, array->data, array->count, 0);                  \
+    }                                                                                                       \
+
+_ARRAY_SIMD_DEFINE_EXTERNAL(int32_t, i32)
+_ARRAY_SIMD_DEFINE_EXTERNAL(float, f32)
+_ARRAY_SIMD_DEFINE_EXTERNAL(uint64_t, u64)
+
+#endif
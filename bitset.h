@@ -0,0 +1,957 @@
+#ifndef MODULE_BITSET
+#define MODULE_BITSET
+
+// Dense bitset stored in u64_Array together with a roaring style compressed variant for sparse sets.
+//
+// Bitset:
+//   Bit i lives in words.data[i/64] at position i%64. Bits past bit_count are always kept zero so that
+//   counting and searching can work on whole words without any special casing. Searching for the next
+//   set bit skips whole zero words and uses platform_find_first_set_bit64 within a word. Iterating a
+//   filter thus costs roughly the number of words plus the number of set bits instead of number of bits:
+//
+//   for(isize i = bitset_find_next_set(&filter, 0); i != -1; i = bitset_find_next_set(&filter, i + 1))
+//       ...
+//
+//   or use bitset_append_indices() to get u32 indices directly usable with array_gather_XXX() from array_simd.h.
+//
+//   Combining bitsets (and, or, andnot, xor) works on bit ranges. The partial edge words are masked and
+//   the whole words in between are processed 4 at a time with AVX2 when available. This uses the same
+//   runtime dispatch as array_simd.h and is also disabled by ARRAY_SIMD_NO_AVX2.
+//
+// Rank/select:
+//   rank(i) is the number of set bits below i. select(k) is the position of the k-th set bit (counting from 0).
+//   Both use a directory holding the number of set bits before each group of BITSET_RANK_WORDS words.
+//   rank is then one directory lookup plus at most BITSET_RANK_WORDS popcounts. select binary searches
+//   the directory and then scans a single group. The directory has to be (re)built using bitset_build_ranks()
+//   after the bitset is modified. All functions in this file that modify the bitset invalidate the directory,
+//   direct writes into words dont so be careful!
+//
+// Compressed_Bitset:
+//   Roaring bitmap over u32 values. The key space is split into chunks of 2^16 values by the upper 16 bits.
+//   Each non empty chunk is stored in a container. Containers are kept sorted by key. Containers with at most
+//   COMPRESSED_BITSET_MAX_ARRAY values store sorted array of the lower 16 bits, the rest store a 2^16 bit (8KB)
+//   bitmap. The array is smaller exactly when it holds at most 4096 values so each container takes at most 8KB
+//   and a sparse set takes about 2B per value.
+//   Set operations are done container by container. For simplicity we always expand both containers into
+//   temporary bitmaps, combine them using the same word kernels as Bitset and store the result in whichever
+//   form is smaller. Containers present in only one of the sets are moved or copied without expanding.
+
+#include "array.h"
+#include "array_simd.h"
+
+#define BITSET_RANK_WORDS 8
+
+typedef struct Bitset {
+    u64_Array words;
+    u64_Array ranks; //ranks.data[g] = number of set bits in words [0, g*BITSET_RANK_WORDS). Empty when not built.
+    isize bit_count;
+} Bitset;
+
+typedef enum Bitset_Op {
+    BITSET_AND,
+    BITSET_OR,
+    BITSET_ANDNOT, //into & ~with
+    BITSET_XOR,
+} Bitset_Op;
+
+EXTERNAL void  bitset_init(Bitset* bitset, Allocator* alloc);
+EXTERNAL void  bitset_deinit(Bitset* bitset);
+//Changes the number of bits. Newly added bits are zero.
+EXTERNAL void  bitset_resize(Bitset* bitset, isize bit_count);
+EXTERNAL void  bitset_fill(Bitset* bitset, bool to);
+EXTERNAL void  bitset_fill_range(Bitset* bitset, isize from_bit, isize to_bit, bool to);
+
+EXTERNAL bool  bitset_get(const Bitset* bitset, isize i);
+EXTERNAL void  bitset_set(Bitset* bitset, isize i);
+EXTERNAL void  bitset_unset(Bitset* bitset, isize i);
+EXTERNAL void  bitset_assign(Bitset* bitset, isize i, bool to);
+
+EXTERNAL isize bitset_count(const Bitset* bitset);
+EXTERNAL isize bitset_count_range(const Bitset* bitset, isize from_bit, isize to_bit);
+//Returns the index of the first set (unset) bit at or after from_bit or -1 if there is none.
+EXTERNAL isize bitset_find_next_set(const Bitset* bitset, isize from_bit);
+EXTERNAL isize bitset_find_next_unset(const Bitset* bitset, isize from_bit);
+//Appends indices of all set bits within [from_bit, to_bit) to into. Returns the number of appended indices.
+EXTERNAL isize bitset_append_indices(const Bitset* bitset, u32_Array* into, isize from_bit, isize to_bit);
+
+//Sets bits of into within [from_bit, to_bit) to `into <op> with`. Both bitsets must have at least to_bit bits.
+EXTERNAL void  bitset_combine(Bitset* into, const Bitset* with, Bitset_Op op, isize from_bit, isize to_bit);
+
+EXTERNAL void  bitset_build_ranks(Bitset* bitset);
+//Returns the number of set bits in [0, i). Requires built ranks.
+EXTERNAL isize bitset_rank(const Bitset* bitset, isize i);
+//Returns the index of the k-th set bit or -1 if there are not enough set bits. Requires built ranks.
+EXTERNAL isize bitset_select(const Bitset* bitset, isize k);
+
+EXTERNAL void  bitset_test_invariants(const Bitset* bitset);
+
+#define COMPRESSED_BITSET_MAX_ARRAY         4096
+#define COMPRESSED_BITSET_CONTAINER_WORDS   1024
+
+typedef struct Compressed_Bitset_Container {
+    u16_Array values; //sorted lower 16 bits when in array form
+    u64_Array words;  //COMPRESSED_BITSET_CONTAINER_WORDS words when in bitmap form
+    u32 key;          //upper 16 bits of all values in this container
+    u32 count;
+} Compressed_Bitset_Container;
+
+typedef Array(Compressed_Bitset_Container) Compressed_Bitset_Container_Array;
+
+typedef struct Compressed_Bitset {
+    Allocator* allocator;
+    Compressed_Bitset_Container_Array containers;
+    isize count;
+} Compressed_Bitset;
+
+EXTERNAL void  compressed_bitset_init(Compressed_Bitset* bitset, Allocator* alloc);
+EXTERNAL void  compressed_bitset_deinit(Compressed_Bitset* bitset);
+EXTERNAL void  compressed_bitset_clear(Compressed_Bitset* bitset);
+
+EXTERNAL bool  compressed_bitset_get(const Compressed_Bitset* bitset, u32 i);
+//Returns true if the bit was not set before.
+EXTERNAL bool  compressed_bitset_set(Compressed_Bitset* bitset, u32 i);
+//Returns true if the bit was set before.
+EXTERNAL bool  compressed_bitset_unset(Compressed_Bitset* bitset, u32 i);
+//Returns the first set value at or after from or -1 if there is none.
+EXTERNAL isize compressed_bitset_find_next_set(const Compressed_Bitset* bitset, isize from);
+
+//Sets into to `into <op> with`.
+EXTERNAL void  compressed_bitset_combine(Compressed_Bitset* into, const Compressed_Bitset* with, Bitset_Op op);
+
+//Converts between the representations. from_bitset requires the bitset to have at most 2^32 bits.
+// to_bitset clears into and grows it if needed to fit all values.
+EXTERNAL void  compressed_bitset_from_bitset(Compressed_Bitset* into, const Bitset* from);
+EXTERNAL void  compressed_bitset_to_bitset(Bitset* into, const Compressed_Bitset* from);
+
+EXTERNAL void  compressed_bitset_test_invariants(const Compressed_Bitset* bitset);
+#endif
+
+#if (defined(MODULE_IMPL_ALL) || defined(MODULE_IMPL_BITSET)) && !defined(MODULE_HAS_IMPL_BITSET)
+#define MODULE_HAS_IMPL_BITSET
+
+#if !defined(ARRAY_SIMD_NO_AVX2) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define _BITSET_AVX2
+    #define _BITSET_AVX2_FUNC       __attribute__((target("avx2,popcnt")))
+    #define _bitset_popcount64(x)   __builtin_popcountll(x)
+#elif !defined(ARRAY_SIMD_NO_AVX2) && defined(_MSC_VER) && defined(__AVX2__)
+    #include <immintrin.h>
+    #include <intrin.h>
+    #define _BITSET_AVX2
+    #define _BITSET_AVX2_FUNC
+    #define _bitset_popcount64(x)   __popcnt64(x)
+#endif
+
+INTERNAL u64 _bitset_combine_word(u64 a, u64 b, Bitset_Op op)
+{
+    switch(op) {
+        case BITSET_AND:    return a & b;
+        case BITSET_OR:     return a | b;
+        case BITSET_ANDNOT: return a & ~b;
+        case BITSET_XOR:    return a ^ b;
+        default: REQUIRE(false && "invalid op"); return a;
+    }
+}
+
+INTERNAL void _bitset_combine_words_scalar(u64* into, const u64* with, isize count, Bitset_Op op)
+{
+    switch(op) {
+        case BITSET_AND:    for(isize i = 0; i < count; i++) into[i] &= with[i]; break;
+        case BITSET_OR:     for(isize i = 0; i < count; i++) into[i] |= with[i]; break;
+        case BITSET_ANDNOT: for(isize i = 0; i < count; i++) into[i] &= ~with[i]; break;
+        case BITSET_XOR:    for(isize i = 0; i < count; i++) into[i] ^= with[i]; break;
+        default: REQUIRE(false && "invalid op");
+    }
+}
+
+INTERNAL isize _bitset_popcount_words_scalar(const u64* words, isize count)
+{
+    isize sum = 0;
+    for(isize i = 0; i < count; i++)
+        sum += platform_pop_count64(words[i]);
+    return sum;
+}
+
+#ifdef _BITSET_AVX2
+    #define _BITSET_AVX2_LOOP(instruction)                                                  \
+        for(; i + 4 <= count; i += 4) {                                                     \
+            __m256i a = _mm256_loadu_si256((const __m256i*) (void*) (into + i));            \
+            __m256i b = _mm256_loadu_si256((const __m256i*) (const void*) (with + i));      \
+            _mm256_storeu_si256((__m256i*) (void*) (into + i), instruction);                \
+        }                                                                                   \
+
+    _BITSET_AVX2_FUNC
+    INTERNAL void _bitset_combine_words_avx2(u64* into, const u64* with, isize count, Bitset_Op op)
+    {
+        isize i = 0;
+        switch(op) {
+            case BITSET_AND:    _BITSET_AVX2_LOOP(_mm256_and_si256(a, b)); break;
+            case BITSET_OR:     _BITSET_AVX2_LOOP(_mm256_or_si256(a, b)); break;
+            case BITSET_ANDNOT: _BITSET_AVX2_LOOP(_mm256_andnot_si256(b, a)); break;
+            case BITSET_XOR:    _BITSET_AVX2_LOOP(_mm256_xor_si256(a, b)); break;
+            default: REQUIRE(false && "invalid op");
+        }
+        _bitset_combine_words_scalar(into + i, with + i, count - i, op);
+    }
+
+    //Uses the hardware popcnt instruction with four independent accumulators
+    _BITSET_AVX2_FUNC
+    INTERNAL isize _bitset_popcount_words_avx2(const u64* words, isize count)
+    {
+        u64 sums[4] = {0};
+        isize i = 0;
+        for(; i + 4 <= count; i += 4)
+        {
+            sums[0] += (u64) _bitset_popcount64(words[i + 0]);
+            sums[1] += (u64) _bitset_popcount64(words[i + 1]);
+            sums[2] += (u64) _bitset_popcount64(words[i + 2]);
+            sums[3] += (u64) _bitset_popcount64(words[i + 3]);
+        }
+        for(; i < count; i++)
+            sums[0] += (u64) _bitset_popcount64(words[i]);
+
+        return (isize) (sums[0] + sums[1] + sums[2] + sums[3]);
+    }
+
+    #define _BITSET_CALL(name, ...) (array_simd_has_avx2() ? name##_avx2(__VA_ARGS__) : name##_scalar(__VA_ARGS__))
+#else
+    #define _BITSET_CALL(name, ...) name##_scalar(__VA_ARGS__)
+#endif
+
+INTERNAL void _bitset_check_invariants(const Bitset* bitset)
+{
+    #if defined(DO_ASSERTS_SLOW)
+        bitset_test_invariants(bitset);
+    #else
+        (void) bitset;
+    #endif
+}
+
+//Mask of bits [from_bit%64, 64) within the first word of a range
+INTERNAL u64 _bitset_first_mask(isize from_bit)
+{
+    return ~(u64) 0 << (from_bit & 63);
+}
+
+//Mask of bits [0, (to_bit - 1)%64] within the last word of a range
+INTERNAL u64 _bitset_last_mask(isize to_bit)
+{
+    return ~(u64) 0 >> (63 - ((to_bit - 1) & 63));
+}
+
+INTERNAL void _bitset_invalidate_ranks(Bitset* bitset)
+{
+    bitset->ranks.count = 0;
+}
+
+EXTERNAL void bitset_init(Bitset* bitset, Allocator* alloc)
+{
+    bitset_deinit(bitset);
+    array_init(&bitset->words, alloc);
+    array_init(&bitset->ranks, alloc);
+}
+
+EXTERNAL void bitset_deinit(Bitset* bitset)
+{
+    array_deinit(&bitset->words);
+    array_deinit(&bitset->ranks);
+    bitset->bit_count = 0;
+}
+
+EXTERNAL void bitset_resize(Bitset* bitset, isize bit_count)
+{
+    REQUIRE(bit_count >= 0);
+    _bitset_invalidate_ranks(bitset);
+    array_resize(&bitset->words, (bit_count + 63)/64);
+    bitset->bit_count = bit_count;
+
+    //clear the bits past the end in case we shrunk
+    if(bit_count % 64)
+        bitset->words.data[bitset->words.count - 1] &= _bitset_last_mask(bit_count);
+    _bitset_check_invariants(bitset);
+}
+
+EXTERNAL void bitset_fill_range(Bitset* bitset, isize from_bit, isize to_bit, bool to)
+{
+    REQUIRE(0 <= from_bit && from_bit <= to_bit && to_bit <= bitset->bit_count);
+    if(from_bit == to_bit)
+        return;
+
+    _bitset_invalidate_ranks(bitset);
+    u64* words = bitset->words.data;
+    isize first = from_bit >> 6;
+    isize last = (to_bit - 1) >> 6;
+    u64 first_mask = _bitset_first_mask(from_bit);
+    u64 last_mask = _bitset_last_mask(to_bit);
+    if(first == last)
+        first_mask = last_mask = first_mask & last_mask;
+
+    if(to)
+    {
+        words[first] |= first_mask;
+        words[last] |= last_mask;
+    }
+    else
+    {
+        words[first] &= ~first_mask;
+        words[last] &= ~last_mask;
+    }
+
+    if(last - first > 1)
+        memset(words + first + 1, to ? 0xFF : 0, (size_t) (last - first - 1)*sizeof(u64));
+    _bitset_check_invariants(bitset);
+}
+
+EXTERNAL void bitset_fill(Bitset* bitset, bool to)
+{
+    bitset_fill_range(bitset, 0, bitset->bit_count, to);
+}
+
+EXTERNAL bool bitset_get(const Bitset* bitset, isize i)
+{
+    CHECK_BOUNDS(i, bitset->bit_count);
+    return (bitset->words.data[i >> 6] >> (i & 63)) & 1;
+}
+
+EXTERNAL void bitset_set(Bitset* bitset, isize i)
+{
+    CHECK_BOUNDS(i, bitset->bit_count);
+    _bitset_invalidate_ranks(bitset);
+    bitset->words.data[i >> 6] |= (u64) 1 << (i & 63);
+}
+
+EXTERNAL void bitset_unset(Bitset* bitset, isize i)
+{
+    CHECK_BOUNDS(i, bitset->bit_count);
+    _bitset_invalidate_ranks(bitset);
+    bitset->words.data[i >> 6] &= ~((u64) 1 << (i & 63));
+}
+
+EXTERNAL void bitset_assign(Bitset* bitset, isize i, bool to)
+{
+    if(to)
+        bitset_set(bitset, i);
+    else
+        bitset_unset(bitset, i);
+}
+
+EXTERNAL isize bitset_count_range(const Bitset* bitset, isize from_bit, isize to_bit)
+{
+    REQUIRE(0 <= from_bit && from_bit <= to_bit && to_bit <= bitset->bit_count);
+    if(from_bit == to_bit)
+        return 0;
+
+    const u64* words = bitset->words.data;
+    isize first = from_bit >> 6;
+    isize last = (to_bit - 1) >> 6;
+    u64 first_mask = _bitset_first_mask(from_bit);
+    u64 last_mask = _bitset_last_mask(to_bit);
+    if(first == last)
+        return platform_pop_count64(words[first] & first_mask & last_mask);
+
+    isize count = platform_pop_count64(words[first] & first_mask) + platform_pop_count64(words[last] & last_mask);
+    count += _BITSET_CALL(_bitset_popcount_words, words + first + 1, last - first - 1);
+    return count;
+}
+
+EXTERNAL isize bitset_count(const Bitset* bitset)
+{
+    return _BITSET_CALL(_bitset_popcount_words, bitset->words.data, bitset->words.count);
+}
+
+EXTERNAL isize bitset_find_next_set(const Bitset* bitset, isize from_bit)
+{
+    REQUIRE(from_bit >= 0);
+    if(from_bit >= bitset->bit_count)
+        return -1;
+
+    isize w = from_bit >> 6;
+    u64 word = bitset->words.data[w] & _bitset_first_mask(from_bit);
+    for(;;)
+    {
+        if(word)
+            return (w << 6) + platform_find_first_set_bit64(word);
+        if(++w >= bitset->words.count)
+            return -1;
+        word = bitset->words.data[w];
+    }
+}
+
+EXTERNAL isize bitset_find_next_unset(const Bitset* bitset, isize from_bit)
+{
+    REQUIRE(from_bit >= 0);
+    if(from_bit >= bitset->bit_count)
+        return -1;
+
+    isize w = from_bit >> 6;
+    u64 word = ~bitset->words.data[w] & _bitset_first_mask(from_bit);
+    for(;;)
+    {
+        if(word)
+        {
+            isize out = (w << 6) + platform_find_first_set_bit64(word);
+            return out < bitset->bit_count ? out : -1;
+        }
+        if(++w >= bitset->words.count)
+            return -1;
+        word = ~bitset->words.data[w];
+    }
+}
+
+EXTERNAL isize bitset_append_indices(const Bitset* bitset, u32_Array* into, isize from_bit, isize to_bit)
+{
+    REQUIRE(0 <= from_bit && from_bit <= to_bit && to_bit <= bitset->bit_count);
+    REQUIRE(to_bit <= (isize) UINT32_MAX + 1, "indices must fit into u32");
+    if(from_bit == to_bit)
+        return 0;
+
+    const u64* words = bitset->words.data;
+    isize first = from_bit >> 6;
+    isize last = (to_bit - 1) >> 6;
+    isize count_before = into->count;
+    array_reserve(into, into->count + bitset_count_range(bitset, from_bit, to_bit));
+    for(isize w = first; w <= last; w++)
+    {
+        u64 word = words[w];
+        if(w == first)
+            word &= _bitset_first_mask(from_bit);
+        if(w == last)
+            word &= _bitset_last_mask(to_bit);
+
+        for(; word; word &= word - 1)
+            into->data[into->count++] = (u32) ((w << 6) + platform_find_first_set_bit64(word));
+    }
+
+    return into->count - count_before;
+}
+
+EXTERNAL void bitset_combine(Bitset* into, const Bitset* with, Bitset_Op op, isize from_bit, isize to_bit)
+{
+    REQUIRE(0 <= from_bit && from_bit <= to_bit && to_bit <= into->bit_count && to_bit <= with->bit_count);
+    if(from_bit == to_bit)
+        return;
+
+    _bitset_invalidate_ranks(into);
+    u64* a = into->words.data;
+    const u64* b = with->words.data;
+    isize first = from_bit >> 6;
+    isize last = (to_bit - 1) >> 6;
+    u64 first_mask = _bitset_first_mask(from_bit);
+    u64 last_mask = _bitset_last_mask(to_bit);
+    if(first == last)
+        first_mask = last_mask = first_mask & last_mask;
+
+    //Compute both edges before writing so that into == with works.
+    u64 first_word = (_bitset_combine_word(a[first], b[first], op) & first_mask) | (a[first] & ~first_mask);
+    u64 last_word = (_bitset_combine_word(a[last], b[last], op) & last_mask) | (a[last] & ~last_mask);
+    a[first] = first_word;
+    a[last] = last_word;
+
+    if(last - first > 1)
+        _BITSET_CALL(_bitset_combine_words, a + first + 1, b + first + 1, last - first - 1, op);
+    _bitset_check_invariants(into);
+}
+
+EXTERNAL void bitset_build_ranks(Bitset* bitset)
+{
+    isize word_count = bitset->words.count;
+    isize groups = (word_count + BITSET_RANK_WORDS - 1)/BITSET_RANK_WORDS;
+    array_resize_for_overwrite(&bitset->ranks, groups + 1);
+
+    u64 sum = 0;
+    for(isize g = 0; g < groups; g++)
+    {
+        bitset->ranks.data[g] = sum;
+        isize words_in_group = MIN(BITSET_RANK_WORDS, word_count - g*BITSET_RANK_WORDS);
+        sum += (u64) _BITSET_CALL(_bitset_popcount_words, bitset->words.data + g*BITSET_RANK_WORDS, words_in_group);
+    }
+    bitset->ranks.data[groups] = sum;
+}
+
+EXTERNAL isize bitset_rank(const Bitset* bitset, isize i)
+{
+    REQUIRE(0 <= i && i <= bitset->bit_count);
+    REQUIRE(bitset->ranks.count > 0, "ranks must be built with bitset_build_ranks()");
+
+    isize w = i >> 6;
+    isize g = w/BITSET_RANK_WORDS;
+    isize rank = (isize) bitset->ranks.data[g];
+    for(isize k = g*BITSET_RANK_WORDS; k < w; k++)
+        rank += platform_pop_count64(bitset->words.data[k]);
+
+    if(i & 63)
+        rank += platform_pop_count64(bitset->words.data[w] & ~_bitset_first_mask(i));
+    return rank;
+}
+
+EXTERNAL isize bitset_select(const Bitset* bitset, isize k)
+{
+    REQUIRE(bitset->ranks.count > 0, "ranks must be built with bitset_build_ranks()");
+    const u64* ranks = bitset->ranks.data;
+    isize groups = bitset->ranks.count - 1;
+    if(k < 0 || k >= (isize) ranks[groups])
+        return -1;
+
+    //find the last group with rank <= k
+    isize lo = 0;
+    isize hi = groups - 1;
+    while(lo < hi)
+    {
+        isize mid = (lo + hi + 1)/2;
+        if((isize) ranks[mid] <= k)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    isize remaining = k - (isize) ranks[lo];
+    for(isize w = lo*BITSET_RANK_WORDS;; w++)
+    {
+        ASSERT(w < bitset->words.count);
+        u64 word = bitset->words.data[w];
+        isize count = platform_pop_count64(word);
+        if(remaining < count)
+        {
+            for(; remaining > 0; remaining--)
+                word &= word - 1;
+            return (w << 6) + platform_find_first_set_bit64(word);
+        }
+        remaining -= count;
+    }
+}
+
+EXTERNAL void bitset_test_invariants(const Bitset* bitset)
+{
+    TEST(bitset->bit_count >= 0);
+    TEST(bitset->words.count == (bitset->bit_count + 63)/64);
+    if(bitset->bit_count % 64)
+        TEST((bitset->words.data[bitset->words.count - 1] & ~_bitset_last_mask(bitset->bit_count)) == 0, "bits past the end must be zero");
+
+    if(bitset->ranks.count > 0)
+    {
+        isize groups = (bitset->words.count + BITSET_RANK_WORDS - 1)/BITSET_RANK_WORDS;
+        TEST(bitset->ranks.count == groups + 1);
+        TEST((isize) bitset->ranks.data[groups] == bitset_count(bitset), "ranks must be up to date");
+    }
+}
+
+//=================================== Compressed_Bitset ==========================================
+INTERNAL void _compressed_bitset_check_invariants(const Compressed_Bitset* bitset)
+{
+    #if defined(DO_ASSERTS_SLOW)
+        compressed_bitset_test_invariants(bitset);
+    #else
+        (void) bitset;
+    #endif
+}
+
+INTERNAL void _compressed_bitset_container_deinit(Compressed_Bitset_Container* container)
+{
+    array_deinit(&container->values);
+    array_deinit(&container->words);
+}
+
+//Returns the index of the container with the given key or the index where it should be inserted
+INTERNAL isize _compressed_bitset_find_container(const Compressed_Bitset* bitset, u32 key, bool* found)
+{
+    isize lo = 0;
+    isize hi = bitset->containers.count;
+    while(lo < hi)
+    {
+        isize mid = (lo + hi)/2;
+        if(bitset->containers.data[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *found = lo < bitset->containers.count && bitset->containers.data[lo].key == key;
+    return lo;
+}
+
+//Returns the index of the first value >= low within an array container
+INTERNAL isize _compressed_bitset_lower_bound(const Compressed_Bitset_Container* container, u32 low)
+{
+    isize lo = 0;
+    isize hi = container->values.count;
+    while(lo < hi)
+    {
+        isize mid = (lo + hi)/2;
+        if(container->values.data[mid] < low)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+INTERNAL void _compressed_bitset_container_expand(const Compressed_Bitset_Container* container, u64* words)
+{
+    if(container->words.count > 0)
+        memcpy(words, container->words.data, COMPRESSED_BITSET_CONTAINER_WORDS*sizeof(u64));
+    else
+    {
+        memset(words, 0, COMPRESSED_BITSET_CONTAINER_WORDS*sizeof(u64));
+        for(isize i = 0; i < container->values.count; i++)
+        {
+            u32 val = container->values.data[i];
+            words[val >> 6] |= (u64) 1 << (val & 63);
+        }
+    }
+}
+
+//Stores the given bitmap into the container choosing the smaller representation
+INTERNAL void _compressed_bitset_container_store(Compressed_Bitset_Container* container, const u64* words)
+{
+    isize count = _BITSET_CALL(_bitset_popcount_words, words, COMPRESSED_BITSET_CONTAINER_WORDS);
+    container->count = (u32) count;
+    if(count <= COMPRESSED_BITSET_MAX_ARRAY)
+    {
+        array_resize_for_overwrite(&container->values, count);
+        isize out = 0;
+        for(isize w = 0; w < COMPRESSED_BITSET_CONTAINER_WORDS; w++)
+            for(u64 word = words[w]; word; word &= word - 1)
+                container->values.data[out++] = (u16) ((w << 6) + platform_find_first_set_bit64(word));
+
+        ASSERT(out == count);
+        array_set_capacity(&container->words, 0);
+    }
+    else
+    {
+        array_resize_for_overwrite(&container->words, COMPRESSED_BITSET_CONTAINER_WORDS);
+        memmove(container->words.data, words, COMPRESSED_BITSET_CONTAINER_WORDS*sizeof(u64));
+        array_set_capacity(&container->values, 0);
+    }
+}
+
+INTERNAL Compressed_Bitset_Container _compressed_bitset_container_copy(Allocator* alloc, const Compressed_Bitset_Container* from)
+{
+    Compressed_Bitset_Container out = {0};
+    array_init(&out.values, alloc);
+    array_init(&out.words, alloc);
+    array_copy(&out.values, from->values);
+    array_copy(&out.words, from->words);
+    out.key = from->key;
+    out.count = from->count;
+    return out;
+}
+
+EXTERNAL void compressed_bitset_init(Compressed_Bitset* bitset, Allocator* alloc)
+{
+    compressed_bitset_deinit(bitset);
+    bitset->allocator = alloc;
+    array_init(&bitset->containers, alloc);
+}
+
+EXTERNAL void compressed_bitset_clear(Compressed_Bitset* bitset)
+{
+    for(isize i = 0; i < bitset->containers.count; i++)
+        _compressed_bitset_container_deinit(&bitset->containers.data[i]);
+
+    bitset->containers.count = 0;
+    bitset->count = 0;
+}
+
+EXTERNAL void compressed_bitset_deinit(Compressed_Bitset* bitset)
+{
+    compressed_bitset_clear(bitset);
+    array_deinit(&bitset->containers);
+    bitset->allocator = NULL;
+}
+
+EXTERNAL bool compressed_bitset_get(const Compressed_Bitset* bitset, u32 i)
+{
+    bool found = false;
+    isize index = _compressed_bitset_find_container(bitset, i >> 16, &found);
+    if(found == false)
+        return false;
+
+    const Compressed_Bitset_Container* container = &bitset->containers.data[index];
+    u32 low = i & 0xFFFF;
+    if(container->words.count > 0)
+        return (container->words.data[low >> 6] >> (low & 63)) & 1;
+
+    isize at = _compressed_bitset_lower_bound(container, low);
+    return at < container->values.count && container->values.data[at] == low;
+}
+
+EXTERNAL bool compressed_bitset_set(Compressed_Bitset* bitset, u32 i)
+{
+    bool found = false;
+    isize index = _compressed_bitset_find_container(bitset, i >> 16, &found);
+    if(found == false)
+    {
+        Compressed_Bitset_Container added = {0};
+        array_init(&added.values, bitset->allocator);
+        array_init(&added.words, bitset->allocator);
+        added.key = i >> 16;
+
+        array_push(&bitset->containers, added);
+        memmove(bitset->containers.data + index + 1, bitset->containers.data + index,
+            (size_t) (bitset->containers.count - index - 1)*sizeof(Compressed_Bitset_Container));
+        bitset->containers.data[index] = added;
+    }
+
+    Compressed_Bitset_Container* container = &bitset->containers.data[index];
+    u32 low = i & 0xFFFF;
+    if(container->words.count > 0)
+    {
+        u64* word = &container->words.data[low >> 6];
+        u64 bit = (u64) 1 << (low & 63);
+        if(*word & bit)
+            return false;
+        *word |= bit;
+        container->count += 1;
+    }
+    else
+    {
+        isize at = _compressed_bitset_lower_bound(container, low);
+        if(at < container->values.count && container->values.data[at] == low)
+            return false;
+
+        array_push(&container->values, 0);
+        memmove(container->values.data + at + 1, container->values.data + at, (size_t) (container->values.count - at - 1)*sizeof(u16));
+        container->values.data[at] = (u16) low;
+        container->count += 1;
+
+        if(container->count > COMPRESSED_BITSET_MAX_ARRAY)
+        {
+            u64 words[COMPRESSED_BITSET_CONTAINER_WORDS];
+            _compressed_bitset_container_expand(container, words);
+            _compressed_bitset_container_store(container, words);
+        }
+    }
+
+    bitset->count += 1;
+    _compressed_bitset_check_invariants(bitset);
+    return true;
+}
+
+EXTERNAL bool compressed_bitset_unset(Compressed_Bitset* bitset, u32 i)
+{
+    bool found = false;
+    isize index = _compressed_bitset_find_container(bitset, i >> 16, &found);
+    if(found == false)
+        return false;
+
+    Compressed_Bitset_Container* container = &bitset->containers.data[index];
+    u32 low = i & 0xFFFF;
+    if(container->words.count > 0)
+    {
+        u64* word = &container->words.data[low >> 6];
+        u64 bit = (u64) 1 << (low & 63);
+        if((*word & bit) == 0)
+            return false;
+
+        *word &= ~bit;
+        container->count -= 1;
+        if(container->count <= COMPRESSED_BITSET_MAX_ARRAY)
+        {
+            u64 words[COMPRESSED_BITSET_CONTAINER_WORDS];
+            _compressed_bitset_container_expand(container, words);
+            _compressed_bitset_container_store(container, words);
+        }
+    }
+    else
+    {
+        isize at = _compressed_bitset_lower_bound(container, low);
+        if(at >= container->values.count || container->values.data[at] != low)
+            return false;
+
+        memmove(container->values.data + at, container->values.data + at + 1, (size_t) (container->values.count - at - 1)*sizeof(u16));
+        array_pop(&container->values);
+        container->count -= 1;
+    }
+
+    if(container->count == 0)
+    {
+        _compressed_bitset_container_deinit(container);
+        memmove(bitset->containers.data + index, bitset->containers.data + index + 1,
+            (size_t) (bitset->containers.count - index - 1)*sizeof(Compressed_Bitset_Container));
+        array_pop(&bitset->containers);
+    }
+
+    bitset->count -= 1;
+    _compressed_bitset_check_invariants(bitset);
+    return true;
+}
+
+EXTERNAL isize compressed_bitset_find_next_set(const Compressed_Bitset* bitset, isize from)
+{
+    REQUIRE(from >= 0);
+    if(from > UINT32_MAX)
+        return -1;
+
+    bool found = false;
+    isize index = _compressed_bitset_find_container(bitset, (u32) (from >> 16), &found);
+    u32 low = found ? (u32) (from & 0xFFFF) : 0;
+    for(; index < bitset->containers.count; index++, low = 0)
+    {
+        const Compressed_Bitset_Container* container = &bitset->containers.data[index];
+        isize base = (isize) container->key << 16;
+        if(container->words.count > 0)
+        {
+            isize w = low >> 6;
+            u64 word = container->words.data[w] & _bitset_first_mask(low);
+            for(;;)
+            {
+                if(word)
+                    return base + (w << 6) + platform_find_first_set_bit64(word);
+                if(++w >= COMPRESSED_BITSET_CONTAINER_WORDS)
+                    break;
+                word = container->words.data[w];
+            }
+        }
+        else
+        {
+            isize at = _compressed_bitset_lower_bound(container, low);
+            if(at < container->values.count)
+                return base + container->values.data[at];
+        }
+    }
+
+    return -1;
+}
+
+EXTERNAL void compressed_bitset_combine(Compressed_Bitset* into, const Compressed_Bitset* with, Bitset_Op op)
+{
+    _compressed_bitset_check_invariants(into);
+    _compressed_bitset_check_invariants(with);
+
+    Compressed_Bitset_Container_Array result = {into->allocator};
+    array_reserve(&result, into->containers.count + (op == BITSET_OR || op == BITSET_XOR ? with->containers.count : 0));
+
+    u64 a_words[COMPRESSED_BITSET_CONTAINER_WORDS];
+    u64 b_words[COMPRESSED_BITSET_CONTAINER_WORDS];
+    isize count = 0;
+    isize i = 0;
+    isize j = 0;
+    while(i < into->containers.count || j < with->containers.count)
+    {
+        Compressed_Bitset_Container* a = i < into->containers.count ? &into->containers.data[i] : NULL;
+        const Compressed_Bitset_Container* b = j < with->containers.count ? &with->containers.data[j] : NULL;
+
+        //only in into: kept unless AND
+        if(b == NULL || (a != NULL && a->key < b->key))
+        {
+            if(op == BITSET_AND)
+                _compressed_bitset_container_deinit(a);
+            else
+            {
+                array_push(&result, *a);
+                count += a->count;
+            }
+            i++;
+        }
+        //only in with: copied if OR or XOR
+        else if(a == NULL || b->key < a->key)
+        {
+            if(op == BITSET_OR || op == BITSET_XOR)
+            {
+                array_push(&result, _compressed_bitset_container_copy(into->allocator, b));
+                count += b->count;
+            }
+            j++;
+        }
+        else
+        {
+            _compressed_bitset_container_expand(a, a_words);
+            _compressed_bitset_container_expand(b, b_words);
+            _BITSET_CALL(_bitset_combine_words, a_words, b_words, COMPRESSED_BITSET_CONTAINER_WORDS, op);
+            _compressed_bitset_container_store(a, a_words);
+            if(a->count > 0)
+            {
+                array_push(&result, *a);
+                count += a->count;
+            }
+            else
+                _compressed_bitset_container_deinit(a);
+            i++;
+            j++;
+        }
+    }
+
+    array_deinit(&into->containers);
+    into->containers = result;
+    into->count = count;
+    _compressed_bitset_check_invariants(into);
+}
+
+EXTERNAL void compressed_bitset_from_bitset(Compressed_Bitset* into, const Bitset* from)
+{
+    REQUIRE(from->bit_count <= (isize) UINT32_MAX + 1);
+    compressed_bitset_clear(into);
+
+    u64 words[COMPRESSED_BITSET_CONTAINER_WORDS];
+    for(isize w = 0; w < from->words.count; w += COMPRESSED_BITSET_CONTAINER_WORDS)
+    {
+        isize chunk_words = MIN(COMPRESSED_BITSET_CONTAINER_WORDS, from->words.count - w);
+        if(_BITSET_CALL(_bitset_popcount_words, from->words.data + w, chunk_words) == 0)
+            continue;
+
+        memset(words, 0, sizeof words);
+        memcpy(words, from->words.data + w, (size_t) chunk_words*sizeof(u64));
+
+        Compressed_Bitset_Container added = {0};
+        array_init(&added.values, into->allocator);
+        array_init(&added.words, into->allocator);
+        added.key = (u32) (w/COMPRESSED_BITSET_CONTAINER_WORDS);
+        _compressed_bitset_container_store(&added, words);
+
+        array_push(&into->containers, added);
+        into->count += added.count;
+    }
+    _compressed_bitset_check_invariants(into);
+}
+
+EXTERNAL void compressed_bitset_to_bitset(Bitset* into, const Compressed_Bitset* from)
+{
+    if(from->containers.count > 0)
+    {
+        const Compressed_Bitset_Container* last = array_last(from->containers);
+        isize needed = ((isize) last->key + 1) << 16;
+        if(into->bit_count < needed)
+            bitset_resize(into, needed);
+    }
+
+    bitset_fill(into, false);
+    for(isize i = 0; i < from->containers.count; i++)
+    {
+        const Compressed_Bitset_Container* container = &from->containers.data[i];
+        u64* words = into->words.data + (isize) container->key*COMPRESSED_BITSET_CONTAINER_WORDS;
+        _compressed_bitset_container_expand(container, words);
+    }
+}
+
+EXTERNAL void compressed_bitset_test_invariants(const Compressed_Bitset* bitset)
+{
+    isize count = 0;
+    for(isize i = 0; i < bitset->containers.count; i++)
+    {
+        const Compressed_Bitset_Container* container = &bitset->containers.data[i];
+        TEST(container->key <= UINT16_MAX);
+        TEST(container->count > 0, "empty containers must not be kept");
+        if(i > 0)
+            TEST(bitset->containers.data[i - 1].key < container->key, "containers must be sorted by key");
+
+        if(container->words.count > 0)
+        {
+            TEST(container->values.count == 0);
+            TEST(container->words.count == COMPRESSED_BITSET_CONTAINER_WORDS);
+            TEST(container->count > COMPRESSED_BITSET_MAX_ARRAY, "small containers must be arrays");
+            TEST(_bitset_popcount_words_scalar(container->words.data, container->words.count) == container->count);
+        }
+        else
+        {
+            TEST(container->values.count == container->count);
+            TEST(container->count <= COMPRESSED_BITSET_MAX_ARRAY);
+            for(isize k = 1; k < container->values.count; k++)
+                TEST(container->values.data[k - 1] < container->values.data[k], "values must be sorted and unique");
+        }
+        count += container->count;
+    }
+
+    TEST(count == bitset->count);
+}
+
+#endif
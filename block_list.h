@@ -0,0 +1,406 @@
+#ifndef MODULE_BLOCK_LIST
+#define MODULE_BLOCK_LIST
+
+// An unrolled doubly linked list. Instead of linking each item separately (as is done with the
+// list.h macros) we link blocks each holding a contiguous run of items. Every block is a multiple
+// of cache line in size and is cache line aligned. Iteration thus touches memory almost as linearly
+// as iterating an Array, with one pointer chase per block instead of one per item.
+//
+// Items inside a block occupy the slots [first, first + count). Pushing to the back fills the last
+// block upwards, pushing to the front fills the first block downwards (new front blocks are started
+// from their end). This means pushes and pops on both ends are O(1) and never move any items so
+// pointers to items stay valid until the item is popped.
+//
+// Blocks inside the list can be only partially filled. This happens when whole lists get spliced
+// together using block_list_append() / block_list_prepend() which are O(1) as well. Empty blocks
+// are never kept in the list. We do however keep one spare block so that a sequence of push/pop
+// right at the block boundary does not hit the allocator each time.
+//
+// Iterating:
+// for(Block_List_Block* block = list.first; block; block = block->next) {
+//     i32* items = (i32*) block_list_block_items(&list, block);
+//     for(u32 i = 0; i < block->count; i++)
+//         sum += items[i];
+// }
+// or equivalently using BLOCK_LIST_FOR_EACH_BEGIN/END macros.
+
+#include "allocator.h"
+#include "list.h"
+
+#define BLOCK_LIST_DEF_BLOCK_SIZE (8*CACHE_LINE)
+
+typedef struct Block_List_Block {
+    struct Block_List_Block* next;
+    struct Block_List_Block* prev;
+    u32 first; //index of the first used slot
+    u32 count; //number of used slots
+} Block_List_Block;
+
+typedef struct Block_List {
+    Allocator* allocator;
+    Block_List_Block* first;
+    Block_List_Block* last;
+    Block_List_Block* spare;
+
+    isize count;
+    isize block_count;
+    u32 item_size;
+    u32 item_align;
+    u32 block_size;
+    u32 block_capacity;
+    u32 items_offset; //offset of the first slot from the start of the block
+    u32 _;
+} Block_List;
+
+EXTERNAL void  block_list_init_custom(Block_List* list, Allocator* alloc, isize item_size, isize item_align, isize block_size);
+EXTERNAL void  block_list_init(Block_List* list, Allocator* alloc, isize item_size);
+EXTERNAL void  block_list_deinit(Block_List* list);
+EXTERNAL void  block_list_clear(Block_List* list);
+
+//Adds an item and returns pointer to it. If item_or_null is NULL zero initializes the item.
+EXTERNAL void* block_list_push_back(Block_List* list, const void* item_or_null);
+EXTERNAL void* block_list_push_front(Block_List* list, const void* item_or_null);
+//Removes an item optionally copying it into into_or_null. The list must not be empty.
+EXTERNAL void  block_list_pop_back(Block_List* list, void* into_or_null);
+EXTERNAL void  block_list_pop_front(Block_List* list, void* into_or_null);
+
+EXTERNAL void* block_list_front(const Block_List* list);
+EXTERNAL void* block_list_back(const Block_List* list);
+//Returns item at the given index. Walks the blocks from the nearer end so is O(block_count).
+EXTERNAL void* block_list_at(const Block_List* list, isize index);
+EXTERNAL u8*   block_list_block_items(const Block_List* list, const Block_List_Block* block);
+
+//Moves all blocks of from to the end (start) of into in O(1). from is left empty but initialized.
+// Both lists must use the same allocator and item layout.
+EXTERNAL void  block_list_append(Block_List* into, Block_List* from);
+EXTERNAL void  block_list_prepend(Block_List* into, Block_List* from);
+
+EXTERNAL void  block_list_test_invariants(const Block_List* list, bool slow_checks);
+
+#define BLOCK_LIST_FOR_EACH_BEGIN_UNTYPED(list, Ptr_Type, ptr_name)                                   \
+    for(Block_List_Block* _block = (list).first; _block; _block = _block->next)                     \
+    {                                                                                               \
+        bool _did_break = false;                                                                    \
+        u8* _items = block_list_block_items(&(list), _block);                                       \
+        for(u32 _item_i = 0; _item_i < _block->count; _item_i++)                                    \
+        {                                                                                           \
+            _did_break = true;                                                                      \
+            Ptr_Type ptr_name = (Ptr_Type) (void*) (_items + _item_i*(list).item_size); (void) ptr_name; \
+
+#define BLOCK_LIST_FOR_EACH_END     \
+            _did_break = false;     \
+        }                           \
+        if(_did_break)              \
+            break;                  \
+    }                               \
+
+#define BLOCK_LIST_FOR_EACH_BEGIN(list, Ptr_Type, ptr_name)                                      \
+        ASSERT((list).item_size == isizeof(*(Ptr_Type) NULL), "wrong type submitted to BLOCK_LIST_FOR_EACH_BEGIN"); \
+        BLOCK_LIST_FOR_EACH_BEGIN_UNTYPED(list, Ptr_Type, ptr_name) \
+
+#endif
+
+#if (defined(MODULE_IMPL_ALL) || defined(MODULE_IMPL_BLOCK_LIST)) && !defined(MODULE_HAS_IMPL_BLOCK_LIST)
+#define MODULE_HAS_IMPL_BLOCK_LIST
+
+INTERNAL void _block_list_check_invariants(const Block_List* list)
+{
+    #if defined(DO_ASSERTS)
+        #if defined(DO_ASSERTS_SLOW)
+            block_list_test_invariants(list, true);
+        #else
+            block_list_test_invariants(list, false);
+        #endif
+    #endif
+}
+
+INTERNAL isize _block_list_block_align(const Block_List* list)
+{
+    return MAX(CACHE_LINE, list->item_align);
+}
+
+INTERNAL Block_List_Block* _block_list_block_make(Block_List* list, u32 first)
+{
+    Block_List_Block* block = list->spare;
+    list->spare = NULL;
+    if(block == NULL)
+        block = (Block_List_Block*) allocator_allocate(list->allocator, list->block_size, _block_list_block_align(list));
+
+    memset(block, 0, sizeof *block);
+    block->first = first;
+    list->block_count += 1;
+    return block;
+}
+
+INTERNAL void _block_list_block_release(Block_List* list, Block_List_Block* block)
+{
+    bilist_remove(&list->first, &list->last, block);
+    list->block_count -= 1;
+    if(list->spare == NULL)
+        list->spare = block;
+    else
+        allocator_deallocate(list->allocator, block, list->block_size, _block_list_block_align(list));
+}
+
+EXTERNAL void block_list_init_custom(Block_List* list, Allocator* alloc, isize item_size, isize item_align, isize block_size)
+{
+    ASSERT(item_size > 0 && item_align > 0 && is_power_of_two(item_align));
+    block_list_deinit(list);
+
+    isize items_offset = ((isize) sizeof(Block_List_Block) + item_align - 1) & ~(item_align - 1);
+    isize min_block_size = items_offset + item_size;
+    if(block_size < min_block_size)
+        block_size = min_block_size;
+    block_size = (block_size + CACHE_LINE - 1)/CACHE_LINE*CACHE_LINE;
+
+    list->allocator = alloc;
+    list->item_size = (u32) item_size;
+    list->item_align = (u32) item_align;
+    list->block_size = (u32) block_size;
+    list->items_offset = (u32) items_offset;
+    list->block_capacity = (u32) ((block_size - items_offset)/item_size);
+    _block_list_check_invariants(list);
+}
+
+EXTERNAL void block_list_init(Block_List* list, Allocator* alloc, isize item_size)
+{
+    //Make sure even large items get at least a few per block
+    isize block_size = MAX(BLOCK_LIST_DEF_BLOCK_SIZE, isizeof(Block_List_Block) + 8*item_size);
+    block_list_init_custom(list, alloc, item_size, DEF_ALIGN, block_size);
+}
+
+EXTERNAL void block_list_clear(Block_List* list)
+{
+    _block_list_check_invariants(list);
+    while(list->first)
+        _block_list_block_release(list, list->first);
+
+    list->count = 0;
+    _block_list_check_invariants(list);
+}
+
+EXTERNAL void block_list_deinit(Block_List* list)
+{
+    block_list_clear(list);
+    if(list->spare)
+        allocator_deallocate(list->allocator, list->spare, list->block_size, _block_list_block_align(list));
+    memset(list, 0, sizeof *list);
+}
+
+EXTERNAL u8* block_list_block_items(const Block_List* list, const Block_List_Block* block)
+{
+    return (u8*) (void*) block + list->items_offset + (isize) block->first*list->item_size;
+}
+
+INTERNAL void* _block_list_set_item(const Block_List* list, void* item, const void* item_or_null)
+{
+    if(item_or_null)
+        memcpy(item, item_or_null, list->item_size);
+    else
+        memset(item, 0, list->item_size);
+    return item;
+}
+
+EXTERNAL void* block_list_push_back(Block_List* list, const void* item_or_null)
+{
+    _block_list_check_invariants(list);
+    ASSERT(list->block_capacity > 0, "must be initialized");
+
+    Block_List_Block* last = list->last;
+    if(last == NULL || last->first + last->count >= list->block_capacity)
+    {
+        last = _block_list_block_make(list, 0);
+        bilist_push_back(&list->first, &list->last, last);
+    }
+
+    u8* item = block_list_block_items(list, last) + (isize) last->count*list->item_size;
+    last->count += 1;
+    list->count += 1;
+
+    _block_list_check_invariants(list);
+    return _block_list_set_item(list, item, item_or_null);
+}
+
+EXTERNAL void* block_list_push_front(Block_List* list, const void* item_or_null)
+{
+    _block_list_check_invariants(list);
+    ASSERT(list->block_capacity > 0, "must be initialized");
+
+    Block_List_Block* first = list->first;
+    if(first == NULL || first->first == 0)
+    {
+        first = _block_list_block_make(list, list->block_capacity);
+        bilist_push_front(&list->first, &list->last, first);
+    }
+
+    first->first -= 1;
+    first->count += 1;
+    list->count += 1;
+    u8* item = block_list_block_items(list, first);
+
+    _block_list_check_invariants(list);
+    return _block_list_set_item(list, item, item_or_null);
+}
+
+EXTERNAL void block_list_pop_back(Block_List* list, void* into_or_null)
+{
+    _block_list_check_invariants(list);
+    REQUIRE(list->count > 0, "cannot pop from empty list");
+
+    Block_List_Block* last = list->last;
+    last->count -= 1;
+    list->count -= 1;
+    if(into_or_null)
+        memcpy(into_or_null, block_list_block_items(list, last) + (isize) last->count*list->item_size, list->item_size);
+
+    if(last->count == 0)
+        _block_list_block_release(list, last);
+    _block_list_check_invariants(list);
+}
+
+EXTERNAL void block_list_pop_front(Block_List* list, void* into_or_null)
+{
+    _block_list_check_invariants(list);
+    REQUIRE(list->count > 0, "cannot pop from empty list");
+
+    Block_List_Block* first = list->first;
+    if(into_or_null)
+        memcpy(into_or_null, block_list_block_items(list, first), list->item_size);
+    first->first += 1;
+    first->count -= 1;
+    list->count -= 1;
+
+    if(first->count == 0)
+        _block_list_block_release(list, first);
+    _block_list_check_invariants(list);
+}
+
+EXTERNAL void* block_list_front(const Block_List* list)
+{
+    REQUIRE(list->count > 0);
+    return block_list_block_items(list, list->first);
+}
+
+EXTERNAL void* block_list_back(const Block_List* list)
+{
+    REQUIRE(list->count > 0);
+    return block_list_block_items(list, list->last) + (isize) (list->last->count - 1)*list->item_size;
+}
+
+EXTERNAL void* block_list_at(const Block_List* list, isize index)
+{
+    CHECK_BOUNDS(index, list->count);
+    if(index < list->count/2)
+    {
+        Block_List_Block* block = list->first;
+        for(; index >= block->count; block = block->next)
+            index -= block->count;
+
+        return block_list_block_items(list, block) + index*list->item_size;
+    }
+    else
+    {
+        isize from_back = list->count - 1 - index;
+        Block_List_Block* block = list->last;
+        for(; from_back >= block->count; block = block->prev)
+            from_back -= block->count;
+
+        return block_list_block_items(list, block) + (block->count - 1 - from_back)*list->item_size;
+    }
+}
+
+INTERNAL void _block_list_splice(Block_List* into, Block_List* from, bool to_back)
+{
+    _block_list_check_invariants(into);
+    _block_list_check_invariants(from);
+    REQUIRE(into->allocator == from->allocator
+        && into->item_size == from->item_size
+        && into->item_align == from->item_align
+        && into->block_size == from->block_size, "lists must be compatible");
+
+    if(from->first == NULL)
+        return;
+
+    if(into->first == NULL)
+    {
+        into->first = from->first;
+        into->last = from->last;
+    }
+    else if(to_back)
+    {
+        into->last->next = from->first;
+        from->first->prev = into->last;
+        into->last = from->last;
+    }
+    else
+    {
+        from->last->next = into->first;
+        into->first->prev = from->last;
+        into->first = from->first;
+    }
+
+    into->count += from->count;
+    into->block_count += from->block_count;
+    from->first = NULL;
+    from->last = NULL;
+    from->count = 0;
+    from->block_count = 0;
+
+    _block_list_check_invariants(into);
+    _block_list_check_invariants(from);
+}
+
+EXTERNAL void block_list_append(Block_List* into, Block_List* from)
+{
+    _block_list_splice(into, from, true);
+}
+
+EXTERNAL void block_list_prepend(Block_List* into, Block_List* from)
+{
+    _block_list_splice(into, from, false);
+}
+
+EXTERNAL void block_list_test_invariants(const Block_List* list, bool slow_checks)
+{
+    if(list->item_size == 0)
+    {
+        TEST(list->first == NULL && list->last == NULL && list->spare == NULL && list->count == 0, "uninit list must be empty");
+        return;
+    }
+
+    TEST(is_power_of_two(list->item_align));
+    TEST(list->block_size % CACHE_LINE == 0, "blocks must be whole cache lines");
+    TEST(list->items_offset >= sizeof(Block_List_Block) && list->items_offset % list->item_align == 0);
+    TEST(list->block_capacity > 0 && list->items_offset + list->block_capacity*list->item_size <= list->block_size);
+    TEST((list->first == NULL) == (list->last == NULL));
+    TEST((list->first == NULL) == (list->count == 0));
+    TEST(list->block_count <= list->count, "every block holds at least one item");
+
+    if(list->first)
+    {
+        TEST(list->first->prev == NULL && list->last->next == NULL);
+        TEST(list->first->count > 0 && list->last->count > 0);
+    }
+
+    if(slow_checks)
+    {
+        isize count = 0;
+        isize block_count = 0;
+        for(Block_List_Block* block = list->first; block; block = block->next)
+        {
+            TEST(block->count > 0, "empty blocks must not be kept");
+            TEST(block->first + block->count <= list->block_capacity);
+            TEST(block->next == NULL ? block == list->last : block->next->prev == block, "must be properly linked");
+            TEST(block == align_forward(block, _block_list_block_align(list)));
+
+            count += block->count;
+            block_count += 1;
+            TEST(block_count <= list->block_count, "needs to not get stuck in an infinite loop");
+        }
+
+        TEST(count == list->count);
+        TEST(block_count == list->block_count);
+    }
+}
+
+#endif
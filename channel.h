@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
     #include <atomic>
@@ -59,6 +60,22 @@
     #define CHAN_CACHE_LINE 64
 #endif
 
+#ifndef CHAN_ADAPTIVE_MIN_SPIN_NS
+    #define CHAN_ADAPTIVE_MIN_SPIN_NS 500
+#endif
+#ifndef CHAN_ADAPTIVE_MAX_SPIN_NS
+    #define CHAN_ADAPTIVE_MAX_SPIN_NS 20000
+#endif
+#ifndef CHAN_ADAPTIVE_YIELDS
+    #define CHAN_ADAPTIVE_YIELDS      2
+#endif
+#ifndef CHAN_ADAPTIVE_BUDGETS
+    #define CHAN_ADAPTIVE_BUDGETS     256
+#endif
+#if CHAN_ADAPTIVE_BUDGETS <= 0 || (CHAN_ADAPTIVE_BUDGETS & (CHAN_ADAPTIVE_BUDGETS - 1)) != 0
+    #error CHAN_ADAPTIVE_BUDGETS must be a power of two
+#endif
+
 typedef int64_t isize;
 
 typedef bool (*Sync_Wait_Func)(volatile void* state, uint32_t undesired, double timeout_or_negative_if_infinite);
@@ -70,6 +87,20 @@ typedef struct Channel_Info {
     Sync_Wake_Func wake;
 } Channel_Info;
 
+typedef struct Channel_Select_Case Channel_Select_Case;
+
+//Instrumentation of a single channel. Only collected when compiled with CHANNEL_STATS defined.
+typedef struct Channel_Stats {
+    uint64_t push_waits;        //number of pushes that had to wait because the channel was full
+    uint64_t pop_waits;         //number of pops that had to wait because the channel was empty
+    uint64_t push_wait_ticks;   //total time the completed pushes spent waiting in chan_perf_counter() units
+    uint64_t pop_wait_ticks;    //total time the completed pops spent waiting in chan_perf_counter() units
+    uint64_t push_lost_races;   //number of lost races (failed CAS) of the non blocking push functions
+    uint64_t pop_lost_races;    //number of lost races (failed CAS) of the non blocking pop functions
+    uint64_t max_count;         //high water mark of channel_count after push
+    uint64_t wakes;             //number of calls to info.wake
+} Channel_Stats;
+
 typedef struct Channel {
     alignas(CHAN_CACHE_LINE) 
     CHAN_ATOMIC(uint64_t) head;
@@ -95,6 +126,18 @@ typedef struct Channel {
     CHAN_ATOMIC(uint32_t) closing_state;
     CHAN_ATOMIC(uint32_t) closing_lock_requested;
     CHAN_ATOMIC(uint32_t) closing_lock_completed;
+
+    //Cases of channel_select calls currently waiting on this channel. 
+    //select_count is checked after every push/pop so it is kept away from the head and tail.
+    alignas(CHAN_CACHE_LINE) 
+    CHAN_ATOMIC(uint32_t) select_count;
+    CHAN_ATOMIC(uint32_t) select_lock;
+    Channel_Select_Case* select_first;
+
+    #ifdef CHANNEL_STATS
+    alignas(CHAN_CACHE_LINE)
+    CHAN_ATOMIC(uint64_t) stats[sizeof(Channel_Stats)/sizeof(uint64_t)]; //Channel_Stats stored as atomics
+    #endif
 } Channel;
 
 typedef enum Channel_Res {
@@ -144,6 +187,22 @@ CHANAPI Channel_Res channel_try_pop_weak(Channel* chan, void* item, Channel_Info
 CHANAPI Channel_Res channel_try_push(Channel* chan, const void* item, Channel_Info info);
 CHANAPI Channel_Res channel_try_pop(Channel* chan, void* item, Channel_Info info);
 
+//Pushes count items stored contiguously in items, waiting if channel is full. Obtains tickets for all items 
+// using a single atomic FAA so that under contention it is much faster than pushing the items one by one.
+// The items are pushed in order and occupy consecutive tickets. Returns the number of pushed items which 
+// is count unless the channel (side) was closed.
+CHANAPI isize channel_push_many(Channel* chan, const void* items, isize count, Channel_Info info);
+//Pops exactly count items into items, waiting if channel is empty. Obtains tickets for all items using a single atomic FAA.
+// Returns the number of popped items which is count unless the channel (side) was closed.
+CHANAPI isize channel_pop_many(Channel* chan, void* items, isize count, Channel_Info info);
+
+//Pushes up to max_count items without blocking, stopping at the first full slot. 
+// Returns the number of pushed items. If it returns 0 the channel is either full or closed.
+CHANAPI isize channel_try_push_many(Channel* chan, const void* items, isize max_count, Channel_Info info);
+//Pops up to max_count items without blocking, stopping at the first empty slot. 
+// Returns the number of popped items. If it returns 0 the channel is either empty or closed.
+CHANAPI isize channel_try_pop_many(Channel* chan, void* items, isize max_count, Channel_Info info);
+
 CHANAPI bool channel_close_push(Channel* chan, Channel_Info info);
 CHANAPI bool channel_close_soft(Channel* chan, Channel_Info info);
 CHANAPI bool channel_close_hard(Channel* chan, Channel_Info info);
@@ -164,6 +223,24 @@ CHANAPI bool channel_is_empty(const Channel* chan);
 
 CHANAPI bool channel_is_invariant_converged_state(Channel* chan, Channel_Info info);
 
+//Returns snapshot of the stats of the channel. If not compiled with CHANNEL_STATS returns all zeros.
+CHANAPI Channel_Stats channel_get_stats(const Channel* chan);
+CHANAPI void channel_reset_stats(Channel* chan);
+
+//Submits the stats of the channel as PROFILE_COUNTER samples named name_prefix followed by the name of the stat.
+//Requires profile.h. name_prefix must be a string literal.
+#define CHANNEL_PROFILE_STATS(chan, name_prefix) do { \
+        Channel_Stats __chan_stats = channel_get_stats(chan); \
+        PROFILE_COUNTER(name_prefix " push waits",      (int64_t) __chan_stats.push_waits); \
+        PROFILE_COUNTER(name_prefix " pop waits",       (int64_t) __chan_stats.pop_waits); \
+        PROFILE_COUNTER(name_prefix " push wait ticks", (int64_t) __chan_stats.push_wait_ticks); \
+        PROFILE_COUNTER(name_prefix " pop wait ticks",  (int64_t) __chan_stats.pop_wait_ticks); \
+        PROFILE_COUNTER(name_prefix " push lost races", (int64_t) __chan_stats.push_lost_races); \
+        PROFILE_COUNTER(name_prefix " pop lost races",  (int64_t) __chan_stats.pop_lost_races); \
+        PROFILE_COUNTER(name_prefix " max count",       (int64_t) __chan_stats.max_count); \
+        PROFILE_COUNTER(name_prefix " wakes",           (int64_t) __chan_stats.wakes); \
+    } while(0)
+
 //==========================================================================
 // Channel ticket interface 
 //==========================================================================
@@ -192,6 +269,207 @@ CHANAPI Channel_Res channel_ticket_try_pop(Channel* chan, void* item, uint64_t*
 CHANAPI Channel_Res channel_ticket_try_push_weak(Channel* chan, const void* item, uint64_t* ticket_or_null, Channel_Info info);
 CHANAPI Channel_Res channel_ticket_try_pop_weak(Channel* chan, void* item, uint64_t* ticket_or_null, Channel_Info info);
 
+//==========================================================================
+// Channel in place slot access
+//==========================================================================
+// Zero copy variants of channel_push/pop. Instead of copying item_size bytes in/out of the channel they give out a
+// pointer to the slot itself, so that producers can for example serialize directly into the channel and consumers
+// parse the item in place. 
+// 
+// channel_push_reserve waits for the slot just like channel_push (including returning NULL when closed) but 
+// instead of filling it returns its address. The slot is exclusively owned by the caller until channel_push_commit 
+// is called with the returned ticket, which publishes the item to consumers. Similarly channel_pop_acquire returns 
+// the address of the filled slot and channel_pop_release gives the slot back to producers. The item must not be 
+// accessed after commit/release.
+// 
+// Once reserved/acquired the operation can no longer be canceled by closing. On the other hand all operations 
+// on the same slot (which is every capacity-th ticket) wait for the commit/release, so the slot should be 
+// held only for a short time.
+
+CHANAPI void* channel_push_reserve(Channel* chan, uint64_t* ticket, Channel_Info info);
+CHANAPI void  channel_push_commit(Channel* chan, uint64_t ticket, Channel_Info info);
+CHANAPI void* channel_pop_acquire(Channel* chan, uint64_t* ticket, Channel_Info info);
+CHANAPI void  channel_pop_release(Channel* chan, uint64_t ticket, Channel_Info info);
+
+//==========================================================================
+// Channel select
+//==========================================================================
+// Waits on multiple channels at once just like the Go select statement. Each case is either a push or a pop. 
+// 
+// Since we cannot block on multiple futexes at once each waiting select registers its cases into the 
+// channels it waits on. After each push/pop (or close) the channel checks whether it has any registered
+// selects and if so notifies them by incrementing a counter they are waiting on. Registering increments
+// select_count before retrying the cases, and the channel checks select_count after publishing the slot. 
+// Both are sequentially consistent so either the retry sees the new state or the channel sees the select. 
+// Thus no wakeups are lost. Channels without a waiting select only pay one uncontended load per operation.
+
+typedef struct Channel_Select_Case {
+    Channel* chan;          //If NULL the case is ignored (like nil channel in Go)
+    void* item;             //When pushing the item to push, when popping the place where the popped item is stored
+    Channel_Info info;      //info of chan. The wait/wake functions of the first case with them set are used to block the select.
+    bool is_push;           
+    bool _[7];
+
+    //Private. Links this case into the list of select waiters of chan.
+    Channel_Select_Case* _next;
+    Channel_Select_Case* _prev;
+    CHAN_ATOMIC(uint32_t)* _notify;
+    Sync_Wake_Func _wake;
+} Channel_Select_Case;
+
+//Waits until any of the cases can proceed (or timeout passes) and performs it. If multiple cases can proceed picks one in round robin fashion.
+//Returns the index of the performed case and sets res_or_null to CHANNEL_OK. 
+//If the (side of the) channel of some case is closed returns the index of that case and sets res_or_null to CHANNEL_CLOSED.
+//On timeout returns -1 and sets res_or_null to CHANNEL_EMPTY. timeout of 0 only checks the cases once without waiting.
+//If all cases have NULL chan returns -1 immediately.
+CHANAPI isize channel_select(Channel_Select_Case* cases, isize case_count, double timeout_or_negative_if_infinite, Channel_Res* res_or_null);
+
+//==========================================================================
+// Unbounded channel
+//==========================================================================
+// A growable variant of Channel for bursty workloads where choosing a single capacity means either
+// over provisioning memory or blocking producers. 
+// 
+// It is a linked list of segments each being a regular bounded Channel. Producers push into the tail segment 
+// and consumers pop from the head segment. Unless a segment fills up the push/pop is exactly the regular 
+// channel operation, so it still contains only a single FAA on the critical path. When a producer gets a ticket 
+// past the capacity of the tail segment instead of waiting it links a new segment of twice the capacity and 
+// closes the push side of the full one (under a lock which is only taken when growing). Closing places a barrier 
+// after the last pushed item, so all producers past it get canceled and retry in the new segment, while pushes 
+// before it complete. Consumers drain the old segment until they get canceled at the same barrier and then move 
+// to the next segment. Because a new segment is linked before the old one is closed and items are only pushed 
+// into it once the old one is closed, the order of items is kept and the channel stays linearizable.
+// 
+// Drained segments can still be referenced by stale producers/consumers so they are not freed until
+// channel_unbounded_trim or channel_unbounded_deinit. Since the capacities are doubling the retired segments are 
+// together never larger than the current tail segment.
+// 
+// Supports the push closing (consumers drain the remaining items then fail), hard closing and reopening of Channel.
+// If allocation of a new segment fails the producers simply wait for consumers like with regular Channel.
+
+typedef struct Channel_Segment {
+    alignas(CHAN_CACHE_LINE) 
+    CHAN_ATOMIC(struct Channel_Segment*) next;
+
+    alignas(CHAN_CACHE_LINE) 
+    Channel chan; //followed by ids and items of chan
+} Channel_Segment;
+
+typedef struct Channel_Unbounded {
+    alignas(CHAN_CACHE_LINE) 
+    CHAN_ATOMIC(Channel_Segment*) head; //segment consumers pop from
+
+    alignas(CHAN_CACHE_LINE) 
+    CHAN_ATOMIC(Channel_Segment*) tail; //segment producers push to
+
+    alignas(CHAN_CACHE_LINE) 
+    Channel_Info info;
+    Channel_Segment* first;             //the oldest not yet freed segment. Segments from first up to head are retired.
+    CHAN_ATOMIC(uint32_t) closing_state;
+    CHAN_ATOMIC(uint32_t) grow_lock;    //protects linking of new segments and closing/reopening
+    CHAN_ATOMIC(uint32_t) segment_count;
+} Channel_Unbounded;
+
+//Initializes the unbounded channel with a first segment of capacity initial_capacity. Returns false if the allocation fails.
+CHANAPI bool channel_unbounded_init(Channel_Unbounded* chan, isize initial_capacity, Channel_Info info);
+//Frees all segments. Must not race with any other operation.
+CHANAPI void channel_unbounded_deinit(Channel_Unbounded* chan);
+//Frees the retired segments. Must not race with any other operation. Returns the number of freed segments.
+CHANAPI isize channel_unbounded_trim(Channel_Unbounded* chan);
+
+//Pushes an item growing the channel if it is full. Only waits for a pop in progress or if growing failed. 
+//If the channel is closed returns false.
+CHANAPI bool channel_unbounded_push(Channel_Unbounded* chan, const void* item, Channel_Info info);
+//Pops an item, waiting if the channel is empty. If the channel is closed (and drained) returns false.
+CHANAPI bool channel_unbounded_pop(Channel_Unbounded* chan, void* item, Channel_Info info);
+//Attempts to pop an item without blocking. Returns CHANNEL_OK, CHANNEL_EMPTY or CHANNEL_CLOSED.
+CHANAPI Channel_Res channel_unbounded_try_pop(Channel_Unbounded* chan, void* item, Channel_Info info);
+
+CHANAPI bool channel_unbounded_close_push(Channel_Unbounded* chan, Channel_Info info);
+CHANAPI bool channel_unbounded_close_hard(Channel_Unbounded* chan, Channel_Info info);
+CHANAPI bool channel_unbounded_reopen(Channel_Unbounded* chan, Channel_Info info);
+CHANAPI bool channel_unbounded_is_closed(const Channel_Unbounded* chan);
+
+//Returns upper bound to the number of items in the channel. 
+CHANAPI isize channel_unbounded_count(const Channel_Unbounded* chan);
+//Returns the capacity of the tail segment.
+CHANAPI isize channel_unbounded_capacity(const Channel_Unbounded* chan);
+
+//==========================================================================
+// Single producer single consumer channel
+//==========================================================================
+// A bounded ring for the common case of exactly one producer thread and one consumer thread. 
+// Because each index is only ever written by a single thread push and pop are just plain loads 
+// and stores (with release/acquire ordering) of the item and the index. There is no FAA and no per slot ids.
+// 
+// The producer owns tail and the consumer owns head, each on its own cache line. Next to its index 
+// each side keeps a cached copy of the index of the other side and only reloads the real one when the 
+// cached copy says the ring is full/empty. Thus in steady state the cache lines of the indices move 
+// between the cores about once per capacity items instead of on every push/pop. The batch functions 
+// copy runs of items with at most two memcpys and publish all of them with a single store.
+// 
+// Blocking uses the same Sync_Wait_Func/Sync_Wake_Func hooks as Channel. Before waiting a side raises 
+// its flag (kept with the other rarely written fields on a separate cache line) and sleeps on it. 
+// When info.wake is set, each push/pop followed by a full fence checks the flag of the other side.
+// Without wake (yield or spin waiting) the fence is skipped entirely. 
+// 
+// Items are addressed by an offset from the channel struct, so channel placed by channel_spsc_init_into_memory
+// contains no pointers and can be mapped at different addresses. Capacity must be a power of two.
+
+typedef struct Channel_Spsc {
+    alignas(CHAN_CACHE_LINE) 
+    CHAN_ATOMIC(uint64_t) tail;         //written only by the producer
+    uint64_t cached_head;               //producers copy of head
+
+    alignas(CHAN_CACHE_LINE) 
+    CHAN_ATOMIC(uint64_t) head;         //written only by the consumer
+    uint64_t cached_tail;               //consumers copy of tail
+
+    alignas(CHAN_CACHE_LINE) 
+    CHAN_ATOMIC(uint32_t) push_waiting; //set by the producer before waiting for a free slot
+    CHAN_ATOMIC(uint32_t) pop_waiting;  //set by the consumer before waiting for an item
+    CHAN_ATOMIC(uint32_t) closed;
+    CHAN_ATOMIC(uint32_t) allocated;
+    isize capacity; 
+    isize items_offset;                 //items are at (uint8_t*) chan + items_offset
+} Channel_Spsc;
+
+CHANAPI void          channel_spsc_init(Channel_Spsc* chan, void* items, isize capacity, Channel_Info info);
+CHANAPI isize         channel_spsc_memory_size(isize capacity, Channel_Info info); //Obtains the combined needed size for the Channel_Spsc struct and capacity items
+CHANAPI Channel_Spsc* channel_spsc_init_into_memory(void* aligned_memory, isize capacity, Channel_Info info); //Places and initializes the Channel_Spsc struct into the given memory
+//Allocates a new channel on the heap and returns pointer to it. If the allocation fails returns 0.
+CHANAPI Channel_Spsc* channel_spsc_malloc(isize capacity, Channel_Info info);
+//If the channel was allocated through channel_spsc_malloc frees it, else only memsets it to zero.
+CHANAPI void          channel_spsc_deinit(Channel_Spsc* chan);
+
+//Pushes an item, waiting if the channel is full. If the channel is closed returns false instead of waiting else returns true. Producer only.
+CHANAPI bool channel_spsc_push(Channel_Spsc* chan, const void* item, Channel_Info info);
+//Pops an item, waiting if the channel is empty. If the channel is closed and empty returns false instead of waiting else returns true. Consumer only.
+CHANAPI bool channel_spsc_pop(Channel_Spsc* chan, void* item, Channel_Info info);
+//Attempts to push an item without waiting. Returns CHANNEL_OK, CHANNEL_FULL or CHANNEL_CLOSED.
+CHANAPI Channel_Res channel_spsc_try_push(Channel_Spsc* chan, const void* item, Channel_Info info);
+//Attempts to pop an item without waiting. Returns CHANNEL_OK, CHANNEL_EMPTY or CHANNEL_CLOSED (only once closed channel is drained).
+CHANAPI Channel_Res channel_spsc_try_pop(Channel_Spsc* chan, void* item, Channel_Info info);
+
+//Pushes up to count items without waiting. Returns the number of pushed items.
+CHANAPI isize channel_spsc_try_push_batch(Channel_Spsc* chan, const void* items, isize count, Channel_Info info);
+//Pops up to max_count items without waiting. Returns the number of popped items.
+CHANAPI isize channel_spsc_try_pop_batch(Channel_Spsc* chan, void* items, isize max_count, Channel_Info info);
+//Pushes all count items waiting for free slots as necessary. Returns the number of pushed items which is less than count only if the channel got closed.
+CHANAPI isize channel_spsc_push_batch(Channel_Spsc* chan, const void* items, isize count, Channel_Info info);
+//Waits for at least one item then pops up to max_count items. Returns the number of popped items which is 0 only if the channel is closed and empty.
+CHANAPI isize channel_spsc_pop_batch(Channel_Spsc* chan, void* items, isize max_count, Channel_Info info);
+
+//Closes the channel. Subsequent pushes fail while pops drain the remaining items and then fail. 
+//Wakes up the waiting side. Can be called from any thread. Returns true if this call closed the channel.
+CHANAPI bool channel_spsc_close(Channel_Spsc* chan, Channel_Info info);
+//Reopens a closed channel keeping all items in it. Returns true if this call reopened the channel.
+CHANAPI bool channel_spsc_reopen(Channel_Spsc* chan);
+CHANAPI bool channel_spsc_is_closed(const Channel_Spsc* chan);
+//Returns the number of items in the channel. Exact only when called from the producer or consumer thread while the other side is idle.
+CHANAPI isize channel_spsc_count(const Channel_Spsc* chan);
+CHANAPI isize channel_spsc_capacity(const Channel_Spsc* chan);
+
 //These functions can be used for Sync_Wait_Func/Sync_Wake_Func interfaces in the channel.
 CHAN_INTRINSIC void chan_pause();
 
@@ -199,6 +477,13 @@ CHAN_OS_API void chan_wake_block(volatile void* state);
 CHAN_OS_API bool chan_wait_block(volatile void* state, uint32_t undesired, double timeout_or_negatove_if_infinite);
 CHAN_OS_API bool chan_wait_yield(volatile void* state, uint32_t undesired, double timeout_or_negatove_if_infinite);
 
+//Spins for a while, then yields, then blocks on the futex. Pair with chan_wake_block.
+// How long to spin is tuned from the durations of the recent waits on the same cache line
+// (so roughly per channel slot). Waits that tend to finish within CHAN_ADAPTIVE_MAX_SPIN_NS
+// are spun through and thus skip the latency of being woken up. Longer waits decay the spin 
+// budget back to CHAN_ADAPTIVE_MIN_SPIN_NS so that blocked threads do not burn cpu.
+CHAN_OS_API bool chan_wait_adaptive(volatile void* state, uint32_t undesired, double timeout_or_negatove_if_infinite);
+
 CHAN_OS_API void chan_futex_wake_all(volatile uint32_t* state);
 CHAN_OS_API void chan_futex_wake_single(volatile uint32_t* state);
 CHAN_OS_API bool chan_futex_wait(volatile uint32_t* state, uint32_t undesired, double timeout_or_negatove_if_infinite);
@@ -224,12 +509,28 @@ CHAN_OS_API bool chan_start_thread(void (*func)(void* context), void* context);
 
 #ifndef chan_debug_log
     //cheaply logs into memory msg static string followed by up to two uint64_t values
-    #define chan_debug_log(msg, ...) (void) sizeof((msg), ##__VA_ARGS__)   
+    #define chan_debug_log(msg, ...) ((void) 0)
     //performs n atomic additions on piece of global memory causing the caller to wait for a bit   
     // is used to make certain states more likely then others (increases the window between two instructions)
     #define chan_debug_wait(n)      (void) sizeof(n) 
 #endif
 
+//Stats are kept in an array of atomics indexed by the offset of the field in Channel_Stats
+#ifdef CHANNEL_STATS
+    #define _CHAN_STATS_ADD(chan, field, value) \
+        atomic_fetch_add(&(chan)->stats[offsetof(Channel_Stats, field)/sizeof(uint64_t)], (uint64_t) (value))
+    #define _CHAN_STATS_WAIT_BEGIN(chan, side, wait_start) \
+        ((wait_start) == 0 ? (void) ((wait_start) = chan_perf_counter(), _CHAN_STATS_ADD(chan, side##_waits, 1)) : (void) 0)
+    #define _CHAN_STATS_WAIT_END(chan, side, wait_start) \
+        ((wait_start) != 0 ? (void) _CHAN_STATS_ADD(chan, side##_wait_ticks, chan_perf_counter() - (wait_start)) : (void) 0)
+    #define _CHAN_STATS_PUSHED(chan) _channel_stats_update_max_count(chan)
+#else
+    #define _CHAN_STATS_ADD(chan, field, value)             (void) 0
+    #define _CHAN_STATS_WAIT_BEGIN(chan, side, wait_start)  (void) (wait_start)
+    #define _CHAN_STATS_WAIT_END(chan, side, wait_start)    (void) (wait_start)
+    #define _CHAN_STATS_PUSHED(chan)                        (void) 0
+#endif
+
 #define _CHAN_ID_WAITING_BIT            ((uint32_t) 1)
 #define _CHAN_ID_CLOSE_NOTIFY_BIT       ((uint32_t) 2)
 #define _CHAN_ID_FILLED_BIT             ((uint32_t) 4)
@@ -258,6 +559,45 @@ CHANAPI bool _channel_id_equals(uint32_t id1, uint32_t id2)
     return ((id1 ^ id2) / _CHAN_ID_FILLED_BIT) == 0;
 }
 
+//The lock is held only for a few instructions but the holder can still get preempted, 
+// so after a short while we yield instead of spinning through the whole time slice.
+CHANAPI void _channel_select_lock(Channel* chan)
+{
+    for(int spins = 0; atomic_exchange(&chan->select_lock, 1); spins++)
+    {
+        if(spins < 64)
+            chan_pause();
+        else
+            chan_yield();
+    }
+}
+
+_CHAN_INLINE_NEVER
+static void _channel_select_notify(Channel* chan)
+{
+    _channel_select_lock(chan);
+
+    for(Channel_Select_Case* waiter = chan->select_first; waiter; waiter = waiter->_next)
+    {
+        atomic_fetch_add(waiter->_notify, 1);
+        if(waiter->_wake)
+            waiter->_wake((void*) waiter->_notify);
+    }
+
+    atomic_store(&chan->select_lock, 0);
+}
+
+#ifdef CHANNEL_STATS
+    _CHAN_INLINE_NEVER
+    static void _channel_stats_update_max_count(Channel* chan)
+    {
+        uint64_t count = (uint64_t) channel_count(chan);
+        CHAN_ATOMIC(uint64_t)* max_count = &chan->stats[offsetof(Channel_Stats, max_count)/sizeof(uint64_t)];
+        uint64_t curr = atomic_load(max_count);
+        while(curr < count && atomic_compare_exchange_weak(max_count, &curr, count) == false);
+    }
+#endif
+
 CHANAPI void _channel_advance_id(Channel* chan, uint64_t target, uint32_t id, Channel_Info info)
 {
     CHAN_ATOMIC(uint32_t)* id_ptr = &chan->ids[target];
@@ -268,14 +608,20 @@ CHANAPI void _channel_advance_id(Channel* chan, uint64_t target, uint32_t id, Ch
         uint32_t prev_id = atomic_exchange(id_ptr, new_id);
         ASSERT(_channel_id_equals(prev_id + _CHAN_ID_FILLED_BIT, new_id));
         if(prev_id & _CHAN_ID_WAITING_BIT)
+        {
+            _CHAN_STATS_ADD(chan, wakes, 1);
             info.wake((void*) id_ptr);
+        }
     }
     else
         atomic_store(id_ptr, new_id);
+
+    if(atomic_load(&chan->select_count) != 0)
+        _channel_select_notify(chan);
 }
 
 _CHAN_INLINE_NEVER
-static bool _channel_ticket_push_potentially_cancel(Channel* chan, uint64_t ticket, uint32_t closing)
+static bool _channel_ticket_push_potentially_cancel(Channel* chan, uint64_t ticket, uint64_t ticket_count, uint32_t closing)
 {
     bool canceled = false;
     if(closing & _CHAN_CLOSING_HARD)
@@ -293,8 +639,8 @@ static bool _channel_ticket_push_potentially_cancel(Channel* chan, uint64_t tick
 
     if(canceled)
     {
-        atomic_fetch_add(&chan->tail_cancel_count, _CHAN_TICKET_INCREMENT);
-        atomic_fetch_sub(&chan->tail, _CHAN_TICKET_INCREMENT);
+        atomic_fetch_add(&chan->tail_cancel_count, ticket_count*_CHAN_TICKET_INCREMENT);
+        atomic_fetch_sub(&chan->tail, ticket_count*_CHAN_TICKET_INCREMENT);
         return false;
     }
     else
@@ -311,25 +657,25 @@ static bool _channel_ticket_push_potentially_cancel(Channel* chan, uint64_t tick
 //   t2: pop first 
 //   t1: push succeeds but by now we should have detected closed!
 //Thus the only option is to load, load check check in this order
-CHANAPI bool channel_ticket_push(Channel* chan, const void* item, uint64_t* out_ticket_or_null, Channel_Info info) 
+CHANAPI void* channel_push_reserve(Channel* chan, uint64_t* out_ticket, Channel_Info info) 
 {
     ASSERT(memcmp(&chan->info, &info, sizeof info) == 0, "info must be matching");
-    REQUIRE(item || (item == NULL && info.item_size == 0), "item must be provided");
     
     uint64_t tail = atomic_fetch_add(&chan->tail, _CHAN_TICKET_INCREMENT);
     uint64_t ticket = tail / _CHAN_TICKET_INCREMENT;
     uint64_t target = _channel_get_target(chan, ticket);
     uint32_t id = _channel_get_id(chan, ticket);
     chan_debug_log("push called", ticket);
+    int64_t wait_start = 0;
     
     for(;;) {
         uint32_t curr = atomic_load(&chan->ids[target]);
         chan_debug_wait(3);
         uint32_t closing = atomic_load(&chan->closing_state);
         if(closing) {
-            if(_channel_ticket_push_potentially_cancel(chan, ticket, closing) == false) {
+            if(_channel_ticket_push_potentially_cancel(chan, ticket, 1, closing) == false) {
                 chan_debug_log("push canceled", ticket);
-                return false;
+                return NULL;
             }
         }
 
@@ -343,6 +689,7 @@ CHANAPI bool channel_ticket_push(Channel* chan, const void* item, uint64_t* out_
         }
 
         chan_debug_log("push waiting", ticket);
+        _CHAN_STATS_WAIT_BEGIN(chan, push, wait_start);
         if(info.wait)
             info.wait((void*) &chan->ids[target], curr, -1);
         else
@@ -350,8 +697,16 @@ CHANAPI bool channel_ticket_push(Channel* chan, const void* item, uint64_t* out_
         chan_debug_log("push woken", ticket);
     }
     
-    memcpy(chan->items + target*info.item_size, item, info.item_size);
-    
+    _CHAN_STATS_WAIT_END(chan, push, wait_start);
+    *out_ticket = ticket;
+    //for zero sized items returns a valid non null pointer
+    return chan->items ? chan->items + target*info.item_size : (void*) &chan->ids[target];
+}
+
+CHANAPI void channel_push_commit(Channel* chan, uint64_t ticket, Channel_Info info) 
+{
+    uint64_t target = _channel_get_target(chan, ticket);
+    uint32_t id = _channel_get_id(chan, ticket);
     #ifdef CHANNEL_DEBUG
         uint32_t closing = atomic_load(&chan->closing_state);
         if((closing & ~_CHAN_CLOSING_HARD))
@@ -366,11 +721,22 @@ CHANAPI bool channel_ticket_push(Channel* chan, const void* item, uint64_t* out_
         }
     #endif
     _channel_advance_id(chan, target, id, info);
+    _CHAN_STATS_PUSHED(chan);
+    chan_debug_log("push done", ticket);
+}
 
+CHANAPI bool channel_ticket_push(Channel* chan, const void* item, uint64_t* out_ticket_or_null, Channel_Info info) 
+{
+    REQUIRE(item || (item == NULL && info.item_size == 0), "item must be provided");
+    uint64_t ticket = 0;
+    void* slot = channel_push_reserve(chan, &ticket, info);
+    if(slot == NULL)
+        return false;
+        
+    memcpy(slot, item, info.item_size);
+    channel_push_commit(chan, ticket, info);
     if(out_ticket_or_null)
         *out_ticket_or_null = ticket;
-
-    chan_debug_log("push done", ticket);
     return true;
 }
 
@@ -382,7 +748,7 @@ bool channel_push_int(Channel* chan, const int* item)
 }
 
 _CHAN_INLINE_NEVER 
-static bool _channel_ticket_pop_potentially_cancel(Channel* chan, uint64_t ticket, uint32_t closing)
+static bool _channel_ticket_pop_potentially_cancel(Channel* chan, uint64_t ticket, uint64_t ticket_count, uint32_t closing)
 {
     bool canceled = false;
     if(closing & _CHAN_CLOSING_HARD)
@@ -398,32 +764,32 @@ static bool _channel_ticket_pop_potentially_cancel(Channel* chan, uint64_t ticke
     if(canceled)
     {
         chan_debug_log("push canceled", ticket);
-        atomic_fetch_add(&chan->head_cancel_count, _CHAN_TICKET_INCREMENT);
-        atomic_fetch_sub(&chan->head, _CHAN_TICKET_INCREMENT);
+        atomic_fetch_add(&chan->head_cancel_count, ticket_count*_CHAN_TICKET_INCREMENT);
+        atomic_fetch_sub(&chan->head, ticket_count*_CHAN_TICKET_INCREMENT);
         return false;
     }
     return true;
 }
 
-CHANAPI bool channel_ticket_pop(Channel* chan, void* item, uint64_t* out_ticket_or_null, Channel_Info info) 
+CHANAPI void* channel_pop_acquire(Channel* chan, uint64_t* out_ticket, Channel_Info info) 
 {
     ASSERT(memcmp(&chan->info, &info, sizeof info) == 0, "info must be matching");
-    REQUIRE(item || (item == NULL && info.item_size == 0), "item must be provided");
 
     uint64_t head = atomic_fetch_add(&chan->head, _CHAN_TICKET_INCREMENT);
     uint64_t ticket = head / _CHAN_TICKET_INCREMENT;
     uint64_t target = _channel_get_target(chan, ticket);
     uint32_t id = _channel_get_id(chan, ticket) + _CHAN_ID_FILLED_BIT;
     chan_debug_log("pop called", ticket);
+    int64_t wait_start = 0;
 
     for(;;) {
         uint32_t curr = atomic_load(&chan->ids[target]);
         chan_debug_log("pop loaded curr", curr);
         uint32_t closing = atomic_load(&chan->closing_state);
         if(closing) {
-            if(_channel_ticket_pop_potentially_cancel(chan, ticket, closing) == false) {
+            if(_channel_ticket_pop_potentially_cancel(chan, ticket, 1, closing) == false) {
                 chan_debug_log("pop canceled", ticket);
-                return false;
+                return NULL;
             }
         }
         
@@ -438,6 +804,7 @@ CHANAPI bool channel_ticket_pop(Channel* chan, void* item, uint64_t* out_ticket_
         }
         
         chan_debug_log("pop waiting", ticket);
+        _CHAN_STATS_WAIT_BEGIN(chan, pop, wait_start);
         if(info.wait)
             info.wait((void*) &chan->ids[target], curr, -1);
         else
@@ -445,8 +812,15 @@ CHANAPI bool channel_ticket_pop(Channel* chan, void* item, uint64_t* out_ticket_
         chan_debug_log("pop woken", ticket);
     }
     
-    memcpy(item, chan->items + target*info.item_size, info.item_size);
-    
+    _CHAN_STATS_WAIT_END(chan, pop, wait_start);
+    *out_ticket = ticket;
+    return chan->items ? chan->items + target*info.item_size : (void*) &chan->ids[target];
+}
+
+CHANAPI void channel_pop_release(Channel* chan, uint64_t ticket, Channel_Info info) 
+{
+    uint64_t target = _channel_get_target(chan, ticket);
+    uint32_t id = _channel_get_id(chan, ticket) + _CHAN_ID_FILLED_BIT;
     #ifdef CHANNEL_DEBUG
         uint32_t closing = atomic_load(&chan->closing_state);
         if((closing & ~_CHAN_CLOSING_HARD) != 0)
@@ -460,10 +834,21 @@ CHANAPI bool channel_ticket_pop(Channel* chan, void* item, uint64_t* out_ticket_
         memset(chan->items + target*info.item_size, -1, info.item_size);
     #endif
     _channel_advance_id(chan, target, id, info);
+    chan_debug_log("pop done", ticket);
+}
+
+CHANAPI bool channel_ticket_pop(Channel* chan, void* item, uint64_t* out_ticket_or_null, Channel_Info info) 
+{
+    REQUIRE(item || (item == NULL && info.item_size == 0), "item must be provided");
+    uint64_t ticket = 0;
+    void* slot = channel_pop_acquire(chan, &ticket, info);
+    if(slot == NULL)
+        return false;
+
+    memcpy(item, slot, info.item_size);
+    channel_pop_release(chan, ticket, info);
     if(out_ticket_or_null)
         *out_ticket_or_null = ticket;
-    
-    chan_debug_log("pop done", ticket);
     return true;
 }
 
@@ -504,10 +889,14 @@ CHANAPI Channel_Res channel_ticket_try_push_weak(Channel* chan, const void* item
         
     chan_debug_wait(3);
     if(atomic_compare_exchange_strong(&chan->tail, &tail, tail+_CHAN_TICKET_INCREMENT) == false)
+    {
+        _CHAN_STATS_ADD(chan, push_lost_races, 1);
         return CHANNEL_LOST_RACE;
+    }
 
     memcpy(chan->items + target*info.item_size, item, info.item_size);
     _channel_advance_id(chan, target, id, info);
+    _CHAN_STATS_PUSHED(chan);
     if(out_ticket_or_null)
         *out_ticket_or_null = ticket;
 
@@ -550,7 +939,10 @@ CHANAPI Channel_Res channel_ticket_try_pop_weak(Channel* chan, void* item, uint6
         
     chan_debug_wait(3);
     if(atomic_compare_exchange_strong(&chan->head, &head, head+_CHAN_TICKET_INCREMENT) == false)
+    {
+        _CHAN_STATS_ADD(chan, pop_lost_races, 1);
         return CHANNEL_LOST_RACE;
+    }
         
     memcpy(item, chan->items + target*info.item_size, info.item_size);
     #ifdef CHANNEL_DEBUG
@@ -563,6 +955,253 @@ CHANAPI Channel_Res channel_ticket_try_pop_weak(Channel* chan, void* item, uint6
     return CHANNEL_OK;
 }
 
+//Batch interface. 
+//The blocking variants reserve a range of tickets with a single FAA and then go slot by slot exactly like 
+// channel_ticket_push/pop. Because barriers only ever lie after already reserved tickets, once some ticket of 
+// the range gets canceled by closing so do all following ones. We thus cancel the whole rest of the range at once.
+//The non-blocking variants first check how many consecutive slots are ready then reserve them with a single CAS.
+// This is the multi item equivalent of channel_ticket_try_push/pop_weak retried until it does not lose a race.
+CHANAPI isize channel_push_many(Channel* chan, const void* items, isize count, Channel_Info info) 
+{
+    ASSERT(memcmp(&chan->info, &info, sizeof info) == 0, "info must be matching");
+    REQUIRE(count >= 0 && (items || count == 0 || info.item_size == 0), "items must be provided");
+    if(count <= 0)
+        return 0;
+
+    uint64_t tail = atomic_fetch_add(&chan->tail, (uint64_t) count*_CHAN_TICKET_INCREMENT);
+    uint64_t first_ticket = tail / _CHAN_TICKET_INCREMENT;
+    chan_debug_log("push many called", first_ticket, count);
+    
+    for(isize i = 0; i < count; i++) {
+        uint64_t ticket = first_ticket + (uint64_t) i;
+        uint64_t target = _channel_get_target(chan, ticket);
+        uint32_t id = _channel_get_id(chan, ticket);
+        int64_t wait_start = 0;
+        for(;;) {
+            uint32_t curr = atomic_load(&chan->ids[target]);
+            chan_debug_wait(3);
+            uint32_t closing = atomic_load(&chan->closing_state);
+            if(closing) {
+                if(_channel_ticket_push_potentially_cancel(chan, ticket, (uint64_t) (count - i), closing) == false) {
+                    chan_debug_log("push many canceled", ticket, count - i);
+                    return i;
+                }
+            }
+
+            if(_channel_id_equals(curr, id))
+                break;
+                
+            if(info.wake) {
+                atomic_fetch_or(&chan->ids[target], _CHAN_ID_WAITING_BIT);
+                curr |= _CHAN_ID_WAITING_BIT;
+            }
+
+            _CHAN_STATS_WAIT_BEGIN(chan, push, wait_start);
+            if(info.wait)
+                info.wait((void*) &chan->ids[target], curr, -1);
+            else
+                chan_pause();
+        }
+        
+        _CHAN_STATS_WAIT_END(chan, push, wait_start);
+        memcpy(chan->items + target*info.item_size, (const uint8_t*) items + i*info.item_size, info.item_size);
+        _channel_advance_id(chan, target, id, info);
+    }
+
+    _CHAN_STATS_PUSHED(chan);
+    chan_debug_log("push many done", first_ticket, count);
+    return count;
+}
+
+CHANAPI isize channel_pop_many(Channel* chan, void* items, isize count, Channel_Info info) 
+{
+    ASSERT(memcmp(&chan->info, &info, sizeof info) == 0, "info must be matching");
+    REQUIRE(count >= 0 && (items || count == 0 || info.item_size == 0), "items must be provided");
+    if(count <= 0)
+        return 0;
+
+    uint64_t head = atomic_fetch_add(&chan->head, (uint64_t) count*_CHAN_TICKET_INCREMENT);
+    uint64_t first_ticket = head / _CHAN_TICKET_INCREMENT;
+    chan_debug_log("pop many called", first_ticket, count);
+
+    for(isize i = 0; i < count; i++) {
+        uint64_t ticket = first_ticket + (uint64_t) i;
+        uint64_t target = _channel_get_target(chan, ticket);
+        uint32_t id = _channel_get_id(chan, ticket) + _CHAN_ID_FILLED_BIT;
+        int64_t wait_start = 0;
+        for(;;) {
+            uint32_t curr = atomic_load(&chan->ids[target]);
+            uint32_t closing = atomic_load(&chan->closing_state);
+            if(closing) {
+                if(_channel_ticket_pop_potentially_cancel(chan, ticket, (uint64_t) (count - i), closing) == false) {
+                    chan_debug_log("pop many canceled", ticket, count - i);
+                    return i;
+                }
+            }
+            
+            chan_debug_wait(10);
+            if(_channel_id_equals(curr, id))
+                break;
+            
+            if(info.wake) {
+                atomic_fetch_or(&chan->ids[target], _CHAN_ID_WAITING_BIT);
+                curr |= _CHAN_ID_WAITING_BIT;
+            }
+            
+            _CHAN_STATS_WAIT_BEGIN(chan, pop, wait_start);
+            if(info.wait)
+                info.wait((void*) &chan->ids[target], curr, -1);
+            else
+                chan_pause();
+        }
+        
+        _CHAN_STATS_WAIT_END(chan, pop, wait_start);
+        memcpy((uint8_t*) items + i*info.item_size, chan->items + target*info.item_size, info.item_size);
+        #ifdef CHANNEL_DEBUG
+            memset(chan->items + target*info.item_size, -1, info.item_size);
+        #endif
+        _channel_advance_id(chan, target, id, info);
+    }
+    
+    chan_debug_log("pop many done", first_ticket, count);
+    return count;
+}
+
+CHANAPI isize channel_try_push_many(Channel* chan, const void* items, isize max_count, Channel_Info info) 
+{
+    ASSERT(memcmp(&chan->info, &info, sizeof info) == 0, "info must be matching");
+    REQUIRE(max_count >= 0 && (items || max_count == 0 || info.item_size == 0), "items must be provided");
+    if(max_count > chan->capacity)
+        max_count = chan->capacity;
+
+    uint64_t tail = 0;
+    uint64_t first_ticket = 0;
+    isize count = 0;
+    for(;;) {
+        tail = atomic_load(&chan->tail);
+        first_ticket = tail / _CHAN_TICKET_INCREMENT;
+        
+        chan_debug_wait(3);
+        for(count = 0; count < max_count; count++) {
+            uint64_t ticket = first_ticket + (uint64_t) count;
+            uint32_t curr_id = atomic_load(&chan->ids[_channel_get_target(chan, ticket)]);
+            if(_channel_id_equals(curr_id, _channel_get_id(chan, ticket)) == false)
+                break;
+        }
+
+        chan_debug_wait(3);
+        uint32_t closing = atomic_load(&chan->closing_state);
+        if(closing)
+        {
+            if(closing & _CHAN_CLOSING_HARD)
+                return 0;
+            else
+            {
+                uint64_t new_tail = atomic_load(&chan->tail);
+                chan_debug_wait(10);
+                uint64_t new_head = atomic_load(&chan->head);
+                chan_debug_wait(10);
+                uint64_t barrier = atomic_load(&chan->tail_barrier);
+
+                //Only push tickets before the barrier
+                if((new_head & _CHAN_TICKET_PUSH_CLOSED_BIT) || (new_tail & _CHAN_TICKET_PUSH_CLOSED_BIT))
+                {
+                    if(channel_ticket_is_less_or_eq(barrier, first_ticket))
+                        return 0;
+                    if(channel_ticket_is_less(barrier, first_ticket + (uint64_t) count))
+                        count = (isize) (barrier - first_ticket);
+                }
+            }
+        }
+
+        if(count == 0)
+            return 0;
+
+        chan_debug_wait(3);
+        if(atomic_compare_exchange_strong(&chan->tail, &tail, tail + (uint64_t) count*_CHAN_TICKET_INCREMENT))
+            break;
+        _CHAN_STATS_ADD(chan, push_lost_races, 1);
+    }
+
+    for(isize i = 0; i < count; i++) {
+        uint64_t ticket = first_ticket + (uint64_t) i;
+        uint64_t target = _channel_get_target(chan, ticket);
+        memcpy(chan->items + target*info.item_size, (const uint8_t*) items + i*info.item_size, info.item_size);
+        _channel_advance_id(chan, target, _channel_get_id(chan, ticket), info);
+    }
+
+    _CHAN_STATS_PUSHED(chan);
+    return count;
+}
+
+CHANAPI isize channel_try_pop_many(Channel* chan, void* items, isize max_count, Channel_Info info) 
+{
+    ASSERT(memcmp(&chan->info, &info, sizeof info) == 0, "info must be matching");
+    REQUIRE(max_count >= 0 && (items || max_count == 0 || info.item_size == 0), "items must be provided");
+    if(max_count > chan->capacity)
+        max_count = chan->capacity;
+
+    uint64_t head = 0;
+    uint64_t first_ticket = 0;
+    isize count = 0;
+    for(;;) {
+        head = atomic_load(&chan->head);
+        first_ticket = head / _CHAN_TICKET_INCREMENT;
+        
+        chan_debug_wait(3);
+        for(count = 0; count < max_count; count++) {
+            uint64_t ticket = first_ticket + (uint64_t) count;
+            uint32_t curr_id = atomic_load(&chan->ids[_channel_get_target(chan, ticket)]);
+            if(_channel_id_equals(curr_id, _channel_get_id(chan, ticket) + _CHAN_ID_FILLED_BIT) == false)
+                break;
+        }
+
+        chan_debug_wait(3);
+        uint32_t closing = atomic_load(&chan->closing_state);
+        if(closing)
+        {
+            if(closing & _CHAN_CLOSING_HARD)
+                return 0;
+            else
+            {
+                chan_debug_wait(10);
+                uint64_t new_head = atomic_load(&chan->head);
+                chan_debug_wait(10);
+                uint64_t barrier = atomic_load(&chan->head_barrier);
+
+                //Only pop tickets before the barrier
+                if(new_head & _CHAN_TICKET_POP_CLOSED_BIT)
+                {
+                    if(channel_ticket_is_less_or_eq(barrier, first_ticket))
+                        return 0;
+                    if(channel_ticket_is_less(barrier, first_ticket + (uint64_t) count))
+                        count = (isize) (barrier - first_ticket);
+                }
+            }
+        }
+
+        if(count == 0)
+            return 0;
+
+        chan_debug_wait(3);
+        if(atomic_compare_exchange_strong(&chan->head, &head, head + (uint64_t) count*_CHAN_TICKET_INCREMENT))
+            break;
+        _CHAN_STATS_ADD(chan, pop_lost_races, 1);
+    }
+
+    for(isize i = 0; i < count; i++) {
+        uint64_t ticket = first_ticket + (uint64_t) i;
+        uint64_t target = _channel_get_target(chan, ticket);
+        memcpy((uint8_t*) items + i*info.item_size, chan->items + target*info.item_size, info.item_size);
+        #ifdef CHANNEL_DEBUG
+            memset(chan->items + target*info.item_size, -1, info.item_size);
+        #endif
+        _channel_advance_id(chan, target, _channel_get_id(chan, ticket) + _CHAN_ID_FILLED_BIT, info);
+    }
+
+    return count;
+}
+
 CHANAPI void _channel_close_lock(Channel* chan, Channel_Info info)
 {
     uint32_t ticket = atomic_fetch_add(&chan->closing_lock_requested, 1);
@@ -601,6 +1240,7 @@ CHANAPI void _channel_close_wakeup_ticket_range(Channel* chan, uint64_t from, ui
         {
             atomic_fetch_and(&chan->ids[target], ~_CHAN_ID_WAITING_BIT);
             chan_debug_log("close waken up", ticket, id);
+            _CHAN_STATS_ADD(chan, wakes, 1);
             info.wake((void*) &chan->ids[target]);
         }
         else
@@ -693,19 +1333,20 @@ CHANAPI bool _channel_close_soft_custom(Channel* chan, Channel_Info info, bool p
             uint64_t head_ticket = head/_CHAN_TICKET_INCREMENT;
             uint64_t tail_ticket = tail/_CHAN_TICKET_INCREMENT;
 
-            bool limited = channel_ticket_is_less(tail_barrier, tail_ticket);
             ASSERT(channel_ticket_is_less_or_eq(head_barrier, tail_barrier));
             ASSERT(channel_ticket_is_less_or_eq(tail_barrier, tail_ticket));
             if(push_close == false)
                 ASSERT(channel_ticket_is_less_or_eq(head_barrier, head_ticket));
 
             chan_debug_log("_channel_close_soft head_barrier", head_barrier, head_ticket);
-            chan_debug_log("_channel_close_soft limiting", (uint64_t) limited, (uint64_t) chan->capacity);
+            chan_debug_log("_channel_close_soft limiting", (uint64_t) channel_ticket_is_less(tail_barrier, tail_ticket), (uint64_t) chan->capacity);
 
             _channel_close_wakeup_ticket_range(chan, head_barrier, head_ticket, info);
             _channel_close_wakeup_ticket_range(chan, tail_barrier, tail_ticket, info);
             
             atomic_fetch_or(&chan->closing_state, _CHAN_CLOSING_CLOSED);
+            if(atomic_load(&chan->select_count) != 0)
+                _channel_select_notify(chan);
         }
         _channel_close_unlock(chan, info);
     }
@@ -832,6 +1473,8 @@ CHANAPI bool channel_close_hard(Channel* chan, Channel_Info info)
     
     chan_debug_log("channel_close_hard called");
     bool out = (atomic_fetch_or(&chan->closing_state, _CHAN_CLOSING_HARD) & _CHAN_CLOSING_HARD) == 0;
+    if(atomic_load(&chan->select_count) != 0)
+        _channel_select_notify(chan);
     chan_debug_log("channel_close_hard done");
     return out;
 }
@@ -899,6 +1542,29 @@ CHANAPI isize channel_count(const Channel* chan)
         return dist;
 }
 
+CHANAPI Channel_Stats channel_get_stats(const Channel* chan)
+{
+    Channel_Stats out = {0};
+    #ifdef CHANNEL_STATS
+        uint64_t* fields = (uint64_t*) (void*) &out;
+        for(size_t i = 0; i < sizeof(Channel_Stats)/sizeof(uint64_t); i++)
+            fields[i] = atomic_load(&chan->stats[i]);
+    #else
+        (void) chan;
+    #endif
+    return out;
+}
+
+CHANAPI void channel_reset_stats(Channel* chan)
+{
+    #ifdef CHANNEL_STATS
+        for(size_t i = 0; i < sizeof(Channel_Stats)/sizeof(uint64_t); i++)
+            atomic_store(&chan->stats[i], 0);
+    #else
+        (void) chan;
+    #endif
+}
+
 CHANAPI bool channel_is_empty(const Channel* chan) 
 {
     return channel_signed_distance(chan) <= 0;
@@ -916,29 +1582,150 @@ CHANAPI bool channel_is_hard_closed(const Channel* chan)
     return (closing & _CHAN_CLOSING_HARD) != 0;
 }
 
-CHANAPI bool channel_ticket_is_less(uint64_t ticket_a, uint64_t ticket_b)
+CHANAPI void _channel_select_register(Channel_Select_Case* select_case, CHAN_ATOMIC(uint32_t)* notify, Sync_Wake_Func wake)
 {
-    uint64_t diff = ticket_a - ticket_b;
-    int64_t signed_diff = (int64_t) diff; 
-    return signed_diff < 0;
+    Channel* chan = select_case->chan;
+    select_case->_notify = notify;
+    select_case->_wake = wake;
+    select_case->_prev = NULL;
+
+    _channel_select_lock(chan);
+    select_case->_next = chan->select_first;
+    if(chan->select_first)
+        chan->select_first->_prev = select_case;
+    chan->select_first = select_case;
+    atomic_fetch_add(&chan->select_count, 1);
+    atomic_store(&chan->select_lock, 0);
 }
 
-CHANAPI bool channel_ticket_is_less_or_eq(uint64_t ticket_a, uint64_t ticket_b)
+CHANAPI void _channel_select_unregister(Channel_Select_Case* select_case)
 {
-    uint64_t diff = ticket_a - ticket_b;
-    int64_t signed_diff = (int64_t) diff; 
-    return signed_diff <= 0;
+    Channel* chan = select_case->chan;
+    _channel_select_lock(chan);
+    if(select_case->_prev)
+        select_case->_prev->_next = select_case->_next;
+    else
+        chan->select_first = select_case->_next;
+    if(select_case->_next)
+        select_case->_next->_prev = select_case->_prev;
+    atomic_fetch_sub(&chan->select_count, 1);
+    atomic_store(&chan->select_lock, 0);
+    
+    select_case->_next = NULL;
+    select_case->_prev = NULL;
 }
 
-CHANAPI void channel_init(Channel* chan, void* items, uint32_t* ids, isize capacity, Channel_Info info)
+//Tries all cases once starting from start. Returns the index of the case that completed or closed or -1.
+CHANAPI isize _channel_select_try(Channel_Select_Case* cases, isize case_count, isize start, Channel_Res* res)
 {
-    REQUIRE(ids);
-    REQUIRE(capacity > 0 && "must be nonzero");
-    REQUIRE(items != NULL || (items == NULL && info.item_size == 0));
+    for(isize k = 0; k < case_count; k++)
+    {
+        isize i = (start + k) % case_count;
+        Channel_Select_Case* c = &cases[i];
+        if(c->chan == NULL)
+            continue;
+
+        Channel_Res curr = c->is_push 
+            ? channel_try_push(c->chan, c->item, c->info) 
+            : channel_try_pop(c->chan, c->item, c->info);
+        if(curr == CHANNEL_OK || curr == CHANNEL_CLOSED)
+        {
+            *res = curr;
+            return i;
+        }
+    }
+    return -1;
+}
 
-    memset(chan, 0, sizeof* chan);
-    chan->items = (uint8_t*) items;
-    chan->ids = (CHAN_ATOMIC(uint32_t)*) (void*) ids;
+CHANAPI isize channel_select(Channel_Select_Case* cases, isize case_count, double timeout_or_negative_if_infinite, Channel_Res* res_or_null)
+{
+    static CHAN_ATOMIC(uint32_t) rotation = 0;
+    isize start = case_count > 0 ? (isize) (atomic_fetch_add_explicit(&rotation, 1, memory_order_relaxed) % (uint32_t) case_count) : 0;
+
+    isize active_count = 0;
+    for(isize i = 0; i < case_count; i++)
+        active_count += cases[i].chan != NULL;
+
+    Channel_Res res = CHANNEL_EMPTY;
+    isize out = _channel_select_try(cases, case_count, start, &res);
+    if(out == -1 && active_count > 0 && timeout_or_negative_if_infinite != 0)
+    {
+        Sync_Wait_Func wait = NULL;
+        Sync_Wake_Func wake = NULL;
+        for(isize i = 0; i < case_count; i++)
+            if(cases[i].chan && cases[i].info.wait)
+            {
+                wait = cases[i].info.wait;
+                wake = cases[i].info.wake;
+                break;
+            }
+
+        CHAN_ATOMIC(uint32_t) notify = 0;
+        for(isize i = 0; i < case_count; i++)
+            if(cases[i].chan)
+                _channel_select_register(&cases[i], &notify, wake);
+
+        int64_t deadline = 0;
+        if(timeout_or_negative_if_infinite > 0)
+            deadline = chan_perf_counter() + (int64_t) (timeout_or_negative_if_infinite*(double) chan_perf_frequency());
+
+        for(;;) {
+            //Must load notify before retrying. Any notification after this load makes the wait return immediately.
+            uint32_t notified = atomic_load(&notify);
+            out = _channel_select_try(cases, case_count, start, &res);
+            if(out != -1)
+                break;
+
+            double remaining = -1;
+            if(timeout_or_negative_if_infinite > 0)
+            {
+                int64_t now = chan_perf_counter();
+                if(now >= deadline)
+                    break;
+                remaining = (double) (deadline - now)/(double) chan_perf_frequency();
+            }
+
+            if(wait)
+                wait((void*) &notify, notified, remaining);
+            else
+                chan_pause();
+        }
+
+        for(isize i = 0; i < case_count; i++)
+            if(cases[i].chan)
+                _channel_select_unregister(&cases[i]);
+    }
+    
+    if(out == -1)
+        res = CHANNEL_EMPTY;
+    if(res_or_null)
+        *res_or_null = res;
+    return out;
+}
+
+CHANAPI bool channel_ticket_is_less(uint64_t ticket_a, uint64_t ticket_b)
+{
+    uint64_t diff = ticket_a - ticket_b;
+    int64_t signed_diff = (int64_t) diff; 
+    return signed_diff < 0;
+}
+
+CHANAPI bool channel_ticket_is_less_or_eq(uint64_t ticket_a, uint64_t ticket_b)
+{
+    uint64_t diff = ticket_a - ticket_b;
+    int64_t signed_diff = (int64_t) diff; 
+    return signed_diff <= 0;
+}
+
+CHANAPI void channel_init(Channel* chan, void* items, uint32_t* ids, isize capacity, Channel_Info info)
+{
+    REQUIRE(ids);
+    REQUIRE(capacity > 0 && "must be nonzero");
+    REQUIRE(items != NULL || (items == NULL && info.item_size == 0));
+
+    memset(chan, 0, sizeof* chan);
+    chan->items = (uint8_t*) items;
+    chan->ids = (CHAN_ATOMIC(uint32_t)*) (void*) ids;
     chan->capacity = capacity; 
     chan->info = info;
     chan->ref_count = 1;
@@ -1012,6 +1799,521 @@ CHANAPI int32_t channel_deinit(Channel* chan)
     return refs;
 }
 
+CHANAPI Channel_Segment* _channel_segment_malloc(isize capacity, Channel_Info info)
+{
+    isize total_size = (isize) sizeof(Channel_Segment) + capacity*(isize) sizeof(uint32_t) + capacity*info.item_size;
+    total_size = (total_size + CHAN_CACHE_LINE - 1)/CHAN_CACHE_LINE*CHAN_CACHE_LINE;
+    Channel_Segment* seg = (Channel_Segment*) chan_aligned_alloc(total_size, CHAN_CACHE_LINE);
+    if(seg)
+    {
+        uint32_t* ids = (uint32_t*) (void*) (seg + 1);
+        atomic_store(&seg->next, (Channel_Segment*) NULL);
+        channel_init(&seg->chan, ids + capacity, ids, capacity, info);
+    }
+    return seg;
+}
+
+CHANAPI void _channel_unbounded_lock(Channel_Unbounded* chan)
+{
+    while(atomic_exchange(&chan->grow_lock, 1))
+        chan_yield();
+}
+
+CHANAPI void _channel_unbounded_unlock(Channel_Unbounded* chan)
+{
+    atomic_store(&chan->grow_lock, 0);
+}
+
+CHANAPI bool channel_unbounded_init(Channel_Unbounded* chan, isize initial_capacity, Channel_Info info)
+{
+    REQUIRE(initial_capacity > 0);
+    memset(chan, 0, sizeof *chan);
+    Channel_Segment* seg = _channel_segment_malloc(initial_capacity, info);
+    chan->info = info;
+    chan->first = seg;
+    chan->segment_count = seg ? 1 : 0;
+    atomic_store(&chan->head, seg);
+    atomic_store(&chan->tail, seg);
+    return seg != NULL;
+}
+
+CHANAPI void channel_unbounded_deinit(Channel_Unbounded* chan)
+{
+    for(Channel_Segment* seg = chan->first; seg; )
+    {
+        Channel_Segment* next = atomic_load(&seg->next);
+        chan_aligned_free(seg);
+        seg = next;
+    }
+    memset(chan, 0, sizeof *chan);
+}
+
+CHANAPI isize channel_unbounded_trim(Channel_Unbounded* chan)
+{
+    isize freed = 0;
+    Channel_Segment* head = atomic_load(&chan->head);
+    while(chan->first != head)
+    {
+        Channel_Segment* next = atomic_load(&chan->first->next);
+        chan_aligned_free(chan->first);
+        chan->first = next;
+        freed += 1;
+    }
+    atomic_fetch_sub(&chan->segment_count, (uint32_t) freed);
+    return freed;
+}
+
+//Links a new segment after seg (unless some other producer already did) and closes seg for pushing.
+_CHAN_INLINE_NEVER
+static void _channel_unbounded_grow(Channel_Unbounded* chan, Channel_Segment* seg, Channel_Info info)
+{
+    _channel_unbounded_lock(chan);
+    if(atomic_load(&seg->next) == NULL && atomic_load(&chan->closing_state) == 0)
+    {
+        Channel_Segment* next = _channel_segment_malloc(seg->chan.capacity*2, info);
+        if(next)
+        {
+            chan_debug_log("unbounded grow", (uint64_t) seg->chan.capacity*2);
+            atomic_store(&seg->next, next);
+            channel_close_push(&seg->chan, info);
+            atomic_store(&chan->tail, next);
+            atomic_fetch_add(&chan->segment_count, 1);
+        }
+    }
+    _channel_unbounded_unlock(chan);
+}
+
+//The same as channel_ticket_push except when the slot is occupied because the segment is full, we grow the 
+// channel instead of waiting for consumers. Growing closes the segment which most likely cancels this push 
+// (unless some pops happened in the meantime) after which we retry in the next segment.
+CHANAPI bool channel_unbounded_push(Channel_Unbounded* unbounded, const void* item, Channel_Info info)
+{
+    ASSERT(memcmp(&unbounded->info, &info, sizeof info) == 0, "info must be matching");
+    REQUIRE(item || (item == NULL && info.item_size == 0), "item must be provided");
+
+    Channel_Segment* seg = atomic_load(&unbounded->tail);
+    for(;;) {
+        Channel* chan = &seg->chan;
+        uint64_t tail = atomic_fetch_add(&chan->tail, _CHAN_TICKET_INCREMENT);
+        uint64_t ticket = tail / _CHAN_TICKET_INCREMENT;
+        uint64_t target = _channel_get_target(chan, ticket);
+        uint32_t id = _channel_get_id(chan, ticket);
+        
+        bool canceled = false;
+        bool grown = false;
+        int64_t wait_start = 0;
+        for(;;) {
+            uint32_t curr = atomic_load(&chan->ids[target]);
+            uint32_t closing = atomic_load(&chan->closing_state);
+            if(closing && _channel_ticket_push_potentially_cancel(chan, ticket, 1, closing) == false) {
+                canceled = true;
+                break;
+            }
+
+            if(_channel_id_equals(curr, id))
+                break;
+
+            if(grown == false)
+            {
+                uint64_t head = atomic_load(&chan->head);
+                uint64_t head_p_cap = (head/_CHAN_TICKET_INCREMENT + (uint64_t) chan->capacity) % CHANNEL_MAX_TICKET;
+                if(channel_ticket_is_less_or_eq(head_p_cap, ticket))
+                {
+                    _channel_unbounded_grow(unbounded, seg, info);
+                    grown = true;
+                    continue;
+                }
+            }
+                
+            if(info.wake) {
+                atomic_fetch_or(&chan->ids[target], _CHAN_ID_WAITING_BIT);
+                curr |= _CHAN_ID_WAITING_BIT;
+            }
+
+            _CHAN_STATS_WAIT_BEGIN(chan, push, wait_start);
+            if(info.wait)
+                info.wait((void*) &chan->ids[target], curr, -1);
+            else
+                chan_pause();
+        }
+
+        if(canceled == false)
+        {
+            _CHAN_STATS_WAIT_END(chan, push, wait_start);
+            memcpy(chan->items + target*info.item_size, item, info.item_size);
+            _channel_advance_id(chan, target, id, info);
+            _CHAN_STATS_PUSHED(chan);
+            return true;
+        }
+
+        //The segment was either grown or the whole channel closed. 
+        //If neither (the channel was reopened in the meantime) simply retry.
+        Channel_Segment* next = atomic_load(&seg->next);
+        if(next)
+            seg = next;
+        else if(atomic_load(&unbounded->closing_state))
+            return false;
+        else
+            seg = atomic_load(&unbounded->tail);
+    }
+}
+
+CHANAPI bool channel_unbounded_pop(Channel_Unbounded* unbounded, void* item, Channel_Info info)
+{
+    ASSERT(memcmp(&unbounded->info, &info, sizeof info) == 0, "info must be matching");
+    for(;;) {
+        Channel_Segment* seg = atomic_load(&unbounded->head);
+        if(channel_ticket_pop(&seg->chan, item, NULL, info))
+            return true;
+        
+        //Segment is closed and all of its items before the barrier were popped. 
+        //If it has a next segment move there else the whole channel is closed.
+        Channel_Segment* next = atomic_load(&seg->next);
+        if(next == NULL)
+            return false;
+        atomic_compare_exchange_strong(&unbounded->head, &seg, next);
+    }
+}
+
+CHANAPI Channel_Res channel_unbounded_try_pop(Channel_Unbounded* unbounded, void* item, Channel_Info info)
+{
+    ASSERT(memcmp(&unbounded->info, &info, sizeof info) == 0, "info must be matching");
+    for(;;) {
+        Channel_Segment* seg = atomic_load(&unbounded->head);
+        Channel_Res res = channel_ticket_try_pop(&seg->chan, item, NULL, info);
+        if(res != CHANNEL_CLOSED)
+            return res;
+
+        Channel_Segment* next = atomic_load(&seg->next);
+        if(next == NULL)
+            return CHANNEL_CLOSED;
+        atomic_compare_exchange_strong(&unbounded->head, &seg, next);
+    }
+}
+
+CHANAPI bool channel_unbounded_close_push(Channel_Unbounded* chan, Channel_Info info)
+{
+    bool out = false;
+    _channel_unbounded_lock(chan);
+    if(atomic_load(&chan->closing_state) == 0)
+    {
+        atomic_store(&chan->closing_state, _CHAN_CLOSING_PUSH);
+        out = channel_close_push(&atomic_load(&chan->tail)->chan, info);
+    }
+    _channel_unbounded_unlock(chan);
+    return out;
+}
+
+CHANAPI bool channel_unbounded_close_hard(Channel_Unbounded* chan, Channel_Info info)
+{
+    bool out = false;
+    _channel_unbounded_lock(chan);
+    if((atomic_load(&chan->closing_state) & _CHAN_CLOSING_HARD) == 0)
+    {
+        atomic_fetch_or(&chan->closing_state, _CHAN_CLOSING_HARD);
+        for(Channel_Segment* seg = atomic_load(&chan->head); seg; seg = atomic_load(&seg->next))
+            channel_close_hard(&seg->chan, info);
+        out = true;
+    }
+    _channel_unbounded_unlock(chan);
+    return out;
+}
+
+CHANAPI bool channel_unbounded_reopen(Channel_Unbounded* chan, Channel_Info info)
+{
+    bool out = false;
+    _channel_unbounded_lock(chan);
+    if(atomic_load(&chan->closing_state) == _CHAN_CLOSING_PUSH)
+    {
+        out = channel_reopen(&atomic_load(&chan->tail)->chan, info);
+        atomic_store(&chan->closing_state, 0);
+    }
+    _channel_unbounded_unlock(chan);
+    return out;
+}
+
+CHANAPI bool channel_unbounded_is_closed(const Channel_Unbounded* chan)
+{
+    return atomic_load(&chan->closing_state) != 0;
+}
+
+CHANAPI isize channel_unbounded_count(const Channel_Unbounded* chan)
+{
+    isize count = 0;
+    for(Channel_Segment* seg = atomic_load(&chan->head); seg; seg = atomic_load(&seg->next))
+        count += channel_count(&seg->chan);
+    return count;
+}
+
+CHANAPI isize channel_unbounded_capacity(const Channel_Unbounded* chan)
+{
+    return atomic_load(&chan->tail)->chan.capacity;
+}
+
+#ifdef __cplusplus
+    using std::memory_order_acquire;
+    using std::memory_order_release;
+    using std::memory_order_relaxed;
+    using std::memory_order_seq_cst;
+#endif
+
+CHANAPI void channel_spsc_init(Channel_Spsc* chan, void* items, isize capacity, Channel_Info info)
+{
+    REQUIRE(capacity > 0 && (capacity & (capacity - 1)) == 0 && "must be a power of two");
+    REQUIRE(items != NULL || info.item_size == 0);
+
+    memset(chan, 0, sizeof* chan);
+    chan->capacity = capacity;
+    chan->items_offset = (isize) ((uint8_t*) items - (uint8_t*) chan);
+    #ifdef CHANNEL_DEBUG
+        memset(items, -1, (size_t) (capacity*info.item_size));
+    #endif
+
+    atomic_store(&chan->head, 0);
+    atomic_store(&chan->tail, 0);
+    atomic_store(&chan->closed, 0);
+}
+
+CHANAPI isize channel_spsc_memory_size(isize capacity, Channel_Info info)
+{
+    return sizeof(Channel_Spsc) + capacity*info.item_size;
+}
+
+CHANAPI Channel_Spsc* channel_spsc_init_into_memory(void* aligned_memory, isize capacity, Channel_Info info)
+{
+    Channel_Spsc* chan = (Channel_Spsc*) aligned_memory;
+    if(chan)
+        channel_spsc_init(chan, chan + 1, capacity, info);
+    return chan;
+}
+
+CHANAPI Channel_Spsc* channel_spsc_malloc(isize capacity, Channel_Info info)
+{
+    isize total_size = channel_spsc_memory_size(capacity, info);
+    total_size = (total_size + CHAN_CACHE_LINE - 1)/CHAN_CACHE_LINE*CHAN_CACHE_LINE;
+    void* mem = chan_aligned_alloc(total_size, CHAN_CACHE_LINE);
+    Channel_Spsc* chan = channel_spsc_init_into_memory(mem, capacity, info);
+    if(chan)
+        atomic_store(&chan->allocated, true);
+    return chan;
+}
+
+CHANAPI void channel_spsc_deinit(Channel_Spsc* chan)
+{
+    if(chan)
+    {
+        if(atomic_load(&chan->allocated))
+            chan_aligned_free(chan);
+        else
+            memset(chan, 0, sizeof *chan);
+    }
+}
+
+//Returns the number of items the consumer can pop, at most wanted. Only reloads tail if the cached copy does not suffice.
+CHANAPI isize _channel_spsc_readable(Channel_Spsc* chan, uint64_t head, isize wanted)
+{
+    uint64_t tail = chan->cached_tail;
+    if((isize) (tail - head) < wanted)
+        chan->cached_tail = tail = atomic_load_explicit(&chan->tail, memory_order_acquire);
+
+    isize readable = (isize) (tail - head);
+    return readable < wanted ? readable : wanted;
+}
+
+//Returns the number of items the producer can push, at most wanted. Only reloads head if the cached copy does not suffice.
+CHANAPI isize _channel_spsc_writable(Channel_Spsc* chan, uint64_t tail, isize wanted)
+{
+    uint64_t head = chan->cached_head;
+    if(chan->capacity - (isize) (tail - head) < wanted)
+        chan->cached_head = head = atomic_load_explicit(&chan->head, memory_order_acquire);
+
+    isize writable = chan->capacity - (isize) (tail - head);
+    return writable < wanted ? writable : wanted;
+}
+
+//Copies count items between the ring starting at index and the linear array. Splits the copy in two if it wraps around.
+CHANAPI void _channel_spsc_copy(Channel_Spsc* chan, uint64_t index, void* items, isize count, bool into_ring, Channel_Info info)
+{
+    uint8_t* ring = (uint8_t*) chan + chan->items_offset;
+    isize offset = (isize) (index & (uint64_t) (chan->capacity - 1));
+    isize first = chan->capacity - offset;
+    if(first > count)
+        first = count;
+
+    uint8_t* slot = ring + offset*info.item_size;
+    uint8_t* rest = (uint8_t*) items + first*info.item_size;
+    if(into_ring)
+    {
+        memcpy(slot, items, (size_t) (first*info.item_size));
+        memcpy(ring, rest, (size_t) ((count - first)*info.item_size));
+    }
+    else
+    {
+        memcpy(items, slot, (size_t) (first*info.item_size));
+        memcpy(rest, ring, (size_t) ((count - first)*info.item_size));
+    }
+}
+
+//Called after publishing a new index. Wakes the other side if it announced it is going to wait.
+CHANAPI void _channel_spsc_wake(CHAN_ATOMIC(uint32_t)* waiting, Channel_Info info)
+{
+    if(info.wake)
+    {
+        //Pairs with the store of the flag and reload of the index in _channel_spsc_wait. 
+        // Without it the load of the flag could move before the store of the index and both sides could sleep forever.
+        atomic_thread_fence(memory_order_seq_cst);
+        if(atomic_load_explicit(waiting, memory_order_relaxed) && atomic_exchange(waiting, 0))
+            info.wake((void*) waiting);
+    }
+}
+
+//Waits until the index of the other side changes from seen or the channel gets closed. Can return spuriously.
+CHANAPI void _channel_spsc_wait(Channel_Spsc* chan, CHAN_ATOMIC(uint64_t)* index, uint64_t seen, CHAN_ATOMIC(uint32_t)* waiting, Channel_Info info)
+{
+    if(info.wait == NULL)
+        chan_pause();
+    else if(info.wake == NULL)
+        info.wait((void*) waiting, 1, -1);
+    else
+    {
+        atomic_store(waiting, 1);
+        if(atomic_load(index) == seen && atomic_load(&chan->closed) == 0)
+            info.wait((void*) waiting, 1, -1);
+    }
+}
+
+CHANAPI isize channel_spsc_try_push_batch(Channel_Spsc* chan, const void* items, isize count, Channel_Info info)
+{
+    if(atomic_load_explicit(&chan->closed, memory_order_relaxed))
+        return 0;
+
+    uint64_t tail = atomic_load_explicit(&chan->tail, memory_order_relaxed);
+    isize pushed = _channel_spsc_writable(chan, tail, count);
+    if(pushed > 0)
+    {
+        _channel_spsc_copy(chan, tail, (void*) items, pushed, true, info);
+        atomic_store_explicit(&chan->tail, tail + (uint64_t) pushed, memory_order_release);
+        _channel_spsc_wake(&chan->pop_waiting, info);
+    }
+    return pushed;
+}
+
+CHANAPI isize channel_spsc_try_pop_batch(Channel_Spsc* chan, void* items, isize max_count, Channel_Info info)
+{
+    uint64_t head = atomic_load_explicit(&chan->head, memory_order_relaxed);
+    isize popped = _channel_spsc_readable(chan, head, max_count);
+    if(popped > 0)
+    {
+        _channel_spsc_copy(chan, head, items, popped, false, info);
+        atomic_store_explicit(&chan->head, head + (uint64_t) popped, memory_order_release);
+        _channel_spsc_wake(&chan->push_waiting, info);
+    }
+    return popped;
+}
+
+CHANAPI Channel_Res channel_spsc_try_push(Channel_Spsc* chan, const void* item, Channel_Info info)
+{
+    if(channel_spsc_try_push_batch(chan, item, 1, info))
+        return CHANNEL_OK;
+    if(atomic_load(&chan->closed))
+        return CHANNEL_CLOSED;
+    return CHANNEL_FULL;
+}
+
+CHANAPI Channel_Res channel_spsc_try_pop(Channel_Spsc* chan, void* item, Channel_Info info)
+{
+    if(channel_spsc_try_pop_batch(chan, item, 1, info))
+        return CHANNEL_OK;
+
+    //Items pushed before closing are visible once we see the channel closed so try once more.
+    if(atomic_load(&chan->closed) == 0)
+        return CHANNEL_EMPTY;
+    if(channel_spsc_try_pop_batch(chan, item, 1, info))
+        return CHANNEL_OK;
+    return CHANNEL_CLOSED;
+}
+
+CHANAPI isize channel_spsc_push_batch(Channel_Spsc* chan, const void* items, isize count, Channel_Info info)
+{
+    isize pushed = 0;
+    while(pushed < count)
+    {
+        isize curr = channel_spsc_try_push_batch(chan, (const uint8_t*) items + pushed*info.item_size, count - pushed, info);
+        if(curr == 0)
+        {
+            if(atomic_load(&chan->closed))
+                break;
+            _channel_spsc_wait(chan, &chan->head, chan->cached_head, &chan->push_waiting, info);
+        }
+        pushed += curr;
+    }
+    return pushed;
+}
+
+CHANAPI isize channel_spsc_pop_batch(Channel_Spsc* chan, void* items, isize max_count, Channel_Info info)
+{
+    if(max_count <= 0)
+        return 0;
+
+    for(;;)
+    {
+        isize popped = channel_spsc_try_pop_batch(chan, items, max_count, info);
+        if(popped > 0)
+            return popped;
+
+        if(atomic_load(&chan->closed))
+            return channel_spsc_try_pop_batch(chan, items, max_count, info);
+        _channel_spsc_wait(chan, &chan->tail, chan->cached_tail, &chan->pop_waiting, info);
+    }
+}
+
+CHANAPI bool channel_spsc_push(Channel_Spsc* chan, const void* item, Channel_Info info)
+{
+    return channel_spsc_push_batch(chan, item, 1, info) == 1;
+}
+
+CHANAPI bool channel_spsc_pop(Channel_Spsc* chan, void* item, Channel_Info info)
+{
+    return channel_spsc_pop_batch(chan, item, 1, info) == 1;
+}
+
+CHANAPI bool channel_spsc_close(Channel_Spsc* chan, Channel_Info info)
+{
+    bool closed_now = atomic_exchange(&chan->closed, 1) == 0;
+    if(info.wake)
+    {
+        if(atomic_exchange(&chan->push_waiting, 0))
+            info.wake((void*) &chan->push_waiting);
+        if(atomic_exchange(&chan->pop_waiting, 0))
+            info.wake((void*) &chan->pop_waiting);
+    }
+    return closed_now;
+}
+
+CHANAPI bool channel_spsc_reopen(Channel_Spsc* chan)
+{
+    //Only closed is affected by closing. Head and tail stay valid.
+    return atomic_exchange(&chan->closed, 0) != 0;
+}
+
+CHANAPI bool channel_spsc_is_closed(const Channel_Spsc* chan)
+{
+    return atomic_load(&chan->closed) != 0;
+}
+
+CHANAPI isize channel_spsc_count(const Channel_Spsc* chan)
+{
+    uint64_t head = atomic_load(&chan->head);
+    uint64_t tail = atomic_load(&chan->tail);
+    isize count = (isize) (tail - head);
+    return count < 0 ? 0 : count;
+}
+
+CHANAPI isize channel_spsc_capacity(const Channel_Spsc* chan)
+{
+    return chan->capacity;
+}
+
 CHANAPI bool chan_wait_yield(volatile void* state, uint32_t undesired, double timeout_or_negatove_if_infinite)
 {
     (void) state; (void) undesired; (void) timeout_or_negatove_if_infinite;
@@ -1019,6 +2321,71 @@ CHANAPI bool chan_wait_yield(volatile void* state, uint32_t undesired, double ti
     return true;
 }
 
+//Spin budgets in nanoseconds indexed by the hash of the cache line waited on. 
+// Updates are racy loads and stores which is fine since they are only heuristics.
+static CHAN_ATOMIC(uint32_t) _chan_adaptive_budgets[CHAN_ADAPTIVE_BUDGETS];
+
+CHANAPI bool chan_wait_adaptive(volatile void* state, uint32_t undesired, double timeout_or_negatove_if_infinite)
+{
+    uint64_t line = (uint64_t) (uintptr_t) state / CHAN_CACHE_LINE;
+    CHAN_ATOMIC(uint32_t)* budget_ptr = &_chan_adaptive_budgets[(line*0x9E3779B97F4A7C15ull >> 32) & (CHAN_ADAPTIVE_BUDGETS - 1)];
+    int64_t budget = (int64_t) atomic_load(budget_ptr);
+    if(budget < CHAN_ADAPTIVE_MIN_SPIN_NS)
+        budget = CHAN_ADAPTIVE_MIN_SPIN_NS;
+
+    int64_t freq = chan_perf_frequency();
+    int64_t start = chan_perf_counter();
+    int64_t spin_ticks = (int64_t) ((double) budget*(double) freq/1e9);
+    volatile uint32_t* value = (volatile uint32_t*) state;
+
+    //Spin checking the clock only every few iterations since it is a lot more expensive than pause 
+    bool changed = false;
+    for(int i = 1;; i++)
+    {
+        if(*value != undesired) { changed = true; break; }
+        chan_pause();
+        if(i % 16 == 0 && chan_perf_counter() - start >= spin_ticks)
+            break;
+    }
+
+    for(int i = 0; changed == false && i < CHAN_ADAPTIVE_YIELDS; i++)
+    {
+        chan_yield();
+        changed = *value != undesired;
+    }
+
+    bool out = true;
+    if(changed == false)
+    {
+        double timeout = timeout_or_negatove_if_infinite;
+        if(timeout >= 0)
+        {
+            timeout -= (double) (chan_perf_counter() - start)/(double) freq;
+            if(timeout < 0)
+                timeout = 0;
+        }
+        out = chan_futex_wait(value, undesired, timeout);
+    }
+
+    //Move the budget towards twice the duration of the wait if spinning that long would have paid off.
+    // Otherwise shrink it. Waits that ran out of time say nothing about the typical wait and are ignored.
+    if(out)
+    {
+        int64_t waited = (int64_t) ((double) (chan_perf_counter() - start)*1e9/(double) freq);
+        if(waited <= CHAN_ADAPTIVE_MAX_SPIN_NS)
+            budget += (2*waited - budget)/8;
+        else
+            budget -= budget/8;
+
+        if(budget < CHAN_ADAPTIVE_MIN_SPIN_NS)
+            budget = CHAN_ADAPTIVE_MIN_SPIN_NS;
+        if(budget > CHAN_ADAPTIVE_MAX_SPIN_NS)
+            budget = CHAN_ADAPTIVE_MAX_SPIN_NS;
+        atomic_store(budget_ptr, (uint32_t) budget);
+    }
+    return out;
+}
+
 CHANAPI bool chan_wait_block(volatile void* state, uint32_t undesired, double timeout_or_negatove_if_infinite)
 {
     return chan_futex_wait((uint32_t*) state, undesired, timeout_or_negatove_if_infinite);
@@ -0,0 +1,297 @@
+#ifndef MODULE_CHANNEL_SHARED
+#define MODULE_CHANNEL_SHARED
+
+// A channel between two processes placed in named shared memory.
+//
+// Channel itself cannot be shared this way because it holds pointers to its ids and items which are only
+// valid in the process that initialized it. Channel_Spsc addresses its items by an offset from itself so each
+// process can map it at a different address. The shared channel thus connects exactly one producer process
+// with one consumer process, which is the common case of a pipeline split into processes. The items are
+// written by the producer straight into the shared memory and read from there by the consumer, nothing
+// passes through the kernel.
+//
+// The block starts with Channel_Shared_Header describing the channel followed by the Channel_Spsc and its items.
+// Blocking uses the non private futexes platform_futex_wait_shared/platform_futex_wake_all_shared.
+// We use named blocks (shm_open on linux, named file mappings on windows) instead of memfd_create because
+// those can be opened just by knowing the name while memfd has to be passed to the other process over a socket.
+//
+// Each side stores its process id in the header while attached. When a side has to wait it checks every
+// CHANNEL_SHARED_PEER_CHECK_SECONDS whether the other side is still running. If the other side died without
+// detaching the channel gets closed. The consumer then still pops all items the producer completely pushed
+// (items are only published once they are fully written, so a crash never exposes a torn item) and then fails.
+// The producer fails right away. A process which died without detaching can be replaced by opening the channel
+// in the same role again. This reopens the channel (if the other side is still attached) so that the surviving
+// side can continue with the new process. A replaced consumer continues from the last item the dead one fully
+// popped so items it was in the middle of popping are delivered again. A channel closed through 
+// channel_shared_close is never reopened.
+
+#include "platform.h"
+#include "channel.h"
+
+#define CHANNEL_SHARED_MAGIC 0x4448534c4e414843ull /* "CHANLSHD" */
+
+#ifndef CHANNEL_SHARED_PEER_CHECK_SECONDS
+    #define CHANNEL_SHARED_PEER_CHECK_SECONDS 0.05
+#endif
+
+#ifndef CHANNEL_SHARED_OPEN_TIMEOUT_SECONDS
+    #define CHANNEL_SHARED_OPEN_TIMEOUT_SECONDS 1.0 /* how long to wait for the creator to finish initializing */
+#endif
+
+typedef enum Channel_Shared_Role {
+    CHANNEL_SHARED_PRODUCER = 0,
+    CHANNEL_SHARED_CONSUMER = 1,
+} Channel_Shared_Role;
+
+typedef struct Channel_Shared_Header {
+    alignas(CHAN_CACHE_LINE)
+    uint64_t magic;
+    CHAN_ATOMIC(uint32_t) ready;            //set once the channel is initialized
+    uint32_t _;
+    isize item_size;
+    isize capacity;
+    CHAN_ATOMIC(int64_t) process_ids[2];    //ids of the attached producer and consumer processes indexed by Channel_Shared_Role. 0 if not attached.
+} Channel_Shared_Header;
+
+typedef struct Channel_Shared {
+    Channel_Spsc* chan;                     //the channel inside the shared memory. Can be also used directly together with info.
+    Channel_Shared_Header* header;
+    Channel_Info info;                      //item size and shared futex wait/wake
+    Channel_Shared_Role role;
+    int32_t _;
+    int64_t last_peer_check;
+    Platform_Memory_Mapping mapping;
+} Channel_Shared;
+
+//Creates a new shared channel with the given name and attaches to it in the given role. Capacity must be a power of two.
+//If a block with the same name exists (for example from a previous crashed run) it is replaced.
+//Processes that have the old block opened keep using it.
+EXTERNAL Platform_Error channel_shared_create(Channel_Shared* shared, Platform_String name, isize capacity, isize item_size, Channel_Shared_Role role);
+//Opens an existing shared channel and attaches to it in the given role.
+//Fails with PLATFORM_ERROR_OTHER if the block is not a channel with items of item_size or if the role is taken by a running process.
+//Taking over the role of a dead process reopens the channel (see the top of the file).
+EXTERNAL Platform_Error channel_shared_open(Channel_Shared* shared, Platform_String name, isize item_size, Channel_Shared_Role role);
+//Closes the channel (the other side drains the remaining items and then fails), detaches and unmaps it.
+EXTERNAL void           channel_shared_close(Channel_Shared* shared);
+//Removes the name of the channel. Processes which have it opened are not affected.
+EXTERNAL Platform_Error channel_shared_remove(Platform_String name);
+
+//Pushes an item, waiting if the channel is full. Returns false if the channel is closed or the consumer died. Producer only.
+EXTERNAL bool  channel_shared_push(Channel_Shared* shared, const void* item);
+//Pops an item, waiting if the channel is empty. Returns false if the channel is closed (or the producer died) and empty. Consumer only.
+EXTERNAL bool  channel_shared_pop(Channel_Shared* shared, void* item);
+//Pushes all count items waiting as necessary. Returns the number of pushed items which is less than count only if the channel got closed.
+EXTERNAL isize channel_shared_push_batch(Channel_Shared* shared, const void* items, isize count);
+//Waits for at least one item then pops up to max_count items. Returns the number of popped items which is 0 only if the channel is closed and empty.
+EXTERNAL isize channel_shared_pop_batch(Channel_Shared* shared, void* items, isize max_count);
+
+//Checks whether the other side is still running. If it has died without detaching closes the channel and returns false.
+EXTERNAL bool  channel_shared_check_peer(Channel_Shared* shared);
+
+#endif
+
+#if (defined(MODULE_IMPL_ALL) || defined(MODULE_IMPL_CHANNEL_SHARED)) && !defined(MODULE_HAS_IMPL_CHANNEL_SHARED)
+#define MODULE_HAS_IMPL_CHANNEL_SHARED
+
+    //Never waits longer than the peer check period so that a dead peer is noticed even if nobody wakes us up.
+    INTERNAL bool _channel_shared_wait(volatile void* state, uint32_t undesired, double timeout_or_negative_if_infinite)
+    {
+        double timeout = timeout_or_negative_if_infinite;
+        if(timeout < 0 || timeout > CHANNEL_SHARED_PEER_CHECK_SECONDS)
+            timeout = CHANNEL_SHARED_PEER_CHECK_SECONDS;
+        return platform_futex_wait_shared(state, undesired, timeout);
+    }
+
+    INTERNAL Channel_Info _channel_shared_info(isize item_size)
+    {
+        Channel_Info info = {item_size, _channel_shared_wait, platform_futex_wake_all_shared};
+        return info;
+    }
+
+    //Registers this process in the role. Succeeds if the role is free or its previous owner is no longer running.
+    INTERNAL bool _channel_shared_attach(Channel_Shared_Header* header, Channel_Shared_Role role)
+    {
+        int64_t self = platform_process_get_current_id();
+        for(;;)
+        {
+            int64_t curr = atomic_load(&header->process_ids[role]);
+            if(curr != 0 && platform_process_is_running(curr))
+                return false;
+            if(atomic_compare_exchange_strong(&header->process_ids[role], &curr, self))
+            {
+                //We replaced a dead process. The other side has closed or is about to close the channel 
+                // because of it (see channel_shared_check_peer). If it is still there let it continue with us.
+                Channel_Spsc* chan = (Channel_Spsc*) (void*) (header + 1);
+                if(curr != 0 && atomic_load(&header->process_ids[1 - role]) != 0)
+                    channel_spsc_reopen(chan);
+                return true;
+            }
+        }
+    }
+
+    INTERNAL void _channel_shared_set_up(Channel_Shared* shared, Channel_Shared_Role role)
+    {
+        shared->header = (Channel_Shared_Header*) shared->mapping.address;
+        shared->chan = (Channel_Spsc*) (void*) (shared->header + 1);
+        shared->info = _channel_shared_info(shared->header->item_size);
+        shared->role = role;
+        shared->last_peer_check = platform_perf_counter();
+    }
+
+    EXTERNAL Platform_Error channel_shared_create(Channel_Shared* shared, Platform_String name, isize capacity, isize item_size, Channel_Shared_Role role)
+    {
+        memset(shared, 0, sizeof *shared);
+        Channel_Info info = _channel_shared_info(item_size);
+        isize size = sizeof(Channel_Shared_Header) + channel_spsc_memory_size(capacity, info);
+
+        platform_shared_memory_remove(name, false);
+        Platform_Error error = platform_shared_memory_open(name, size, true, &shared->mapping);
+        if(error == PLATFORM_ERROR_OK)
+        {
+            Channel_Shared_Header* header = (Channel_Shared_Header*) shared->mapping.address;
+            header->magic = CHANNEL_SHARED_MAGIC;
+            header->item_size = item_size;
+            header->capacity = capacity;
+            atomic_store(&header->process_ids[role], platform_process_get_current_id());
+
+            Channel_Spsc* chan = (Channel_Spsc*) (void*) (header + 1);
+            channel_spsc_init(chan, chan + 1, capacity, info);
+
+            atomic_store(&header->ready, 1);
+            platform_futex_wake_all_shared(&header->ready);
+            _channel_shared_set_up(shared, role);
+        }
+        return error;
+    }
+
+    EXTERNAL Platform_Error channel_shared_open(Channel_Shared* shared, Platform_String name, isize item_size, Channel_Shared_Role role)
+    {
+        memset(shared, 0, sizeof *shared);
+        Platform_Error error = platform_shared_memory_open(name, 0, false, &shared->mapping);
+        if(error != PLATFORM_ERROR_OK)
+            return error;
+
+        Channel_Shared_Header* header = (Channel_Shared_Header*) shared->mapping.address;
+        bool ok = shared->mapping.size >= (int64_t) sizeof(Channel_Shared_Header);
+
+        //The creator might have not yet finished initializing the block
+        int64_t start = platform_perf_counter();
+        while(ok && atomic_load(&header->ready) == 0)
+        {
+            if(platform_perf_counter() - start > CHANNEL_SHARED_OPEN_TIMEOUT_SECONDS*platform_perf_counter_frequency())
+                ok = false;
+            else
+                platform_futex_wait_shared(&header->ready, 0, CHANNEL_SHARED_PEER_CHECK_SECONDS);
+        }
+
+        ok = ok
+            && header->magic == CHANNEL_SHARED_MAGIC
+            && header->item_size == item_size
+            && shared->mapping.size >= (int64_t) sizeof(Channel_Shared_Header) + channel_spsc_memory_size(header->capacity, _channel_shared_info(item_size))
+            && _channel_shared_attach(header, role);
+
+        if(ok == false)
+        {
+            platform_shared_memory_close(&shared->mapping);
+            memset(shared, 0, sizeof *shared);
+            return PLATFORM_ERROR_OTHER;
+        }
+
+        _channel_shared_set_up(shared, role);
+        return PLATFORM_ERROR_OK;
+    }
+
+    EXTERNAL void channel_shared_close(Channel_Shared* shared)
+    {
+        if(shared->header)
+        {
+            channel_spsc_close(shared->chan, shared->info);
+            int64_t self = platform_process_get_current_id();
+            atomic_compare_exchange_strong(&shared->header->process_ids[shared->role], &self, 0);
+            platform_shared_memory_close(&shared->mapping);
+        }
+        memset(shared, 0, sizeof *shared);
+    }
+
+    EXTERNAL Platform_Error channel_shared_remove(Platform_String name)
+    {
+        return platform_shared_memory_remove(name, false);
+    }
+
+    EXTERNAL bool channel_shared_check_peer(Channel_Shared* shared)
+    {
+        int64_t peer = atomic_load(&shared->header->process_ids[1 - shared->role]);
+        if(peer != 0 && platform_process_is_running(peer) == false)
+        {
+            channel_spsc_close(shared->chan, shared->info);
+
+            //Someone might have taken over the role between our load and the close. It reopens the channel
+            // after attaching, but if it already did so before our close we have to undo it ourselves.
+            if(atomic_load(&shared->header->process_ids[1 - shared->role]) != peer)
+            {
+                channel_spsc_reopen(shared->chan);
+                return true;
+            }
+            return false;
+        }
+        return true;
+    }
+
+    //Only checks the peer once per CHANNEL_SHARED_PEER_CHECK_SECONDS since it requires a syscall.
+    INTERNAL bool _channel_shared_check_peer_periodically(Channel_Shared* shared)
+    {
+        int64_t now = platform_perf_counter();
+        if(now - shared->last_peer_check < CHANNEL_SHARED_PEER_CHECK_SECONDS*platform_perf_counter_frequency())
+            return true;
+
+        shared->last_peer_check = now;
+        return channel_shared_check_peer(shared);
+    }
+
+    EXTERNAL isize channel_shared_push_batch(Channel_Shared* shared, const void* items, isize count)
+    {
+        Channel_Spsc* chan = shared->chan;
+        isize pushed = 0;
+        while(pushed < count)
+        {
+            isize curr = channel_spsc_try_push_batch(chan, (const uint8_t*) items + pushed*shared->info.item_size, count - pushed, shared->info);
+            if(curr == 0)
+            {
+                if(channel_spsc_is_closed(chan) || _channel_shared_check_peer_periodically(shared) == false)
+                    break;
+                _channel_spsc_wait(chan, &chan->head, chan->cached_head, &chan->push_waiting, shared->info);
+            }
+            pushed += curr;
+        }
+        return pushed;
+    }
+
+    EXTERNAL isize channel_shared_pop_batch(Channel_Shared* shared, void* items, isize max_count)
+    {
+        Channel_Spsc* chan = shared->chan;
+        if(max_count <= 0)
+            return 0;
+
+        for(;;)
+        {
+            isize popped = channel_spsc_try_pop_batch(chan, items, max_count, shared->info);
+            if(popped > 0)
+                return popped;
+
+            //Once closed drain what is left
+            if(channel_spsc_is_closed(chan) || _channel_shared_check_peer_periodically(shared) == false)
+                return channel_spsc_try_pop_batch(chan, items, max_count, shared->info);
+            _channel_spsc_wait(chan, &chan->tail, chan->cached_tail, &chan->pop_waiting, shared->info);
+        }
+    }
+
+    EXTERNAL bool channel_shared_push(Channel_Shared* shared, const void* item)
+    {
+        return channel_shared_push_batch(shared, item, 1) == 1;
+    }
+
+    EXTERNAL bool channel_shared_pop(Channel_Shared* shared, void* item)
+    {
+        return channel_shared_pop_batch(shared, item, 1) == 1;
+    }
+#endif
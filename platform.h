@@ -151,6 +151,12 @@ typedef enum Platform_Virtual_Allocation {
     PLATFORM_VIRTUAL_ALLOC_COMMIT   = 2, //Commits address space causing operating system to supply physical memory or swap file
     PLATFORM_VIRTUAL_ALLOC_DECOMMIT = 4, //Removes address space from commited freeing physical memory
     PLATFORM_VIRTUAL_ALLOC_RELEASE  = 8, //Free address space
+
+    //Modifiers which can be combined with the actions above:
+    PLATFORM_VIRTUAL_ALLOC_HUGE_PAGES = 16,          //Asks the OS to back the range with transparent huge pages when possible (MADV_HUGEPAGE). Is only a hint so never fails because of it.
+                                                     // When used with RESERVE the returned address is aligned to platform_huge_page_size().
+    PLATFORM_VIRTUAL_ALLOC_HUGE_PAGES_EXPLICIT = 32, //Backs the range with preallocated huge pages (MAP_HUGETLB). Is used with RESERVE and fails if the system does not have enough configured
+                                                     // for the whole range. Address and bytes of all subsequent calls on the range need to be multiples of platform_huge_page_size().
 } Platform_Virtual_Allocation;
 
 typedef enum Platform_Memory_Protection {
@@ -165,6 +171,21 @@ typedef enum Platform_Memory_Protection {
 Platform_Error platform_virtual_reallocate(void** output_adress_or_null, void* address, int64_t bytes, Platform_Virtual_Allocation action, Platform_Memory_Protection protection);
 int64_t platform_page_size();
 int64_t platform_allocation_granularity();
+//Returns the size of a single (default) huge page. Is 2MB on most systems.
+int64_t platform_huge_page_size();
+
+//Returns the number of NUMA nodes on this system. Is 1 on non-NUMA machines.
+int32_t platform_numa_node_count();
+//Sets the NUMA memory policy of the given range so that all its memory is supplied from numa_node (mbind with MPOL_BIND).
+//Should be called on reserved but not yet commited range. Already commited pages get migrated.
+//address needs to be page aligned.
+Platform_Error platform_virtual_bind_numa_node(void* address, int64_t bytes, int32_t numa_node);
+
+//Allocates (address == NULL), resizes or frees (new_bytes == 0) a commited read-write region. 
+//old_bytes needs to be the size the region was last allocated or resized to. Both sizes are rounded up to page size.
+//Resizing keeps the contents but can move the region. Where possible this is done by remapping the pages (mremap) 
+// instead of copying so it takes time proportional to the number of pages not bytes. The result is always page aligned.
+Platform_Error platform_virtual_resize(void** output_adress_or_null, void* address, int64_t old_bytes, int64_t new_bytes);
 
 void* platform_heap_reallocate(int64_t new_size, void* old_ptr, int64_t align);
 //Returns the size in bytes of an allocated block. 
@@ -246,6 +267,15 @@ bool            platform_futex_wait(volatile void* futex, uint32_t value, double
 void            platform_futex_wake(volatile void* futex);
 void            platform_futex_wake_all(volatile void* futex);
 
+//Same as the functions above except the futex can reside in memory shared between processes (see platform_shared_memory_open).
+//Slower than the process private versions so only use them for shared memory.
+bool            platform_futex_wait_shared(volatile void* futex, uint32_t value, double seconds_or_negative_if_infinite);
+void            platform_futex_wake_shared(volatile void* futex);
+void            platform_futex_wake_all_shared(volatile void* futex);
+
+int64_t         platform_process_get_current_id();
+bool            platform_process_is_running(int64_t process_id); //Returns false if no process with the given id exists or it has terminated but was not yet waited on by its parent
+
 //Allows a resource to be initialized exactly once even in the case of raacing threads.
 //The first thread that reaches this point attomically sets state to initializing value and return true.
 //  This thread must eventually call platform_once_end() once its done initializing said resource.
@@ -458,6 +488,19 @@ Platform_Error platform_file_memory_map(Platform_String file_path, int64_t desir
 //Unmpas the previously mapped file. If mapping is a result of failed platform_file_memory_map does nothing.
 void platform_file_memory_unmap(Platform_Memory_Mapping* mapping);
 
+//Creates or opens a named block of memory which can be mapped by multiple processes at once and maps it.
+//The name must be a single path component (no slashes). 
+//If create is true creates a new block of size_or_zero bytes filled with zeros. Fails if the block already exists.
+//If create is false opens an existing block mapping all of it. size_or_zero is ignored. 
+//If the block was just created by other process and does not yet have its size waits up to about a second for it.
+//The block stays alive until it is removed using platform_shared_memory_remove and unmapped by all processes. 
+//(On windows there is no removal, the block lives until all processes unmap it).
+Platform_Error platform_shared_memory_open(Platform_String name, int64_t size_or_zero, bool create, Platform_Memory_Mapping* mapping);
+//Unmaps the previously mapped shared memory. If mapping is a result of failed platform_shared_memory_open does nothing.
+void platform_shared_memory_close(Platform_Memory_Mapping* mapping);
+//Removes the name of the shared memory block so that it can no longer be opened. Processes that have it mapped are not affected. 
+Platform_Error platform_shared_memory_remove(Platform_String name, bool fail_if_not_found);
+
 //=========================================
 // File Watch
 //=========================================
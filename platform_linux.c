@@ -131,11 +131,47 @@ Platform_Error platform_virtual_reallocate(void** output_adress_or_null, void* a
 
     if(action & PLATFORM_VIRTUAL_ALLOC_RESERVE)   
     {
-        out = mmap(allocate_at, (size_t) bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-        if(out == MAP_FAILED)
+        if(action & PLATFORM_VIRTUAL_ALLOC_HUGE_PAGES_EXPLICIT)
         {
-            error = (Platform_Error) errno;
-            out = NULL;
+            //hugetlb mappings are always aligned to the huge page size. 
+            // The whole range is reserved from the huge page pool so that commits cannot fail later.
+            out = mmap(allocate_at, (size_t) bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if(out == MAP_FAILED)
+            {
+                error = (Platform_Error) errno;
+                out = NULL;
+            }
+        }
+        else if((action & PLATFORM_VIRTUAL_ALLOC_HUGE_PAGES) && allocate_at == NULL)
+        {
+            //Transparent huge pages are only used for huge page aligned parts of the mapping.
+            // Thus we over-reserve by one huge page and trim the unaligned head and tail.
+            size_t huge = (size_t) platform_huge_page_size();
+            uint8_t* reserved = (uint8_t*) mmap(NULL, (size_t) bytes + huge, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(reserved == MAP_FAILED)
+                error = (Platform_Error) errno;
+            else
+            {
+                uint8_t* aligned = (uint8_t*) (((size_t) reserved + huge - 1) / huge * huge);
+                size_t head = (size_t) (aligned - reserved);
+                size_t tail = huge - head;
+                if(head > 0)
+                    munmap(reserved, head);
+                if(tail > 0)
+                    munmap(aligned + bytes, tail);
+                    
+                madvise(aligned, (size_t) bytes, MADV_HUGEPAGE);
+                out = aligned;
+            }
+        }
+        else
+        {
+            out = mmap(allocate_at, (size_t) bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(out == MAP_FAILED)
+            {
+                error = (Platform_Error) errno;
+                out = NULL;
+            }
         }
     }
     if(action & PLATFORM_VIRTUAL_ALLOC_RELEASE)
@@ -159,6 +195,8 @@ Platform_Error platform_virtual_reallocate(void** output_adress_or_null, void* a
             assert((size_t) allocate_at % platform_page_size() == 0);
             if(mprotect(allocate_at, (size_t) bytes, prot) == 0)
             {
+                if(action & PLATFORM_VIRTUAL_ALLOC_HUGE_PAGES)
+                    madvise(allocate_at, (size_t) bytes, MADV_HUGEPAGE);
                 madvise(allocate_at, (size_t) bytes, MADV_WILLNEED);
                 out = allocate_at;
             }
@@ -183,6 +221,49 @@ Platform_Error platform_virtual_reallocate(void** output_adress_or_null, void* a
     return error;
 }
 
+Platform_Error platform_virtual_resize(void** output_adress_or_null, void* address, int64_t old_bytes, int64_t new_bytes)
+{
+    Platform_Error error = PLATFORM_ERROR_OK;
+    void* out = NULL;
+    size_t page = (size_t) getpagesize();
+    size_t old_rounded = ((size_t) old_bytes + page - 1) / page * page;
+    size_t new_rounded = ((size_t) new_bytes + page - 1) / page * page;
+
+    if(address == NULL)
+    {
+        if(new_rounded > 0)
+        {
+            out = mmap(NULL, new_rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(out == MAP_FAILED)
+            {
+                error = (Platform_Error) errno;
+                out = NULL;
+            }
+        }
+    }
+    else if(new_rounded == 0)
+    {
+        if(munmap(address, old_rounded) == -1)
+            error = (Platform_Error) errno;
+    }
+    else if(new_rounded == old_rounded)
+        out = address;
+    else
+    {
+        out = mremap(address, old_rounded, new_rounded, MREMAP_MAYMOVE);
+        if(out == MAP_FAILED)
+        {
+            error = (Platform_Error) errno;
+            out = NULL;
+        }
+    }
+
+    if(output_adress_or_null)
+        *output_adress_or_null = out;
+
+    return error;
+}
+
 #include <unistd.h>
 int64_t platform_page_size()
 {
@@ -195,6 +276,81 @@ int64_t platform_allocation_granularity()
     return (int64_t) getpagesize();
 }
 
+int64_t platform_huge_page_size()
+{
+    static int64_t huge_page_size = -1;
+    if(huge_page_size == -1)
+    {
+        //Format is "Hugepagesize:       2048 kB"
+        int64_t size = 0;
+        FILE* meminfo = fopen("/proc/meminfo", "r");
+        if(meminfo)
+        {
+            char line[256];
+            while(fgets(line, sizeof line, meminfo))
+            {
+                long long kb = 0;
+                if(sscanf(line, "Hugepagesize: %lld kB", &kb) == 1)
+                {
+                    size = (int64_t) kb * 1024;
+                    break;
+                }
+            }
+            fclose(meminfo);
+        }
+
+        huge_page_size = size > 0 ? size : 2*1024*1024;
+    }
+    return huge_page_size;
+}
+
+int32_t platform_numa_node_count()
+{
+    static int32_t node_count = -1;
+    if(node_count == -1)
+    {
+        //Format is "0" or "0-3"
+        int from = 0;
+        int to = 0;
+        int32_t count = 1;
+        FILE* possible = fopen("/sys/devices/system/node/possible", "r");
+        if(possible)
+        {
+            int read = fscanf(possible, "%d-%d", &from, &to);
+            if(read == 2 && to >= from)
+                count = (int32_t) (to + 1);
+            else if(read == 1)
+                count = (int32_t) (from + 1);
+            fclose(possible);
+        }
+        node_count = count;
+    }
+    return node_count;
+}
+
+#include <sys/syscall.h>
+Platform_Error platform_virtual_bind_numa_node(void* address, int64_t bytes, int32_t numa_node)
+{
+    //We call mbind directly so that we dont need to link against libnuma.
+    // Values are from <numaif.h>
+    enum {
+        _MPOL_BIND = 2,
+        _MPOL_MF_MOVE = 1 << 1,
+        _MAX_NODES = 1024,
+        _LONG_BITS = sizeof(unsigned long)*CHAR_BIT,
+    };
+
+    if(numa_node < 0 || numa_node >= _MAX_NODES)
+        return (Platform_Error) EINVAL;
+
+    unsigned long mask[_MAX_NODES/_LONG_BITS] = {0};
+    mask[numa_node/_LONG_BITS] = 1ul << (numa_node%_LONG_BITS);
+
+    //maxnode is one more than the number of bits in mask. This is a long standing quirk of the syscall.
+    long state = syscall(SYS_mbind, address, (unsigned long) bytes, _MPOL_BIND, mask, (unsigned long) _MAX_NODES + 1, _MPOL_MF_MOVE);
+    return _platform_error_code(state == 0);
+}
+
 //=========================================
 // Threading
 //=========================================
@@ -318,9 +474,45 @@ int64_t platform_thread_get_exit_code(Platform_Thread finished_thread)
     return INT64_MIN;
 }
 
+//pthread_cleanup_push is scoped to a block so we cannot use it. 
+// Instead we keep a per thread list of cleanups in a pthread key whose destructor runs them on thread exit. 
+typedef struct Platform_Thread_Cleanup {
+    struct Platform_Thread_Cleanup* next;
+    void (*func)(void* context);
+    void* context;
+} Platform_Thread_Cleanup;
+
+static pthread_key_t _platform_thread_cleanup_key;
+static pthread_once_t _platform_thread_cleanup_once = PTHREAD_ONCE_INIT;
+
+static void _platform_thread_run_cleanups(void* list)
+{
+    //Last attached is called first
+    for(Platform_Thread_Cleanup* cleanup = (Platform_Thread_Cleanup*) list; cleanup; )
+    {
+        Platform_Thread_Cleanup* next = cleanup->next;
+        cleanup->func(cleanup->context);
+        free(cleanup);
+        cleanup = next;
+    }
+}
+
+static void _platform_thread_cleanup_key_init()
+{
+    int err = pthread_key_create(&_platform_thread_cleanup_key, _platform_thread_run_cleanups);
+    assert(err == 0); (void) err;
+}
+
 void platform_thread_attach_deinit(void (*func)(void* context), void* context)
 {
-    // pthread_cleanup_push(func, context); //wtf
+    pthread_once(&_platform_thread_cleanup_once, _platform_thread_cleanup_key_init);
+
+    Platform_Thread_Cleanup* cleanup = (Platform_Thread_Cleanup*) malloc(sizeof(Platform_Thread_Cleanup));
+    assert(cleanup);
+    cleanup->func = func;
+    cleanup->context = context;
+    cleanup->next = (Platform_Thread_Cleanup*) pthread_getspecific(_platform_thread_cleanup_key);
+    pthread_setspecific(_platform_thread_cleanup_key, cleanup);
 }
 
 void platform_thread_exit(int code)
@@ -427,21 +619,26 @@ void platform_mutex_unlock(Platform_Mutex* mutex)
         pthread_mutex_unlock(mutex_state);
 }
 
+bool platform_mutex_try_lock(Platform_Mutex* mutex)
+{
+    pthread_mutex_t* mutex_state = (pthread_mutex_t*) mutex->handle;
+    if(mutex_state)
+        return pthread_mutex_trylock(mutex_state) == 0;
+    return false;
+}
+
 
 #include <linux/futex.h> 
 #include <sys/syscall.h> 
 #include <unistd.h>
 #include <sched.h>
 #include <errno.h>
-void platform_futex_wake_all(volatile void* state) {
-    syscall(SYS_futex, (void*) state, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, INT32_MAX, NULL, NULL, 0);
+//Shared futexes omit FUTEX_PRIVATE_FLAG so that they work across processes at the cost of slightly slower lookup
+static void _platform_futex_wake(volatile void* state, int count, int private_flag) {
+    syscall(SYS_futex, (void*) state, FUTEX_WAKE | private_flag, count, NULL, NULL, 0);
 }
 
-void platform_futex_wake(volatile void* state) {
-    syscall(SYS_futex, (void*) state, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, NULL, NULL, 0);
-}
-
-bool platform_futex_wait(volatile void* state, uint32_t undesired, double seconds_or_negatove_if_infinite)
+static bool _platform_futex_wait(volatile void* state, uint32_t undesired, double seconds_or_negatove_if_infinite, int private_flag)
 {
     struct timespec tm = {0};
     struct timespec* tm_ptr = NULL;
@@ -452,12 +649,71 @@ bool platform_futex_wait(volatile void* state, uint32_t undesired, double second
         tm.tv_nsec = nanosecs % 1000000000LL; 
         tm_ptr = &tm;
     }
-    long ret = syscall(SYS_futex, (void*) state, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, undesired, tm_ptr, NULL, 0);
+    long ret = syscall(SYS_futex, (void*) state, FUTEX_WAIT | private_flag, undesired, tm_ptr, NULL, 0);
     if (ret == -1 && errno == ETIMEDOUT) 
         return false;
     return true;
 }
 
+void platform_futex_wake_all(volatile void* state) {
+    _platform_futex_wake(state, INT32_MAX, FUTEX_PRIVATE_FLAG);
+}
+
+void platform_futex_wake(volatile void* state) {
+    _platform_futex_wake(state, 1, FUTEX_PRIVATE_FLAG);
+}
+
+bool platform_futex_wait(volatile void* state, uint32_t undesired, double seconds_or_negatove_if_infinite) {
+    return _platform_futex_wait(state, undesired, seconds_or_negatove_if_infinite, FUTEX_PRIVATE_FLAG);
+}
+
+void platform_futex_wake_all_shared(volatile void* state) {
+    _platform_futex_wake(state, INT32_MAX, 0);
+}
+
+void platform_futex_wake_shared(volatile void* state) {
+    _platform_futex_wake(state, 1, 0);
+}
+
+bool platform_futex_wait_shared(volatile void* state, uint32_t undesired, double seconds_or_negatove_if_infinite) {
+    return _platform_futex_wait(state, undesired, seconds_or_negatove_if_infinite, 0);
+}
+
+#include <signal.h>
+int64_t platform_process_get_current_id()
+{
+    return (int64_t) getpid();
+}
+
+bool platform_process_is_running(int64_t process_id)
+{
+    //Signal 0 only checks whether the process exists. EPERM means it exists but belongs to someone else.
+    if(kill((pid_t) process_id, 0) != 0 && errno != EPERM)
+        return false;
+
+    //Terminated processes that were not yet reaped by their parent (zombies) still exist,
+    // so look at the state field of /proc/<pid>/stat. It follows the last ')' as the
+    // preceding executable name can itself contain parentheses and spaces.
+    char path[64] = {0};
+    char stat[512] = {0};
+    snprintf(path, sizeof path, "/proc/%lli/stat", (long long) process_id);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return errno != ENOENT;
+
+    ssize_t read_bytes = read(fd, stat, sizeof stat - 1);
+    close(fd);
+    if(read_bytes <= 0)
+        return true;
+
+    char* name_end = strrchr(stat, ')');
+    if(name_end == NULL || name_end[1] != ' ')
+        return true;
+
+    char state = name_end[2];
+    return state != 'Z' && state != 'X';
+}
+
 //=========================================
 // Timings 
 //=========================================
@@ -1142,6 +1398,85 @@ Platform_Error platform_file_memory_map(Platform_String file_path, int64_t desir
 //Unmpas the previously mapped file. If mapping is a result of failed platform_file_memory_map does nothing.
 void platform_file_memory_unmap(Platform_Memory_Mapping* mapping);
 
+Platform_Error platform_shared_memory_open(Platform_String name, int64_t size_or_zero, bool create, Platform_Memory_Mapping* mapping)
+{
+    memset(mapping, 0, sizeof *mapping);
+
+    //shm_open requires the name to be of the form "/name"
+    char path[NAME_MAX + 2] = "/";
+    if(name.count <= 0 || name.count > NAME_MAX || memchr(name.data, '/', (size_t) name.count) != NULL)
+        return (Platform_Error) EINVAL;
+    memcpy(path + 1, name.data, (size_t) name.count);
+
+    int fd = shm_open(path, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+    bool state = fd != -1;
+    int64_t size = size_or_zero;
+    if(state && create)
+        state = ftruncate(fd, (off_t) size) == 0;
+    if(state && create == false)
+    {
+        //The creator sets the size only after shm_open so we might see the block while its still empty.
+        // Give it a moment instead of failing to map zero bytes.
+        for(int i = 0; ; i++)
+        {
+            struct stat buf = {0};
+            state = fstat(fd, &buf) == 0;
+            size = (int64_t) buf.st_size;
+            if(state == false || size > 0)
+                break;
+
+            if(i >= 1000)
+            {
+                errno = ETIMEDOUT;
+                state = false;
+                break;
+            }
+            platform_thread_sleep(0.001);
+        }
+    }
+
+    void* address = MAP_FAILED;
+    if(state)
+    {
+        address = mmap(NULL, (size_t) size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        state = address != MAP_FAILED;
+    }
+
+    //The mapping keeps the memory alive so the descriptor is no longer needed
+    Platform_Error error = _platform_error_code(state);
+    if(fd != -1)
+        close(fd);
+    if(state)
+    {
+        mapping->address = address;
+        mapping->size = size;
+    }
+    else if(create && fd != -1)
+        shm_unlink(path);
+
+    return error;
+}
+
+void platform_shared_memory_close(Platform_Memory_Mapping* mapping)
+{
+    if(mapping->address != NULL)
+        munmap(mapping->address, (size_t) mapping->size);
+    memset(mapping, 0, sizeof *mapping);
+}
+
+Platform_Error platform_shared_memory_remove(Platform_String name, bool fail_if_not_found)
+{
+    char path[NAME_MAX + 2] = "/";
+    if(name.count <= 0 || name.count > NAME_MAX)
+        return (Platform_Error) EINVAL;
+    memcpy(path + 1, name.data, (size_t) name.count);
+
+    bool state = shm_unlink(path) == 0;
+    if(!state && fail_if_not_found == false && errno == ENOENT)
+        state = true;
+    return _platform_error_code(state);
+}
+
 int64_t platform_translate_error(Platform_Error error, char* translated, int64_t translated_size)
 {
     const char* str = NULL;
@@ -1235,6 +1570,8 @@ int64_t platform_capture_call_stack(void** stack, int64_t stack_size, int64_t sk
     int64_t not_skipped_size = found_size - skip_count;
     if(not_skipped_size < 0)
         not_skipped_size = 0;
+    if(not_skipped_size > stack_size)
+        not_skipped_size = stack_size;
 
     memcpy(stack, stack_ptrs + skip_count, (size_t) not_skipped_size*sizeof(void*));
     return not_skipped_size;
@@ -1516,7 +1853,9 @@ Platform_Exception platform_exception_sandbox(
         Signal_Handler_State* handler = &platform_signal_handler_queue[platform_signal_handler_i1 - 1];
         memset(handler, 0, sizeof *handler);
 
-        switch(sigsetjmp(handler->jump_buffer, 0))
+        //Saves the signal mask so that it gets restored after jumping out of the signal handler.
+        // Otherwise the caught signal would stay blocked and the next one would kill the process.
+        switch(sigsetjmp(handler->jump_buffer, 1))
         {
             case 0: {
                 sandboxed_func(sandbox_context);
@@ -1544,7 +1883,8 @@ Platform_Exception platform_exception_sandbox(
                 sanbox_error.execution_context = NULL;
                 sanbox_error.execution_context_size = 0;
 
-                error_func(error_context, sanbox_error);
+                if(error_func)
+                    error_func(error_context, sanbox_error);
                 break;
             }
             default: {
@@ -83,6 +83,13 @@ Platform_Error platform_virtual_reallocate(void** output_adress_or_null, void* a
 {
     void* out_addr = NULL;
     Platform_Error out = PLATFORM_ERROR_OK;
+
+    //Large pages on windows need to be commited at reservation time (MEM_LARGE_PAGES) and 
+    // require SeLockMemoryPrivilege. That does not fit the reserve/commit model so we dont support them.
+    // Transparent huge pages have no equivalent and since its only a hint we ignore it.
+    if(action & PLATFORM_VIRTUAL_ALLOC_HUGE_PAGES_EXPLICIT)
+        return (Platform_Error) ERROR_NOT_SUPPORTED;
+    action = (Platform_Virtual_Allocation) (action & ~PLATFORM_VIRTUAL_ALLOC_HUGE_PAGES);
     
     if(action == PLATFORM_VIRTUAL_ALLOC_RELEASE)
         out = _platform_error_code(!!VirtualFree(address, 0, MEM_RELEASE));  
@@ -125,6 +132,37 @@ Platform_Error platform_virtual_reallocate(void** output_adress_or_null, void* a
     return out;
 }
 
+Platform_Error platform_virtual_resize(void** output_adress_or_null, void* address, int64_t old_bytes, int64_t new_bytes)
+{
+    //Windows has no equivalent of mremap so we allocate a new region and copy.
+    void* out_addr = NULL;
+    Platform_Error out = PLATFORM_ERROR_OK;
+    int64_t page = platform_page_size();
+    int64_t old_rounded = (old_bytes + page - 1) / page * page;
+    int64_t new_rounded = (new_bytes + page - 1) / page * page;
+
+    if(address != NULL && new_rounded == old_rounded)
+        out_addr = address;
+    else
+    {
+        if(new_rounded > 0)
+        {
+            out_addr = VirtualAlloc(NULL, (SIZE_T) new_rounded, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+            out = _platform_error_code(out_addr != NULL);
+            if(out_addr && address)
+                memcpy(out_addr, address, (size_t) (old_rounded < new_rounded ? old_rounded : new_rounded));
+        }
+
+        if(address && out == PLATFORM_ERROR_OK)
+            out = _platform_error_code(!!VirtualFree(address, 0, MEM_RELEASE));  
+    }
+
+    if(output_adress_or_null)
+        *output_adress_or_null = out_addr;
+
+    return out;
+}
+
 void* platform_heap_reallocate(int64_t new_size, void* old_ptr, int64_t align)
 {
     assert(align > 0 && new_size >= 0);
@@ -163,6 +201,33 @@ int64_t platform_allocation_granularity()
     return page_size;
 }
 
+int64_t platform_huge_page_size()
+{
+    static int64_t huge_page_size = -1;
+    if(huge_page_size == -1)
+    {
+        huge_page_size = (int64_t) GetLargePageMinimum();
+        if(huge_page_size <= 0)
+            huge_page_size = 2*1024*1024;
+    }
+    return huge_page_size;
+}
+
+int32_t platform_numa_node_count()
+{
+    ULONG highest = 0;
+    if(GetNumaHighestNodeNumber(&highest) == false)
+        return 1;
+    return (int32_t) highest + 1;
+}
+
+Platform_Error platform_virtual_bind_numa_node(void* address, int64_t bytes, int32_t numa_node)
+{
+    //Windows only lets us choose the preferred node at reservation time (VirtualAllocExNuma)
+    (void) address; (void) bytes; (void) numa_node;
+    return (Platform_Error) ERROR_NOT_SUPPORTED;
+}
+
 int64_t platform_heap_get_block_size(const void* old_ptr, int64_t align)
 {
     int64_t size = 0;
@@ -462,6 +527,47 @@ void platform_futex_wake_all(volatile void* futex)
     WakeByAddressAll((void*) futex);
 }
 
+//WaitOnAddress only works within a single process so for shared memory we have to poll.
+bool platform_futex_wait_shared(volatile void* futex, uint32_t value, double seconds_or_negative_if_infinite)
+{
+    int64_t start = platform_perf_counter();
+    for(int64_t i = 0;; i++)
+    {
+        if(*(volatile uint32_t*) futex != value)
+            return true;
+        if(seconds_or_negative_if_infinite >= 0 && (double) (platform_perf_counter() - start) >= seconds_or_negative_if_infinite*(double) platform_perf_counter_frequency())
+            return false;
+        if(i < 16)
+            SwitchToThread();
+        else
+            Sleep(1);
+    }
+}
+void platform_futex_wake_shared(volatile void* futex)
+{
+    (void) futex;
+}
+void platform_futex_wake_all_shared(volatile void* futex)
+{
+    (void) futex;
+}
+
+int64_t platform_process_get_current_id()
+{
+    return (int64_t) GetCurrentProcessId();
+}
+
+bool platform_process_is_running(int64_t process_id)
+{
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD) process_id);
+    if(process == NULL)
+        return GetLastError() == ERROR_ACCESS_DENIED;
+
+    bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return running;
+}
+
 //=========================================
 // Timings
 //=========================================
@@ -1578,6 +1684,74 @@ Platform_Error platform_file_memory_map(Platform_String file_path, int64_t desir
     }
 }
 
+static wchar_t* _shared_memory_name(WString_Buffer* buffer, Platform_String name)
+{
+    char local[MAX_PATH] = {0};
+    snprintf(local, sizeof local, "Local\\%.*s", (int) name.count, name.data);
+    return _utf8_to_utf16(buffer, local, (int64_t) strlen(local));
+}
+
+Platform_Error platform_shared_memory_open(Platform_String name, int64_t size_or_zero, bool create, Platform_Memory_Mapping* mapping)
+{
+    memset(mapping, 0, sizeof *mapping);
+    if(name.count <= 0 || name.count > MAX_PATH - 16 || memchr(name.data, '/', (size_t) name.count) != NULL || memchr(name.data, '\\', (size_t) name.count) != NULL)
+        return ERROR_INVALID_NAME;
+
+    WString_Buffer buffer = {0}; buffer_init_backed(&buffer, _LOCAL_BUFFER_SIZE);
+    const wchar_t* wname = _shared_memory_name(&buffer, name);
+    HANDLE hMap = NULL;
+    if(create)
+    {
+        LARGE_INTEGER size = {0};
+        size.QuadPart = size_or_zero;
+        hMap = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, size.HighPart, size.LowPart, wname);
+        if(hMap != NULL && GetLastError() == ERROR_ALREADY_EXISTS)
+        {
+            CloseHandle(hMap);
+            hMap = NULL;
+            SetLastError(ERROR_ALREADY_EXISTS);
+        }
+    }
+    else
+        hMap = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, wname);
+    buffer_deinit(&buffer);
+
+    LPVOID address = NULL;
+    if(hMap != NULL)
+        address = MapViewOfFile(hMap, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    
+    MEMORY_BASIC_INFORMATION info = {0};
+    if(address == NULL || VirtualQuery(address, &info, sizeof info) == 0)
+    {
+        Platform_Error error = _platform_error_code(false);
+        if(address != NULL)
+            UnmapViewOfFile(address);
+        if(hMap != NULL)
+            CloseHandle(hMap);
+        return error;
+    }
+
+    mapping->address = address;
+    mapping->size = create ? size_or_zero : (int64_t) info.RegionSize;
+    mapping->state[1] = (uint64_t) hMap;
+    return PLATFORM_ERROR_OK;
+}
+
+void platform_shared_memory_close(Platform_Memory_Mapping* mapping)
+{
+    if(mapping->address != NULL)
+        UnmapViewOfFile(mapping->address);
+    if(mapping->state[1] != 0)
+        CloseHandle((HANDLE) mapping->state[1]);
+    memset(mapping, 0, sizeof *mapping);
+}
+
+Platform_Error platform_shared_memory_remove(Platform_String name, bool fail_if_not_found)
+{
+    //Named mappings are destroyed once the last handle to them is closed so there is nothing to remove. 
+    (void) name; (void) fail_if_not_found;
+    return PLATFORM_ERROR_OK;
+}
 
 //=========================================
 // File watch
@@ -4,6 +4,7 @@
 #define PROFILE_START(...) 
 #define PROFILE_STOP(...) 
 #define PROFILE_INSTANT(...)
+#define PROFILE_COUNTER(...)
 #define PROFILE_SCOPE(...) for(int __i = 0; __i == 0; __i = 1)
 
 #ifndef MODULE_PROFILE
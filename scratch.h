@@ -31,6 +31,11 @@
     #define SCRATCH_ARENA_DEF_COMMIT_SIZE  ( 4*MB) 
 #endif
 
+//Flags for scratch_arena_init_custom. Have the same meaning as the ARENA_XXX flags in arena.h
+#define SCRATCH_ARENA_HUGE_PAGES           1 //Backs the arena with transparent huge pages where possible. Commit granularity is rounded to platform_huge_page_size(). 
+#define SCRATCH_ARENA_HUGE_PAGES_EXPLICIT  2 //Backs the arena with preallocated huge pages. Init fails if the system does not have enough for the whole reserve size.
+#define SCRATCH_ARENA_NUMA_BIND            4 //Binds all memory of the arena to the given NUMA node. Init fails if binding is not supported.
+
 typedef struct Scratch_Stack {
     union {
         u8* reserved_from;
@@ -42,6 +47,8 @@ typedef struct Scratch_Stack {
 } Scratch_Stack;
 
 typedef struct Scratch_Arena {
+    //Can only be used to query stats of the whole arena (allocator_get_stats). Allocations are done through Scratch frames.
+    Allocator alloc[1];
     Scratch_Stack stacks[SCRATCH_ARENA_CHANNELS];
     u32 frame_count;
     u32 frame_capacity;
@@ -49,6 +56,9 @@ typedef struct Scratch_Arena {
     u8* reserved_from;
     isize reserved_size;
     isize commit_granularity;
+    u32 flags;
+    i32 numa_node;
+    isize pool_generation; //config generation of the thread scratch arena pool this arena was made by. Zero if not made by the pool.
 
     //purely informative
     const char* name;
@@ -69,6 +79,7 @@ typedef struct Scratch {
 } Scratch;
 
 EXTERNAL Platform_Error scratch_arena_init(Scratch_Arena* arena, const char* name, isize reserve_size_or_zero, isize commit_granularity_or_zero, isize stack_max_depth_or_zero);
+EXTERNAL Platform_Error scratch_arena_init_custom(Scratch_Arena* arena, const char* name, isize reserve_size_or_zero, isize commit_granularity_or_zero, isize stack_max_depth_or_zero, u32 flags, i32 numa_node_or_zero);
 EXTERNAL void scratch_arena_test_invariants(Scratch_Arena* arena);
 EXTERNAL void scratch_arena_deinit(Scratch_Arena* arena);
 
@@ -81,10 +92,30 @@ EXTERNAL void* scratch_push_nonzero_generic(Scratch* scratch, isize size, isize
 
 EXTERNAL void* scratch_allocator_func(Allocator* self, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error);
 EXTERNAL Allocator_Stats scratch_allocator_get_stats(Allocator* self);
+EXTERNAL Allocator_Stats scratch_arena_get_stats(Allocator* self);
 
+//Returns the calling thread's scratch arena. If the arena was not initialized explicitly it is lazily 
+// taken from the thread scratch arena pool and returned to it when the thread exits. 
 EXTERNAL Scratch_Arena* global_scratch_arena();
 EXTERNAL Scratch        global_scratch_acquire();
 
+//The pool recycles thread scratch arenas (including their already commited memory) across short lived threads.
+#define SCRATCH_ARENA_POOL_CAPACITY 64
+
+typedef struct Scratch_Arena_Pool_Stats {
+    isize pooled_count;    //arenas waiting for reuse
+    isize created_count;   //arenas created because none were pooled
+    isize reused_count;    //arenas handed out from the pool
+    isize discarded_count; //arenas deinited on thread exit because the pool was full or they were made with outdated config
+} Scratch_Arena_Pool_Stats;
+
+//Sets the parameters of arenas created by the pool (see scratch_arena_init_custom) and the max number of arenas kept for reuse.
+//Pooled arenas are deinited. Arenas currently used by threads are deinited once their thread exits.
+EXTERNAL void scratch_arena_pool_configure(isize reserve_size_or_zero, isize commit_granularity_or_zero, isize stack_max_depth_or_zero, u32 flags, isize max_pooled_or_zero);
+//Deinits all pooled arenas returning their memory to the OS.
+EXTERNAL void scratch_arena_pool_trim();
+EXTERNAL Scratch_Arena_Pool_Stats scratch_arena_pool_get_stats();
+
 #define SCRATCH_SCOPE(scratch) SCRATCH_SCOPE_FROM(scratch, global_scratch_arena())
 #define SCRATCH_SCOPE_FROM(scratch, arena_ptr) \
     for(Scratch scratch = scratch_acquire(arena_ptr); scratch._ == 0; scratch_release(&scratch), scratch._ = 1)
@@ -239,17 +270,26 @@ EXTERNAL Scratch        global_scratch_acquire();
 #define MODULE_HAS_IMPL_SCRATCH_ARENA
 
     INTERNAL void _scratch_arena_check_invariants(Scratch_Arena* arena);
+    INTERNAL void* _scratch_arena_unsupported_func(Allocator* self, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error);
     INTERNAL void _scratch_arena_fill_garbage(Scratch_Arena* arena, isize content_size);
 
     EXTERNAL void scratch_arena_deinit(Scratch_Arena* arena)
     {
         _scratch_arena_check_invariants(arena);
         if(arena->reserved_from)
+        {
+            allocator_registry_remove(arena->alloc);
             platform_virtual_reallocate(NULL, arena->reserved_from, arena->reserved_size, PLATFORM_VIRTUAL_ALLOC_RELEASE, PLATFORM_MEMORY_PROT_NO_ACCESS);
+        }
         memset(arena, 0, sizeof *arena);
     }
 
     EXTERNAL Platform_Error scratch_arena_init(Scratch_Arena* arena, const char* name, isize reserve_size_or_zero, isize commit_granularity_or_zero, isize level_count_or_zero)
+    {
+        return scratch_arena_init_custom(arena, name, reserve_size_or_zero, commit_granularity_or_zero, level_count_or_zero, 0, 0);
+    }
+
+    EXTERNAL Platform_Error scratch_arena_init_custom(Scratch_Arena* arena, const char* name, isize reserve_size_or_zero, isize commit_granularity_or_zero, isize level_count_or_zero, u32 flags, i32 numa_node_or_zero)
     {
         scratch_arena_deinit(arena);
         isize alloc_granularity = platform_allocation_granularity();
@@ -258,7 +298,17 @@ EXTERNAL Scratch        global_scratch_acquire();
         REQUIRE(reserve_size_or_zero >= 0);
         REQUIRE(commit_granularity_or_zero >= 0);
         REQUIRE(level_count_or_zero >= 0);
+        REQUIRE(numa_node_or_zero >= 0);
         REQUIRE(alloc_granularity >= 1);
+
+        //Each stack has to start and commit at huge page boundary
+        Platform_Virtual_Allocation page_flags = (Platform_Virtual_Allocation) 0;
+        if(flags & SCRATCH_ARENA_HUGE_PAGES)
+            page_flags = (Platform_Virtual_Allocation) (page_flags | PLATFORM_VIRTUAL_ALLOC_HUGE_PAGES);
+        if(flags & SCRATCH_ARENA_HUGE_PAGES_EXPLICIT)
+            page_flags = (Platform_Virtual_Allocation) (page_flags | PLATFORM_VIRTUAL_ALLOC_HUGE_PAGES_EXPLICIT);
+        if(page_flags)
+            alloc_granularity = MAX(alloc_granularity, platform_huge_page_size());
     
         isize commit_granularity = commit_granularity_or_zero > 0 ? commit_granularity_or_zero : SCRATCH_ARENA_DEF_COMMIT_SIZE;
         isize reserve_size = reserve_size_or_zero > 0 ? reserve_size_or_zero : SCRATCH_ARENA_DEF_RESERVE_SIZE;
@@ -273,7 +323,9 @@ EXTERNAL Scratch        global_scratch_acquire();
 
         //reserve eveyrthing
         u8* reserved_from = 0;
-        Platform_Error error = platform_virtual_reallocate((void**) &reserved_from, NULL, reserve_size, PLATFORM_VIRTUAL_ALLOC_RESERVE, PLATFORM_MEMORY_PROT_NO_ACCESS);
+        Platform_Error error = platform_virtual_reallocate((void**) &reserved_from, NULL, reserve_size, (Platform_Virtual_Allocation) (PLATFORM_VIRTUAL_ALLOC_RESERVE | page_flags), PLATFORM_MEMORY_PROT_NO_ACCESS);
+        if(error == 0 && (flags & SCRATCH_ARENA_NUMA_BIND))
+            error = platform_virtual_bind_numa_node(reserved_from, reserve_size, numa_node_or_zero);
             
         //commit levels
         u8* datas[SCRATCH_ARENA_CHANNELS] = {NULL};
@@ -302,7 +354,13 @@ EXTERNAL Scratch        global_scratch_acquire();
         
             arena->commit_granularity = commit_granularity;
             arena->frame_capacity = (u32) level_count;
+            arena->reserved_from = reserved_from;
             arena->reserved_size = reserve_size;
+            arena->flags = flags;
+            arena->numa_node = numa_node_or_zero;
+            arena->alloc[0].func = _scratch_arena_unsupported_func;
+            arena->alloc[0].get_stats = scratch_arena_get_stats;
+            allocator_registry_track(arena->alloc);
             arena->name = name;
             arena->frame_count = 0;
         
@@ -500,9 +558,177 @@ EXTERNAL Scratch        global_scratch_acquire();
         return stats;
     }
 
+    typedef struct _Scratch_Arena_Pool {
+        Platform_Mutex mutex;
+        isize generation;
+        isize reserve_size;
+        isize commit_granularity;
+        isize stack_max_depth;
+        u32 flags;
+        isize max_pooled;
+        Scratch_Arena_Pool_Stats stats;
+        Scratch_Arena pooled[SCRATCH_ARENA_POOL_CAPACITY];
+    } _Scratch_Arena_Pool;
+
+    INTERNAL _Scratch_Arena_Pool* _scratch_arena_pool()
+    {
+        static _Scratch_Arena_Pool pool = {0};
+        static volatile uint32_t init = 0;
+        if(platform_once_begin(&init))
+        {
+            platform_mutex_init(&pool.mutex);
+            pool.generation = 1;
+            pool.max_pooled = SCRATCH_ARENA_POOL_CAPACITY;
+            platform_once_end(&init);
+        }
+        return &pool;
+    }
+
+    INTERNAL void _scratch_arena_pool_release(void* context)
+    {
+        Scratch_Arena* arena = (Scratch_Arena*) context;
+
+        //Release all frames the thread did not release
+        isize garbage_size = 0;
+        for(isize k = 0; k < SCRATCH_ARENA_CHANNELS; k++)
+        {
+            Scratch_Stack* stack = &arena->stacks[k];
+            u8* used_from = (u8*) (stack->frames + arena->frame_capacity/SCRATCH_ARENA_CHANNELS);
+            garbage_size = MAX(garbage_size, *stack->curr_frame - used_from);
+            stack->curr_frame = stack->frames;
+            *stack->curr_frame = used_from;
+        }
+        arena->frame_count = 0;
+        _scratch_arena_fill_garbage(arena, garbage_size);
+        _scratch_arena_check_invariants(arena);
+
+        _Scratch_Arena_Pool* pool = _scratch_arena_pool();
+        bool pooled = false;
+        allocator_registry_remove(arena->alloc);
+        platform_mutex_lock(&pool->mutex);
+        if(arena->pool_generation == pool->generation && pool->stats.pooled_count < pool->max_pooled)
+        {
+            pool->pooled[pool->stats.pooled_count++] = *arena;
+            pooled = true;
+        }
+        else
+            pool->stats.discarded_count += 1;
+        platform_mutex_unlock(&pool->mutex);
+
+        if(pooled)
+            memset(arena, 0, sizeof *arena);
+        else
+            scratch_arena_deinit(arena);
+    }
+
+    INTERNAL ATTRIBUTE_INLINE_NEVER void _scratch_arena_pool_attach(Scratch_Arena* arena)
+    {
+        PROFILE_START();
+        _Scratch_Arena_Pool* pool = _scratch_arena_pool();
+        platform_mutex_lock(&pool->mutex);
+        bool reused = pool->stats.pooled_count > 0;
+        if(reused)
+        {
+            *arena = pool->pooled[--pool->stats.pooled_count];
+            pool->stats.reused_count += 1;
+        }
+        else
+            pool->stats.created_count += 1;
+
+        isize generation = pool->generation;
+        isize reserve_size = pool->reserve_size;
+        isize commit_granularity = pool->commit_granularity;
+        isize stack_max_depth = pool->stack_max_depth;
+        u32 flags = pool->flags;
+        platform_mutex_unlock(&pool->mutex);
+
+        //If this fails the arena stays uninit and the first scratch_acquire reports it
+        if(reused)
+            allocator_registry_track(arena->alloc);
+        else if(scratch_arena_init_custom(arena, "thread_scratch_arena", reserve_size, commit_granularity, stack_max_depth, flags, 0) == 0)
+            arena->pool_generation = generation;
+
+        if(arena->reserved_from)
+            platform_thread_attach_deinit(_scratch_arena_pool_release, arena);
+        PROFILE_STOP();
+    }
+
+    EXTERNAL void scratch_arena_pool_trim()
+    {
+        _Scratch_Arena_Pool* pool = _scratch_arena_pool();
+        Scratch_Arena trimmed[SCRATCH_ARENA_POOL_CAPACITY];
+
+        platform_mutex_lock(&pool->mutex);
+        isize trimmed_count = pool->stats.pooled_count;
+        memcpy(trimmed, pool->pooled, (size_t) trimmed_count*sizeof(Scratch_Arena));
+        pool->stats.pooled_count = 0;
+        platform_mutex_unlock(&pool->mutex);
+
+        for(isize i = 0; i < trimmed_count; i++)
+            scratch_arena_deinit(&trimmed[i]);
+    }
+
+    EXTERNAL void scratch_arena_pool_configure(isize reserve_size_or_zero, isize commit_granularity_or_zero, isize stack_max_depth_or_zero, u32 flags, isize max_pooled_or_zero)
+    {
+        REQUIRE(reserve_size_or_zero >= 0);
+        REQUIRE(commit_granularity_or_zero >= 0);
+        REQUIRE(stack_max_depth_or_zero >= 0);
+        REQUIRE(0 <= max_pooled_or_zero && max_pooled_or_zero <= SCRATCH_ARENA_POOL_CAPACITY);
+
+        _Scratch_Arena_Pool* pool = _scratch_arena_pool();
+        platform_mutex_lock(&pool->mutex);
+        pool->generation += 1;
+        pool->reserve_size = reserve_size_or_zero;
+        pool->commit_granularity = commit_granularity_or_zero;
+        pool->stack_max_depth = stack_max_depth_or_zero;
+        pool->flags = flags;
+        pool->max_pooled = max_pooled_or_zero > 0 ? max_pooled_or_zero : SCRATCH_ARENA_POOL_CAPACITY;
+        platform_mutex_unlock(&pool->mutex);
+
+        scratch_arena_pool_trim();
+    }
+
+    EXTERNAL Scratch_Arena_Pool_Stats scratch_arena_pool_get_stats()
+    {
+        _Scratch_Arena_Pool* pool = _scratch_arena_pool();
+        platform_mutex_lock(&pool->mutex);
+        Scratch_Arena_Pool_Stats stats = pool->stats;
+        platform_mutex_unlock(&pool->mutex);
+        return stats;
+    }
+
+    INTERNAL void* _scratch_arena_unsupported_func(Allocator* self, isize new_size, void* old_ptr, isize old_size, isize align, Allocator_Error* error)
+    {
+        allocator_error(error, ALLOCATOR_ERROR_UNSUPPORTED, self, new_size, old_ptr, old_size, align, 
+            "Scratch_Arena cannot be allocated from directly! Use scratch_acquire() and allocate from the returned Scratch.");
+        return NULL;
+    }
+
+    EXTERNAL Allocator_Stats scratch_arena_get_stats(Allocator* self)
+    {
+        Scratch_Arena* arena = (Scratch_Arena*) (void*) self;
+        Allocator_Stats stats = {0};
+        stats.type_name = "Scratch_Arena";
+        stats.name = arena->name;
+        stats.is_top_level = true;
+        stats.is_capable_of_free_all = true;
+        stats.fixed_memory_pool_size = arena->reserved_size;
+        for(isize k = 0; k < SCRATCH_ARENA_CHANNELS; k++)
+        {
+            Scratch_Stack* stack = &arena->stacks[k];
+            u8* used_from = (u8*) (stack->frames + arena->frame_capacity/SCRATCH_ARENA_CHANNELS);
+            if(stack->curr_frame)
+                stats.bytes_allocated += *stack->curr_frame - used_from;
+        }
+        stats.max_bytes_allocated = stats.bytes_allocated;
+        return stats;
+    }
+
     EXTERNAL ATTRIBUTE_INLINE_ALWAYS Scratch_Arena* global_scratch_arena()
     {
         static ATTRIBUTE_THREAD_LOCAL Scratch_Arena _scratch_stack = {0};
+        if(_scratch_stack.reserved_from == NULL)
+            _scratch_arena_pool_attach(&_scratch_stack);
         return &_scratch_stack;
     }
 
@@ -159,7 +159,7 @@ EXTERNAL void stable_array_deinit(Stable_Array* stable)
         allocator_deallocate(stable->allocator, stable->blocks[k].ptr, (i - k)*STABLE_ARRAY_BLOCK_SIZE*stable->item_size, stable->item_align);
     }
 
-    allocator_deallocate(stable->allocator, stable->blocks, stable->blocks_count*isizeof(Stable_Array_Block), _STABLE_ARRAY_BLOCKS_ARR_ALIGN);
+    allocator_deallocate(stable->allocator, stable->blocks, stable->blocks_capacity*isizeof(Stable_Array_Block), _STABLE_ARRAY_BLOCKS_ARR_ALIGN);
     memset(stable, 0, sizeof *stable);
 }
 
@@ -258,7 +258,7 @@ EXTERNAL void stable_array_reserve(Stable_Array* stable, isize to_size)
             isize old_alloced = stable->blocks_capacity * sizeof(Stable_Array_Block);
             isize new_alloced = new_capacity * sizeof(Stable_Array_Block);
             
-            u8* alloced = (u8*) allocator_reallocate(stable->allocator, new_alloced, stable->blocks, stable->blocks_capacity, _STABLE_ARRAY_BLOCKS_ARR_ALIGN);
+            u8* alloced = (u8*) allocator_reallocate(stable->allocator, new_alloced, stable->blocks, old_alloced, _STABLE_ARRAY_BLOCKS_ARR_ALIGN);
             memset(alloced + old_alloced, 0, (size_t) (new_alloced - old_alloced));
 
             stable->blocks = (Stable_Array_Block*) alloced;
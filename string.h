@@ -626,6 +626,8 @@ EXTERNAL bool char_is_id(char c);
         else
             //We clear the memory when shrinking so that we dont have to clear it when pushing!
             memset(builder->data + to_size, 0, (size_t) ((builder->count - to_size)));
+
+        builder->count = to_size;
     }
 
     EXTERNAL void builder_resize(String_Builder* builder, isize to_size)
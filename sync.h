@@ -1,4 +1,8 @@
+#ifndef MODULE_SYNC
+#define MODULE_SYNC
+
 #include "channel.h"
+#include <stddef.h>
 
 //==========================================================================
 // Wait free list 
@@ -20,7 +24,171 @@
         if(atomic_compare_exchange_weak(__head, &__curr, (void*) (first_node_ptr)))         \
             break;                                                                          \
     }                                                                                       \
-    
+
+//==========================================================================
+// MPSC queue
+//==========================================================================
+// An unbounded intrusive multi producer single consumer FIFO queue (Dmitry Vyukov's design).
+// Nodes are linked through a `next` pointer member just like in list.h, only its offset
+// needs to be supplied to sync_queue_init() (or use sync_queue_init_for() with node type).
+//
+// Push is wait free - one atomic exchange of head followed by a store into the previous node.
+// Pop is done by a single consumer thread and uses no read-modify-write atomics at all.
+// The price is that between the exchange and the store the queue is momentarily "cut":
+// the consumer cannot see the pushed node nor anything pushed after it. In that case
+// sync_queue_pop() returns NULL even though sync_queue_is_empty() is false.
+// sync_queue_pop_wait() spins until the push gets finished.
+//
+// When the consumer takes the last node it pushes the stub behind it. A producer can exchange head
+// just before that, so the stub can end up queued behind nodes that are not yet linked. Thus head
+// pointing to the stub does not by itself mean the queue is empty - the stub must also be the tail.
+//
+// The queue contains its own stub node so that it never becomes truly empty. The stub is
+// only the stub_next field posing as a next member of some (never dereferenced) node.
+//
+// Ownership rules are the same as for sync_list: after push the pusher must no longer
+// touch the node, once popped the consumer has exclusive ownership of it.
+typedef struct Sync_Queue {
+    alignas(CHAN_CACHE_LINE)
+    CHAN_ATOMIC(void*) head; //the most recently pushed node. Exchanged by producers.
+
+    alignas(CHAN_CACHE_LINE)
+    CHAN_ATOMIC(void*) tail; //the oldest node. Written only by the consumer, atomic so that sync_queue_is_empty() can be called from anywhere.
+    isize next_offset;
+    CHAN_ATOMIC(void*) stub_next;
+} Sync_Queue;
+
+#define sync_queue_init_for(queue_ptr, Node_Type) sync_queue_init((queue_ptr), offsetof(Node_Type, next))
+
+CHANAPI void  sync_queue_init(Sync_Queue* queue, isize next_offset);
+//Returns true if there are no nodes in the queue including ones whose push is still in progress.
+// Exact when called by the consumer, only a snapshot when called by others.
+CHANAPI bool  sync_queue_is_empty(Sync_Queue* queue);
+CHANAPI void  sync_queue_push(Sync_Queue* queue, void* node);
+//Pushes already linked chain of nodes first -> ... -> last. The whole chain becomes visible at once.
+CHANAPI void  sync_queue_push_chain(Sync_Queue* queue, void* first, void* last);
+//Pops the oldest node. Returns NULL if the queue is empty or a producer is in the middle of push. Consumer only.
+CHANAPI void* sync_queue_pop(Sync_Queue* queue);
+//Pops the oldest node. Returns NULL only if the queue is empty. Consumer only.
+CHANAPI void* sync_queue_pop_wait(Sync_Queue* queue);
+//Pops up to max_count nodes and returns them as a NULL terminated chain linked through their next members
+// so that they can be directly used with list.h macros. Saves the number of popped nodes into count_or_null. Consumer only.
+CHANAPI void* sync_queue_pop_batch(Sync_Queue* queue, isize max_count, isize* count_or_null);
+
+#define _sync_queue_next(queue, node) ((CHAN_ATOMIC(void*)*) (void*) ((uint8_t*) (node) + (queue)->next_offset))
+#define _sync_queue_stub(queue) ((void*) ((uint8_t*) (void*) &(queue)->stub_next - (queue)->next_offset))
+
+CHANAPI void sync_queue_init(Sync_Queue* queue, isize next_offset)
+{
+    memset(queue, 0, sizeof *queue);
+    queue->next_offset = next_offset;
+    atomic_store(&queue->tail, _sync_queue_stub(queue));
+    atomic_store(&queue->stub_next, NULL);
+    atomic_store(&queue->head, _sync_queue_stub(queue));
+}
+
+CHANAPI bool sync_queue_is_empty(Sync_Queue* queue)
+{
+    //The stub must be the only node: if its not the tail there are (possibly not yet linked)
+    // nodes before it, if it has next or is not the head there are nodes after it.
+    void* stub = _sync_queue_stub(queue);
+    return atomic_load_explicit(&queue->tail, memory_order_relaxed) == stub
+        && atomic_load(&queue->stub_next) == NULL
+        && atomic_load(&queue->head) == stub;
+}
+
+CHANAPI void sync_queue_push_chain(Sync_Queue* queue, void* first, void* last)
+{
+    atomic_store_explicit(_sync_queue_next(queue, last), NULL, memory_order_relaxed);
+    void* prev = atomic_exchange_explicit(&queue->head, last, memory_order_acq_rel);
+    //<- here is the queue cut. Consumer sees prev as the last node until the store below.
+    atomic_store_explicit(_sync_queue_next(queue, prev), first, memory_order_release);
+}
+
+CHANAPI void sync_queue_push(Sync_Queue* queue, void* node)
+{
+    sync_queue_push_chain(queue, node, node);
+}
+
+CHANAPI void* sync_queue_pop(Sync_Queue* queue)
+{
+    void* stub = _sync_queue_stub(queue);
+    void* tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    void* next = atomic_load_explicit(_sync_queue_next(queue, tail), memory_order_acquire);
+
+    //skip over the stub
+    if(tail == stub)
+    {
+        if(next == NULL)
+            return NULL;
+
+        atomic_store_explicit(&queue->tail, next, memory_order_relaxed);
+        tail = next;
+        next = atomic_load_explicit(_sync_queue_next(queue, next), memory_order_acquire);
+    }
+
+    if(next)
+    {
+        atomic_store_explicit(&queue->tail, next, memory_order_relaxed);
+        return tail;
+    }
+
+    //tail is not the last pushed node but its next is not yet linked
+    // => some producer is in the middle of push
+    void* head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if(tail != head)
+        return NULL;
+
+    //tail is the only node. We cannot take it since the queue must never
+    // be without a node so we push the stub behind it.
+    sync_queue_push(queue, stub);
+    next = atomic_load_explicit(_sync_queue_next(queue, tail), memory_order_acquire);
+    if(next)
+    {
+        atomic_store_explicit(&queue->tail, next, memory_order_relaxed);
+        return tail;
+    }
+
+    //someone pushed between our load of head and the stub push and did not yet finish.
+    return NULL;
+}
+
+CHANAPI void* sync_queue_pop_wait(Sync_Queue* queue)
+{
+    for(;;) {
+        void* node = sync_queue_pop(queue);
+        if(node || sync_queue_is_empty(queue))
+            return node;
+
+        chan_pause();
+    }
+}
+
+CHANAPI void* sync_queue_pop_batch(Sync_Queue* queue, isize max_count, isize* count_or_null)
+{
+    void* first = NULL;
+    void* last = NULL;
+    isize count = 0;
+    for(; count < max_count; count++)
+    {
+        void* node = sync_queue_pop(queue);
+        if(node == NULL)
+            break;
+
+        if(last)
+            atomic_store_explicit(_sync_queue_next(queue, last), node, memory_order_relaxed);
+        else
+            first = node;
+        last = node;
+    }
+
+    if(last)
+        atomic_store_explicit(_sync_queue_next(queue, last), NULL, memory_order_relaxed);
+    if(count_or_null)
+        *count_or_null = count;
+    return first;
+}
+
 //==========================================================================
 // Wait/Wake helpers
 //==========================================================================
@@ -43,6 +211,7 @@ typedef struct Sync_Wait {
 #define SYNC_WAIT_BLOCK          _CHAN_SINIT(Sync_Wait){chan_wait_block, chan_wake_block}
 #define SYNC_WAIT_YIELD          _CHAN_SINIT(Sync_Wait){chan_wait_yield}
 #define SYNC_WAIT_SPIN           _CHAN_SINIT(Sync_Wait){}
+#define SYNC_WAIT_ADAPTIVE       _CHAN_SINIT(Sync_Wait){chan_wait_adaptive, chan_wake_block}
 #define SYNC_WAIT_BLOCK_BIT(bit) _CHAN_SINIT(Sync_Wait){chan_wait_block, chan_wake_block, 1u << bit}
 
 CHANAPI bool sync_wait(volatile void* state, uint32_t current, isize timeout, Sync_Wait wait);
@@ -452,3 +621,4 @@ CHANAPI bool wait_group_wait_timed(volatile Wait_Group* wg, double timeout, Sync
             chan_pause();
     }
 }
+#endif
@@ -41,7 +41,7 @@ EXTERNAL String_Builder translate_error_builder(Allocator* alloc, Platform_Error
             isize base_size = append_to->count; 
             builder_resize_for_overwrite(append_to, append_to->count + size);
 
-            if(size > sizeof local) {
+            if(size >= sizeof local) {
                 PROFILE_INSTANT("format twice")
                 vsnprintf(append_to->data + base_size, size + 1, format, args);
             }